@@ -25,6 +25,9 @@ COPYRIGHT 1993-1998 PARALLAX SOFTWARE CORPORATION.  ALL RIGHTS RESERVED.
  */
 
 #include <algorithm>
+#include <memory>
+#include <unordered_map>
+#include <vector>
 #include <stdlib.h>
 #include <stdio.h>
 #include <string.h>
@@ -35,6 +38,9 @@ COPYRIGHT 1993-1998 PARALLAX SOFTWARE CORPORATION.  ALL RIGHTS RESERVED.
 #include "dxxerror.h"
 #include "rle.h"
 #include "byteutil.h"
+#if !DXX_USE_OGL
+#include "texmap.h"
+#endif
 
 #include "compiler-range_for.h"
 #include "d_range.h"
@@ -42,14 +48,6 @@ COPYRIGHT 1993-1998 PARALLAX SOFTWARE CORPORATION.  ALL RIGHTS RESERVED.
 namespace dcx {
 namespace {
 
-constexpr uint8_t RLE_CODE{0xe0};
-constexpr uint8_t NOT_RLE_CODE{0x1f};
-static_assert((RLE_CODE | NOT_RLE_CODE) == 0xff, "RLE mask error");
-static inline int IS_RLE_CODE(const uint8_t &x)
-{
-	return (x & RLE_CODE) == RLE_CODE;
-}
-
 union rle_size_pun {
 	uint8_t *rle_little;
 	uint16_t *rle_big;
@@ -58,34 +56,6 @@ union rle_size_pun {
 }
 #define rle_stosb(_dest, _len, _color)	memset(_dest,_color,_len)
 
-uint8_t *gr_rle_decode(const color_palette_index *sb, color_palette_index *db, const rle_position_t e)
-{
-	using std::advance;
-	using std::distance;
-	for (; sb != e.src;)
-	{
-		auto p{sb};
-		color_palette_index c;
-		for (; c = *p, !IS_RLE_CODE(c);)
-			if (++p == e.src)
-				return db;
-		const size_t count{(size_t{c} & NOT_RLE_CODE)};
-		const size_t cn{std::min<size_t>(distance(sb, p), distance(db, e.dst))};
-		memcpy(db, sb, cn);
-		advance(db, cn);
-		if (!count)
-			break;
-		advance(sb, cn);
-		if (sb == e.src || db == e.dst || count > static_cast<size_t>(distance(db, e.dst)))
-			break;
-		if (++ sb == e.src)
-			break;
-		std::fill_n(db, count, *sb++);
-		advance(db, count);
-	}
-	return db;
-}
-
 #if !DXX_USE_OGL
 // Given pointer to start of one scanline of rle data, uncompress it to
 // dest, from source pixels x1 to x2.
@@ -367,42 +337,88 @@ void gr_bitmap_rle_compress(grs_bitmap &bmp)
 
 namespace {
 
-struct rle_cache_element
+/* Budget for decoded bitmaps, in bytes.  The cache is split into two
+ * generations of half the budget each.  When the current generation
+ * fills, the previous one is freed and the current one takes its
+ * place.  A bitmap found in the previous generation is copied to the
+ * current one, so that bitmaps in use survive the switch, and a pointer
+ * returned by _rle_expand_texture stays valid until the generation
+ * after next fills, which is far longer than any caller keeps it.
+ */
+constexpr std::size_t rle_cache_budget{8u << 20};
+
+/* Storage for decoded pixels.  Allocations are carved from large
+ * chunks, and are only ever freed all at once.
+ */
+class rle_cache_arena
 {
-	const grs_bitmap *rle_bitmap;
-	grs_bitmap_ptr expanded_bitmap;
-	int last_used;
+	static constexpr std::size_t chunk_size{256u << 10};
+	std::vector<std::unique_ptr<uint8_t[]>> chunks;
+	std::size_t chunk_used{chunk_size};
+public:
+	std::size_t used{0};
+	[[nodiscard]]
+	uint8_t *allocate(std::size_t n);
+	void clear()
+	{
+		chunks.clear();
+		chunk_used = chunk_size;
+		used = 0;
+	}
 };
 
-static int rle_cache_initialized;
-static int rle_counter;
-static int rle_next;
-static std::array<rle_cache_element, 32> rle_cache;
-
-static void rle_cache_init()
+uint8_t *rle_cache_arena::allocate(const std::size_t n)
 {
-	rle_cache = {};
-	rle_cache_initialized = 1;
+	used += n;
+	if (n > chunk_size / 4)
+	{
+		/* Give a large bitmap its own chunk, and keep the partly used
+		 * chunk last, so that later small bitmaps continue to fill it.
+		 */
+		auto &c{chunks.emplace_back(std::make_unique_for_overwrite<uint8_t[]>(n))};
+		const auto result{c.get()};
+		if (chunks.size() > 1 && chunk_used != chunk_size)
+			std::swap(chunks.back(), chunks[chunks.size() - 2]);
+		return result;
+	}
+	if (chunk_size - chunk_used < n)
+	{
+		chunks.emplace_back(std::make_unique_for_overwrite<uint8_t[]>(chunk_size));
+		chunk_used = 0;
+	}
+	const auto result{&chunks.back()[chunk_used]};
+	chunk_used += n;
+	return result;
 }
 
+struct rle_cache_generation
+{
+	rle_cache_arena arena;
+	/* Keyed by the RLE bitmap.  Values are the expanded bitmaps, whose
+	 * pixels are in `arena`.  Nodes of an unordered_map do not move, so
+	 * pointers to the values stay valid until the map is cleared.
+	 */
+	std::unordered_map<const grs_bitmap *, grs_bitmap> index;
+	void clear()
+	{
+		index.clear();
+		arena.clear();
+	}
+};
+
+static rle_cache_generation rle_cache_current, rle_cache_previous;
+
 }
 
 void rle_cache_close(void)
 {
-	if (rle_cache_initialized)	{
-		rle_cache_initialized = 0;
-		range_for (auto &i, rle_cache)
-			i.expanded_bitmap.reset();
-	}
+	rle_cache_flush();
 }
 
 void rle_cache_flush()
 {
-	range_for (auto &i, rle_cache)
-	{
-		i.rle_bitmap = NULL;
-		i.last_used = 0;
-	}
+	rle_cache_current.clear();
+	rle_cache_previous.clear();
 }
 
 namespace {
@@ -415,56 +431,52 @@ static void rle_expand_texture_sub(const grs_bitmap &bmp, grs_bitmap &rle_temp_b
 	rle_temp_bitmap_1.set_flags(bmp.get_flags() & (~BM_FLAG_RLE));
 
 	for (int i{0}; i < bmp.bm_h; i++ ) {
-		gr_rle_decode(sbits, dbits, rle_end(bmp, rle_temp_bitmap_1));
-		sbits += static_cast<int>(bmp.bm_data[4+i]);
+		const auto row_size{static_cast<int>(bmp.bm_data[4+i])};
+		gr_rle_decode(sbits, dbits, {sbits + row_size, end(rle_temp_bitmap_1)});
+		sbits += row_size;
 		dbits += bmp.bm_w;
 	}
 }
 
+/* Make room for a bitmap of `size` bytes in the current generation. */
+static void rle_cache_reserve(const std::size_t size)
+{
+	if (rle_cache_current.arena.used + size <= rle_cache_budget / 2 || rle_cache_current.index.empty())
+		return;
+#if !DXX_USE_OGL
+	/* Polygons recorded by the binned rasterizer may use bitmaps of
+	 * the generation about to be freed.
+	 */
+	tmap_flush_bin();
+#endif
+	std::swap(rle_cache_previous, rle_cache_current);
+	rle_cache_current.clear();
+}
+
 }
 
 grs_bitmap *_rle_expand_texture(const grs_bitmap &bmp)
 {
-	int lowest_count, lc;
-
-	if (!rle_cache_initialized) rle_cache_init();
-
 	Assert(!(bmp.get_flag_mask(BM_FLAG_PAGED_OUT)));
 
-	lc = rle_counter;
-	rle_counter++;
-
-	if (rle_counter < 0)
-		rle_counter = 0;
-	
-	if ( rle_counter < lc )	{
-		rle_cache_flush();
-	}
-
-	lowest_count = rle_cache[rle_next].last_used;
-	auto least_recently_used{&rle_cache[rle_next]};
-	rle_next++;
-	if (rle_next >= rle_cache.size())
-		rle_next = 0;
-
-	range_for (auto &i, rle_cache)
+	if (const auto i{rle_cache_current.index.find(&bmp)}; i != rle_cache_current.index.end())
+		return &i->second;
+	/* Reserve before searching the previous generation, since reserving
+	 * may free it.
+	 */
+	const std::size_t size{std::size_t{bmp.bm_w} * bmp.bm_h};
+	rle_cache_reserve(size);
+	auto &expanded{rle_cache_current.index[&bmp]};
+	gr_init_bitmap(expanded, bm_mode::linear, 0, 0, bmp.bm_w, bmp.bm_h, bmp.bm_w, rle_cache_current.arena.allocate(size));
+	if (const auto i{rle_cache_previous.index.find(&bmp)}; i != rle_cache_previous.index.end())
 	{
-		if (i.rle_bitmap == &bmp)
-		{
-			i.last_used = rle_counter;
-			return i.expanded_bitmap.get();
-		}
-		if (i.last_used < lowest_count)
-		{
-			lowest_count = (least_recently_used = &i)->last_used;
-		}
+		const auto &old{i->second};
+		expanded.set_flags(old.get_flags());
+		memcpy(expanded.get_bitmap_data(), old.bm_data, size);
 	}
-
-	least_recently_used->expanded_bitmap = gr_create_bitmap(bmp.bm_w, bmp.bm_h);
-	rle_expand_texture_sub(bmp, *least_recently_used->expanded_bitmap.get());
-	least_recently_used->rle_bitmap = &bmp;
-	least_recently_used->last_used = rle_counter;
-	return least_recently_used->expanded_bitmap.get();
+	else
+		rle_expand_texture_sub(bmp, expanded);
+	return &expanded;
 }
 
 #if !DXX_USE_OGL
@@ -633,7 +645,7 @@ void rle_remap(grs_bitmap &bmp, std::array<color_palette_index, 256> &colormap)
 	memcpy(&bmp.get_bitmap_data()[4], &temp.get()[4], len - 4);
 }
 
-void bm_rle_src_stride::advance_src_bits()
+uintptr_t bm_rle_src_stride::get_src_row_size() const
 {
 	/* Both bytes are always legal to read since the bitmap data
 	 * is placed after the length table.  Reading both, then
@@ -641,14 +653,20 @@ void bm_rle_src_stride::advance_src_bits()
 	 * BM_FLAG_RLE_BIG) encourages the compiler to implement
 	 * this line without using branches.
 	 */
-	const uintptr_t u{(ptr_src_bit_lengths[0] | (static_cast<uintptr_t>(ptr_src_bit_lengths[1]) << 8)) & src_bit_load_mask};
+	return (ptr_src_bit_lengths[0] | (static_cast<uintptr_t>(ptr_src_bit_lengths[1]) << 8)) & src_bit_load_mask;
+}
+
+void bm_rle_src_stride::advance_src_bits()
+{
+	const auto u{get_src_row_size()};
 	ptr_src_bit_lengths += src_bit_stride_size;
 	src_bits += u;
 }
 
 bm_rle_expand::step_result bm_rle_expand::step_internal(uint8_t *const begin_dbits, uint8_t *const end_dbits)
 {
-	const auto rd{gr_rle_decode(src_bits, begin_dbits, {end_src_bm, end_dbits})};
+	const auto end_row{std::min(src_bits + get_src_row_size(), end_src_bm)};
+	const auto rd{gr_rle_decode(src_bits, begin_dbits, {end_row, end_dbits})};
 	/* If the destination buffer is exhausted, return without
 	 * modifying the source state.  This lets the caller retry
 	 * with a larger buffer, if desired.
@@ -0,0 +1,123 @@
+/*
+ * This file is part of the DXX-Rebirth project <https://www.dxx-rebirth.com/>.
+ * It is copyright by its individual contributors, as recorded in the
+ * project's Git history.  See COPYING.txt at the top level for license
+ * terms and a link to the Git history.
+ */
+
+/*
+ *
+ * Decoder for one row of an RLE bitmap
+ *
+ */
+
+#include "rle_decode.h"
+#include <algorithm>
+#include <bit>
+#include <cstring>
+#include <iterator>
+
+#if defined(__SSE2__)
+#define DXX_RLE_SSE2	1
+#include <emmintrin.h>
+#elif defined(__ARM_NEON)
+#define DXX_RLE_NEON	1
+#include <arm_neon.h>
+#endif
+
+namespace dcx {
+
+namespace {
+
+/* Return the first RLE code in [p, e), or `e` if there is none.  Every
+ * byte in [p, e) must be readable, so the vector loop never reads past
+ * `e`.
+ */
+static const uint8_t *rle_find_code(const uint8_t *p, const uint8_t *const e)
+{
+#if DXX_RLE_SSE2
+	/* SSE2 has no unsigned byte compare, but c >= RLE_CODE exactly when
+	 * max(c, RLE_CODE) == c.
+	 */
+	const __m128i code = _mm_set1_epi8(static_cast<char>(RLE_CODE));
+	for (; e - p >= 16; p += 16)
+	{
+		const __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i *>(p));
+		if (const unsigned m = _mm_movemask_epi8(_mm_cmpeq_epi8(_mm_max_epu8(v, code), v)))
+			return p + std::countr_zero(m);
+	}
+#elif DXX_RLE_NEON
+	/* Narrow the byte mask to four bits per byte, so that it fits in
+	 * one 64-bit lane.
+	 */
+	const uint8x16_t code = vdupq_n_u8(RLE_CODE);
+	for (; e - p >= 16; p += 16)
+	{
+		const uint8x16_t m = vcgeq_u8(vld1q_u8(p), code);
+		if (const uint64_t bits = vget_lane_u64(vreinterpret_u64_u8(vshrn_n_u16(vreinterpretq_u16_u8(m), 4)), 0))
+			return p + std::countr_zero(bits) / 4;
+	}
+#endif
+	for (; p != e && !IS_RLE_CODE(*p); ++p)
+	{
+	}
+	return p;
+}
+
+/* Write `count` copies of `color`.  Runs are at most NOT_RLE_CODE
+ * pixels long, so two overlapping 16-byte stores cover any run of 16 or
+ * more, without writing past the end of the run.
+ */
+static void rle_fill_run(uint8_t *const db, const std::size_t count, const uint8_t color)
+{
+	static_assert(NOT_RLE_CODE <= 32);
+#if DXX_RLE_SSE2
+	if (count >= 16)
+	{
+		const __m128i c = _mm_set1_epi8(static_cast<char>(color));
+		_mm_storeu_si128(reinterpret_cast<__m128i *>(db), c);
+		_mm_storeu_si128(reinterpret_cast<__m128i *>(db + count - 16), c);
+		return;
+	}
+#elif DXX_RLE_NEON
+	if (count >= 16)
+	{
+		const uint8x16_t c = vdupq_n_u8(color);
+		vst1q_u8(db, c);
+		vst1q_u8(db + count - 16, c);
+		return;
+	}
+#endif
+	std::fill_n(db, count, color);
+}
+
+}
+
+uint8_t *gr_rle_decode(const uint8_t *sb, uint8_t *db, const rle_position_t e)
+{
+	using std::advance;
+	using std::distance;
+	for (; sb != e.src;)
+	{
+		const auto p{rle_find_code(sb, e.src)};
+		if (p == e.src)
+			return db;
+		const uint8_t c{*p};
+		const size_t count{(size_t{c} & NOT_RLE_CODE)};
+		const size_t cn{std::min<size_t>(distance(sb, p), distance(db, e.dst))};
+		memcpy(db, sb, cn);
+		advance(db, cn);
+		if (!count)
+			break;
+		advance(sb, cn);
+		if (sb == e.src || db == e.dst || count > static_cast<size_t>(distance(db, e.dst)))
+			break;
+		if (++ sb == e.src)
+			break;
+		rle_fill_run(db, count, *sb++);
+		advance(db, count);
+	}
+	return db;
+}
+
+}
@@ -0,0 +1,106 @@
+/*
+ * This file is part of the DXX-Rebirth project <https://www.dxx-rebirth.com/>.
+ * It is copyright by its individual contributors, as recorded in the
+ * project's Git history.  See COPYING.txt at the top level for license
+ * terms and a link to the Git history.
+ */
+
+/*
+ *
+ * Blend kernel for merged wall textures
+ *
+ */
+
+#include "texmerge_row.h"
+
+#if defined(__SSE2__)
+#define DXX_TEXMERGE_ROW_SSE2	1
+#include <emmintrin.h>
+#elif defined(__ARM_NEON)
+#define DXX_TEXMERGE_ROW_NEON	1
+#include <arm_neon.h>
+#endif
+
+namespace dcx {
+
+namespace {
+
+/* Each kernel handles whole vectors from the front of the row, and
+ * returns how many pixels it handled.  The scalar loop finishes the
+ * rest.
+ *
+ * The transparency mask is computed before the supertransparent remap,
+ * so a remapped 254 stays 255 in the result instead of showing the
+ * bottom bitmap.  The remap itself is an OR with the mask of 254
+ * pixels, since 254 | 0xff == 255.
+ */
+#if DXX_TEXMERGE_ROW_SSE2
+template <bool super_transparent>
+std::size_t texmerge_row_sse2(uint8_t *const dest, const uint8_t *const top, const uint8_t *const bottom, const std::size_t count)
+{
+	const __m128i xparent = _mm_set1_epi8(static_cast<char>(255));
+	const __m128i super_xparent = _mm_set1_epi8(static_cast<char>(254));
+	std::size_t i = 0;
+	for (; i + 16 <= count; i += 16)
+	{
+		__m128i t = _mm_loadu_si128(reinterpret_cast<const __m128i *>(top + i));
+		const __m128i b = _mm_loadu_si128(reinterpret_cast<const __m128i *>(bottom + i));
+		const __m128i m = _mm_cmpeq_epi8(t, xparent);
+		if constexpr (super_transparent)
+			t = _mm_or_si128(t, _mm_cmpeq_epi8(t, super_xparent));
+		_mm_storeu_si128(reinterpret_cast<__m128i *>(dest + i), _mm_or_si128(_mm_and_si128(m, b), _mm_andnot_si128(m, t)));
+	}
+	return i;
+}
+#elif DXX_TEXMERGE_ROW_NEON
+template <bool super_transparent>
+std::size_t texmerge_row_neon(uint8_t *const dest, const uint8_t *const top, const uint8_t *const bottom, const std::size_t count)
+{
+	const uint8x16_t xparent = vdupq_n_u8(255);
+	const uint8x16_t super_xparent = vdupq_n_u8(254);
+	std::size_t i = 0;
+	for (; i + 16 <= count; i += 16)
+	{
+		uint8x16_t t = vld1q_u8(top + i);
+		const uint8x16_t m = vceqq_u8(t, xparent);
+		if constexpr (super_transparent)
+			t = vorrq_u8(t, vceqq_u8(t, super_xparent));
+		vst1q_u8(dest + i, vbslq_u8(m, vld1q_u8(bottom + i), t));
+	}
+	return i;
+}
+#endif
+
+template <bool super_transparent>
+void texmerge_row_case(uint8_t *const dest, const uint8_t *const top, const uint8_t *const bottom, const std::size_t count)
+{
+	std::size_t i =
+#if DXX_TEXMERGE_ROW_SSE2
+		texmerge_row_sse2<super_transparent>(dest, top, bottom, count);
+#elif DXX_TEXMERGE_ROW_NEON
+		texmerge_row_neon<super_transparent>(dest, top, bottom, count);
+#else
+		0;
+#endif
+	for (; i != count; ++i)
+	{
+		const uint8_t c = top[i];
+		dest[i] = (c == 255)
+			? bottom[i]
+			: (super_transparent && c == 254)
+				? 255
+				: c;
+	}
+}
+
+}
+
+void texmerge_row(uint8_t *const dest, const uint8_t *const top, const uint8_t *const bottom, const std::size_t count, const bool super_transparent)
+{
+	if (super_transparent)
+		texmerge_row_case<true>(dest, top, bottom, count);
+	else
+		texmerge_row_case<false>(dest, top, bottom, count);
+}
+
+}
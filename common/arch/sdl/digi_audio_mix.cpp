@@ -0,0 +1,191 @@
+/*
+ * This file is part of the DXX-Rebirth project <https://www.dxx-rebirth.com/>.
+ * It is copyright by its individual contributors, as recorded in the
+ * project's Git history.  See COPYING.txt at the top level for license
+ * terms and a link to the Git history.
+ */
+
+/*
+ *
+ * Mixing kernels for the SDL digital audio backend
+ *
+ */
+
+#include <algorithm>
+#include <cstring>
+#include "digi_audio_mix.h"
+
+#if defined(__SSE2__)
+#define DXX_DIGI_MIX_SSE2	1
+#include <emmintrin.h>
+#elif defined(__ARM_NEON)
+#define DXX_DIGI_MIX_NEON	1
+#include <arm_neon.h>
+#endif
+
+namespace dcx {
+
+namespace {
+
+/* Each kernel handles whole vectors from the front of the buffer, and
+ * returns how many frames or samples it handled.  The scalar loop
+ * finishes the rest, with the same arithmetic.
+ */
+#if DXX_DIGI_MIX_SSE2
+std::size_t digi_mix_accumulate_sse2(int32_t *const acc, const int16_t *const mono, const std::size_t frames, const int16_t gain_left, const int16_t gain_right)
+{
+	/* _mm_madd_epi16 multiplies pairs of 16-bit lanes and adds each
+	 * pair.  Pairing every sample with a zero, next to a gain paired
+	 * with a zero, gives one 32-bit product per lane.
+	 */
+	const __m128i gain = _mm_setr_epi16(gain_left, 0, gain_right, 0, gain_left, 0, gain_right, 0);
+	const __m128i zero = _mm_setzero_si128();
+	std::size_t i = 0;
+	for (; i + 8 <= frames; i += 8)
+	{
+		const __m128i s = _mm_loadu_si128(reinterpret_cast<const __m128i *>(mono + i));
+		const __m128i lo = _mm_unpacklo_epi16(s, zero);
+		const __m128i hi = _mm_unpackhi_epi16(s, zero);
+		const __m128i product[4]{
+			_mm_madd_epi16(_mm_unpacklo_epi32(lo, lo), gain),
+			_mm_madd_epi16(_mm_unpackhi_epi32(lo, lo), gain),
+			_mm_madd_epi16(_mm_unpacklo_epi32(hi, hi), gain),
+			_mm_madd_epi16(_mm_unpackhi_epi32(hi, hi), gain),
+		};
+		const auto a = reinterpret_cast<__m128i *>(acc + 2 * i);
+		for (unsigned k = 0; k != 4; ++k)
+			_mm_storeu_si128(a + k, _mm_add_epi32(_mm_loadu_si128(a + k), _mm_srai_epi32(product[k], 14)));
+	}
+	return i;
+}
+
+std::size_t digi_mix_saturate_sse2(int16_t *const out, const int32_t *const acc, const std::size_t count)
+{
+	std::size_t i = 0;
+	for (; i + 8 <= count; i += 8)
+	{
+		const __m128i a = _mm_loadu_si128(reinterpret_cast<const __m128i *>(acc + i));
+		const __m128i b = _mm_loadu_si128(reinterpret_cast<const __m128i *>(acc + i + 4));
+		_mm_storeu_si128(reinterpret_cast<__m128i *>(out + i), _mm_packs_epi32(a, b));
+	}
+	return i;
+}
+#elif DXX_DIGI_MIX_NEON
+std::size_t digi_mix_accumulate_neon(int32_t *const acc, const int16_t *const mono, const std::size_t frames, const int16_t gain_left, const int16_t gain_right)
+{
+	std::size_t i = 0;
+	for (; i + 4 <= frames; i += 4)
+	{
+		const int16x4_t s = vld1_s16(mono + i);
+		const int32x4x2_t lr = vzipq_s32(vshrq_n_s32(vmull_n_s16(s, gain_left), 14), vshrq_n_s32(vmull_n_s16(s, gain_right), 14));
+		int32_t *const a = acc + 2 * i;
+		vst1q_s32(a, vaddq_s32(vld1q_s32(a), lr.val[0]));
+		vst1q_s32(a + 4, vaddq_s32(vld1q_s32(a + 4), lr.val[1]));
+	}
+	return i;
+}
+
+std::size_t digi_mix_saturate_neon(int16_t *const out, const int32_t *const acc, const std::size_t count)
+{
+	std::size_t i = 0;
+	for (; i + 8 <= count; i += 8)
+		vst1q_s16(out + i, vcombine_s16(vqmovn_s32(vld1q_s32(acc + i)), vqmovn_s32(vld1q_s32(acc + i + 4))));
+	return i;
+}
+#endif
+
+}
+
+std::size_t digi_mix_resample(int16_t *const mono, const std::size_t frames, const std::span<const uint8_t> samples, uint64_t &position, const uint32_t step, const bool looped)
+{
+	const std::size_t length = samples.size();
+	if (!length)
+		return 0;
+	const uint64_t end = uint64_t{length} << 16;
+	uint64_t p = position;
+	std::size_t i = 0;
+	for (; i != frames; ++i, p += step)
+	{
+		if (p >= end)
+		{
+			if (!looped)
+				break;
+			p %= end;
+		}
+		const std::size_t index = p >> 16;
+		const int32_t s0 = samples[index];
+		/* The last sample of a looped sound leads into the first. */
+		const int32_t s1 = (index + 1 < length) ? samples[index + 1] : looped ? samples[0] : s0;
+		const int32_t fraction = p & 0xffff;
+		mono[i] = ((s0 - 0x80) << 8) + (((s1 - s0) * fraction) >> 8);
+	}
+	position = p;
+	return i;
+}
+
+void digi_mix_accumulate(int32_t *const acc, const int16_t *const mono, const std::size_t frames, const int16_t gain_left, const int16_t gain_right)
+{
+	std::size_t i =
+#if DXX_DIGI_MIX_SSE2
+		digi_mix_accumulate_sse2(acc, mono, frames, gain_left, gain_right);
+#elif DXX_DIGI_MIX_NEON
+		digi_mix_accumulate_neon(acc, mono, frames, gain_left, gain_right);
+#else
+		0;
+#endif
+	for (; i != frames; ++i)
+	{
+		const int32_t s = mono[i];
+		acc[2 * i] += (s * gain_left) >> 14;
+		acc[2 * i + 1] += (s * gain_right) >> 14;
+	}
+}
+
+void digi_mix_saturate(int16_t *const out, const int32_t *const acc, const std::size_t count)
+{
+	std::size_t i =
+#if DXX_DIGI_MIX_SSE2
+		digi_mix_saturate_sse2(out, acc, count);
+#elif DXX_DIGI_MIX_NEON
+		digi_mix_saturate_neon(out, acc, count);
+#else
+		0;
+#endif
+	for (; i != count; ++i)
+		out[i] = std::clamp<int32_t>(acc[i], INT16_MIN, INT16_MAX);
+}
+
+void digi_mix_ring::reset(const std::size_t capacity)
+{
+	buffer = std::make_unique<int16_t[]>(capacity);
+	mask = capacity - 1;
+	written.store(0, std::memory_order_relaxed);
+	read_count.store(0, std::memory_order_relaxed);
+}
+
+std::size_t digi_mix_ring::write(const int16_t *const src, const std::size_t count)
+{
+	const std::size_t w = written.load(std::memory_order_relaxed);
+	const std::size_t used = w - read_count.load(std::memory_order_acquire);
+	const std::size_t n = std::min(count, mask + 1 - used);
+	const std::size_t start = w & mask;
+	const std::size_t first = std::min(n, mask + 1 - start);
+	std::memcpy(&buffer[start], src, first * sizeof(int16_t));
+	std::memcpy(&buffer[0], src + first, (n - first) * sizeof(int16_t));
+	written.store(w + n, std::memory_order_release);
+	return n;
+}
+
+std::size_t digi_mix_ring::read(int16_t *const dest, const std::size_t count)
+{
+	const std::size_t r = read_count.load(std::memory_order_relaxed);
+	const std::size_t n = std::min(count, written.load(std::memory_order_acquire) - r);
+	const std::size_t start = r & mask;
+	const std::size_t first = std::min(n, mask + 1 - start);
+	std::memcpy(dest, &buffer[start], first * sizeof(int16_t));
+	std::memcpy(dest + first, &buffer[0], (n - first) * sizeof(int16_t));
+	read_count.store(r + n, std::memory_order_release);
+	return n;
+}
+
+}
@@ -0,0 +1,66 @@
+/*
+ * This file is part of the DXX-Rebirth project <https://www.dxx-rebirth.com/>.
+ * It is copyright by its individual contributors, as recorded in the
+ * project's Git history.  See COPYING.txt at the top level for license
+ * terms and a link to the Git history.
+ */
+
+/*
+ *
+ * Polyphase upsampler for the SDL_mixer sound conversion
+ *
+ */
+
+#include <vector>
+#include "digi_mixer_resample.h"
+
+namespace dcx {
+
+void digi_upsample_polyphase(const std::span<const uint8_t> input, const unsigned factor, const std::span<const int32_t> coeffs, const std::span<int16_t> output)
+{
+	/* Output sample n uses input samples n / factor, n / factor - 1, ...
+	 * with taps n % factor, n % factor + factor, ...  Keep only the
+	 * nonzero taps of each phase, and the number of input samples back
+	 * from the newest that each one multiplies.
+	 */
+	struct tap
+	{
+		int32_t coeff;
+		std::size_t back;
+	};
+	std::vector<std::vector<tap>> phases(factor);
+	for (unsigned p = 0; p != factor; ++p)
+		for (std::size_t t = p, back = 0; t < coeffs.size(); t += factor, ++back)
+			if (const auto c = coeffs[t])
+				phases[p].push_back({c, back});
+	std::vector<int32_t> signal(input.size());
+	for (std::size_t i = 0; i != input.size(); ++i)
+		signal[i] = int32_t{input[i]} - 0x80;
+	auto out = output.begin();
+	for (std::size_t newest = 0; newest != signal.size(); ++newest)
+		for (const auto &phase : phases)
+		{
+			int32_t sum = 0;
+			const auto newest_signal = &signal[newest];
+			/* Taps are in order of `back`, so stop at the first one
+			 * that reaches before the start of the sound.
+			 */
+			for (const auto &t : phase)
+			{
+				if (t.back > newest)
+					break;
+				sum += newest_signal[-static_cast<std::ptrdiff_t>(t.back)] * t.coeff;
+			}
+			*out++ = static_cast<int16_t>(sum >> 8);
+		}
+}
+
+uint64_t digi_sound_hash(const std::span<const uint8_t> data)
+{
+	uint64_t h = 0xcbf29ce484222325;
+	for (const auto c : data)
+		h = (h ^ c) * 0x100000001b3;
+	return h;
+}
+
+}
@@ -222,6 +222,8 @@ window_event_result event_send(const d_event &event)
 	return handled;
 }
 
+unsigned Event_frame_count;
+
 // Process the first event in queue, sending to the appropriate handler
 // This is the new object-oriented system
 // Uses the old system for now, but this may change
@@ -265,6 +267,7 @@ window_event_result event_process(void)
 	}
 
 	gr_flip();
+	++ Event_frame_count;
 
 	return highest_result;
 }
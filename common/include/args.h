@@ -116,6 +116,8 @@ struct CArg : prohibit_void_ptr<CArg>
 	bool DbgSdlASyncBlit;
 #endif
 	bool DbgNoRun;
+	unsigned DbgSimBenchFrames;
+	int DbgSimBenchLevel;
 	bool DbgNoDoubleBuffer;
 	bool DbgNoCompressPigBitmap;
 	bool DbgRenderStats;
@@ -126,6 +128,9 @@ struct CArg : prohibit_void_ptr<CArg>
 #endif
 	bool SysNoNiceFPS;
 	int SysMaxFPS;
+	unsigned SysThreads;
+	unsigned SysMaxObjects;
+	unsigned SndOutputRate;
 	int SysRenderZoomAdjustment;
 	uint16_t MplUdpHostPort;
 	uint16_t MplUdpMyPort;
@@ -139,6 +144,8 @@ struct CArg : prohibit_void_ptr<CArg>
 	std::string SysRecordDemoNameTemplate;
 	std::string MplUdpHostAddr;
 	std::string DbgAltTex;
+	std::string DbgSimBenchMission;
+	std::string DbgSimBenchInput;
 #if !DXX_USE_OGL
 	std::string DbgTexMap;
 #endif
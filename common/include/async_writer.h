@@ -0,0 +1,84 @@
+/*
+ * This file is part of the DXX-Rebirth project <https://www.dxx-rebirth.com/>.
+ * It is copyright by its individual contributors, as recorded in the
+ * project's Git history.  See COPYING.txt at the top level for license
+ * terms and a link to the Git history.
+ */
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace dcx {
+
+/* Collect many small writes in memory on the calling thread, and pass
+ * them in blocks to a background thread, which hands them to a sink.
+ * The calling thread never waits for the sink, unless the background
+ * thread falls several blocks behind.
+ *
+ * Only one thread may call `write`, `submit` and `finish`.
+ */
+class async_writer
+{
+public:
+	/* Write `size` bytes, and return whether all of them were written.
+	 * Called on the background thread.
+	 */
+	using sink_type = bool (*)(void *context, const uint8_t *data, std::size_t size);
+private:
+	/* Beyond this many queued blocks, `submit` waits for the writer, so
+	 * that a slow sink cannot use unbounded memory.
+	 */
+	static constexpr std::size_t max_queued_blocks = 16;
+	std::mutex mutex;
+	std::condition_variable queue_changed;
+	std::deque<std::vector<uint8_t>> queue;
+	/* Written blocks, kept so that their memory can be reused. */
+	std::vector<std::vector<uint8_t>> spare;
+	std::vector<uint8_t> current;
+	std::thread thread;
+	sink_type sink = nullptr;
+	void *context = nullptr;
+	bool stopping = false;
+	std::atomic<bool> sink_failed{false};
+	void run_writer();
+public:
+	async_writer() = default;
+	async_writer(const async_writer &) = delete;
+	async_writer &operator=(const async_writer &) = delete;
+	~async_writer()
+	{
+		finish();
+	}
+	/* Start a background thread which writes to `sink`.  Any earlier
+	 * sink must have been finished.
+	 */
+	void start(sink_type sink, void *context);
+	void write(const void *const data, const std::size_t size)
+	{
+		const auto p = static_cast<const uint8_t *>(data);
+		current.insert(current.end(), p, p + size);
+	}
+	/* Queue everything written since the last call. */
+	void submit();
+	/* Submit, wait until everything has been written, and stop the
+	 * background thread.  Return whether every write succeeded.
+	 */
+	bool finish();
+	/* Whether the sink has reported a failure.  Blocks queued after a
+	 * failure are discarded.
+	 */
+	[[nodiscard]]
+	bool failed() const
+	{
+		return sink_failed.load(std::memory_order_relaxed);
+	}
+};
+
+}
@@ -0,0 +1,333 @@
+/*
+ * This file is part of the DXX-Rebirth project <https://www.dxx-rebirth.com/>.
+ * It is copyright by its individual contributors, as recorded in the
+ * project's Git history.  See COPYING.txt at the top level for license
+ * terms and a link to the Git history.
+ */
+#pragma once
+
+#include <array>
+#include <bit>
+#include <bitset>
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <span>
+
+namespace dcx {
+
+/* Pack values into a buffer, least significant bit first.  A write that
+ * does not fit is dropped and sets `overflow()`.
+ */
+class bit_writer
+{
+	std::span<uint8_t> buf;
+	std::size_t bits = 0;
+	bool overflowed = false;
+public:
+	explicit bit_writer(const std::span<uint8_t> buf) :
+		buf(buf)
+	{
+	}
+	/* Write the low `count` bits of `value`.  `count` must not exceed 32. */
+	void write(const uint32_t value, const unsigned count)
+	{
+		if (bits + count > buf.size() * 8)
+		{
+			overflowed = true;
+			return;
+		}
+		for (unsigned i = 0; i != count; ++i, ++bits)
+		{
+			auto &b = buf[bits / 8];
+			const uint8_t mask = 1u << (bits % 8);
+			if ((value >> i) & 1)
+				b |= mask;
+			else
+				b &= ~mask;
+		}
+	}
+	/* The number of bytes that hold the bits written so far. */
+	[[nodiscard]]
+	std::size_t bytes() const
+	{
+		return (bits + 7) / 8;
+	}
+	[[nodiscard]]
+	bool overflow() const
+	{
+		return overflowed;
+	}
+};
+
+/* Unpack values written by `bit_writer`.  Reading past the end returns
+ * zero bits and sets `overrun()`.
+ */
+class bit_reader
+{
+	std::span<const uint8_t> buf;
+	std::size_t bits = 0;
+	bool overran = false;
+public:
+	explicit bit_reader(const std::span<const uint8_t> buf) :
+		buf(buf)
+	{
+	}
+	uint32_t read(const unsigned count)
+	{
+		if (bits + count > buf.size() * 8)
+		{
+			overran = true;
+			return 0;
+		}
+		uint32_t value = 0;
+		for (unsigned i = 0; i != count; ++i, ++bits)
+			if ((buf[bits / 8] >> (bits % 8)) & 1)
+				value |= uint32_t{1} << i;
+		return value;
+	}
+	[[nodiscard]]
+	bool overrun() const
+	{
+		return overran;
+	}
+};
+
+/* Write `value` as its difference from `base`: one bit if they are
+ * equal, otherwise a 5 bit length and the zigzag coded difference
+ * without its leading 1.  Small changes cost a few bits, and any change
+ * costs at most 38.
+ */
+inline void write_delta(bit_writer &w, const int32_t value, const int32_t base)
+{
+	const uint32_t d = static_cast<uint32_t>(value) - static_cast<uint32_t>(base);
+	if (!d)
+	{
+		w.write(0, 1);
+		return;
+	}
+	const uint32_t z = (d << 1) ^ (0 - (d >> 31));
+	const unsigned width = std::bit_width(z);
+	w.write(1, 1);
+	w.write(width - 1, 5);
+	w.write(z, width - 1);
+}
+
+[[nodiscard]]
+inline int32_t read_delta(bit_reader &r, const int32_t base)
+{
+	if (!r.read(1))
+		return base;
+	const unsigned width = r.read(5) + 1;
+	const uint32_t z = (uint32_t{1} << (width - 1)) | r.read(width - 1);
+	const uint32_t d = (z >> 1) ^ (0 - (z & 1));
+	return static_cast<int32_t>(static_cast<uint32_t>(base) + d);
+}
+
+/* The state of up to `entities` things, each described by `fields`
+ * quantized integers.  Only the entities in `updated` are sent; the
+ * others keep the value of the baseline they were decoded against.
+ */
+template <std::size_t entities, std::size_t fields>
+struct delta_snapshot
+{
+	using entity = std::array<int32_t, fields>;
+	std::array<entity, entities> state{};
+	std::bitset<entities> updated;
+};
+
+/* Write the updated entities of `current` as changes from `baseline`,
+ * or from zero if there is no baseline.  Store in `sent` the snapshot
+ * that the receiver will decode, for use as a later baseline.
+ */
+template <std::size_t entities, std::size_t fields>
+void encode_snapshot(bit_writer &w, const delta_snapshot<entities, fields> &current, const delta_snapshot<entities, fields> *const baseline, delta_snapshot<entities, fields> &sent)
+{
+	if (baseline)
+		sent.state = baseline->state;
+	else
+		sent.state = {};
+	sent.updated = current.updated;
+	for (std::size_t e = 0; e != entities; ++e)
+	{
+		const bool updated = current.updated[e];
+		w.write(updated, 1);
+		if (!updated)
+			continue;
+		auto &base = sent.state[e];
+		auto &value = current.state[e];
+		const bool changed = value != base;
+		w.write(changed, 1);
+		if (!changed)
+			continue;
+		for (std::size_t f = 0; f != fields; ++f)
+			write_delta(w, value[f], base[f]);
+		base = value;
+	}
+}
+
+/* Read a snapshot written by `encode_snapshot` against the same
+ * baseline.  Return false if the data ran out.
+ */
+template <std::size_t entities, std::size_t fields>
+[[nodiscard]]
+bool decode_snapshot(bit_reader &r, const delta_snapshot<entities, fields> *const baseline, delta_snapshot<entities, fields> &out)
+{
+	if (baseline)
+		out.state = baseline->state;
+	else
+		out.state = {};
+	out.updated.reset();
+	for (std::size_t e = 0; e != entities; ++e)
+	{
+		if (!r.read(1))
+			continue;
+		out.updated.set(e);
+		if (!r.read(1))
+			continue;
+		auto &value = out.state[e];
+		for (auto &f : value)
+			f = read_delta(r, f);
+	}
+	return !r.overrun();
+}
+
+/* Is snapshot number `a` later than `b`?  Numbers wrap at 16 bits. */
+[[nodiscard]]
+constexpr bool snapshot_seq_newer(const uint16_t a, const uint16_t b)
+{
+	return static_cast<int16_t>(static_cast<uint16_t>(a - b)) > 0;
+}
+
+/* The last `history` snapshots, by number. */
+template <typename Snapshot, std::size_t history>
+class snapshot_history
+{
+	struct entry
+	{
+		uint16_t seq;
+		bool valid;
+		Snapshot snapshot;
+	};
+	std::array<entry, history> entries{};
+public:
+	void clear()
+	{
+		for (auto &e : entries)
+			e.valid = false;
+	}
+	Snapshot &store(const uint16_t seq)
+	{
+		auto &e = entries[seq % history];
+		e.seq = seq;
+		e.valid = true;
+		return e.snapshot;
+	}
+	[[nodiscard]]
+	const Snapshot *find(const uint16_t seq) const
+	{
+		auto &e = entries[seq % history];
+		return e.valid && e.seq == seq ? &e.snapshot : nullptr;
+	}
+};
+
+/* The sending end of a snapshot stream to one peer.  Each snapshot is
+ * numbered, and encoded against the latest one that the peer has
+ * acknowledged, if that one is still in the history.
+ */
+template <typename Snapshot, std::size_t history>
+class snapshot_sender
+{
+	snapshot_history<Snapshot, history> sent;
+	uint16_t next_seq = 0;
+	std::optional<uint16_t> baseline;
+public:
+	struct header
+	{
+		uint16_t seq;
+		std::optional<uint16_t> baseline;
+	};
+	void clear()
+	{
+		sent.clear();
+		next_seq = 0;
+		baseline.reset();
+	}
+	/* The peer received snapshot `seq`.  Acknowledgements of snapshots
+	 * that were never sent, or that are older than the baseline, are
+	 * ignored.
+	 */
+	void acknowledge(const uint16_t seq)
+	{
+		if (!sent.find(seq))
+			return;
+		if (!baseline || snapshot_seq_newer(seq, *baseline))
+			baseline = seq;
+	}
+	/* Write `current` as the next snapshot, and return the number and
+	 * baseline that the peer needs to decode it.
+	 */
+	header encode(bit_writer &w, const Snapshot &current)
+	{
+		const Snapshot *base = nullptr;
+		if (baseline)
+		{
+			/* Drop a baseline that is about to leave the history, so that
+			 * it is never confused with a later snapshot of the same
+			 * number once the sequence wraps.
+			 */
+			if (static_cast<uint16_t>(next_seq - *baseline) >= history)
+				baseline.reset();
+			else
+				base = sent.find(*baseline);
+		}
+		Snapshot encoded;
+		encode_snapshot(w, current, base, encoded);
+		const header h{next_seq++, base ? baseline : std::nullopt};
+		sent.store(h.seq) = encoded;
+		return h;
+	}
+};
+
+/* The receiving end of a snapshot stream from one peer. */
+template <typename Snapshot, std::size_t history>
+class snapshot_receiver
+{
+	snapshot_history<Snapshot, history> received;
+	std::optional<uint16_t> latest_seq;
+public:
+	void clear()
+	{
+		received.clear();
+		latest_seq.reset();
+	}
+	/* The number of the latest snapshot decoded, which the peer should
+	 * be told about.
+	 */
+	[[nodiscard]]
+	std::optional<uint16_t> latest() const
+	{
+		return latest_seq;
+	}
+	/* Decode snapshot `seq`, written against `baseline`.  Return it if
+	 * it is newer than every snapshot decoded so far.  Return nullptr if
+	 * it is out of date, its baseline is unknown, or it is truncated.  A
+	 * number far from the latest one means that the peer started over,
+	 * so it is accepted.
+	 */
+	const Snapshot *decode(bit_reader &r, const uint16_t seq, const std::optional<uint16_t> baseline)
+	{
+		if (latest_seq && static_cast<uint16_t>(*latest_seq - seq) < history)
+			return nullptr;
+		const Snapshot *base = nullptr;
+		if (baseline && !(base = received.find(*baseline)))
+			return nullptr;
+		Snapshot decoded;
+		if (!decode_snapshot(r, base, decoded))
+			return nullptr;
+		latest_seq = seq;
+		return &(received.store(seq) = decoded);
+	}
+};
+
+}
@@ -29,6 +29,7 @@ void digi_audio_set_channel_pan(sound_channel, sound_pan);
 void digi_audio_stop_sound(sound_channel);
 void digi_audio_end_sound(sound_channel);
 void digi_audio_set_digi_volume(int);
+void digi_audio_prepare_level_sounds();
 }
 #endif
 
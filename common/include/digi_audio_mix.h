@@ -0,0 +1,62 @@
+/*
+ * This file is part of the DXX-Rebirth project <https://www.dxx-rebirth.com/>.
+ * It is copyright by its individual contributors, as recorded in the
+ * project's Git history.  See COPYING.txt at the top level for license
+ * terms and a link to the Git history.
+ */
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <span>
+
+namespace dcx {
+
+/* Gains are signed Q14: 0x4000 plays a sample at full volume. */
+constexpr int16_t digi_mix_unity_gain = 0x4000;
+
+/* Convert `frames` output frames of the 8-bit unsigned sound `samples`
+ * to 16-bit signed, with linear interpolation, and write them to
+ * `mono`.  `position` is the offset into `samples` in 1/65536 of a
+ * sample, and advances by `step` per frame.  A looped sound wraps to the
+ * start.  Return how many frames were written, which is less than
+ * `frames` only if a sound that is not looped reached its end.
+ */
+std::size_t digi_mix_resample(int16_t *mono, std::size_t frames, std::span<const uint8_t> samples, uint64_t &position, uint32_t step, bool looped);
+
+/* Add `frames` frames of `mono` to the interleaved stereo accumulator
+ * `acc`.  The left channel gets (mono[i] * gain_left) >> 14, and the
+ * right channel likewise.
+ */
+void digi_mix_accumulate(int32_t *acc, const int16_t *mono, std::size_t frames, int16_t gain_left, int16_t gain_right);
+
+/* Clamp `count` values of `acc` to 16 bits, and write them to `out`. */
+void digi_mix_saturate(int16_t *out, const int32_t *acc, std::size_t count);
+
+/* A ring of 16-bit samples, with one thread writing and one thread
+ * reading.  Neither side takes a lock.  `capacity` must be a power of 2.
+ */
+class digi_mix_ring
+{
+	std::unique_ptr<int16_t[]> buffer;
+	std::size_t mask = 0;
+	/* Count of samples ever written and ever read.  Each side writes
+	 * only its own counter.
+	 */
+	std::atomic<std::size_t> written{0}, read_count{0};
+public:
+	void reset(std::size_t capacity);
+	/* Samples that read can return now. */
+	std::size_t size() const
+	{
+		return written.load(std::memory_order_acquire) - read_count.load(std::memory_order_acquire);
+	}
+	/* Append up to `count` samples, and return how many fit. */
+	std::size_t write(const int16_t *src, std::size_t count);
+	/* Remove up to `count` samples, and return how many there were. */
+	std::size_t read(int16_t *dest, std::size_t count);
+};
+
+}
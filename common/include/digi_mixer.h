@@ -58,7 +58,6 @@ enum class digi_mixer_method : uint8_t
 #endif
 };
 
-void digi_mixer_close();
 void digi_mixer_set_channel_volume(sound_channel, int);
 void digi_mixer_set_channel_pan(sound_channel, sound_pan);
 void digi_mixer_stop_sound(sound_channel);
@@ -69,6 +68,8 @@ void digi_mixer_stop_all_channels();
 int digi_mixer_init();
 }
 namespace dsx {
+void digi_mixer_close();
+void digi_mixer_prepare_level_sounds();
 sound_channel digi_mixer_start_sound(short, fix, sound_pan, int, int, int, sound_object *);
 }
 #endif
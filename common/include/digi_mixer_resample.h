@@ -0,0 +1,33 @@
+/*
+ * This file is part of the DXX-Rebirth project <https://www.dxx-rebirth.com/>.
+ * It is copyright by its individual contributors, as recorded in the
+ * project's Git history.  See COPYING.txt at the top level for license
+ * terms and a link to the Git history.
+ */
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <span>
+
+namespace dcx {
+
+/* Upsample the 8-bit unsigned sound `input` by `factor`, and write the
+ * 16-bit result to `output`, which must hold input.size() * factor
+ * samples.
+ *
+ * The result is the same as inserting factor - 1 zero samples after
+ * each input sample, convolving with `coeffs`, and shifting each sum
+ * right by 8.  Each output sample only uses the taps that line up with
+ * a real input sample, so this skips the multiplications by the
+ * inserted zeros.
+ */
+void digi_upsample_polyphase(std::span<const uint8_t> input, unsigned factor, std::span<const int32_t> coeffs, std::span<int16_t> output);
+
+/* 64-bit FNV-1a hash of `data`, used to name converted sounds in the
+ * on-disk cache.
+ */
+[[nodiscard]]
+uint64_t digi_sound_hash(std::span<const uint8_t> data);
+
+}
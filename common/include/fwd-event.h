@@ -32,6 +32,9 @@ window_event_result event_send(const d_event &event);
 // Sends input, idle and draw events to event handlers
 window_event_result event_process();
 
+// Number of frames that event_process has drawn and flipped
+extern unsigned Event_frame_count;
+
 void event_enable_focus();
 void event_disable_focus();
 static inline void event_toggle_focus(int activate_focus)
@@ -5,6 +5,7 @@
 
 #pragma once
 
+#include <span>
 #include "maths.h"
 #include "dxxsconf.h"
 #include "dsx-ns.h"
@@ -88,6 +89,39 @@ void vm_vector_to_matrix_u(vms_matrix &m, const vms_vector &fvec, const vms_vect
 void vm_vector_to_matrix(vms_matrix &m, const vms_vector &fvec);
 void vm_vec_rotate (vms_vector &dest, const vms_vector &src, const vms_matrix &m);
 void _vm_matrix_x_matrix (vms_matrix &dest, const vms_matrix &src0, const vms_matrix &src1);
+
+/* Batch forms of vm_vec_rotate, vm_vec_dot, vm_vec_dist2 and
+ * vm_vec_dist.  Element `i` of `dest` is set to exactly what the single
+ * form returns for element `i` of `src`, so these are safe to use where
+ * demo playback and netgames need identical results.  `dest` and `src`
+ * must be the same length, and must not overlap.
+ */
+void vm_vec_rotate_n(std::span<vms_vector> dest, std::span<const vms_vector> src, const vms_matrix &m);
+void vm_vec_dot_n(std::span<fix> dest, std::span<const vms_vector> src, const vms_vector &v);
+void vm_vec_dist2_n(std::span<vm_distance_squared> dest, std::span<const vms_vector> src, const vms_vector &p);
+void vm_vec_dist_n(std::span<vm_distance> dest, std::span<const vms_vector> src, const vms_vector &p);
+
+/* Instruction sets that the batch functions can use.  The best one that
+ * the processor supports is picked on first use.
+ */
+enum class vm_vec_batch_isa : uint8_t
+{
+	scalar,
+	sse4_1,
+	avx2,
+	neon,
+};
+
+[[nodiscard]]
+vm_vec_batch_isa vm_vec_batch_best_isa();
+[[nodiscard]]
+vm_vec_batch_isa vm_vec_batch_get_isa();
+/* Force the batch functions to use `isa`, for tests and benchmarks.
+ * Return false, and change nothing, if this build or this processor
+ * cannot use it.  This must not be called while another thread is in a
+ * batch function.
+ */
+bool vm_vec_batch_set_isa(vm_vec_batch_isa isa);
 [[nodiscard]]
 vms_angvec vm_extract_angles_matrix(const vms_matrix &m);
 [[nodiscard]]
@@ -135,6 +135,13 @@ namespace dcx {
 void ogl_draw_vertex_reticle(grs_canvas &, int cross, int primary, int secondary, int color, int alpha, int size_offs);
 void ogl_toggle_depth_test(int enable);
 void ogl_set_blending(gr_blend);
+
+/* Between these calls, textured faces drawn with normal blending are
+ * collected by texture, and drawn together by ogl_end_tmap_batch.  Use
+ * only for faces whose draw order does not matter.
+ */
+void ogl_begin_tmap_batch();
+void ogl_end_tmap_batch();
 }
 
 #endif /* _OGL_INIT_H_ */
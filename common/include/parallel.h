@@ -0,0 +1,47 @@
+/*
+ * This file is part of the DXX-Rebirth project <https://www.dxx-rebirth.com/>.
+ * It is copyright by its individual contributors, as recorded in the
+ * project's Git history.  See COPYING.txt at the top level for license
+ * terms and a link to the Git history.
+ */
+#pragma once
+
+#include <cstddef>
+#include <memory>
+#include <type_traits>
+
+namespace dcx {
+
+/* Set the number of threads, including the calling thread, that
+ * `parallel_for` may use.  0 picks a count from the number of
+ * available processors.  1 runs all work on the calling thread.
+ *
+ * This must not be called while a `parallel_for` is running.
+ */
+void set_parallel_thread_count(unsigned count);
+
+/* Return the number of threads, including the calling thread, that
+ * `parallel_for` will use.
+ */
+[[nodiscard]]
+unsigned get_parallel_thread_count();
+
+/* Call `work(context, i)` for every `i` in [0, count), spread across
+ * the worker threads and the calling thread.  Return after every call
+ * has finished.  Calls may run concurrently and in any order, so each
+ * call must only write state that belongs to its own index.  `work`
+ * must not throw, and must not call `parallel_for`.
+ */
+void parallel_for(std::size_t count, void (*work)(void *context, std::size_t index), void *context);
+
+template <typename F>
+requires(std::is_invocable_v<F &, std::size_t>)
+void parallel_for(const std::size_t count, F &&work)
+{
+	using work_type = std::remove_reference_t<F>;
+	parallel_for(count, [](void *const context, const std::size_t index) {
+		(*static_cast<work_type *>(context))(index);
+	}, const_cast<void *>(static_cast<const void *>(std::addressof(work))));
+}
+
+}
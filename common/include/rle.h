@@ -32,12 +32,7 @@ COPYRIGHT 1993-1998 PARALLAX SOFTWARE CORPORATION.  ALL RIGHTS RESERVED.
 #include "dsx-ns.h"
 #include "compiler-poison.h"
 #include <iterator>
-
-struct rle_position_t
-{
-	const uint8_t *src;
-	uint8_t *dst;
-};
+#include "rle_decode.h"
 
 static inline const uint8_t *end(const grs_bitmap &b)
 {
@@ -49,13 +44,7 @@ static inline uint8_t *end(grs_bitmap &b)
 	return &b.get_bitmap_data()[b.bm_h * b.bm_w];
 }
 
-static inline rle_position_t rle_end(const auto &src, auto &dst)
-{
-	return {end(src), end(dst)};
-}
-
 namespace dcx {
-uint8_t *gr_rle_decode(const uint8_t *sb, uint8_t *db, rle_position_t e);
 void gr_bitmap_rle_compress(grs_bitmap &bmp);
 #if !DXX_USE_OGL
 void gr_rle_expand_scanline_masked(uint8_t *dest, const uint8_t *src, uint_fast32_t x1, uint_fast32_t x2);
@@ -141,6 +130,7 @@ public:
 		src_bits{&ptr_src_bit_lengths[rle_big ? src.bm_h * 2 : src.bm_h]}
 	{
 	}
+	uintptr_t get_src_row_size() const;
 	void advance_src_bits();
 };
 
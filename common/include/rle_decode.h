@@ -0,0 +1,35 @@
+/*
+ * This file is part of the DXX-Rebirth project <https://www.dxx-rebirth.com/>.
+ * It is copyright by its individual contributors, as recorded in the
+ * project's Git history.  See COPYING.txt at the top level for license
+ * terms and a link to the Git history.
+ */
+#pragma once
+
+#include <cstdint>
+
+struct rle_position_t
+{
+	const uint8_t *src;
+	uint8_t *dst;
+};
+
+namespace dcx {
+
+/* A byte with all of RLE_CODE set starts a run of (byte & NOT_RLE_CODE)
+ * copies of the next byte.  A run of length 0 ends the row.
+ */
+constexpr uint8_t RLE_CODE{0xe0};
+constexpr uint8_t NOT_RLE_CODE{0x1f};
+static_assert((RLE_CODE | NOT_RLE_CODE) == 0xff, "RLE mask error");
+static inline int IS_RLE_CODE(const uint8_t &x)
+{
+	return (x & RLE_CODE) == RLE_CODE;
+}
+
+/* Decode one row.  `e.src` must be the end of the row's encoded data,
+ * since the decoder may read any byte before it.
+ */
+uint8_t *gr_rle_decode(const uint8_t *sb, uint8_t *db, rle_position_t e);
+
+}
@@ -83,7 +83,7 @@ struct g3ds_tmap {
 //	Set Interpolation_method to 0/1/2 for linear/linear, perspective/linear, perspective/perspective
 #if !DXX_USE_OGL
 extern	int	Interpolation_method;
-extern uint8_t Transparency_on;
+extern thread_local uint8_t Transparency_on;
 
 // Set Lighting_on to 0/1/2 for no lighting/intensity lighting/rgb lighting
 extern	int	Lighting_on;
@@ -91,6 +91,23 @@ extern	int	Lighting_on;
 // HACK INTERFACE: how far away the current segment (& thus texture) is
 extern unsigned Current_seg_depth;
 void init_interface_vars_to_assembler();
+
+// Between tmap_begin_bin and tmap_end_bin, polygons drawn by draw_tmap,
+// draw_tmap_flat and gr_upoly_tmap are recorded instead of drawn, each
+// with the clip window and lighting in effect when it was recorded.
+// tmap_end_bin splits the canvas into horizontal bands, and draws the
+// bands in parallel.  Each band draws its polygons in the order that
+// they were recorded, so that a polygon still covers the polygons
+// recorded before it.
+// tmap_begin_bin returns false, and records nothing, if there is only
+// one thread to draw with.
+bool tmap_begin_bin(const grs_canvas &canvas);
+void tmap_end_bin();
+
+// Draw the polygons recorded so far, and keep recording.  This must be
+// called before bitmap data which a recorded polygon may use is freed
+// or overwritten.
+void tmap_flush_bin();
 #endif
 class push_interpolation_method
 {
@@ -116,7 +133,7 @@ public:
 //	These are pointers to texture maps.  If you want to render texture map #7, then you will render
 //	the texture map defined by Texmap_ptrs[7].
 
-extern int Window_clip_left, Window_clip_bot, Window_clip_right, Window_clip_top;
+extern thread_local int Window_clip_left, Window_clip_bot, Window_clip_right, Window_clip_top;
 
 // for ugly hack put in to be sure we don't overflow render buffer
 
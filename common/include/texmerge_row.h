@@ -0,0 +1,24 @@
+/*
+ * This file is part of the DXX-Rebirth project <https://www.dxx-rebirth.com/>.
+ * It is copyright by its individual contributors, as recorded in the
+ * project's Git history.  See COPYING.txt at the top level for license
+ * terms and a link to the Git history.
+ */
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+namespace dcx {
+
+/* Overlay `count` pixels of `top` on `bottom`, and write the result to
+ * `dest`.  Where `top` is 255 (TRANSPARENCY_COLOR), the result is the
+ * `bottom` pixel.  If `super_transparent`, a `top` pixel of 254 becomes
+ * 255, so that the merged bitmap is transparent there.  Other pixels
+ * are copied from `top`.
+ *
+ * `dest` may not overlap `top` or `bottom`.
+ */
+void texmerge_row(uint8_t *dest, const uint8_t *top, const uint8_t *bottom, std::size_t count, bool super_transparent);
+
+}
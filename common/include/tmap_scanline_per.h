@@ -0,0 +1,62 @@
+/*
+ * This file is part of the DXX-Rebirth project <https://www.dxx-rebirth.com/>.
+ * It is copyright by its individual contributors, as recorded in the
+ * project's Git history.  See COPYING.txt at the top level for license
+ * terms and a link to the Git history.
+ */
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+namespace dcx {
+
+/* One span of the fixed point perspective texture mapper, in the form
+ * that `c_tmap_scanline_per` steps it.  `v` and `dv` are already scaled
+ * by 64, and `l` and `dl` are in 1/256 of the units of fx_l.  Pixel `i`
+ * of the span is
+ *
+ *	fade_table[256 * ((l_i >> 8) & 0x7f) + texture[((v_i / z_i) & (64 * 63)) + ((u_i / z_i) & 63)]]
+ *
+ * where u_i = u + i * du, and likewise for v, z and l, all with 32-bit
+ * wraparound.  If `transparent`, pixels where the texel is 255 are left
+ * unchanged.
+ *
+ * `texture` is a 64x64 bitmap.  `fade_table` has 256 colors for each
+ * light level that the span reaches.
+ */
+struct tmap_per_span
+{
+	uint8_t *dest;
+	const uint8_t *texture;
+	const uint8_t *fade_table;
+	int32_t u, v, z, l;
+	int32_t du, dv, dz, dl;
+	std::size_t count;
+	bool transparent;
+};
+
+/* Instruction sets that tmap_scanline_per can use.  The best one that
+ * the processor supports is picked on first use.
+ */
+enum class tmap_scanline_isa : uint8_t
+{
+	scalar,
+	sse2,
+	avx2,
+};
+
+/* Draw `span`.  Every instruction set gives exactly the same pixels. */
+void tmap_scanline_per(const tmap_per_span &span);
+
+[[nodiscard]]
+tmap_scanline_isa tmap_scanline_best_isa();
+[[nodiscard]]
+tmap_scanline_isa tmap_scanline_get_isa();
+/* Force tmap_scanline_per to use `isa`.  Return false, and change
+ * nothing, if this build or this processor cannot use it.  This must
+ * not be called while another thread is drawing.
+ */
+bool tmap_scanline_set_isa(tmap_scanline_isa isa);
+
+}
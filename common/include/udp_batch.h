@@ -0,0 +1,140 @@
+/*
+ * This file is part of the DXX-Rebirth project <https://www.dxx-rebirth.com/>.
+ * It is copyright by its individual contributors, as recorded in the
+ * project's Git history.  See COPYING.txt at the top level for license
+ * terms and a link to the Git history.
+ */
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <span>
+
+#ifdef _WIN32
+#include <winsock2.h>
+#include <ws2tcpip.h>
+#else
+#include <sys/socket.h>
+#endif
+
+namespace dcx {
+
+/* Several messages for one peer, packed into one datagram of at most
+ * `capacity` bytes.  The datagram starts with `opcode`, followed by
+ * each message with its 16-bit little endian length in front of it.
+ *
+ * A bundle that holds only one message is sent as that message alone,
+ * so that the common case costs no extra bytes.
+ */
+template <uint8_t opcode, std::size_t capacity>
+class udp_bundle
+{
+	static_assert(capacity <= UINT16_MAX);
+	std::array<uint8_t, capacity> buffer{{opcode}};
+	std::size_t used = 1;
+	unsigned count = 0;
+public:
+	/* Add `message`, and return whether it fit.  A message that does
+	 * not fit in an empty bundle must be sent by itself.
+	 */
+	[[nodiscard]]
+	bool append(const std::span<const uint8_t> message)
+	{
+		if (message.empty() || message.size() + 2 > capacity - used)
+			return false;
+		buffer[used] = message.size();
+		buffer[used + 1] = message.size() >> 8;
+		std::memcpy(&buffer[used + 2], message.data(), message.size());
+		used += message.size() + 2;
+		++count;
+		return true;
+	}
+	[[nodiscard]]
+	bool empty() const
+	{
+		return !count;
+	}
+	/* The datagram that carries every message appended so far. */
+	[[nodiscard]]
+	std::span<const uint8_t> datagram() const
+	{
+		if (count == 1)
+			return std::span(buffer).subspan(3, used - 3);
+		return std::span(buffer).first(used);
+	}
+	/* Call `f` with each message appended so far, for a peer that
+	 * takes them one datagram each.
+	 */
+	template <typename F>
+	void for_each_message(F &&f) const
+	{
+		for (std::size_t i = 1; i != used;)
+		{
+			const std::size_t size = buffer[i] | (buffer[i + 1] << 8);
+			f(std::span(buffer).subspan(i + 2, size));
+			i += size + 2;
+		}
+	}
+	void clear()
+	{
+		used = 1;
+		count = 0;
+	}
+};
+
+/* Call `f` with each message of the bundle `datagram`, which includes
+ * the opcode.  Stop at the first length that is zero or that runs past
+ * the end of the datagram, and return false.
+ */
+template <typename F>
+bool udp_bundle_for_each(const std::span<uint8_t> datagram, F &&f)
+{
+	auto rest = datagram.subspan(1);
+	while (!rest.empty())
+	{
+		if (rest.size() < 2)
+			return false;
+		const std::size_t size = rest[0] | (rest[1] << 8);
+		rest = rest.subspan(2);
+		if (!size || size > rest.size())
+			return false;
+		f(rest.first(size));
+		rest = rest.subspan(size);
+	}
+	return true;
+}
+
+struct udp_send_item
+{
+	std::span<const uint8_t> data;
+	const sockaddr *addr;
+	socklen_t addrlen;
+};
+
+struct udp_receive_item
+{
+	std::span<uint8_t> buffer;
+	sockaddr *addr;
+	/* On entry, the size of `*addr`.  On return, the size of the
+	 * sender address.
+	 */
+	socklen_t addrlen;
+	/* On return, the size of the datagram. */
+	std::size_t size;
+};
+
+/* Send each item, in as few system calls as the platform allows.
+ * Errors for a single item are ignored, as for `sendto`.  Return the
+ * number of bytes sent.
+ */
+std::size_t udp_send_batch(int sockfd, std::span<const udp_send_item> items);
+
+/* Receive waiting datagrams into `items`, in order, without blocking.
+ * Return how many were received.  A return of less than items.size()
+ * means that the socket has no more datagrams waiting.
+ */
+std::size_t udp_receive_batch(int sockfd, std::span<udp_receive_item> items);
+
+}
@@ -0,0 +1,260 @@
+/*
+ * This file is part of the DXX-Rebirth project <https://www.dxx-rebirth.com/>.
+ * It is copyright by its individual contributors, as recorded in the
+ * project's Git history.  See COPYING.txt at the top level for license
+ * terms and a link to the Git history.
+ */
+#pragma once
+
+#include <array>
+#include <bitset>
+#include <cstddef>
+#include <cstdint>
+
+namespace dcx {
+
+/* Messages that some peers have not acknowledged yet, for resending
+ * until they do.
+ *
+ * Messages are kept in a ring in the order they were added, so that the
+ * oldest message is always at the front.  Each peer has its own list of
+ * the messages it still has to acknowledge, ordered by when each is next
+ * due to be resent, and a table that finds a message from the packet
+ * number that peer knows it by.
+ *
+ * Each peer must number its messages consecutively, wrapping at a
+ * multiple of `capacity`, so that no two messages waiting for the same
+ * peer share a table entry.
+ */
+template <typename T, std::size_t peers, std::size_t capacity>
+class udp_retransmit_queue
+{
+public:
+	using slot_index = uint16_t;
+	using peer_mask = std::bitset<peers>;
+	static constexpr slot_index none = UINT16_MAX;
+	static_assert(capacity < none);
+private:
+	struct link
+	{
+		slot_index prev = none, next = none;
+	};
+	struct slot
+	{
+		int64_t added;
+		peer_mask pending;
+		std::array<uint32_t, peers> pkt_num;
+		std::array<int64_t, peers> deadline;
+		std::array<link, peers> links;
+		T payload;
+	};
+	std::array<slot, capacity> slots{};
+	struct list
+	{
+		slot_index first = none, last = none;
+	};
+	std::array<list, peers> lists;
+	std::array<std::array<slot_index, capacity>, peers> by_pkt_num;
+	std::size_t first = 0, count = 0;
+	void unlink(const slot_index s, const std::size_t peer)
+	{
+		auto &l = slots[s].links[peer];
+		(l.prev == none ? lists[peer].first : slots[l.prev].links[peer].next) = l.next;
+		(l.next == none ? lists[peer].last : slots[l.next].links[peer].prev) = l.prev;
+		l = {};
+	}
+	/* How many messages were added before `s` that are still here. */
+	std::size_t age_rank(const slot_index s) const
+	{
+		return (s + capacity - first) % capacity;
+	}
+	/* Insert `s` in the list of `peer`, after every message that is due
+	 * sooner.  Messages due at the same time are kept oldest first, so
+	 * that a peer that accepts packets only in order gets them in order.
+	 */
+	void link(const slot_index s, const std::size_t peer)
+	{
+		const auto deadline = slots[s].deadline[peer];
+		const auto rank = age_rank(s);
+		auto prev = lists[peer].last;
+		for (; prev != none; prev = slots[prev].links[peer].prev)
+		{
+			const auto d = slots[prev].deadline[peer];
+			if (d < deadline || (d == deadline && age_rank(prev) < rank))
+				break;
+		}
+		const auto next = prev == none ? lists[peer].first : slots[prev].links[peer].next;
+		slots[s].links[peer] = {prev, next};
+		(prev == none ? lists[peer].first : slots[prev].links[peer].next) = s;
+		(next == none ? lists[peer].last : slots[next].links[peer].prev) = s;
+	}
+public:
+	udp_retransmit_queue()
+	{
+		clear();
+	}
+	void clear()
+	{
+		for (auto &s : slots)
+			s.pending.reset();
+		lists.fill({});
+		for (auto &t : by_pkt_num)
+			t.fill(none);
+		first = count = 0;
+	}
+	/* The number of slots in use, including those of fully acknowledged
+	 * messages that are not yet the oldest.
+	 */
+	[[nodiscard]]
+	std::size_t size() const
+	{
+		return count;
+	}
+	[[nodiscard]]
+	bool full() const
+	{
+		return count == capacity;
+	}
+	[[nodiscard]]
+	slot_index oldest() const
+	{
+		return count ? first : none;
+	}
+	[[nodiscard]]
+	const T &payload(const slot_index s) const
+	{
+		return slots[s].payload;
+	}
+	[[nodiscard]]
+	int64_t added(const slot_index s) const
+	{
+		return slots[s].added;
+	}
+	[[nodiscard]]
+	const peer_mask &pending(const slot_index s) const
+	{
+		return slots[s].pending;
+	}
+	[[nodiscard]]
+	uint32_t pkt_num(const slot_index s, const std::size_t peer) const
+	{
+		return slots[s].pkt_num[peer];
+	}
+	/* Store a message added at time `now`.  The queue must not be full.
+	 * Use `expect_ack` to name the peers that must acknowledge it.
+	 */
+	slot_index add(const int64_t now, const T &payload)
+	{
+		const slot_index s = (first + count) % capacity;
+		++count;
+		auto &m = slots[s];
+		m.added = now;
+		m.pending.reset();
+		m.payload = payload;
+		return s;
+	}
+	/* Wait for `peer` to acknowledge message `s` as packet `pkt_num`,
+	 * and resend it to that peer at `deadline` if it has not.
+	 */
+	void expect_ack(const slot_index s, const std::size_t peer, const uint32_t pkt_num, const int64_t deadline)
+	{
+		auto &m = slots[s];
+		if (m.pending[peer])
+			unlink(s, peer);
+		m.pending.set(peer);
+		m.pkt_num[peer] = pkt_num;
+		m.deadline[peer] = deadline;
+		link(s, peer);
+		by_pkt_num[peer][pkt_num % capacity] = s;
+	}
+	/* Return the message that `peer` has not acknowledged as packet
+	 * `pkt_num`, or `none`.
+	 */
+	[[nodiscard]]
+	slot_index find(const std::size_t peer, const uint32_t pkt_num) const
+	{
+		const auto s = by_pkt_num[peer][pkt_num % capacity];
+		if (s == none)
+			return none;
+		auto &m = slots[s];
+		return m.pending[peer] && m.pkt_num[peer] == pkt_num ? s : none;
+	}
+	void acknowledge(const slot_index s, const std::size_t peer)
+	{
+		auto &m = slots[s];
+		if (!m.pending[peer])
+			return;
+		m.pending.reset(peer);
+		unlink(s, peer);
+		by_pkt_num[peer][m.pkt_num[peer] % capacity] = none;
+	}
+	/* Stop waiting for `peer` to acknowledge anything. */
+	void acknowledge_all(const std::size_t peer)
+	{
+		while (lists[peer].first != none)
+			acknowledge(lists[peer].first, peer);
+	}
+	/* If a message is due to be resent to `peer` at time `now`, call
+	 * `resend(s)` for every message `s` that `peer` has not
+	 * acknowledged, in list order, and make each due again at
+	 * `now + interval`.  A peer that accepts packets only in order
+	 * dropped everything sent after the packet it missed, so those are
+	 * sent again with it.  Stop early if `resend` returns false; that
+	 * message and the rest keep their deadlines.
+	 */
+	template <typename F>
+	void resend_due(const std::size_t peer, const int64_t now, const int64_t interval, F &&resend)
+	{
+		auto s = lists[peer].first;
+		if (s == none || slots[s].deadline[peer] > now)
+			return;
+		/* Take the resent messages out of the list, in order, and put
+		 * them back by their new deadline afterward.
+		 */
+		slot_index resent_first = none, resent_last = none;
+		while (s != none && resend(s))
+		{
+			const auto next = slots[s].links[peer].next;
+			unlink(s, peer);
+			slots[s].deadline[peer] = now + interval;
+			(resent_last == none ? resent_first : slots[resent_last].links[peer].next) = s;
+			resent_last = s;
+			s = next;
+		}
+		for (s = resent_first; s != none;)
+		{
+			const auto next = slots[s].links[peer].next;
+			link(s, peer);
+			s = next;
+		}
+	}
+	/* Remove the oldest message, whether or not it was acknowledged. */
+	void pop_oldest()
+	{
+		const slot_index s = first;
+		for (std::size_t peer = 0; peer != peers; ++peer)
+			acknowledge(s, peer);
+		first = (first + 1) % capacity;
+		--count;
+	}
+	/* Remove messages from the front of the ring while they are fully
+	 * acknowledged, or were added at least `timeout` before `now`.
+	 * `on_remove(s)` is called for each message before it is removed;
+	 * `pending(s)` is not empty for one that timed out.
+	 */
+	template <typename F>
+	void remove_finished(const int64_t now, const int64_t timeout, F &&on_remove)
+	{
+		while (count)
+		{
+			const slot_index s = first;
+			auto &m = slots[s];
+			if (m.pending.any() && m.added + timeout > now)
+				break;
+			on_remove(s);
+			pop_oldest();
+		}
+	}
+};
+
+}
@@ -174,6 +174,8 @@ extern d_level_shared_boss_state LevelSharedBossState;
 void move_towards_segment_center(const robot_info &robptr, const d_level_shared_segment_state &, object_base &objp);
 imobjptridx_t gate_in_robot(const d_robot_info_array &Robot_info, robot_id type, vmsegptridx_t segnum);
 void do_ai_frame(const d_level_shared_robot_info_state &LevelSharedRobotInfoState, vmobjptridx_t objp);
+void ai_start_visibility_prefetch();
+void init_ai_commands();
 #if defined(DXX_BUILD_DESCENT_I)
 #define do_ai_frame_all(Robot_info) do_ai_frame_all()
 #elif defined(DXX_BUILD_DESCENT_II)
@@ -26,6 +26,10 @@ namespace dsx {
 struct d_level_unique_object_state
 {
 	unsigned num_objects = 0;
+	/* The most objects that obj_allocate will allow at once.  It is set
+	 * from `-maxobjects` when a single player level is loaded.
+	 */
+	unsigned Object_limit = DEFAULT_MAX_OBJECTS;
 	/* `accumulated_robots` counts robots present at level entry and
 	 * robots added later via materialization centers / boss gating.  It
 	 * never decreases, so it is not a shortcut for counting the number
@@ -41,6 +45,7 @@ struct d_level_unique_object_state
 #endif
 	std::array<imobjidx_t, MAX_OBJECTS> free_obj_list = init_object_number_array<imobjidx_t>(std::make_index_sequence<MAX_OBJECTS>());
 	object_array Objects;
+	d_object_type_index Object_types;
 	d_level_unique_boss_state BossState;
 	d_level_unique_control_center_state ControlCenterState;
 	vms_vector last_console_player_position;
@@ -54,6 +59,10 @@ struct d_level_unique_object_state
 	{
 		return Objects;
 	}
+	unsigned get_max_used_objects() const
+	{
+		return Object_limit - RESERVED_OBJECT_SLOTS;
+	}
 };
 
 extern d_level_unique_object_state LevelUniqueObjectState;
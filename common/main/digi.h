@@ -192,6 +192,9 @@ extern void digi_sync_sounds();
 
 extern void digi_set_digi_volume( int dvolume );
 
+// Convert the sounds of the level for the sound system ahead of their first use.
+void digi_prepare_level_sounds();
+
 extern void digi_pause_digi_sounds();
 extern void digi_resume_digi_sounds();
 
@@ -32,6 +32,7 @@ COPYRIGHT 1993-1999 PARALLAX SOFTWARE CORPORATION.  ALL RIGHTS RESERVED.
 #include "pack.h"
 #include "countarray.h"
 #include "fwd-segment.h"
+#include "fwd-wall.h"
 #include "robot.h"
 
 //return values for find_vector_intersection() - what did we hit?
@@ -131,10 +132,34 @@ struct fvi_query
 [[nodiscard]]
 fvi_hit_type find_vector_intersection(fvi_query fq, segnum_t startseg, fix rad, fvi_info &hit_data);
 
+//The walls whose WALL_IS_DOORWAY result a traced find_vector_intersection
+//call depended on.  While unchanged() is true, repeating the same query
+//would produce the same result, so the result may be reused.
+struct fvi_wall_trace
+{
+	struct wall_side
+	{
+		segnum_t segnum;
+		sidenum_t sidenum;
+		wall_is_doorway_result wid;
+	};
+	std::array<wall_side, 16> sides;
+	uint8_t count;
+	bool overflow;
+	void add(segnum_t segnum, sidenum_t sidenum, wall_is_doorway_result wid);
+	[[nodiscard]]
+	bool unchanged() const;
+};
+
+[[nodiscard]]
+fvi_hit_type find_vector_intersection(const fvi_query &fq, segnum_t startseg, fix rad, fvi_info &hit_data, fvi_wall_trace &trace);
+
 //finds the uv coords of the given point on the given seg & side
 //fills in u & v. if l is non-NULL fills it in also
 [[nodiscard]]
 fvi_hitpoint find_hitpoint_uv(const vms_vector &pnt, const cscusegment seg, sidenum_t sidenum, uint_fast32_t facenum);
+
+void init_fvi_commands();
 }
 
 //Returns true if the object is through any walls
@@ -149,6 +149,7 @@ extern int force_cockpit_redraw;
 // from game.c
 void close_game(void);
 void calc_frame_time(void);
+void advance_game_time();
 
 #define MAX_PALETTE_ADD 30
 
@@ -22,8 +22,16 @@
 namespace dcx {
 
 // Movement types
-constexpr std::integral_constant<std::size_t, 350> MAX_OBJECTS{};
-constexpr std::integral_constant<std::size_t, MAX_OBJECTS - 20> MAX_USED_OBJECTS{};
+/* The size of the object array.  A level may use fewer; see
+ * d_level_unique_object_state::Object_limit.
+ */
+constexpr std::integral_constant<std::size_t, 2000> MAX_OBJECTS{};
+/* The object limit of the original game, and the default limit. */
+constexpr std::integral_constant<std::size_t, 350> DEFAULT_MAX_OBJECTS{};
+/* When fewer than this many object slots remain under the limit,
+ * object_move_all frees short-lived objects to make room.
+ */
+constexpr std::integral_constant<std::size_t, 20> RESERVED_OBJECT_SLOTS{};
 struct d_level_unique_control_center_state;
 
 // Render types
@@ -280,7 +288,7 @@ void wake_up_rendered_objects(const object &gmissp, window_rendered_data &window
 
 void fuelcen_check_for_goal(object &plrobj, const shared_segment &segp);
 #endif
-imobjptridx_t obj_find_first_of_type(fvmobjptridx &, object_type_t type);
+imobjptridx_t obj_find_first_of_type(d_level_unique_object_state &, object_type_t type);
 
 void object_rw_swap(struct object_rw *obj_rw, physfsx_endian swap);
 void reset_player_object(object_base &);
@@ -103,7 +103,13 @@ constexpr std::integral_constant<unsigned, 2620> MAX_BITMAP_FILES{};
 using GameBitmaps_array = enumerated_array<grs_bitmap, MAX_BITMAP_FILES, bitmap_index>;
 extern std::array<digi_sound, MAX_SOUND_FILES> GameSounds;
 extern GameBitmaps_array GameBitmaps;
+// The value of Event_frame_count when each bitmap was last paged in or
+// found already paged in.  Bitmaps used in the current frame are never
+// evicted to make room for another.
+extern enumerated_array<unsigned, MAX_BITMAP_FILES, bitmap_index> GameBitmapLastUse;
+extern unsigned Piggy_bitmap_cache_hits;
 void piggy_bitmap_page_in(GameBitmaps_array &, bitmap_index bmp);
+void init_piggy_commands();
 
 #if defined(DXX_BUILD_DESCENT_I)
 void piggy_read_sounds(int pc_shareware);
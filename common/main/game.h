@@ -295,6 +295,7 @@ struct game_cheats : prohibit_void_ptr<game_cheats>
 void game_render_frame(const d_robot_info_array &Robot_info, const control_info &Controls);
 void game_render_frame_mono(const d_robot_info_array &Robot_info, const control_info &Controls);
 window_event_result ReadControls(const d_level_shared_robot_info_state &LevelSharedRobotInfoState, const d_event &event, control_info &Controls);
+window_event_result GameProcessFrame(const d_level_shared_robot_info_state &LevelSharedRobotInfoState);
 
 }
 #endif
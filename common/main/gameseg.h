@@ -210,10 +210,9 @@ vms_vector pick_random_point_in_seg(fvcvertptr &vcvertptr, const shared_segment
 
 int check_segment_connections(void);
 unsigned set_segment_depths(vcsegidx_t start_seg, const std::array<uint8_t, MAX_SEGMENTS> *limit, segment_depth_array_t &depths);
-#if defined(DXX_BUILD_DESCENT_I)
-static inline void flush_fcd_cache() {}
-#elif defined(DXX_BUILD_DESCENT_II)
 void flush_fcd_cache();
+void init_fcd_cache_commands();
+#if defined(DXX_BUILD_DESCENT_II)
 void apply_all_changed_light(const d_level_shared_destructible_light_state &LevelSharedDestructibleLightState, fvmsegptridx &vmsegptridx);
 void	set_ambient_sound_flags(void);
 #endif
@@ -258,6 +258,10 @@ struct mission_entry_predicate
 //Returns nullptr if mission loaded ok, else error string.
 const char *load_mission_by_name (mission_entry_predicate mission_name, mission_name_type);
 
+//loads the first mission that the New Game menu lists.
+//Returns nullptr if mission loaded ok, else error string.
+const char *load_first_mission();
+
 #if DXX_USE_EDITOR
 void create_new_mission(void);
 #endif
@@ -629,6 +629,11 @@ enum class netgame_rule_flags : uint8_t
 	 * Changing them breaks ABI compatibility.
 	 */
 	closed = 1,
+	/* The host accepts and sends delta coded player position snapshots
+	 * (upid::pdata_snapshot).  Older versions ignore this bit, and are
+	 * sent plain pdata.
+	 */
+	pdata_snapshots = 2,
 	show_all_players_on_automap = 4,
 	/* if DXX_BUILD_DESCENT_II */
 	hoard = 8,
@@ -636,6 +641,11 @@ enum class netgame_rule_flags : uint8_t
 	really_endlevel = 32,
 	really_forming = 64,
 	/* endif */
+	/* The host accepts and sends several game packets in one datagram
+	 * (upid::bundle).  Older versions ignore this bit, and are sent one
+	 * datagram per packet.
+	 */
+	packet_bundles = 128,
 };
 
 [[nodiscard]]
@@ -81,6 +81,7 @@ constexpr std::integral_constant<unsigned, 12> UDP_NETGAMES_PPAGE{}; // Netgames
 #define UDP_MDATA_STOR_MIN_FREE_2JOIN 384u // have at least this many free packet slots before we let someone join the game
 #define UDP_MDATA_PKT_NUM_MIN 1 // start from pkt_num 1 (0 is used to initialize the trace list)
 #define UDP_MDATA_PKT_NUM_MAX (UDP_MDATA_STOR_QUEUE_SIZE*100) // the max value for pkt_num. roll over when we go any higher. this should be smaller than INT_MAX
+#define UDP_MDATA_RESEND_INTERVAL (F1_0/4) // resend MDATA packets that were not ACK'd after this long
 
 // UDP-Packet identificators (ubyte) and their (max. sizes).
 #define UPID_MAX_SIZE			       1024 // Max size for a packet
@@ -134,16 +135,11 @@ struct UDP_mdata_info : prohibit_void_ptr<UDP_mdata_info>
 	std::array<uint8_t, UPID_MDATA_BUF_SIZE> mbuf;
 };
 
-// structure to store MDATA to maybe resend
+// structure to store MDATA to maybe resend.  The queue that holds it keeps the timestamps, packet numbers and ACKs.
 struct UDP_mdata_store : prohibit_void_ptr<UDP_mdata_store>
 {
-	fix64				pkt_initial_timestamp;			// initial timestamp to see if packet is outdated
-	per_player_array<fix64>		pkt_timestamp;		// Packet timestamp
-	per_player_array<uint32_t>	pkt_num;			// Packet number
-	sbyte				used;
 	ubyte				Player_num;				// sender of this packet
 	uint16_t			data_size;
-	player_acknowledgement_mask player_ack;		// 0 if player has not ACK'd this packet, 1 if ACK'd or not connected
 	std::array<uint8_t, UPID_MDATA_BUF_SIZE> data;		// extra data of a packet - contains all multibuf data we don't want to loose
 };
 
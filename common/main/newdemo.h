@@ -151,6 +151,7 @@ extern window_event_result newdemo_goto_end(int to_rewrite);
 }
 #endif
 extern window_event_result newdemo_goto_beginning();
+window_event_result newdemo_skip_seconds(int seconds);
 
 // Interactive functions to control playback/record;
 #ifdef dsx
@@ -54,6 +54,7 @@ COPYRIGHT 1993-1999 PARALLAX SOFTWARE CORPORATION.  ALL RIGHTS RESERVED.
 #include "escort.h"
 #endif
 #include <array>
+#include <initializer_list>
 #include <utility>
 
 namespace dcx {
@@ -582,6 +583,7 @@ struct obj_position
 			dxx_object_type_value == OBJ_MARKER	\
 		);	\
 		dxx_object_type_ref.type = static_cast<object_type_t>(dxx_object_type_value);	\
+		note_object_type_change(dxx_object_type_ref);	\
 	} DXX_END_COMPOUND_STATEMENT )
 
 namespace dsx {
@@ -745,6 +747,134 @@ struct d_level_unique_boss_state : ::dcx::d_level_unique_boss_state
 const player &get_player_controlling_guidebot(const d_unique_buddy_state & /* reserved for future use */, const valptridx<player>::array_managed_type &Players);
 #endif
 
+/* A set of object types to search for.  Types that no object can have,
+ * such as OBJ_NONE, are ignored.
+ */
+class object_type_mask
+{
+	uint32_t bits = 0;
+public:
+	constexpr object_type_mask() = default;
+	constexpr object_type_mask(const std::initializer_list<object_type_t> types)
+	{
+		for (const auto type : types)
+			insert(type);
+	}
+	/* Every type that an object can have. */
+	static constexpr object_type_mask all()
+	{
+		object_type_mask m;
+		m.bits = (1u << MAX_OBJECT_TYPES) - 1;
+		return m;
+	}
+	constexpr void insert(const object_type_t type)
+	{
+		if (type < MAX_OBJECT_TYPES)
+			bits |= 1u << type;
+	}
+	constexpr uint32_t get_bits() const
+	{
+		return bits;
+	}
+};
+
+/* For each object type, the object numbers that currently hold an
+ * object of that type.  This lets a search for a few types skip the
+ * rest of the object array.
+ *
+ * obj_create, obj_delete and set_object_type keep the index current.
+ * Code that rewrites the object array in bulk, such as loading a level
+ * or a saved game, ends in reset_objects or special_reset_objects,
+ * which rebuild it.  Debug builds check it against the object array
+ * each frame.
+ */
+class d_object_type_index
+{
+	using word_type = uint64_t;
+	static constexpr std::size_t word_bits = 64;
+	using object_bits = std::array<word_type, (MAX_OBJECTS + word_bits - 1) / word_bits>;
+	std::array<object_bits, MAX_OBJECT_TYPES> objects_by_type{};
+	/* The type under which each object number is in `objects_by_type`,
+	 * or OBJ_NONE if it is in none of them.
+	 */
+	std::array<object_type_t, MAX_OBJECTS> indexed_type;
+public:
+	d_object_type_index();
+	void update(objnum_t objnum, object_type_t type);
+	void rebuild(const object_array &Objects);
+#ifndef NDEBUG
+	/* Does the index agree with the types in `Objects`? */
+	[[nodiscard]]
+	bool matches(const object_array &Objects) const;
+#endif
+	/* Return the lowest object number in [first, end) of an object with
+	 * a type in `types`, or `end` if there is none.
+	 */
+	[[nodiscard]]
+	objnum_t find_next(objnum_t first, objnum_t end, object_type_mask types) const;
+};
+
+/* The objects with a type in `types`, in increasing object number.
+ * Like a loop over `vmobjptridx`, the end is fixed when the range is
+ * created, and the index is read as the loop advances, so an object
+ * that changes type during the loop is visited if it has a wanted type
+ * when the loop reaches it.
+ *
+ * If `center` is given, objects that are `radius` or farther from it
+ * along any axis are skipped.  That bounds a cube, not a sphere, so the
+ * caller must still test the distance it needs.
+ */
+class object_type_range
+{
+	const d_object_type_index &index;
+	fvmobjptridx &vmobjptridx;
+	const object_type_mask types;
+	const objnum_t end_objnum;
+	const vms_vector *const center;
+	const vm_distance radius;
+	[[nodiscard]]
+	objnum_t find_next(objnum_t first) const;
+public:
+	class iterator
+	{
+		const object_type_range &range;
+		objnum_t objnum;
+	public:
+		iterator(const object_type_range &range, const objnum_t objnum) :
+			range(range), objnum(objnum)
+		{
+		}
+		vmobjptridx_t operator*() const
+		{
+			return range.vmobjptridx(objnum);
+		}
+		iterator &operator++()
+		{
+			objnum = range.find_next(objnum + 1);
+			return *this;
+		}
+		bool operator==(const iterator &rhs) const
+		{
+			return objnum == rhs.objnum;
+		}
+	};
+	object_type_range(const d_object_type_index &index, fvmobjptridx &vmobjptridx, const object_type_mask types, const vms_vector *const center = nullptr, const vm_distance radius = {}) :
+		index(index), vmobjptridx(vmobjptridx), types(types), end_objnum(vmobjptridx.count()), center(center), radius(radius)
+	{
+	}
+	iterator begin() const
+	{
+		return {*this, find_next(0)};
+	}
+	iterator end() const
+	{
+		return {*this, end_objnum};
+	}
+};
+
+/* Record a type change made by set_object_type in the type index. */
+void note_object_type_change(const object_base &obj);
+
 // after calling init_object(), the network code has grabbed specific
 // object slots without allocating them.  Go though the objects &
 // build the free list, then set the appropriate globals.
@@ -785,6 +915,7 @@ window_event_result dead_player_frame(const d_robot_info_array &Robot_info);
 // move all objects for the current frame
 window_event_result game_move_all_objects(const d_level_shared_robot_info_state &LevelSharedRobotInfoState);     // moves all objects
 window_event_result endlevel_move_all_objects(const d_level_shared_robot_info_state &LevelSharedRobotInfoState);
+void init_object_commands();
 
 }
 
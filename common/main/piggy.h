@@ -27,6 +27,7 @@ COPYRIGHT 1993-1999 PARALLAX SOFTWARE CORPORATION.  ALL RIGHTS RESERVED.
 
 #include <ranges>
 #include "dsx-ns.h"
+#include "fwd-event.h"
 #include "fwd-inferno.h"
 #include "fwd-piggy.h"
 #include "fwd-robot.h"
@@ -64,8 +65,11 @@ namespace dsx {
 #  define  PIGGY_PAGE_IN(bmp) _piggy_page_in(GameBitmaps, bmp)
 static inline void _piggy_page_in(GameBitmaps_array &GameBitmaps, bitmap_index bmp)
 {
+	GameBitmapLastUse[bmp] = Event_frame_count;
 	if (GameBitmaps[bmp].get_flag_mask(BM_FLAG_PAGED_OUT))
         piggy_bitmap_page_in(GameBitmaps, bmp);
+	else
+		++ Piggy_bitmap_cache_hits;
 }
 
 #if defined(DXX_BUILD_DESCENT_I)
@@ -136,6 +136,10 @@ namespace dsx {
 void render_frame(grs_canvas &, fix eye_offset, window_rendered_data &);  //draws the world into the current canvas
 void render_mine(grs_canvas &, const vms_vector &, vcsegidx_t start_seg_num, fix eye_offset, window_rendered_data &);
 
+// Forget every cached visible segment list.  Call when the level changes.
+void flush_segment_list_cache();
+void init_render_commands();
+
 // Render an object.  Calls one of several routines based on type
 void render_object(grs_canvas &, const d_level_unique_light_state &LevelUniqueLightState, vmobjptridx_t obj);
 
@@ -0,0 +1,74 @@
+/*
+ * This file is part of the DXX-Rebirth project <https://www.dxx-rebirth.com/>.
+ * It is copyright by its individual contributors, as recorded in the
+ * project's Git history.  See COPYING.txt at the top level for license
+ * terms and a link to the Git history.
+ */
+
+/*
+ *
+ * Headless simulation benchmark
+ *
+ */
+
+#pragma once
+
+#include <array>
+#include <chrono>
+#include <cstdint>
+#include "dsx-ns.h"
+
+namespace dcx {
+
+/* Parts of the simulation that -simbench times separately.  A phase may
+ * run inside another: physics is part of object movement, and
+ * collisions are part of physics.
+ */
+enum class sim_bench_phase : uint8_t
+{
+	ai,
+	object_movement,
+	physics,
+	collisions,
+};
+
+constexpr std::size_t sim_bench_phase_count = 4;
+
+/* Time is only counted while a benchmark runs, so normal play pays one
+ * test per timed call.
+ */
+extern bool Sim_bench_active;
+extern std::array<std::chrono::steady_clock::duration, sim_bench_phase_count> Sim_bench_phase_time;
+
+class sim_bench_phase_timer
+{
+	const sim_bench_phase phase;
+	const std::chrono::steady_clock::time_point start;
+public:
+	sim_bench_phase_timer(const sim_bench_phase phase) :
+		phase(phase), start(Sim_bench_active ? std::chrono::steady_clock::now() : std::chrono::steady_clock::time_point{})
+	{
+	}
+	sim_bench_phase_timer(const sim_bench_phase_timer &) = delete;
+	sim_bench_phase_timer &operator=(const sim_bench_phase_timer &) = delete;
+	~sim_bench_phase_timer()
+	{
+		if (Sim_bench_active)
+			Sim_bench_phase_time[static_cast<std::size_t>(phase)] += std::chrono::steady_clock::now() - start;
+	}
+};
+
+}
+
+#ifdef dsx
+namespace dsx {
+
+/* Load the mission and level named by the -simbench options, step the
+ * simulation for the requested number of frames at a fixed FrameTime
+ * without rendering, and report the timings and a hash of the final
+ * state to the console.  The game window is closed before returning.
+ */
+void run_sim_bench();
+
+}
+#endif
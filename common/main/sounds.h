@@ -28,6 +28,7 @@ COPYRIGHT 1993-1999 PARALLAX SOFTWARE CORPORATION.  ALL RIGHTS RESERVED.
 #define _SOUNDS_H
 
 #include <array>
+#include <bitset>
 #include <cstdint>
 #include <type_traits>
 #include "dsx-ns.h"
@@ -181,6 +182,16 @@ enum sound_effect : unsigned
 extern std::array<uint8_t, ::d2x::MAX_SOUNDS> Sounds, AltSounds;
 }
 
+namespace dsx {
+
+/* The sounds, as indices into GameSounds, that the current level may
+ * play.  This leaves out only the sounds of robots that cannot appear
+ * in the level.
+ */
+std::bitset<MAX_SOUNDS> digi_level_sounds();
+
+}
+
 constexpr std::integral_constant<int, -1> sound_none{};
 #endif
 
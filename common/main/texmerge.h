@@ -37,5 +37,12 @@ int texmerge_init();
 grs_bitmap &texmerge_get_cached_bitmap(texture1_value tmap_bottom, texture2_value tmap_top);
 void texmerge_close();
 void texmerge_flush();
+void init_texmerge_commands();
+
+#ifdef dsx
+namespace dsx {
+void texmerge_prepare_level();
+}
+#endif
 
 #endif /* _TEXMERGE_H */
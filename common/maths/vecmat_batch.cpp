@@ -0,0 +1,449 @@
+/*
+ * This file is part of the DXX-Rebirth project <https://www.dxx-rebirth.com/>.
+ * It is copyright by its individual contributors, as recorded in the
+ * project's Git history.  See COPYING.txt at the top level for license
+ * terms and a link to the Git history.
+ */
+
+/*
+ *
+ * Batch forms of the vector functions, with SIMD kernels
+ *
+ */
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cassert>
+#include "maths.h"
+#include "vecmat.h"
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define DXX_VECMAT_BATCH_X86	1
+#include <immintrin.h>
+#elif defined(__ARM_NEON)
+#define DXX_VECMAT_BATCH_NEON	1
+#include <arm_neon.h>
+#endif
+
+/* The kernels read and write a span of vms_vector as a packed array of
+ * fix.
+ */
+static_assert(sizeof(dcx::vms_vector) == 3 * sizeof(dcx::fix));
+static_assert(sizeof(dcx::vm_distance_squared) == sizeof(int64_t));
+
+namespace dcx {
+
+namespace {
+
+/* Every kernel handles `count` elements starting at the front of each
+ * array.  The caller ensures the arrays are at least that long.  A
+ * kernel may stop early, leaving the remainder for the scalar code, and
+ * returns how many elements it handled.
+ */
+struct vm_vec_batch_kernels
+{
+	vm_vec_batch_isa isa;
+	std::size_t (*rotate)(vms_vector *dest, const vms_vector *src, std::size_t count, const vms_matrix &m);
+	std::size_t (*dot)(fix *dest, const vms_vector *src, std::size_t count, const vms_vector &v);
+	std::size_t (*dist2)(vm_distance_squared *dest, const vms_vector *src, std::size_t count, const vms_vector &p);
+};
+
+std::size_t vm_vec_rotate_scalar(vms_vector *, const vms_vector *, std::size_t, const vms_matrix &)
+{
+	return 0;
+}
+
+std::size_t vm_vec_dot_scalar(fix *, const vms_vector *, std::size_t, const vms_vector &)
+{
+	return 0;
+}
+
+std::size_t vm_vec_dist2_scalar(vm_distance_squared *, const vms_vector *, std::size_t, const vms_vector &)
+{
+	return 0;
+}
+
+constexpr vm_vec_batch_kernels vm_vec_kernels_scalar{
+	vm_vec_batch_isa::scalar,
+	vm_vec_rotate_scalar,
+	vm_vec_dot_scalar,
+	vm_vec_dist2_scalar,
+};
+
+/* The scalar functions compute each product in 64 bits, sum the
+ * products in 64 bits, then shift the sum right by 16 and truncate it
+ * to 32 bits.  The kernels do the same in each 64-bit lane.  The low 32
+ * bits of a logical right shift equal the low 32 bits of an arithmetic
+ * right shift, so the kernels may use whichever shift the instruction
+ * set offers.
+ */
+#if DXX_VECMAT_BATCH_X86
+/* SSE4.1: `_mm_mul_epi32` multiplies the signed low 32 bits of each
+ * 64-bit lane, so each register carries two elements, in lanes 0 and 2.
+ */
+#define DXX_VECMAT_TARGET_SSE41	__attribute__((target("sse4.1")))
+#define DXX_VECMAT_TARGET_AVX2	__attribute__((target("avx2")))
+
+struct vm_vec_sse41_xyz
+{
+	__m128i x, y, z;
+};
+
+/* Load two consecutive vectors, so that lanes 0 and 2 of `x` are the
+ * `x` of the first and second vector, and likewise for `y` and `z`.
+ */
+DXX_VECMAT_TARGET_SSE41
+static inline vm_vec_sse41_xyz vm_vec_load2_sse41(const vms_vector *const src)
+{
+	const auto f = reinterpret_cast<const fix *>(src);
+	/* x0 y0 z0 x1 */
+	const __m128i a = _mm_loadu_si128(reinterpret_cast<const __m128i *>(f));
+	/* y1 z1 */
+	const __m128i b = _mm_loadl_epi64(reinterpret_cast<const __m128i *>(f + 4));
+	return {
+		_mm_unpacklo_epi64(a, _mm_srli_si128(a, 12)),
+		_mm_unpacklo_epi64(_mm_srli_si128(a, 4), b),
+		_mm_unpacklo_epi64(_mm_srli_si128(a, 8), _mm_srli_si128(b, 4)),
+	};
+}
+
+DXX_VECMAT_TARGET_SSE41
+static inline __m128i vm_vec_dot_sse41(const vm_vec_sse41_xyz &s, const __m128i vx, const __m128i vy, const __m128i vz)
+{
+	const __m128i p = _mm_add_epi64(_mm_add_epi64(_mm_mul_epi32(s.x, vx), _mm_mul_epi32(s.y, vy)), _mm_mul_epi32(s.z, vz));
+	return _mm_srli_epi64(p, 16);
+}
+
+DXX_VECMAT_TARGET_SSE41
+std::size_t vm_vec_rotate_sse41(vms_vector *const dest, const vms_vector *const src, const std::size_t count, const vms_matrix &m)
+{
+	const __m128i rx = _mm_set1_epi32(m.rvec.x), ry = _mm_set1_epi32(m.rvec.y), rz = _mm_set1_epi32(m.rvec.z);
+	const __m128i ux = _mm_set1_epi32(m.uvec.x), uy = _mm_set1_epi32(m.uvec.y), uz = _mm_set1_epi32(m.uvec.z);
+	const __m128i fx = _mm_set1_epi32(m.fvec.x), fy = _mm_set1_epi32(m.fvec.y), fz = _mm_set1_epi32(m.fvec.z);
+	std::size_t i = 0;
+	for (; i + 2 <= count; i += 2)
+	{
+		const auto s = vm_vec_load2_sse41(&src[i]);
+		const __m128i r = vm_vec_dot_sse41(s, rx, ry, rz);
+		const __m128i u = vm_vec_dot_sse41(s, ux, uy, uz);
+		const __m128i f = vm_vec_dot_sse41(s, fx, fy, fz);
+		dest[i] = {_mm_cvtsi128_si32(r), _mm_cvtsi128_si32(u), _mm_cvtsi128_si32(f)};
+		dest[i + 1] = {_mm_extract_epi32(r, 2), _mm_extract_epi32(u, 2), _mm_extract_epi32(f, 2)};
+	}
+	return i;
+}
+
+DXX_VECMAT_TARGET_SSE41
+std::size_t vm_vec_dot_sse41(fix *const dest, const vms_vector *const src, const std::size_t count, const vms_vector &v)
+{
+	const __m128i vx = _mm_set1_epi32(v.x), vy = _mm_set1_epi32(v.y), vz = _mm_set1_epi32(v.z);
+	std::size_t i = 0;
+	for (; i + 2 <= count; i += 2)
+	{
+		const __m128i d = vm_vec_dot_sse41(vm_vec_load2_sse41(&src[i]), vx, vy, vz);
+		_mm_storel_epi64(reinterpret_cast<__m128i *>(&dest[i]), _mm_shuffle_epi32(d, _MM_SHUFFLE(3, 3, 2, 0)));
+	}
+	return i;
+}
+
+DXX_VECMAT_TARGET_SSE41
+std::size_t vm_vec_dist2_sse41(vm_distance_squared *const dest, const vms_vector *const src, const std::size_t count, const vms_vector &p)
+{
+	const __m128i px = _mm_set1_epi32(p.x), py = _mm_set1_epi32(p.y), pz = _mm_set1_epi32(p.z);
+	std::size_t i = 0;
+	for (; i + 2 <= count; i += 2)
+	{
+		const auto s = vm_vec_load2_sse41(&src[i]);
+		const __m128i dx = _mm_sub_epi32(s.x, px), dy = _mm_sub_epi32(s.y, py), dz = _mm_sub_epi32(s.z, pz);
+		const __m128i d2 = _mm_add_epi64(_mm_add_epi64(_mm_mul_epi32(dx, dx), _mm_mul_epi32(dy, dy)), _mm_mul_epi32(dz, dz));
+		_mm_storeu_si128(reinterpret_cast<__m128i *>(&dest[i]), d2);
+	}
+	return i;
+}
+
+constexpr vm_vec_batch_kernels vm_vec_kernels_sse41{
+	vm_vec_batch_isa::sse4_1,
+	vm_vec_rotate_sse41,
+	vm_vec_dot_sse41,
+	vm_vec_dist2_sse41,
+};
+
+/* AVX2: as SSE4.1, but with four elements per register, in lanes 0, 2,
+ * 4 and 6.
+ */
+struct vm_vec_avx2_xyz
+{
+	__m256i x, y, z;
+};
+
+DXX_VECMAT_TARGET_AVX2
+static inline vm_vec_avx2_xyz vm_vec_load4_avx2(const vms_vector *const src)
+{
+	const auto f = reinterpret_cast<const fix *>(src);
+	/* x0 y0 z0 x1 y1 z1 x2 y2 */
+	const __m256i a = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(f));
+	/* y1 z1 x2 y2 z2 x3 y3 z3 */
+	const __m256i b = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(f + 4));
+	return {
+		_mm256_blend_epi32(
+			_mm256_permutevar8x32_epi32(a, _mm256_setr_epi32(0, 0, 3, 3, 6, 6, 6, 6)),
+			_mm256_permutevar8x32_epi32(b, _mm256_setr_epi32(5, 5, 5, 5, 5, 5, 5, 5)), 0xc0),
+		_mm256_blend_epi32(
+			_mm256_permutevar8x32_epi32(a, _mm256_setr_epi32(1, 1, 4, 4, 7, 7, 7, 7)),
+			_mm256_permutevar8x32_epi32(b, _mm256_setr_epi32(6, 6, 6, 6, 6, 6, 6, 6)), 0xc0),
+		_mm256_blend_epi32(
+			_mm256_permutevar8x32_epi32(a, _mm256_setr_epi32(2, 2, 5, 5, 5, 5, 5, 5)),
+			_mm256_permutevar8x32_epi32(b, _mm256_setr_epi32(4, 4, 4, 4, 4, 4, 7, 7)), 0xf0),
+	};
+}
+
+DXX_VECMAT_TARGET_AVX2
+static inline __m256i vm_vec_dot_avx2(const vm_vec_avx2_xyz &s, const __m256i vx, const __m256i vy, const __m256i vz)
+{
+	const __m256i p = _mm256_add_epi64(_mm256_add_epi64(_mm256_mul_epi32(s.x, vx), _mm256_mul_epi32(s.y, vy)), _mm256_mul_epi32(s.z, vz));
+	return _mm256_srli_epi64(p, 16);
+}
+
+DXX_VECMAT_TARGET_AVX2
+std::size_t vm_vec_rotate_avx2(vms_vector *const dest, const vms_vector *const src, const std::size_t count, const vms_matrix &m)
+{
+	const __m256i rx = _mm256_set1_epi32(m.rvec.x), ry = _mm256_set1_epi32(m.rvec.y), rz = _mm256_set1_epi32(m.rvec.z);
+	const __m256i ux = _mm256_set1_epi32(m.uvec.x), uy = _mm256_set1_epi32(m.uvec.y), uz = _mm256_set1_epi32(m.uvec.z);
+	const __m256i fx = _mm256_set1_epi32(m.fvec.x), fy = _mm256_set1_epi32(m.fvec.y), fz = _mm256_set1_epi32(m.fvec.z);
+	std::size_t i = 0;
+	for (; i + 4 <= count; i += 4)
+	{
+		const auto s = vm_vec_load4_avx2(&src[i]);
+		const __m256i r = vm_vec_dot_avx2(s, rx, ry, rz);
+		const __m256i u = vm_vec_dot_avx2(s, ux, uy, uz);
+		const __m256i f = vm_vec_dot_avx2(s, fx, fy, fz);
+		/* Interleave back to x0 y0 z0 x1 y1 z1 x2 y2 | z2 x3 y3 z3 */
+		const __m256i head = _mm256_blend_epi32(
+			_mm256_blend_epi32(
+				_mm256_permutevar8x32_epi32(r, _mm256_setr_epi32(0, 0, 0, 2, 2, 2, 4, 4)),
+				_mm256_permutevar8x32_epi32(u, _mm256_setr_epi32(0, 0, 0, 2, 2, 2, 2, 4)), 0x92),
+			_mm256_permutevar8x32_epi32(f, _mm256_setr_epi32(0, 0, 0, 0, 0, 2, 2, 2)), 0x24);
+		const __m256i tail = _mm256_blend_epi32(
+			_mm256_blend_epi32(
+				_mm256_permutevar8x32_epi32(f, _mm256_setr_epi32(4, 4, 4, 6, 6, 6, 6, 6)),
+				_mm256_permutevar8x32_epi32(r, _mm256_setr_epi32(6, 6, 6, 6, 6, 6, 6, 6)), 0x02),
+			_mm256_permutevar8x32_epi32(u, _mm256_setr_epi32(6, 6, 6, 6, 6, 6, 6, 6)), 0x04);
+		const auto d = reinterpret_cast<fix *>(&dest[i]);
+		_mm256_storeu_si256(reinterpret_cast<__m256i *>(d), head);
+		_mm_storeu_si128(reinterpret_cast<__m128i *>(d + 8), _mm256_castsi256_si128(tail));
+	}
+	return i;
+}
+
+DXX_VECMAT_TARGET_AVX2
+std::size_t vm_vec_dot_avx2(fix *const dest, const vms_vector *const src, const std::size_t count, const vms_vector &v)
+{
+	const __m256i vx = _mm256_set1_epi32(v.x), vy = _mm256_set1_epi32(v.y), vz = _mm256_set1_epi32(v.z);
+	const __m256i even = _mm256_setr_epi32(0, 2, 4, 6, 0, 2, 4, 6);
+	std::size_t i = 0;
+	for (; i + 4 <= count; i += 4)
+	{
+		const __m256i d = vm_vec_dot_avx2(vm_vec_load4_avx2(&src[i]), vx, vy, vz);
+		_mm_storeu_si128(reinterpret_cast<__m128i *>(&dest[i]), _mm256_castsi256_si128(_mm256_permutevar8x32_epi32(d, even)));
+	}
+	return i;
+}
+
+DXX_VECMAT_TARGET_AVX2
+std::size_t vm_vec_dist2_avx2(vm_distance_squared *const dest, const vms_vector *const src, const std::size_t count, const vms_vector &p)
+{
+	const __m256i px = _mm256_set1_epi32(p.x), py = _mm256_set1_epi32(p.y), pz = _mm256_set1_epi32(p.z);
+	std::size_t i = 0;
+	for (; i + 4 <= count; i += 4)
+	{
+		const auto s = vm_vec_load4_avx2(&src[i]);
+		const __m256i dx = _mm256_sub_epi32(s.x, px), dy = _mm256_sub_epi32(s.y, py), dz = _mm256_sub_epi32(s.z, pz);
+		const __m256i d2 = _mm256_add_epi64(_mm256_add_epi64(_mm256_mul_epi32(dx, dx), _mm256_mul_epi32(dy, dy)), _mm256_mul_epi32(dz, dz));
+		_mm256_storeu_si256(reinterpret_cast<__m256i *>(&dest[i]), d2);
+	}
+	return i;
+}
+
+constexpr vm_vec_batch_kernels vm_vec_kernels_avx2{
+	vm_vec_batch_isa::avx2,
+	vm_vec_rotate_avx2,
+	vm_vec_dot_avx2,
+	vm_vec_dist2_avx2,
+};
+
+#undef DXX_VECMAT_TARGET_AVX2
+#undef DXX_VECMAT_TARGET_SSE41
+#elif DXX_VECMAT_BATCH_NEON
+/* NEON: `vld3q_s32` splits four vectors into x, y and z registers.
+ * `vmull_s32` and `vmlal_s32` multiply and accumulate in 64 bits, two
+ * elements per register.  `vshrn_n_s64` shifts and truncates to 32 bits
+ * in one step.
+ */
+static inline int32x4_t vm_vec_dot_neon(const int32x4x3_t &s, const int32x2_t vx, const int32x2_t vy, const int32x2_t vz)
+{
+	const int64x2_t lo = vmlal_s32(vmlal_s32(vmull_s32(vget_low_s32(s.val[0]), vx), vget_low_s32(s.val[1]), vy), vget_low_s32(s.val[2]), vz);
+	const int64x2_t hi = vmlal_s32(vmlal_s32(vmull_s32(vget_high_s32(s.val[0]), vx), vget_high_s32(s.val[1]), vy), vget_high_s32(s.val[2]), vz);
+	return vcombine_s32(vshrn_n_s64(lo, 16), vshrn_n_s64(hi, 16));
+}
+
+std::size_t vm_vec_rotate_neon(vms_vector *const dest, const vms_vector *const src, const std::size_t count, const vms_matrix &m)
+{
+	const int32x2_t rx = vdup_n_s32(m.rvec.x), ry = vdup_n_s32(m.rvec.y), rz = vdup_n_s32(m.rvec.z);
+	const int32x2_t ux = vdup_n_s32(m.uvec.x), uy = vdup_n_s32(m.uvec.y), uz = vdup_n_s32(m.uvec.z);
+	const int32x2_t fx = vdup_n_s32(m.fvec.x), fy = vdup_n_s32(m.fvec.y), fz = vdup_n_s32(m.fvec.z);
+	std::size_t i = 0;
+	for (; i + 4 <= count; i += 4)
+	{
+		const int32x4x3_t s = vld3q_s32(reinterpret_cast<const int32_t *>(&src[i]));
+		int32x4x3_t d;
+		d.val[0] = vm_vec_dot_neon(s, rx, ry, rz);
+		d.val[1] = vm_vec_dot_neon(s, ux, uy, uz);
+		d.val[2] = vm_vec_dot_neon(s, fx, fy, fz);
+		vst3q_s32(reinterpret_cast<int32_t *>(&dest[i]), d);
+	}
+	return i;
+}
+
+std::size_t vm_vec_dot_neon(fix *const dest, const vms_vector *const src, const std::size_t count, const vms_vector &v)
+{
+	const int32x2_t vx = vdup_n_s32(v.x), vy = vdup_n_s32(v.y), vz = vdup_n_s32(v.z);
+	std::size_t i = 0;
+	for (; i + 4 <= count; i += 4)
+		vst1q_s32(&dest[i], vm_vec_dot_neon(vld3q_s32(reinterpret_cast<const int32_t *>(&src[i])), vx, vy, vz));
+	return i;
+}
+
+std::size_t vm_vec_dist2_neon(vm_distance_squared *const dest, const vms_vector *const src, const std::size_t count, const vms_vector &p)
+{
+	const int32x4_t px = vdupq_n_s32(p.x), py = vdupq_n_s32(p.y), pz = vdupq_n_s32(p.z);
+	std::size_t i = 0;
+	for (; i + 4 <= count; i += 4)
+	{
+		const int32x4x3_t s = vld3q_s32(reinterpret_cast<const int32_t *>(&src[i]));
+		const int32x4_t dx = vsubq_s32(s.val[0], px), dy = vsubq_s32(s.val[1], py), dz = vsubq_s32(s.val[2], pz);
+		const int64x2_t lo = vmlal_s32(vmlal_s32(vmull_s32(vget_low_s32(dx), vget_low_s32(dx)), vget_low_s32(dy), vget_low_s32(dy)), vget_low_s32(dz), vget_low_s32(dz));
+		const int64x2_t hi = vmlal_s32(vmlal_s32(vmull_s32(vget_high_s32(dx), vget_high_s32(dx)), vget_high_s32(dy), vget_high_s32(dy)), vget_high_s32(dz), vget_high_s32(dz));
+		const auto d = reinterpret_cast<int64_t *>(&dest[i]);
+		vst1q_s64(d, lo);
+		vst1q_s64(d + 2, hi);
+	}
+	return i;
+}
+
+constexpr vm_vec_batch_kernels vm_vec_kernels_neon{
+	vm_vec_batch_isa::neon,
+	vm_vec_rotate_neon,
+	vm_vec_dot_neon,
+	vm_vec_dist2_neon,
+};
+#endif
+
+const vm_vec_batch_kernels *vm_vec_batch_find_kernels(const vm_vec_batch_isa isa)
+{
+	switch (isa)
+	{
+		case vm_vec_batch_isa::scalar:
+			return &vm_vec_kernels_scalar;
+#if DXX_VECMAT_BATCH_X86
+		case vm_vec_batch_isa::sse4_1:
+			return __builtin_cpu_supports("sse4.1") ? &vm_vec_kernels_sse41 : nullptr;
+		case vm_vec_batch_isa::avx2:
+			return __builtin_cpu_supports("avx2") ? &vm_vec_kernels_avx2 : nullptr;
+#elif DXX_VECMAT_BATCH_NEON
+		case vm_vec_batch_isa::neon:
+			return &vm_vec_kernels_neon;
+#endif
+		default:
+			return nullptr;
+	}
+}
+
+/* Selected on first use, so that callers which run during static
+ * initialization still find a valid table.
+ */
+std::atomic<const vm_vec_batch_kernels *> Vm_vec_batch_kernels;
+
+const vm_vec_batch_kernels &vm_vec_batch_get_kernels()
+{
+	if (const auto k = Vm_vec_batch_kernels.load(std::memory_order_relaxed))
+		return *k;
+	const auto k = vm_vec_batch_find_kernels(vm_vec_batch_best_isa());
+	Vm_vec_batch_kernels.store(k, std::memory_order_relaxed);
+	return *k;
+}
+
+}
+
+vm_vec_batch_isa vm_vec_batch_best_isa()
+{
+#if DXX_VECMAT_BATCH_X86
+	if (__builtin_cpu_supports("avx2"))
+		return vm_vec_batch_isa::avx2;
+	if (__builtin_cpu_supports("sse4.1"))
+		return vm_vec_batch_isa::sse4_1;
+#elif DXX_VECMAT_BATCH_NEON
+	return vm_vec_batch_isa::neon;
+#endif
+	return vm_vec_batch_isa::scalar;
+}
+
+vm_vec_batch_isa vm_vec_batch_get_isa()
+{
+	return vm_vec_batch_get_kernels().isa;
+}
+
+bool vm_vec_batch_set_isa(const vm_vec_batch_isa isa)
+{
+	const auto k = vm_vec_batch_find_kernels(isa);
+	if (!k)
+		return false;
+	Vm_vec_batch_kernels.store(k, std::memory_order_relaxed);
+	return true;
+}
+
+void vm_vec_rotate_n(const std::span<vms_vector> dest, const std::span<const vms_vector> src, const vms_matrix &m)
+{
+	assert(dest.size() == src.size());
+	const std::size_t count = src.size();
+	for (std::size_t i = vm_vec_batch_get_kernels().rotate(dest.data(), src.data(), count, m); i != count; ++i)
+		vm_vec_rotate(dest[i], src[i], m);
+}
+
+void vm_vec_dot_n(const std::span<fix> dest, const std::span<const vms_vector> src, const vms_vector &v)
+{
+	assert(dest.size() == src.size());
+	const std::size_t count = src.size();
+	for (std::size_t i = vm_vec_batch_get_kernels().dot(dest.data(), src.data(), count, v); i != count; ++i)
+		dest[i] = vm_vec_dot(src[i], v);
+}
+
+void vm_vec_dist2_n(const std::span<vm_distance_squared> dest, const std::span<const vms_vector> src, const vms_vector &p)
+{
+	assert(dest.size() == src.size());
+	const std::size_t count = src.size();
+	for (std::size_t i = vm_vec_batch_get_kernels().dist2(dest.data(), src.data(), count, p); i != count; ++i)
+		dest[i] = vm_vec_dist2(src[i], p);
+}
+
+void vm_vec_dist_n(const std::span<vm_distance> dest, const std::span<const vms_vector> src, const vms_vector &p)
+{
+	assert(dest.size() == src.size());
+	const std::size_t count = src.size();
+	auto &dist2 = vm_vec_batch_get_kernels().dist2;
+	/* Square in blocks on the stack, then take each root with the same
+	 * quad_sqrt that vm_vec_dist uses.
+	 */
+	std::array<vm_distance_squared, 64> block;
+	for (std::size_t first = 0; first != count;)
+	{
+		const std::size_t n = std::min(block.size(), count - first);
+		for (std::size_t i = dist2(block.data(), &src[first], n, p); i != n; ++i)
+			block[i] = vm_vec_dist2(src[first + i], p);
+		for (std::size_t i = 0; i != n; ++i)
+			dest[first + i] = vm_distance{static_cast<fix>(quad_sqrt(quadint{static_cast<int64_t>(block[i])}))};
+		first += n;
+	}
+}
+
+}
@@ -0,0 +1,87 @@
+/*
+ * This file is part of the DXX-Rebirth project <https://www.dxx-rebirth.com/>.
+ * It is copyright by its individual contributors, as recorded in the
+ * project's Git history.  See COPYING.txt at the top level for license
+ * terms and a link to the Git history.
+ */
+
+#include <utility>
+#include "async_writer.h"
+
+namespace dcx {
+
+void async_writer::start(const sink_type s, void *const c)
+{
+	finish();
+	sink = s;
+	context = c;
+	sink_failed.store(false, std::memory_order_relaxed);
+	stopping = false;
+	thread = std::thread(&async_writer::run_writer, this);
+}
+
+void async_writer::run_writer()
+{
+	std::unique_lock lock(mutex);
+	for (;;)
+	{
+		queue_changed.wait(lock, [this]{ return stopping || !queue.empty(); });
+		if (queue.empty())
+			return;
+		auto block = std::move(queue.front());
+		queue.pop_front();
+		lock.unlock();
+		if (!failed() && !sink(context, block.data(), block.size()))
+			sink_failed.store(true, std::memory_order_relaxed);
+		block.clear();
+		lock.lock();
+		spare.emplace_back(std::move(block));
+		queue_changed.notify_all();
+	}
+}
+
+void async_writer::submit()
+{
+	if (current.empty())
+		return;
+	if (!thread.joinable())
+	{
+		/* Not started: write on the calling thread. */
+		if (!failed() && sink && !sink(context, current.data(), current.size()))
+			sink_failed.store(true, std::memory_order_relaxed);
+		current.clear();
+		return;
+	}
+	std::unique_lock lock(mutex);
+	queue_changed.wait(lock, [this]{ return queue.size() < max_queued_blocks; });
+	queue.emplace_back(std::move(current));
+	if (spare.empty())
+		current = {};
+	else
+	{
+		current = std::move(spare.back());
+		spare.pop_back();
+	}
+	lock.unlock();
+	queue_changed.notify_all();
+}
+
+bool async_writer::finish()
+{
+	submit();
+	if (thread.joinable())
+	{
+		{
+			std::lock_guard lock(mutex);
+			stopping = true;
+		}
+		queue_changed.notify_all();
+		thread.join();
+	}
+	sink = nullptr;
+	spare.clear();
+	current = {};
+	return !failed();
+}
+
+}
@@ -0,0 +1,173 @@
+/*
+ * This file is part of the DXX-Rebirth project <https://www.dxx-rebirth.com/>.
+ * It is copyright by its individual contributors, as recorded in the
+ * project's Git history.  See COPYING.txt at the top level for license
+ * terms and a link to the Git history.
+ */
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include "parallel.h"
+
+namespace dcx {
+
+namespace {
+
+/* Beyond this, the game has too little independent work per frame for
+ * more threads to help.
+ */
+constexpr unsigned parallel_max_threads = 8;
+
+class worker_pool
+{
+	std::mutex mutex;
+	std::condition_variable work_ready, work_done;
+	std::vector<std::thread> workers;
+	void (*work)(void *, std::size_t);
+	void *context;
+	std::size_t count, chunk;
+	std::atomic<std::size_t> next_index;
+	/* Number of workers that have not yet finished the current job. */
+	unsigned busy_workers = 0;
+	/* Incremented for each job, so that a worker can tell whether it
+	 * has already run the current job.
+	 */
+	unsigned job_generation = 0;
+	bool stopping = false;
+	void run_worker();
+	void run_chunks();
+	void start();
+	void stop();
+public:
+	unsigned thread_count = 0;
+	~worker_pool()
+	{
+		stop();
+	}
+	void resize(unsigned count);
+	void run(std::size_t count, void (*work)(void *, std::size_t), void *context);
+};
+
+static worker_pool Parallel_workers;
+
+static unsigned default_parallel_thread_count()
+{
+	const unsigned processors = std::thread::hardware_concurrency();
+	return std::clamp(processors, 1u, parallel_max_threads);
+}
+
+void worker_pool::run_chunks()
+{
+	for (;;)
+	{
+		const std::size_t first = next_index.fetch_add(chunk, std::memory_order_relaxed);
+		if (first >= count)
+			return;
+		const std::size_t last = std::min(first + chunk, count);
+		for (std::size_t i = first; i != last; ++i)
+			work(context, i);
+	}
+}
+
+void worker_pool::run_worker()
+{
+	unsigned seen_generation = 0;
+	for (;;)
+	{
+		{
+			std::unique_lock lock(mutex);
+			work_ready.wait(lock, [&]{ return stopping || job_generation != seen_generation; });
+			if (stopping)
+				return;
+			seen_generation = job_generation;
+		}
+		run_chunks();
+		std::lock_guard lock(mutex);
+		if (!--busy_workers)
+			work_done.notify_one();
+	}
+}
+
+void worker_pool::start()
+{
+	if (!thread_count)
+		thread_count = default_parallel_thread_count();
+	const unsigned n = thread_count - 1;
+	workers.reserve(n);
+	for (unsigned i = 0; i != n; ++i)
+		workers.emplace_back(&worker_pool::run_worker, this);
+}
+
+void worker_pool::stop()
+{
+	{
+		std::lock_guard lock(mutex);
+		stopping = true;
+	}
+	work_ready.notify_all();
+	for (auto &t : workers)
+		t.join();
+	workers.clear();
+	stopping = false;
+}
+
+void worker_pool::resize(const unsigned count)
+{
+	stop();
+	thread_count = count ? std::min(count, parallel_max_threads) : default_parallel_thread_count();
+}
+
+void worker_pool::run(const std::size_t n, void (*const w)(void *, std::size_t), void *const c)
+{
+	if (workers.empty() && thread_count != 1)
+		start();
+	if (workers.empty() || n < 2)
+	{
+		for (std::size_t i = 0; i != n; ++i)
+			w(c, i);
+		return;
+	}
+	{
+		std::lock_guard lock(mutex);
+		work = w;
+		context = c;
+		count = n;
+		/* Several chunks per thread, so that a thread which draws slow
+		 * entries does not hold up the others for long.
+		 */
+		chunk = std::max<std::size_t>(1, n / (4 * (workers.size() + 1)));
+		next_index.store(0, std::memory_order_relaxed);
+		busy_workers = workers.size();
+		++ job_generation;
+	}
+	work_ready.notify_all();
+	run_chunks();
+	std::unique_lock lock(mutex);
+	work_done.wait(lock, [this]{ return !busy_workers; });
+}
+
+}
+
+void set_parallel_thread_count(const unsigned count)
+{
+	Parallel_workers.resize(count);
+}
+
+unsigned get_parallel_thread_count()
+{
+	auto &p = Parallel_workers;
+	if (!p.thread_count)
+		p.thread_count = default_parallel_thread_count();
+	return p.thread_count;
+}
+
+void parallel_for(const std::size_t count, void (*const work)(void *, std::size_t), void *const context)
+{
+	Parallel_workers.run(count, work, context);
+}
+
+}
@@ -0,0 +1,139 @@
+/*
+ * This file is part of the DXX-Rebirth project <https://www.dxx-rebirth.com/>.
+ * It is copyright by its individual contributors, as recorded in the
+ * project's Git history.  See COPYING.txt at the top level for license
+ * terms and a link to the Git history.
+ */
+
+/*
+ *
+ * Send and receive several UDP datagrams per system call
+ *
+ */
+
+#include "dxxsconf.h"
+#include <algorithm>
+#include "udp_batch.h"
+
+#ifdef DXX_HAVE_RECVMMSG
+#include <sys/uio.h>
+#elif !defined(_WIN32)
+#include <sys/select.h>
+#endif
+
+namespace dcx {
+
+namespace {
+
+#ifdef DXX_HAVE_RECVMMSG
+/* The most datagrams passed to the kernel in one call. */
+constexpr std::size_t udp_batch_max = 32;
+#else
+#ifndef MSG_DONTWAIT
+static bool udp_packet_ready(const int sockfd)
+{
+	fd_set set;
+	timeval tv{};
+	FD_ZERO(&set);
+	FD_SET(sockfd, &set);
+	return select(sockfd + 1, &set, nullptr, nullptr, &tv) > 0;
+}
+#endif
+#endif
+
+}
+
+std::size_t udp_send_batch(const int sockfd, std::span<const udp_send_item> items)
+{
+	std::size_t bytes = 0;
+#ifdef DXX_HAVE_RECVMMSG
+	std::array<mmsghdr, udp_batch_max> headers;
+	std::array<iovec, udp_batch_max> iov;
+	while (!items.empty())
+	{
+		const std::size_t n = std::min(items.size(), udp_batch_max);
+		for (std::size_t i = 0; i != n; ++i)
+		{
+			auto &item = items[i];
+			iov[i] = {const_cast<uint8_t *>(item.data.data()), item.data.size()};
+			headers[i] = {};
+			headers[i].msg_hdr.msg_name = const_cast<sockaddr *>(item.addr);
+			headers[i].msg_hdr.msg_namelen = item.addrlen;
+			headers[i].msg_hdr.msg_iov = &iov[i];
+			headers[i].msg_hdr.msg_iovlen = 1;
+		}
+		const int sent = sendmmsg(sockfd, headers.data(), n, 0);
+		if (sent > 0)
+		{
+			for (std::size_t i = 0; i != static_cast<std::size_t>(sent); ++i)
+				bytes += headers[i].msg_len;
+			items = items.subspan(sent);
+		}
+		else
+			/* The kernel stops at the first item that fails.  Skip
+			 * that item, as a failed `sendto` would.
+			 */
+			items = items.subspan(1);
+	}
+#else
+	for (auto &item : items)
+		if (const auto rv = sendto(sockfd, reinterpret_cast<const char *>(item.data.data()), item.data.size(), 0, item.addr, item.addrlen); rv > 0)
+			bytes += rv;
+#endif
+	return bytes;
+}
+
+std::size_t udp_receive_batch(const int sockfd, const std::span<udp_receive_item> items)
+{
+#ifdef DXX_HAVE_RECVMMSG
+	std::array<mmsghdr, udp_batch_max> headers;
+	std::array<iovec, udp_batch_max> iov;
+	std::size_t received = 0;
+	while (received != items.size())
+	{
+		const auto chunk = items.subspan(received, std::min(items.size() - received, udp_batch_max));
+		for (std::size_t i = 0; i != chunk.size(); ++i)
+		{
+			auto &item = chunk[i];
+			iov[i] = {item.buffer.data(), item.buffer.size()};
+			headers[i] = {};
+			headers[i].msg_hdr.msg_name = item.addr;
+			headers[i].msg_hdr.msg_namelen = item.addrlen;
+			headers[i].msg_hdr.msg_iov = &iov[i];
+			headers[i].msg_hdr.msg_iovlen = 1;
+		}
+		const int got = recvmmsg(sockfd, headers.data(), chunk.size(), MSG_DONTWAIT, nullptr);
+		if (got <= 0)
+			break;
+		for (std::size_t i = 0; i != static_cast<std::size_t>(got); ++i)
+		{
+			chunk[i].addrlen = headers[i].msg_hdr.msg_namelen;
+			chunk[i].size = headers[i].msg_len;
+		}
+		received += got;
+		if (static_cast<std::size_t>(got) != chunk.size())
+			break;
+	}
+	return received;
+#else
+	std::size_t received = 0;
+	for (auto &item : items)
+	{
+		int flags = 0;
+#ifdef MSG_DONTWAIT
+		flags |= MSG_DONTWAIT;
+#else
+		if (!udp_packet_ready(sockfd))
+			break;
+#endif
+		const auto rv = recvfrom(sockfd, reinterpret_cast<char *>(item.buffer.data()), item.buffer.size(), flags, item.addr, &item.addrlen);
+		if (rv < 0)
+			break;
+		item.size = rv;
+		++received;
+	}
+	return received;
+#endif
+}
+
+}
@@ -38,7 +38,11 @@ COPYRIGHT 1993-1998 PARALLAX SOFTWARE CORPORATION.  ALL RIGHTS RESERVED.
 #include "d_zip.h"
 #include "dxxsconf.h"
 #include "dsx-ns.h"
+#include "parallel.h"
+#include <algorithm>
+#include <climits>
 #include <utility>
+#include <vector>
 
 namespace dcx {
 
@@ -54,14 +58,15 @@ unsigned	Current_seg_depth;		// HACK INTERFACE: how far away the current segment
 // These variables are the interface to assembler.  They get set for each texture map, which is a real waste of time.
 //	They should be set only when they change, which is generally when the window bounds change.  And, even still, it's
 //	a pretty bad interface.
-int	bytes_per_row=-1;
-unsigned char *write_buffer;
+thread_local int	bytes_per_row=-1;
+thread_local unsigned char *write_buffer;
 
-fix fx_l, fx_u, fx_v, fx_z, fx_du_dx, fx_dv_dx, fx_dz_dx, fx_dl_dx;
-int fx_xleft, fx_xright, fx_y;
-const color_palette_index *pixptr;
-uint8_t Transparency_on = 0;
-uint8_t tmap_flat_color;
+thread_local fix fx_l, fx_u, fx_v, fx_z, fx_du_dx, fx_dv_dx, fx_dz_dx, fx_dl_dx;
+thread_local int fx_xleft, fx_xright, fx_y;
+thread_local const color_palette_index *pixptr;
+thread_local uint8_t Transparency_on = 0;
+thread_local uint8_t tmap_flat_color;
+thread_local int Tmap_band_top = INT_MIN, Tmap_band_bot = INT_MAX, Tmap_band_row_width;
 
 int	Interpolation_method;	// 0 = choose best method
 // -------------------------------------------------------------------------------------
@@ -99,7 +104,7 @@ void init_interface_vars_to_assembler(void)
 	Window_clip_bot = static_cast<int>(bp->bm_h)-1;
 }
 
-static int Lighting_enabled;
+static thread_local int Lighting_enabled;
 // -------------------------------------------------------------------------------------
 //                             VARIABLES
 
@@ -284,6 +289,8 @@ static void ntmap_scanline_lighted(const grs_bitmap &srcb, int y, fix xleft, fix
 {
 	fix	dx,recip_dx;
 
+	if (tmap_band_skip_row(y))
+		return;
 	fx_xright = f2i(xright);
 	//edited 06/27/99 Matt Mueller - moved these tests up from within the switch so as not to do a bunch of needless calculations when we are just gonna return anyway.  Slight fps boost?
 	if (fx_xright < Window_clip_left)
@@ -312,12 +319,18 @@ static void ntmap_scanline_lighted(const grs_bitmap &srcb, int y, fix xleft, fix
 
 	switch (Lighting_enabled) {
 		case 0:
+			// The perspective scanline renderers always read the light.
+			// Draw at full brightness, instead of at whatever light the
+			// last lighted scanline of this thread left behind.
+			fx_l = MAX_LIGHTING_VALUE*NUM_LIGHTING_LEVELS;
+			fx_dl_dx = 0;
 			//added 05/17/99 Matt Mueller - prevent writing before the buffer
             if ((fx_y == 0) && (fx_xleft < 0))
 				fx_xleft = 0;
 			//end addition -MM
 			if (fx_xright > Window_clip_right)
 				fx_xright = Window_clip_right;
+			tmap_band_clamp_span();
 			
 			cur_tmap_scanline_per();
 			break;
@@ -345,6 +358,7 @@ static void ntmap_scanline_lighted(const grs_bitmap &srcb, int y, fix xleft, fix
 			//end addition -MM
 			if (fx_xright > Window_clip_right)
 				fx_xright = Window_clip_right;
+			tmap_band_clamp_span();
 
 			cur_tmap_scanline_per();
 			break;
@@ -355,6 +369,7 @@ static void ntmap_scanline_lighted(const grs_bitmap &srcb, int y, fix xleft, fix
 			fx_xleft = f2i(xleft);
 
 			tmap_flat_color = 1;
+			tmap_band_clamp_span();
 			c_tmap_scanline_flat();
 #else
 			Int3();	//	Illegal, called an editor only routine!
@@ -442,6 +457,9 @@ static void ntexture_map_lighted(const grs_bitmap &srcb, const g3ds_tmap &t)
 	next_break_right = f2i(v3d[vrb].y2d);
 
 	for (int y = topy; y < boty; y++) {
+		// Rows below the band of this thread can only be skipped.
+		if (y > Tmap_band_bot)
+			return;
 
 		// See if we have reached the end of the current left edge, and if so, set
 		// new values for dx_dy and x,u,v
@@ -547,6 +565,8 @@ static void ntmap_scanline_lighted_linear(const grs_bitmap &srcb, int y, fix xle
 {
 	fix	dx,recip_dx,du_dx,dv_dx,dl_dx;
 
+	if (tmap_band_skip_row(y))
+		return;
 	dx = f2i(xright) - f2i(xleft);
 	if ((dx < 0) || (xright < 0) || (xleft > xright))		// the (xleft > xright) term is not redundant with (dx < 0) because dx is computed using integers
 		return;
@@ -572,6 +592,7 @@ static void ntmap_scanline_lighted_linear(const grs_bitmap &srcb, int y, fix xle
 				if (fx_xleft < 0)
 					fx_xleft = 0;
 				//end addition -adb
+				tmap_band_clamp_span();
 				
 				c_tmap_scanline_lin_nolight();
 				break;
@@ -608,6 +629,7 @@ static void ntmap_scanline_lighted_linear(const grs_bitmap &srcb, int y, fix xle
 				fx_l = lleft;
 				dl_dx = fixmul(lright - lleft,recip_dx);
 				fx_dl_dx = dl_dx;
+				tmap_band_clamp_span();
 				c_tmap_scanline_lin();
 				break;
 			case 2:
@@ -615,6 +637,7 @@ static void ntmap_scanline_lighted_linear(const grs_bitmap &srcb, int y, fix xle
 				fx_xright = f2i(xright);
 				fx_xleft = f2i(xleft);
 				tmap_flat_color = 1;
+				tmap_band_clamp_span();
 				c_tmap_scanline_flat();
 #else
 				Int3();	//	Illegal, called an editor only routine!
@@ -697,6 +720,9 @@ static void ntexture_map_lighted_linear(const grs_bitmap &srcb, const g3ds_tmap
 	next_break_right = f2i(v3d[vrb].y2d);
 
 	for (int y = topy; y < boty; y++) {
+		// Rows below the band of this thread can only be skipped.
+		if (y > Tmap_band_bot)
+			return;
 
 		// See if we have reached the end of the current left edge, and if so, set
 		// new values for dx_dy and x,u,v
@@ -784,6 +810,179 @@ static void ntexture_map_lighted_linear(const grs_bitmap &srcb, const g3ds_tmap
 	ntmap_scanline_lighted_linear(srcb,boty,xleft,xright,uleft,uright,vleft,vright,lleft,lright);
 }
 
+namespace {
+
+enum class tmap_bin_kind : uint8_t
+{
+	linear,
+	perspective,
+	flat,
+};
+
+// A polygon recorded by the binned rasterizer, with the globals that the
+// texture mapper would have read when the polygon was recorded.  The
+// vertices are in Tmap_bin.vertices.
+struct tmap_bin_command
+{
+	tmap_bin_kind kind;
+	uint8_t transparency;
+	uint8_t lighting;
+	uint8_t flat_color;
+	gr_fade_level fade;
+	uint8_t nv;
+	unsigned first_vertex;
+	int clip_left, clip_top, clip_right, clip_bot;
+	int row_size;
+	unsigned char *buffer;
+	const grs_bitmap *bitmap;
+};
+
+struct tmap_bin_state
+{
+	bool active;
+	int band_height;
+	int row_width;
+	std::vector<tmap_bin_command> commands;
+	std::vector<g3ds_vertex> vertices;
+	// For each band, the indices in `commands` of the polygons which
+	// may draw into the band, in the order they were recorded.
+	std::vector<std::vector<unsigned>> bands;
+};
+
+// Bands are at least this many rows tall, so that a polygon is not
+// walked down to the same band by many threads.
+constexpr int Tmap_bin_min_band_height = 8;
+
+static tmap_bin_state Tmap_bin;
+
+static void tmap_bin_record(const tmap_bin_kind kind, const g3ds_tmap &t, const grs_bitmap *const bitmap, const uint8_t flat_color, const gr_fade_level fade)
+{
+	auto &bin = Tmap_bin;
+	int topy = f2i(t.verts[0].y2d), boty = topy;
+	for (int i = 1; i < t.nv; i++)
+	{
+		const int y = f2i(t.verts[i].y2d);
+		topy = std::min(topy, y);
+		boty = std::max(boty, y);
+	}
+	if (kind != tmap_bin_kind::flat)
+	{
+		// The texture mappers draw nothing below the clip window.
+		if (topy > Window_clip_bot)
+			return;
+		boty = std::min(boty, Window_clip_bot);
+	}
+	const unsigned index = bin.commands.size();
+	bin.commands.push_back({kind, Transparency_on, static_cast<uint8_t>(Lighting_enabled), flat_color, fade, static_cast<uint8_t>(t.nv), static_cast<unsigned>(bin.vertices.size()), Window_clip_left, Window_clip_top, Window_clip_right, Window_clip_bot, bytes_per_row, write_buffer, bitmap});
+	bin.vertices.insert(bin.vertices.end(), t.verts.begin(), std::next(t.verts.begin(), t.nv));
+	// Rows above the canvas are drawn by the first band, and rows below
+	// it by the last band, as they would be without binning.
+	const int last_band = bin.bands.size() - 1;
+	const int first = std::clamp(topy / bin.band_height, 0, last_band);
+	const int last = std::clamp(boty / bin.band_height, 0, last_band);
+	for (int b = first; b <= last; ++b)
+		bin.bands[b].push_back(index);
+}
+
+static void tmap_bin_draw(const tmap_bin_command &c)
+{
+	Window_clip_left = c.clip_left;
+	Window_clip_top = c.clip_top;
+	Window_clip_right = c.clip_right;
+	Window_clip_bot = c.clip_bot;
+	bytes_per_row = c.row_size;
+	write_buffer = c.buffer;
+	Transparency_on = c.transparency;
+	Lighting_enabled = c.lighting;
+	g3ds_tmap t;
+	t.nv = c.nv;
+	std::copy_n(&Tmap_bin.vertices[c.first_vertex], c.nv, t.verts.begin());
+	switch (c.kind)
+	{
+		case tmap_bin_kind::linear:
+			ntexture_map_lighted_linear(*c.bitmap, t);
+			break;
+		case tmap_bin_kind::perspective:
+			ntexture_map_lighted(*c.bitmap, t);
+			break;
+		case tmap_bin_kind::flat:
+			texture_map_flat(t, c.flat_color, c.fade);
+			break;
+	}
+}
+
+}
+
+bool tmap_begin_bin(const grs_canvas &canvas)
+{
+	const unsigned threads = get_parallel_thread_count();
+	if (threads < 2)
+		return false;
+	auto &bin = Tmap_bin;
+	const int rows = canvas.cv_bitmap.bm_h;
+	// Several bands per thread, so that a thread which draws a busy band
+	// does not hold up the others for long.
+	const int nbands = std::clamp<int>(threads * 4, 1, std::max(1, rows / Tmap_bin_min_band_height));
+	bin.band_height = std::max(1, (rows + nbands - 1) / nbands);
+	bin.row_width = canvas.cv_bitmap.bm_w;
+	bin.bands.resize(nbands);
+	bin.active = true;
+	return true;
+}
+
+void tmap_flush_bin()
+{
+	auto &bin = Tmap_bin;
+	if (bin.commands.empty())
+		return;
+	// The calling thread draws some bands, so keep its globals.
+	const auto save_clip_left = Window_clip_left, save_clip_top = Window_clip_top, save_clip_right = Window_clip_right, save_clip_bot = Window_clip_bot;
+	const auto save_bytes_per_row = bytes_per_row;
+	const auto save_write_buffer = write_buffer;
+	const auto save_transparency = Transparency_on;
+	const auto save_lighting = Lighting_enabled;
+	const auto save_flat_color = tmap_flat_color;
+	const std::size_t nbands = bin.bands.size();
+	parallel_for(nbands, [&bin, nbands](const std::size_t b) {
+		const int top = static_cast<int>(b) * bin.band_height;
+		Tmap_band_top = b ? top : INT_MIN;
+		Tmap_band_bot = b + 1 < nbands ? top + bin.band_height - 1 : INT_MAX;
+		Tmap_band_row_width = bin.row_width;
+		for (const auto i : bin.bands[b])
+			tmap_bin_draw(bin.commands[i]);
+		Tmap_band_top = INT_MIN;
+		Tmap_band_bot = INT_MAX;
+		Tmap_band_row_width = 0;
+	});
+	for (auto &b : bin.bands)
+		b.clear();
+	bin.commands.clear();
+	bin.vertices.clear();
+	Window_clip_left = save_clip_left;
+	Window_clip_top = save_clip_top;
+	Window_clip_right = save_clip_right;
+	Window_clip_bot = save_clip_bot;
+	bytes_per_row = save_bytes_per_row;
+	write_buffer = save_write_buffer;
+	Transparency_on = save_transparency;
+	Lighting_enabled = save_lighting;
+	tmap_flat_color = save_flat_color;
+}
+
+void tmap_end_bin()
+{
+	tmap_flush_bin();
+	Tmap_bin.active = false;
+}
+
+bool tmap_bin_flat(const g3ds_tmap &t, const uint8_t color, const gr_fade_level fade)
+{
+	if (!Tmap_bin.active)
+		return false;
+	tmap_bin_record(tmap_bin_kind::flat, t, nullptr, color, fade);
+	return true;
+}
+
 // fix	DivNum = F1_0*12;
 
 // -------------------------------------------------------------------------------------
@@ -843,14 +1042,20 @@ void draw_tmap(grs_canvas &canvas, const grs_bitmap &rbp, const std::span<const
 				if (Current_seg_depth > Max_perspective_depth)
 				{
 				case 1:								// linear interpolation
-					ntexture_map_lighted_linear(*bp, Tmap1);
+					if (Tmap_bin.active)
+						tmap_bin_record(tmap_bin_kind::linear, Tmap1, bp, 0, GR_FADE_OFF);
+					else
+						ntexture_map_lighted_linear(*bp, Tmap1);
 				}
 				else
 				{
 					[[fallthrough]];
 				case 2:								// perspective every 8th pixel interpolation
 				case 3:								// perspective every pixel interpolation
-					ntexture_map_lighted(*bp, Tmap1);
+					if (Tmap_bin.active)
+						tmap_bin_record(tmap_bin_kind::perspective, Tmap1, bp, 0, GR_FADE_OFF);
+					else
+						ntexture_map_lighted(*bp, Tmap1);
 				}
 				break;
 			default:
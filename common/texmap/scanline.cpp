@@ -23,6 +23,7 @@ COPYRIGHT 1993-1998 PARALLAX SOFTWARE CORPORATION.  ALL RIGHTS RESERVED.
  *
  */
 
+#include <algorithm>
 #include <math.h>
 #include <limits.h>
 #include <stdio.h>
@@ -34,6 +35,7 @@ COPYRIGHT 1993-1998 PARALLAX SOFTWARE CORPORATION.  ALL RIGHTS RESERVED.
 #include "grdef.h"
 #include "texmap.h"
 #include "texmapl.h"
+#include "tmap_scanline_per.h"
 #include "scanline.h"
 #include "strutil.h"
 #include "dxxerror.h"
@@ -460,118 +462,31 @@ static void c_fp_tmap_scanline_per()
 	}
 }
 
-// note the unrolling loop is broken. It is never called, and uses big endian. -- FH
+// Perspective correct scanline, drawn by the span kernel in scanline_per.cpp.
 static void c_tmap_scanline_per()
 {
-	uint c;
-	int x, j, index = fx_xleft + (bytes_per_row * fx_y);
-	fix l,u,v,z;
-	fix dudx, dvdx, dzdx, dldx;
-
-	u = fx_u;
-	v = fx_v*64;
-	z = fx_z;
-	dudx = fx_du_dx; 
-	dvdx = fx_dv_dx*64; 
-	dzdx = fx_dz_dx;
-
-	l = fx_l>>8;
-	dldx = fx_dl_dx/256;
-	auto dest = &write_buffer[fx_xleft + (bytes_per_row * fx_y)];
-
-	if (!Transparency_on)	{
-		const auto pixPtrLocalCopy = pixptr;
-		auto &fadeTableLocalCopy = gr_fade_table;
-
-		x = fx_xright-fx_xleft+1; // x = number of pixels in scanline
-
-		if ((j = reinterpret_cast<uintptr_t>(dest) & 3) != 0)
-			{
-			j = 4 - j;
-
-			if (j > x)
-				j = x;
-
-			while (j > 0)
-				{	
-				if (++index >= SWIDTH*SHEIGHT) return;
-				//edited 05/18/99 Matt Mueller - changed from 0xff00 to 0x7f00 to fix glitches
-				*dest++ = fadeTableLocalCopy.base_type::operator[]((l >> 8) & 0x7f)[static_cast<uint32_t>(pixPtrLocalCopy[((v / z) & (64 * 63)) + ((u / z) & 63)])];
-				//end edit -MM
-				l += dldx;
-				u += dudx;
-				v += dvdx;
-				z += dzdx;
-				x--;
-				j--;
-				}
-			}
-
-		j &= ~3;
-		while (j > 0)
-			{
-				uint32_t destlong;
-			//edited 05/18/99 Matt Mueller - changed from 0xff00 to 0x7f00 to fix glitches
-			destlong = fadeTableLocalCopy.base_type::operator[]((l >> 8) & 0x7f)[pixPtrLocalCopy[ ( (v/z)&(64*63) ) + ((u/z)&63) ] ] << 24;
-			//end edit -MM
-			l += dldx;
-			u += dudx;
-			v += dvdx;
-			z += dzdx;
-			//edited 05/18/99 Matt Mueller - changed from 0xff00 to 0x7f00 to fix glitches
-			destlong |= fadeTableLocalCopy.base_type::operator[]((l >> 8) & 0x7f)[pixPtrLocalCopy[ ( (v/z)&(64*63) ) + ((u/z)&63) ] ] << 16;
-			//end edit -MM
-			l += dldx;
-			u += dudx;
-			v += dvdx;
-			z += dzdx;
-			//edited 05/18/99 Matt Mueller - changed from 0xff00 to 0x7f00 to fix glitches
-			destlong |= fadeTableLocalCopy.base_type::operator[]((l >> 8) & 0x7f)[pixPtrLocalCopy[ ( (v/z)&(64*63) ) + ((u/z)&63) ] ] << 8;
-			//end edit -MM
-			l += dldx;
-			u += dudx;
-			v += dvdx;
-			z += dzdx;
-			//edited 05/18/99 Matt Mueller - changed from 0xff00 to 0x7f00 to fix glitches
-			destlong |= fadeTableLocalCopy.base_type::operator[]((l >> 8) & 0x7f)[pixPtrLocalCopy[ ( (v/z)&(64*63) ) + ((u/z)&63) ] ];
-			//end edit -MM
-			l += dldx;
-			u += dudx;
-			v += dvdx;
-			z += dzdx;
-			*reinterpret_cast<uint32_t *>(dest) = destlong;
-			dest += 4;
-			x -= 4;
-			j -= 4;
-			index += 4;
-			if (index+4 >= SWIDTH*SHEIGHT) return;
-			}
-
-		while (x-- > 0)
-			{
-			if (++index >= SWIDTH*SHEIGHT) return;
-			//edited 05/18/99 Matt Mueller - changed from 0xff00 to 0x7f00 to fix glitches
-			*dest++ = fadeTableLocalCopy.base_type::operator[]((l >> 8) & 0x7f)[pixPtrLocalCopy[ ( (v/z)&(64*63) ) + ((u/z)&63) ] ];
-			//end edit -MM
-			l += dldx;
-			u += dudx;
-			v += dvdx;
-			z += dzdx;
-			}
-
-	} else {
-		for (x= fx_xright-fx_xleft+1 ; x > 0; --x ) {
-			if (++index >= SWIDTH*SHEIGHT) return;
-			c = static_cast<uint32_t>(pixptr[ ( (v/z)&(64*63) ) + ((u/z)&63) ]);
-			if ( c!=TRANSPARENCY_COLOR)
-				*dest = gr_fade_table.base_type::operator[]((l >> 8) & 0x7f)[c];
-			dest++;
-			l += dldx;
-			u += dudx;
-			v += dvdx;
-			z += dzdx;
-		}
-	}
+	const int index = fx_xleft + (bytes_per_row * fx_y);
+	// Draw only the pixels that the old per-pixel loop reached before
+	// its end of screen check.
+	const int x = std::min(fx_xright - fx_xleft + 1, SWIDTH * SHEIGHT - index - 1);
+	if (x <= 0)
+		return;
+	const tmap_per_span span{
+		&write_buffer[index],
+		pixptr,
+		gr_fade_table.base_type::operator[](0).data(),
+		fx_u,
+		static_cast<int32_t>(static_cast<uint32_t>(fx_v) * 64),
+		fx_z,
+		fx_l >> 8,
+		fx_du_dx,
+		static_cast<int32_t>(static_cast<uint32_t>(fx_dv_dx) * 64),
+		fx_dz_dx,
+		fx_dl_dx / 256,
+		static_cast<std::size_t>(x),
+		static_cast<bool>(Transparency_on),
+	};
+	tmap_scanline_per(span);
 }
 
 static void c_tmap_scanline_quad()
@@ -652,6 +567,18 @@ void select_tmap(const std::string &type)
 		cur_tmap_scanline_per=c_tmap_scanline_quad;
 	}
 	else {
+		// "scalar", "sse2" and "avx2" force the instruction set of the
+		// perspective mapper.  Anything else, or one that this processor
+		// lacks, picks the best one available.
+		tmap_scanline_isa isa = tmap_scanline_best_isa();
+		if (type == "scalar")
+			isa = tmap_scanline_isa::scalar;
+		else if (type == "sse2")
+			isa = tmap_scanline_isa::sse2;
+		else if (type == "avx2")
+			isa = tmap_scanline_isa::avx2;
+		if (!tmap_scanline_set_isa(isa))
+			tmap_scanline_set_isa(tmap_scanline_best_isa());
 		cur_tmap_scanline_per=c_tmap_scanline_per;
 	}
 }
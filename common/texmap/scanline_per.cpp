@@ -0,0 +1,327 @@
+/*
+ * This file is part of the DXX-Rebirth project <https://www.dxx-rebirth.com/>.
+ * It is copyright by its individual contributors, as recorded in the
+ * project's Git history.  See COPYING.txt at the top level for license
+ * terms and a link to the Git history.
+ */
+
+/*
+ *
+ * SIMD kernels for the fixed point perspective texture mapper
+ *
+ */
+
+#include <atomic>
+#include "tmap_scanline_per.h"
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define DXX_TMAP_SCANLINE_X86	1
+#include <immintrin.h>
+#endif
+
+namespace dcx {
+
+namespace {
+
+/* Every kernel draws whole blocks from the front of the span, and
+ * returns how many pixels it drew.  tmap_scanline_per draws the rest
+ * with the scalar loop.
+ */
+struct tmap_scanline_kernel
+{
+	tmap_scanline_isa isa;
+	std::size_t (*per)(const tmap_per_span &span);
+};
+
+std::size_t tmap_scanline_per_scalar(const tmap_per_span &)
+{
+	return 0;
+}
+
+constexpr tmap_scanline_kernel tmap_scanline_kernel_scalar{
+	tmap_scanline_isa::scalar,
+	tmap_scanline_per_scalar,
+};
+
+/* The scalar loop divides u and v by z in 32-bit integers.  For 32-bit
+ * operands, the double quotient truncates to the same integer, since
+ * the quotient is exact to well within 1/|z| of the true value.  So the
+ * kernels convert to double, divide, and truncate, which x86 can do
+ * several lanes at a time.
+ *
+ * The texel and the faded color are each loaded from the dword that
+ * contains them, and then shifted down.  Rounding the offset down to a
+ * multiple of 4 keeps each load inside the 64x64 texture and inside the
+ * row of the fade table.
+ */
+#if DXX_TMAP_SCANLINE_X86
+#define DXX_TMAP_TARGET_SSE2	__attribute__((target("sse2")))
+#define DXX_TMAP_TARGET_AVX2	__attribute__((target("avx2")))
+
+/* SSE2 has no gather, so the kernel computes the texel offsets and the
+ * fade table rows of 8 pixels in vectors, then does the loads in scalar
+ * code.
+ */
+struct tmap_per_lanes_sse2
+{
+	__m128i u, v, z, l;
+};
+
+DXX_TMAP_TARGET_SSE2
+static inline __m128i tmap_per_div_sse2(const __m128i n, const __m128i d)
+{
+	const __m128d lo = _mm_div_pd(_mm_cvtepi32_pd(n), _mm_cvtepi32_pd(d));
+	const __m128d hi = _mm_div_pd(_mm_cvtepi32_pd(_mm_srli_si128(n, 8)), _mm_cvtepi32_pd(_mm_srli_si128(d, 8)));
+	return _mm_unpacklo_epi64(_mm_cvttpd_epi32(lo), _mm_cvttpd_epi32(hi));
+}
+
+/* Store the texel offsets and the fade table row offsets of the four
+ * pixels in `p`, and step `p` to the next four pixels.
+ */
+DXX_TMAP_TARGET_SSE2
+static inline void tmap_per_offsets_sse2(tmap_per_lanes_sse2 &p, const tmap_per_lanes_sse2 &step, uint32_t *const texel, uint32_t *const row)
+{
+	const __m128i qu = tmap_per_div_sse2(p.u, p.z);
+	const __m128i qv = tmap_per_div_sse2(p.v, p.z);
+	const __m128i offset = _mm_or_si128(_mm_and_si128(qv, _mm_set1_epi32(64 * 63)), _mm_and_si128(qu, _mm_set1_epi32(63)));
+	const __m128i level = _mm_and_si128(_mm_srai_epi32(p.l, 8), _mm_set1_epi32(0x7f));
+	_mm_store_si128(reinterpret_cast<__m128i *>(texel), offset);
+	_mm_store_si128(reinterpret_cast<__m128i *>(row), _mm_slli_epi32(level, 8));
+	p.u = _mm_add_epi32(p.u, step.u);
+	p.v = _mm_add_epi32(p.v, step.v);
+	p.z = _mm_add_epi32(p.z, step.z);
+	p.l = _mm_add_epi32(p.l, step.l);
+}
+
+DXX_TMAP_TARGET_SSE2
+static inline __m128i tmap_per_ramp_sse2(const int32_t start, const int32_t delta)
+{
+	const uint32_t s = start, d = delta;
+	return _mm_setr_epi32(s, s + d, s + 2 * d, s + 3 * d);
+}
+
+DXX_TMAP_TARGET_SSE2
+std::size_t tmap_scanline_per_sse2(const tmap_per_span &s)
+{
+	tmap_per_lanes_sse2 p{
+		tmap_per_ramp_sse2(s.u, s.du),
+		tmap_per_ramp_sse2(s.v, s.dv),
+		tmap_per_ramp_sse2(s.z, s.dz),
+		tmap_per_ramp_sse2(s.l, s.dl),
+	};
+	const tmap_per_lanes_sse2 step{
+		_mm_set1_epi32(static_cast<uint32_t>(s.du) * 4),
+		_mm_set1_epi32(static_cast<uint32_t>(s.dv) * 4),
+		_mm_set1_epi32(static_cast<uint32_t>(s.dz) * 4),
+		_mm_set1_epi32(static_cast<uint32_t>(s.dl) * 4),
+	};
+	const auto texture = s.texture;
+	const auto fade_table = s.fade_table;
+	const auto dest = s.dest;
+	std::size_t i = 0;
+	for (; i + 8 <= s.count; i += 8)
+	{
+		alignas(16) uint32_t texel[8], row[8];
+		tmap_per_offsets_sse2(p, step, texel, row);
+		tmap_per_offsets_sse2(p, step, texel + 4, row + 4);
+		if (s.transparent)
+		{
+			for (unsigned k = 0; k != 8; ++k)
+				if (const uint8_t c = texture[texel[k]]; c != 255)
+					dest[i + k] = fade_table[row[k] + c];
+		}
+		else
+		{
+			for (unsigned k = 0; k != 8; ++k)
+				dest[i + k] = fade_table[row[k] + texture[texel[k]]];
+		}
+	}
+	return i;
+}
+
+constexpr tmap_scanline_kernel tmap_scanline_kernel_sse2{
+	tmap_scanline_isa::sse2,
+	tmap_scanline_per_sse2,
+};
+
+/* AVX2: eight pixels per register, with both loads done by gathers. */
+struct tmap_per_lanes_avx2
+{
+	__m256i u, v, z, l;
+};
+
+DXX_TMAP_TARGET_AVX2
+static inline __m256i tmap_per_div_avx2(const __m256i n, const __m256i d)
+{
+	const __m256d lo = _mm256_div_pd(_mm256_cvtepi32_pd(_mm256_castsi256_si128(n)), _mm256_cvtepi32_pd(_mm256_castsi256_si128(d)));
+	const __m256d hi = _mm256_div_pd(_mm256_cvtepi32_pd(_mm256_extracti128_si256(n, 1)), _mm256_cvtepi32_pd(_mm256_extracti128_si256(d, 1)));
+	return _mm256_inserti128_si256(_mm256_castsi128_si256(_mm256_cvttpd_epi32(lo)), _mm256_cvttpd_epi32(hi), 1);
+}
+
+/* Load the byte at `base + offset` for each lane. */
+DXX_TMAP_TARGET_AVX2
+static inline __m256i tmap_per_gather_u8_avx2(const uint8_t *const base, const __m256i offset)
+{
+	const __m256i three = _mm256_set1_epi32(3);
+	const __m256i word = _mm256_i32gather_epi32(reinterpret_cast<const int *>(base), _mm256_andnot_si256(three, offset), 1);
+	return _mm256_and_si256(_mm256_srlv_epi32(word, _mm256_slli_epi32(_mm256_and_si256(offset, three), 3)), _mm256_set1_epi32(0xff));
+}
+
+/* Move the low byte of each lane to the low 8 bytes of the result. */
+DXX_TMAP_TARGET_AVX2
+static inline __m128i tmap_per_pack_avx2(const __m256i x)
+{
+	const __m256i low_bytes = _mm256_setr_epi8(
+		0, 4, 8, 12, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+		0, 4, 8, 12, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1);
+	const __m256i b = _mm256_shuffle_epi8(x, low_bytes);
+	return _mm_unpacklo_epi32(_mm256_castsi256_si128(b), _mm256_extracti128_si256(b, 1));
+}
+
+/* Return the 8 pixels at `dest` in the low 8 bytes, and step `p` to the
+ * next 8 pixels.
+ */
+DXX_TMAP_TARGET_AVX2
+static inline __m128i tmap_per_block_avx2(const tmap_per_span &s, tmap_per_lanes_avx2 &p, const tmap_per_lanes_avx2 &step, const uint8_t *const dest)
+{
+	const __m256i qu = tmap_per_div_avx2(p.u, p.z);
+	const __m256i qv = tmap_per_div_avx2(p.v, p.z);
+	const __m256i offset = _mm256_or_si256(_mm256_and_si256(qv, _mm256_set1_epi32(64 * 63)), _mm256_and_si256(qu, _mm256_set1_epi32(63)));
+	const __m256i texel = tmap_per_gather_u8_avx2(s.texture, offset);
+	const __m256i level = _mm256_and_si256(_mm256_srai_epi32(p.l, 8), _mm256_set1_epi32(0x7f));
+	const __m256i color = tmap_per_gather_u8_avx2(s.fade_table, _mm256_or_si256(_mm256_slli_epi32(level, 8), texel));
+	p.u = _mm256_add_epi32(p.u, step.u);
+	p.v = _mm256_add_epi32(p.v, step.v);
+	p.z = _mm256_add_epi32(p.z, step.z);
+	p.l = _mm256_add_epi32(p.l, step.l);
+	const __m128i pixels = tmap_per_pack_avx2(color);
+	if (!s.transparent)
+		return pixels;
+	const __m128i keep = tmap_per_pack_avx2(_mm256_cmpeq_epi32(texel, _mm256_set1_epi32(255)));
+	const __m128i old = _mm_loadl_epi64(reinterpret_cast<const __m128i *>(dest));
+	return _mm_or_si128(_mm_and_si128(keep, old), _mm_andnot_si128(keep, pixels));
+}
+
+DXX_TMAP_TARGET_AVX2
+static inline __m256i tmap_per_ramp_avx2(const int32_t start, const int32_t delta)
+{
+	return _mm256_add_epi32(_mm256_set1_epi32(start), _mm256_mullo_epi32(_mm256_set1_epi32(delta), _mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7)));
+}
+
+DXX_TMAP_TARGET_AVX2
+std::size_t tmap_scanline_per_avx2(const tmap_per_span &s)
+{
+	tmap_per_lanes_avx2 p{
+		tmap_per_ramp_avx2(s.u, s.du),
+		tmap_per_ramp_avx2(s.v, s.dv),
+		tmap_per_ramp_avx2(s.z, s.dz),
+		tmap_per_ramp_avx2(s.l, s.dl),
+	};
+	const tmap_per_lanes_avx2 step{
+		_mm256_set1_epi32(static_cast<uint32_t>(s.du) * 8),
+		_mm256_set1_epi32(static_cast<uint32_t>(s.dv) * 8),
+		_mm256_set1_epi32(static_cast<uint32_t>(s.dz) * 8),
+		_mm256_set1_epi32(static_cast<uint32_t>(s.dl) * 8),
+	};
+	const auto dest = s.dest;
+	std::size_t i = 0;
+	for (; i + 16 <= s.count; i += 16)
+	{
+		const __m128i a = tmap_per_block_avx2(s, p, step, dest + i);
+		const __m128i b = tmap_per_block_avx2(s, p, step, dest + i + 8);
+		_mm_storeu_si128(reinterpret_cast<__m128i *>(dest + i), _mm_unpacklo_epi64(a, b));
+	}
+	if (i + 8 <= s.count)
+	{
+		_mm_storel_epi64(reinterpret_cast<__m128i *>(dest + i), tmap_per_block_avx2(s, p, step, dest + i));
+		i += 8;
+	}
+	return i;
+}
+
+constexpr tmap_scanline_kernel tmap_scanline_kernel_avx2{
+	tmap_scanline_isa::avx2,
+	tmap_scanline_per_avx2,
+};
+
+#undef DXX_TMAP_TARGET_AVX2
+#undef DXX_TMAP_TARGET_SSE2
+#endif
+
+const tmap_scanline_kernel *tmap_scanline_find_kernel(const tmap_scanline_isa isa)
+{
+	switch (isa)
+	{
+		case tmap_scanline_isa::scalar:
+			return &tmap_scanline_kernel_scalar;
+#if DXX_TMAP_SCANLINE_X86
+		case tmap_scanline_isa::sse2:
+			return __builtin_cpu_supports("sse2") ? &tmap_scanline_kernel_sse2 : nullptr;
+		case tmap_scanline_isa::avx2:
+			return __builtin_cpu_supports("avx2") ? &tmap_scanline_kernel_avx2 : nullptr;
+#endif
+		default:
+			return nullptr;
+	}
+}
+
+/* Selected on first use, like the batch vector kernels. */
+std::atomic<const tmap_scanline_kernel *> Tmap_scanline_kernel;
+
+const tmap_scanline_kernel &tmap_scanline_get_kernel()
+{
+	if (const auto k = Tmap_scanline_kernel.load(std::memory_order_relaxed))
+		return *k;
+	const auto k = tmap_scanline_find_kernel(tmap_scanline_best_isa());
+	Tmap_scanline_kernel.store(k, std::memory_order_relaxed);
+	return *k;
+}
+
+}
+
+tmap_scanline_isa tmap_scanline_best_isa()
+{
+#if DXX_TMAP_SCANLINE_X86
+	if (__builtin_cpu_supports("avx2"))
+		return tmap_scanline_isa::avx2;
+	if (__builtin_cpu_supports("sse2"))
+		return tmap_scanline_isa::sse2;
+#endif
+	return tmap_scanline_isa::scalar;
+}
+
+tmap_scanline_isa tmap_scanline_get_isa()
+{
+	return tmap_scanline_get_kernel().isa;
+}
+
+bool tmap_scanline_set_isa(const tmap_scanline_isa isa)
+{
+	const auto k = tmap_scanline_find_kernel(isa);
+	if (!k)
+		return false;
+	Tmap_scanline_kernel.store(k, std::memory_order_relaxed);
+	return true;
+}
+
+void tmap_scanline_per(const tmap_per_span &s)
+{
+	const std::size_t first = tmap_scanline_get_kernel().per(s);
+	const auto texture = s.texture;
+	const auto fade_table = s.fade_table;
+	/* Step in unsigned, so that wraparound is defined. */
+	uint32_t u = s.u + first * s.du, v = s.v + first * s.dv, z = s.z + first * s.dz, l = s.l + first * s.dl;
+	for (std::size_t i = first; i != s.count; ++i)
+	{
+		const int32_t zi = z;
+		const uint8_t c = texture[((static_cast<int32_t>(v) / zi) & (64 * 63)) + ((static_cast<int32_t>(u) / zi) & 63)];
+		if (!s.transparent || c != 255)
+			s.dest[i] = fade_table[256 * ((static_cast<int32_t>(l) >> 8) & 0x7f) + c];
+		u += s.du;
+		v += s.dv;
+		z += s.dz;
+		l += s.dl;
+	}
+}
+
+}
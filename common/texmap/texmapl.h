@@ -33,6 +33,7 @@ COPYRIGHT 1993-1998 PARALLAX SOFTWARE CORPORATION.  ALL RIGHTS RESERVED.
 #include <cstddef>
 #include "dxxsconf.h"
 #include "dsx-ns.h"
+#include "fwd-gr.h"
 #include <array>
 
 namespace dcx {
@@ -46,16 +47,56 @@ extern	int succmod(int val,int modulus);
 fix compute_dx_dy(const g3ds_tmap &t, int top_vertex,int bottom_vertex, fix recip_dy);
 void compute_y_bounds(const g3ds_tmap &t, int &vlt, int &vlb, int &vrt, int &vrb,int &bottom_y_ind);
 
-extern int	fx_y,fx_xleft,fx_xright;
-extern const color_palette_index *pixptr;
+// These are thread_local, so that the binned rasterizer can draw
+// several bands of the canvas at once.
+extern thread_local int	fx_y,fx_xleft,fx_xright;
+extern thread_local const color_palette_index *pixptr;
 // texture mapper scanline renderers
 // Interface variables to assembler code
-extern	fix	fx_u,fx_v,fx_z,fx_du_dx,fx_dv_dx,fx_dz_dx;
-extern	fix	fx_dl_dx,fx_l;
-extern	int	bytes_per_row;
-extern  unsigned char *write_buffer;
+extern thread_local fix	fx_u,fx_v,fx_z,fx_du_dx,fx_dv_dx,fx_dz_dx;
+extern thread_local fix	fx_dl_dx,fx_l;
+extern thread_local int	bytes_per_row;
+extern thread_local unsigned char *write_buffer;
 
-extern uint8_t tmap_flat_color;
+extern thread_local uint8_t tmap_flat_color;
+
+// Rows that the calling thread may draw.  Outside of a band of the
+// binned rasterizer, every row may be drawn, and Tmap_band_row_width is
+// 0.
+extern thread_local int Tmap_band_top, Tmap_band_bot, Tmap_band_row_width;
+
+static inline bool tmap_band_skip_row(const int y)
+{
+	return y < Tmap_band_top || y > Tmap_band_bot;
+}
+
+// Inside a band, keep the span fx_xleft..fx_xright in its own row.  A
+// span which starts left of the canvas would otherwise write the end of
+// the row above, and one which ends right of the canvas would write the
+// start of the row below, either of which may belong to another band.
+// The interpolants are advanced past the skipped pixels, so that the
+// pixels which are drawn are the same as without the clamp.
+static inline void tmap_band_clamp_span()
+{
+	if (!Tmap_band_row_width)
+		return;
+	if (fx_xleft < 0)
+	{
+		const int skip = -fx_xleft;
+		fx_xleft = 0;
+		fx_u += skip * fx_du_dx;
+		fx_v += skip * fx_dv_dx;
+		fx_z += skip * fx_dz_dx;
+		fx_l += skip * fx_dl_dx;
+	}
+	if (fx_xright >= Tmap_band_row_width)
+		fx_xright = Tmap_band_row_width - 1;
+}
+
+// Record a flat polygon, if the binned rasterizer is recording.  Return
+// false if the caller should draw it now.
+bool tmap_bin_flat(const g3ds_tmap &t, uint8_t color, gr_fade_level fade);
+void texture_map_flat(const g3ds_tmap &t, uint8_t color, gr_fade_level fade);
 
 constexpr std::integral_constant<std::size_t, 641> FIX_RECIP_TABLE_SIZE{};	//increased from 321 to 641, since this res is now quite achievable.. slight fps boost -MM
 extern const std::array<fix, FIX_RECIP_TABLE_SIZE> fix_recip_table;
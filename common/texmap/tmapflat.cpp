@@ -49,21 +49,24 @@ static void gr_upoly_tmap_ylr(grs_canvas &, uint_fast32_t nverts, const int *ver
 //	Texture map current scanline.
 //	Uses globals Du_dx and Dv_dx to incrementally compute u,v coordinates
 // -------------------------------------------------------------------------------------
-static void tmap_scanline_flat(grs_canvas &canvas, int y, fix xleft, fix xright)
+static void tmap_scanline_flat(const gr_fade_level fade, int y, fix xleft, fix xright)
 {
 	if (xright < xleft)
 		return;
+	if (tmap_band_skip_row(y))
+		return;
 
 	// setup to call assembler scanline renderer
 
 	fx_y = y;
 	fx_xleft = xleft/F1_0;		// (xleft >> 16) != xleft/F1_0 for negative numbers, f2i caused random crashes
 	fx_xright = xright/F1_0;
+	tmap_band_clamp_span();
 
-	if (canvas.cv_fade_level >= GR_FADE_OFF)
+	if (fade >= GR_FADE_OFF)
 		c_tmap_scanline_flat();
 	else	{
-		c_tmap_scanline_shaded(canvas.cv_fade_level);
+		c_tmap_scanline_shaded(fade);
 	}	
 }
 
@@ -82,11 +85,13 @@ static void tmap_scanline_flat(grs_canvas &canvas, int y, fix xleft, fix xright)
 //--unused-- 	asm_tmap_scanline_shaded();
 //--unused-- }
 
+}
+
 // -------------------------------------------------------------------------------------
 //	Render a texture map.
 // Linear in outer loop, linear in inner loop.
 // -------------------------------------------------------------------------------------
-static void texture_map_flat(grs_canvas &canvas, const g3ds_tmap &t, int color)
+void texture_map_flat(const g3ds_tmap &t, const uint8_t color, const gr_fade_level fade)
 {
 	int	vlt,vrt,vlb,vrb;	// vertex left top, vertex right top, vertex left bottom, vertex right bottom
 	int	topy,boty,dy;
@@ -124,6 +129,9 @@ static void texture_map_flat(grs_canvas &canvas, const g3ds_tmap &t, int color)
 	// @mk: Should we render the scanline for y==boty?  This violates Matt's spec.
 
 	for (int y = topy; y < boty; y++) {
+		// Rows below the band of this thread can only be skipped.
+		if (y > Tmap_band_bot)
+			return;
 
 		// See if we have reached the end of the current left edge, and if so, set
 		// new values for dx_dy and x,u,v
@@ -159,15 +167,13 @@ static void texture_map_flat(grs_canvas &canvas, const g3ds_tmap &t, int color)
 			xright = v3d[vrt].x2d;
 
 		}
-		tmap_scanline_flat(canvas, y, xleft, xright);
+		tmap_scanline_flat(fade, y, xleft, xright);
 
 		xleft += dx_dy_left;
 		xright += dx_dy_right;
 
 	}
-	tmap_scanline_flat(canvas, boty, xleft, xright);
-}
-
+	tmap_scanline_flat(fade, boty, xleft, xright);
 }
 
 //	-----------------------------------------------------------------------------------------
@@ -235,7 +241,9 @@ static void gr_upoly_tmap_ylr(grs_canvas &canvas, uint_fast32_t nverts, const in
 		i.x2d = *vert++;
 		i.y2d = *vert++;
 	}
-	texture_map_flat(canvas, my_tmap, color);
+	if (tmap_bin_flat(my_tmap, color, canvas.cv_fade_level))
+		return;
+	texture_map_flat(my_tmap, color, canvas.cv_fade_level);
 }
 
 }
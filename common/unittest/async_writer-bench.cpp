@@ -0,0 +1,72 @@
+#include "async_writer.h"
+#include <chrono>
+#include <cstdio>
+
+#define BOOST_TEST_DYN_LINK
+#define BOOST_TEST_MODULE Rebirth async_writer benchmark
+#include <boost/test/unit_test.hpp>
+
+/* Time how long the game thread spends recording a demo frame: once
+ * with a buffered stdio write per field, as demos used to be written,
+ * and once through async_writer.  Run with `--log_level=message` to see
+ * the timings.
+ */
+
+/* A busy multiplayer frame: a few hundred objects of about twenty
+ * fields each, plus some events.
+ */
+static constexpr unsigned bench_fields_per_frame = 300 * 20 + 200;
+static constexpr unsigned bench_frames = 2000;
+
+template <typename W, typename E>
+static std::chrono::nanoseconds bench_record(W &&write_field, E &&end_frame)
+{
+	const auto start = std::chrono::steady_clock::now();
+	for (unsigned frame = 0; frame != bench_frames; ++frame)
+	{
+		for (unsigned i = 0; i != bench_fields_per_frame; ++i)
+		{
+			const int32_t v = frame ^ i;
+			write_field(&v, sizeof(v));
+		}
+		end_frame();
+	}
+	return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start);
+}
+
+static double bench_us_per_frame(const std::chrono::nanoseconds t)
+{
+	return static_cast<double>(t.count()) / 1000 / bench_frames;
+}
+
+static bool bench_write_file(void *const context, const uint8_t *const data, const std::size_t size)
+{
+	return std::fwrite(data, 1, size, static_cast<FILE *>(context)) == size;
+}
+
+BOOST_AUTO_TEST_CASE(async_writer_benchmark)
+{
+	FILE *const direct_file = std::tmpfile();
+	BOOST_REQUIRE(direct_file);
+	const auto direct = bench_record([direct_file](const void *const p, const std::size_t size) {
+		std::fwrite(p, 1, size, direct_file);
+	}, []{});
+	std::fclose(direct_file);
+
+	FILE *const async_file = std::tmpfile();
+	BOOST_REQUIRE(async_file);
+	dcx::async_writer w;
+	w.start(bench_write_file, async_file);
+	const auto async = bench_record([&w](const void *const p, const std::size_t size) {
+		w.write(p, size);
+	}, [&w]{
+		w.submit();
+	});
+	const auto finish_start = std::chrono::steady_clock::now();
+	BOOST_TEST(w.finish());
+	const auto finish_ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - finish_start).count();
+	std::fclose(async_file);
+
+	BOOST_TEST_MESSAGE("direct writes: " << bench_us_per_frame(direct) << " us/frame");
+	BOOST_TEST_MESSAGE("async_writer: " << bench_us_per_frame(async) << " us/frame, then " << finish_ms << " ms to finish");
+}
@@ -0,0 +1,104 @@
+#include "async_writer.h"
+#include <cstring>
+#include <vector>
+
+#define BOOST_TEST_DYN_LINK
+#define BOOST_TEST_MODULE Rebirth async_writer
+#include <boost/test/unit_test.hpp>
+
+namespace {
+
+struct recording_sink
+{
+	std::vector<uint8_t> data;
+	unsigned calls = 0;
+	/* Fail the call with this number, counting from 1.  0 never fails. */
+	unsigned fail_on_call = 0;
+	static bool write(void *const context, const uint8_t *const p, const std::size_t size)
+	{
+		auto &self = *static_cast<recording_sink *>(context);
+		if (++ self.calls == self.fail_on_call)
+			return false;
+		self.data.insert(self.data.end(), p, p + size);
+		return true;
+	}
+};
+
+}
+
+/* Test that everything written reaches the sink, in order, whether or
+ * not it was explicitly submitted.
+ */
+BOOST_AUTO_TEST_CASE(async_writer_preserves_order)
+{
+	recording_sink sink;
+	dcx::async_writer w;
+	w.start(recording_sink::write, &sink);
+	std::vector<uint8_t> expected;
+	for (unsigned frame = 0; frame != 1000; ++frame)
+	{
+		for (unsigned i = 0; i != frame % 17; ++i)
+		{
+			const uint32_t v = frame * 1000 + i;
+			uint8_t bytes[sizeof(v)];
+			std::memcpy(bytes, &v, sizeof(v));
+			w.write(bytes, sizeof(bytes));
+			expected.insert(expected.end(), bytes, bytes + sizeof(bytes));
+		}
+		if (frame % 3)
+			w.submit();
+	}
+	BOOST_TEST(w.finish());
+	BOOST_TEST((sink.data == expected));
+}
+
+/* Test that empty submissions do not call the sink. */
+BOOST_AUTO_TEST_CASE(async_writer_empty_submit)
+{
+	recording_sink sink;
+	dcx::async_writer w;
+	w.start(recording_sink::write, &sink);
+	w.submit();
+	w.submit();
+	BOOST_TEST(w.finish());
+	BOOST_TEST(sink.calls == 0u);
+}
+
+/* Test that a sink failure is reported, and that later blocks are
+ * dropped instead of written after the gap.
+ */
+BOOST_AUTO_TEST_CASE(async_writer_reports_failure)
+{
+	recording_sink sink;
+	sink.fail_on_call = 2;
+	dcx::async_writer w;
+	w.start(recording_sink::write, &sink);
+	for (uint8_t i = 0; i != 5; ++i)
+	{
+		w.write(&i, 1);
+		w.submit();
+	}
+	BOOST_TEST(!w.finish());
+	BOOST_TEST(w.failed());
+	BOOST_TEST((sink.data == std::vector<uint8_t>{0}));
+}
+
+/* Test that a writer can be restarted after it finishes, and that a
+ * failure does not carry over.
+ */
+BOOST_AUTO_TEST_CASE(async_writer_restart)
+{
+	recording_sink failing;
+	failing.fail_on_call = 1;
+	dcx::async_writer w;
+	w.start(recording_sink::write, &failing);
+	const uint8_t b = 7;
+	w.write(&b, 1);
+	BOOST_TEST(!w.finish());
+	recording_sink sink;
+	w.start(recording_sink::write, &sink);
+	BOOST_TEST(!w.failed());
+	w.write(&b, 1);
+	BOOST_TEST(w.finish());
+	BOOST_TEST((sink.data == std::vector<uint8_t>{7}));
+}
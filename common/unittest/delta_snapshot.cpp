@@ -0,0 +1,242 @@
+#include "delta_snapshot.h"
+#include <limits>
+#include <random>
+#include <vector>
+
+#define BOOST_TEST_DYN_LINK
+#define BOOST_TEST_MODULE Rebirth delta_snapshot
+#include <boost/test/unit_test.hpp>
+
+namespace {
+
+using test_snapshot = dcx::delta_snapshot<4, 3>;
+constexpr std::size_t test_history = 8;
+using test_sender = dcx::snapshot_sender<test_snapshot, test_history>;
+using test_receiver = dcx::snapshot_receiver<test_snapshot, test_history>;
+
+struct encoded_snapshot
+{
+	test_sender::header header;
+	std::vector<uint8_t> data;
+};
+
+encoded_snapshot encode(test_sender &s, const test_snapshot &current)
+{
+	std::array<uint8_t, 256> buf{};
+	dcx::bit_writer w(buf);
+	const auto h = s.encode(w, current);
+	BOOST_TEST_REQUIRE(!w.overflow());
+	return {h, std::vector<uint8_t>(buf.begin(), buf.begin() + w.bytes())};
+}
+
+const test_snapshot *decode(test_receiver &r, const encoded_snapshot &e)
+{
+	dcx::bit_reader br(e.data);
+	return r.decode(br, e.header.seq, e.header.baseline);
+}
+
+}
+
+BOOST_AUTO_TEST_CASE(bit_writer_round_trip)
+{
+	std::array<uint8_t, 8> buf{};
+	dcx::bit_writer w(buf);
+	w.write(1, 1);
+	w.write(0x15, 5);
+	w.write(0xdeadbeef, 32);
+	w.write(3, 2);
+	BOOST_TEST(w.bytes() == 5u);
+	BOOST_TEST(!w.overflow());
+	dcx::bit_reader r(std::span<const uint8_t>(buf).first(w.bytes()));
+	BOOST_TEST(r.read(1) == 1u);
+	BOOST_TEST(r.read(5) == 0x15u);
+	BOOST_TEST(r.read(32) == 0xdeadbeefu);
+	BOOST_TEST(r.read(2) == 3u);
+	BOOST_TEST(!r.overrun());
+	BOOST_TEST(r.read(8) == 0u);
+	BOOST_TEST(r.overrun());
+}
+
+BOOST_AUTO_TEST_CASE(bit_writer_overflow)
+{
+	std::array<uint8_t, 1> buf{};
+	dcx::bit_writer w(buf);
+	w.write(0x7f, 7);
+	BOOST_TEST(!w.overflow());
+	w.write(3, 2);
+	BOOST_TEST(w.overflow());
+	BOOST_TEST(buf[0] == 0x7f);
+}
+
+BOOST_AUTO_TEST_CASE(delta_round_trip)
+{
+	constexpr int32_t lo = std::numeric_limits<int32_t>::min(), hi = std::numeric_limits<int32_t>::max();
+	const std::array<std::pair<int32_t, int32_t>, 8> cases{{
+		{0, 0}, {1, 0}, {-1, 0}, {100, 99}, {-65536, 65536}, {hi, lo}, {lo, hi}, {lo, 0},
+	}};
+	std::array<uint8_t, 64> buf{};
+	dcx::bit_writer w(buf);
+	for (auto &[value, base] : cases)
+		dcx::write_delta(w, value, base);
+	BOOST_TEST(!w.overflow());
+	dcx::bit_reader r(buf);
+	for (auto &[value, base] : cases)
+		BOOST_TEST(dcx::read_delta(r, base) == value);
+	BOOST_TEST(!r.overrun());
+}
+
+BOOST_AUTO_TEST_CASE(delta_size)
+{
+	std::array<uint8_t, 8> buf{};
+	{
+		dcx::bit_writer w(buf);
+		dcx::write_delta(w, 5, 5);
+		BOOST_TEST(w.bytes() == 1u);
+	}
+	{
+		/* A change of one costs the flag, the length and one bit. */
+		dcx::bit_writer w(buf);
+		dcx::write_delta(w, 6, 5);
+		dcx::write_delta(w, 4, 5);
+		BOOST_TEST(w.bytes() == 2u);
+	}
+}
+
+BOOST_AUTO_TEST_CASE(snapshot_unchanged_is_small)
+{
+	test_sender s;
+	test_receiver r;
+	test_snapshot current;
+	current.state[1] = {100000, -200000, 7};
+	current.state[2] = {1, 2, 3};
+	current.updated.set(1).set(2);
+	const auto full = encode(s, current);
+	BOOST_TEST(!full.header.baseline);
+	const auto d0 = decode(r, full);
+	BOOST_TEST_REQUIRE(d0);
+	BOOST_TEST((d0->state == current.state));
+	BOOST_TEST((d0->updated == current.updated));
+	s.acknowledge(*r.latest());
+	const auto delta = encode(s, current);
+	BOOST_TEST_REQUIRE(delta.header.baseline.has_value());
+	BOOST_TEST(*delta.header.baseline == full.header.seq);
+	/* Two bits for each updated entity, one for each other. */
+	BOOST_TEST(delta.data.size() == 1u);
+	BOOST_TEST(delta.data.size() < full.data.size());
+	const auto d1 = decode(r, delta);
+	BOOST_TEST_REQUIRE(d1);
+	BOOST_TEST((d1->state == current.state));
+}
+
+BOOST_AUTO_TEST_CASE(snapshot_absent_entity_keeps_baseline)
+{
+	test_sender s;
+	test_receiver r;
+	test_snapshot current;
+	current.state[0] = {1, 2, 3};
+	current.state[3] = {4, 5, 6};
+	current.updated.set(0).set(3);
+	BOOST_TEST_REQUIRE(decode(r, encode(s, current)));
+	s.acknowledge(*r.latest());
+	/* Entity 3 is not sent, so both ends keep its acknowledged value,
+	 * not the one the sender has now.
+	 */
+	current.state[0] = {10, 2, 3};
+	current.state[3] = {40, 50, 60};
+	current.updated.reset(3);
+	const auto d = decode(r, encode(s, current));
+	BOOST_TEST_REQUIRE(d);
+	BOOST_TEST((d->state[0] == test_snapshot::entity{10, 2, 3}));
+	BOOST_TEST((d->state[3] == test_snapshot::entity{4, 5, 6}));
+	BOOST_TEST(!d->updated[3]);
+	s.acknowledge(*r.latest());
+	current.updated.set(3);
+	const auto d2 = decode(r, encode(s, current));
+	BOOST_TEST_REQUIRE(d2);
+	BOOST_TEST((d2->state == current.state));
+}
+
+BOOST_AUTO_TEST_CASE(snapshot_stale_and_unknown_baseline)
+{
+	test_sender s;
+	test_receiver r;
+	test_snapshot current;
+	current.updated.set(0);
+	const auto first = encode(s, current);
+	const auto second = encode(s, current);
+	BOOST_TEST(decode(r, second));
+	/* Older than the latest one decoded. */
+	BOOST_TEST(!decode(r, first));
+	BOOST_TEST(!decode(r, second));
+	/* A baseline that the receiver never decoded. */
+	s.acknowledge(first.header.seq);
+	const auto third = encode(s, current);
+	BOOST_TEST_REQUIRE(third.header.baseline.has_value());
+	BOOST_TEST(!decode(r, third));
+	BOOST_TEST(*r.latest() == second.header.seq);
+}
+
+BOOST_AUTO_TEST_CASE(snapshot_baseline_leaves_history)
+{
+	test_sender s;
+	test_receiver r;
+	test_snapshot current;
+	current.updated.set(0);
+	BOOST_TEST_REQUIRE(decode(r, encode(s, current)));
+	s.acknowledge(*r.latest());
+	/* The peer stops acknowledging.  Once its baseline is about to be
+	 * overwritten, the sender falls back to full snapshots.
+	 */
+	for (std::size_t i = 1; i != test_history; ++i)
+		BOOST_TEST(encode(s, current).header.baseline.has_value());
+	BOOST_TEST(!encode(s, current).header.baseline.has_value());
+	s.acknowledge(0);
+	BOOST_TEST(!encode(s, current).header.baseline.has_value());
+}
+
+/* A peer that loses and reorders snapshots still decodes every one it
+ * accepts to exactly what was sent.
+ */
+BOOST_AUTO_TEST_CASE(snapshot_lossy_stream)
+{
+	std::minstd_rand rng(25);
+	test_sender s;
+	test_receiver r;
+	test_snapshot current;
+	std::vector<std::pair<encoded_snapshot, test_snapshot>> in_flight;
+	std::size_t delivered = 0, accepted = 0, full_bytes = 0, delta_bytes = 0;
+	for (unsigned tick = 0; tick != 4000; ++tick)
+	{
+		for (std::size_t e = 0; e != 4; ++e)
+		{
+			current.updated[e] = rng() % 4 != 0;
+			for (auto &f : current.state[e])
+				if (rng() % 3 == 0)
+					f += static_cast<int32_t>(rng() % 64) - 32;
+		}
+		auto encoded = encode(s, current);
+		(encoded.header.baseline ? delta_bytes : full_bytes) += encoded.data.size();
+		in_flight.emplace_back(std::move(encoded), current);
+		while (!in_flight.empty() && rng() % 2)
+		{
+			const auto i = rng() % in_flight.size();
+			auto [e, sent] = std::move(in_flight[i]);
+			in_flight.erase(in_flight.begin() + i);
+			if (rng() % 10 == 0)
+				continue;
+			++delivered;
+			const auto d = decode(r, e);
+			if (!d)
+				continue;
+			++accepted;
+			for (std::size_t n = 0; n != 4; ++n)
+				if (sent.updated[n])
+					BOOST_TEST((d->state[n] == sent.state[n]));
+			BOOST_TEST((d->updated == sent.updated));
+			if (rng() % 5)
+				s.acknowledge(*r.latest());
+		}
+	}
+	BOOST_TEST(accepted > delivered / 2);
+	BOOST_TEST_MESSAGE("delivered " << delivered << ", accepted " << accepted << ", full bytes " << full_bytes << ", delta bytes " << delta_bytes);
+}
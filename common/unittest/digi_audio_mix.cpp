@@ -0,0 +1,142 @@
+#include "digi_audio_mix.h"
+#include <algorithm>
+#include <random>
+#include <thread>
+#include <vector>
+
+#define BOOST_TEST_DYN_LINK
+#define BOOST_TEST_MODULE Rebirth digi_audio_mix
+#include <boost/test/unit_test.hpp>
+
+/* Counts that cover an empty buffer, and every remainder after a full
+ * vector.
+ */
+static constexpr std::size_t frame_counts[]{0, 1, 3, 4, 5, 7, 8, 9, 15, 16, 17, 256, 1023};
+
+BOOST_AUTO_TEST_CASE(digi_mix_resample_steps_and_interpolates)
+{
+	const std::vector<uint8_t> samples{0x80, 0x90, 0x00, 0xff};
+	std::array<int16_t, 8> mono{};
+	uint64_t position = 0;
+	/* Half a sample per frame, as when 22KHz sounds play at 44KHz. */
+	BOOST_TEST(dcx::digi_mix_resample(mono.data(), mono.size(), samples, position, 0x8000, false) == 8u);
+	const int16_t expected[]{0, 0x800, 0x1000, -0x3800, -0x8000, -0x80, 0x7f00, 0x7f00};
+	for (std::size_t i = 0; i != mono.size(); ++i)
+		BOOST_TEST(mono[i] == expected[i], "frame " << i);
+	BOOST_TEST(position == 0x40000u);
+	/* The sound has ended. */
+	BOOST_TEST(dcx::digi_mix_resample(mono.data(), mono.size(), samples, position, 0x8000, false) == 0u);
+}
+
+BOOST_AUTO_TEST_CASE(digi_mix_resample_loops)
+{
+	const std::vector<uint8_t> samples{0x80, 0xc0, 0x40};
+	std::array<int16_t, 7> mono{};
+	uint64_t position = 0x10000;
+	BOOST_TEST(dcx::digi_mix_resample(mono.data(), mono.size(), samples, position, 0x10000, true) == 7u);
+	const int16_t expected[]{0x4000, -0x4000, 0, 0x4000, -0x4000, 0, 0x4000};
+	for (std::size_t i = 0; i != mono.size(); ++i)
+		BOOST_TEST(mono[i] == expected[i], "frame " << i);
+	BOOST_TEST(position == 0x20000u);
+	/* The last sample interpolates toward the first. */
+	position = 0x28000;
+	dcx::digi_mix_resample(mono.data(), 1, samples, position, 0x10000, true);
+	BOOST_TEST(mono[0] == -0x2000);
+	/* An empty sound never produces frames, even when looped. */
+	position = 0;
+	BOOST_TEST(dcx::digi_mix_resample(mono.data(), mono.size(), {}, position, 0x10000, true) == 0u);
+}
+
+BOOST_AUTO_TEST_CASE(digi_mix_accumulate_matches_reference)
+{
+	std::mt19937 rng(18);
+	std::uniform_int_distribution<int> sample(INT16_MIN, INT16_MAX);
+	std::uniform_int_distribution<int> gain(0, INT16_MAX);
+	for (const auto frames : frame_counts)
+	{
+		std::vector<int16_t> mono(frames);
+		for (auto &s : mono)
+			s = sample(rng);
+		std::vector<int32_t> acc(2 * frames + 2);
+		for (auto &a : acc)
+			a = sample(rng);
+		auto expected = acc;
+		const int16_t gain_left = gain(rng), gain_right = gain(rng);
+		for (std::size_t i = 0; i != frames; ++i)
+		{
+			expected[2 * i] += (int32_t{mono[i]} * gain_left) >> 14;
+			expected[2 * i + 1] += (int32_t{mono[i]} * gain_right) >> 14;
+		}
+		dcx::digi_mix_accumulate(acc.data(), mono.data(), frames, gain_left, gain_right);
+		for (std::size_t i = 0; i != acc.size(); ++i)
+			BOOST_TEST(acc[i] == expected[i], "frames " << frames << " sample " << i);
+	}
+}
+
+BOOST_AUTO_TEST_CASE(digi_mix_saturate_clamps)
+{
+	std::mt19937 rng(19);
+	std::uniform_int_distribution<int32_t> value(-0x20000, 0x20000);
+	for (const auto count : frame_counts)
+	{
+		std::vector<int32_t> acc(count);
+		for (auto &a : acc)
+			a = value(rng);
+		std::vector<int16_t> out(count + 1, 0x55);
+		dcx::digi_mix_saturate(out.data(), acc.data(), count);
+		for (std::size_t i = 0; i != count; ++i)
+			BOOST_TEST(out[i] == std::clamp<int32_t>(acc[i], INT16_MIN, INT16_MAX), "count " << count << " sample " << i);
+		BOOST_TEST(out[count] == 0x55);
+	}
+}
+
+BOOST_AUTO_TEST_CASE(digi_mix_ring_wraps)
+{
+	dcx::digi_mix_ring ring;
+	ring.reset(8);
+	const int16_t in[]{1, 2, 3, 4, 5, 6, 7, 8, 9, 10};
+	int16_t out[10]{};
+	BOOST_TEST(ring.write(in, 6) == 6u);
+	BOOST_TEST(ring.read(out, 4) == 4u);
+	BOOST_TEST(out[3] == 4);
+	/* Only 6 of these fit, and they wrap past the end of the buffer. */
+	BOOST_TEST(ring.write(in + 1, 9) == 6u);
+	BOOST_TEST(ring.size() == 8u);
+	BOOST_TEST(ring.read(out, 10) == 8u);
+	const int16_t expected[]{5, 6, 2, 3, 4, 5, 6, 7};
+	for (std::size_t i = 0; i != 8; ++i)
+		BOOST_TEST(out[i] == expected[i], "sample " << i);
+	BOOST_TEST(ring.read(out, 10) == 0u);
+}
+
+BOOST_AUTO_TEST_CASE(digi_mix_ring_between_threads)
+{
+	/* One thread writes a counting sequence in uneven pieces while
+	 * another reads it.  The reader must see every value, in order.
+	 */
+	constexpr int16_t total = 30000;
+	dcx::digi_mix_ring ring;
+	ring.reset(64);
+	std::thread writer([&ring]() {
+		int16_t next = 0;
+		std::array<int16_t, 37> block;
+		while (next != total)
+		{
+			const std::size_t n = std::min<std::size_t>(block.size(), total - next);
+			for (std::size_t i = 0; i != n; ++i)
+				block[i] = next + i;
+			next += ring.write(block.data(), n);
+		}
+	});
+	int16_t expected = 0;
+	bool in_order = true;
+	std::array<int16_t, 23> block;
+	while (expected != total)
+	{
+		const auto n = ring.read(block.data(), block.size());
+		for (std::size_t i = 0; i != n; ++i)
+			in_order &= (block[i] == expected++);
+	}
+	writer.join();
+	BOOST_TEST(in_order);
+}
@@ -0,0 +1,73 @@
+#include "digi_mixer_resample.h"
+#include <random>
+#include <vector>
+
+#define BOOST_TEST_DYN_LINK
+#define BOOST_TEST_MODULE Rebirth digi_mixer_resample
+#include <boost/test/unit_test.hpp>
+
+namespace {
+
+/* The quarter band filter of the SoundBlaster16 emulation. */
+constexpr int32_t coeffs_quarterband[]{
+	0, 0, -7, -25, -35, 0, 94, 200, 205, 0, -395, -751, -702, 0, 1178, 2127,
+	1907, 0, -3050, -5490, -5011, 0, 9275, 20326, 29311, 32767, 29311,
+	20326, 9275, 0, -5011, -5490, -3050, 0, 1907, 2127, 1178, 0, -702,
+	-751, -395, 0, 205, 200, 94, 0, -35, -25, -7, 0, 0
+};
+
+/* Zero-stuff the input, and convolve it with every tap.  This is how the
+ * SoundBlaster16 emulation used to upsample.
+ */
+std::vector<int16_t> reference_upsample(const std::vector<uint8_t> &input, const unsigned factor, const std::span<const int32_t> coeffs)
+{
+	std::vector<int32_t> stuffed(input.size() * factor);
+	for (std::size_t i = 0; i != input.size(); ++i)
+		stuffed[i * factor] = int32_t{input[i]} - 0x80;
+	std::vector<int16_t> result(stuffed.size());
+	for (std::size_t n = 0; n != stuffed.size(); ++n)
+	{
+		int32_t sum = 0;
+		for (std::size_t k = (n + 1 > coeffs.size() ? n + 1 - coeffs.size() : 0); k <= n; ++k)
+			sum += stuffed[k] * coeffs[n - k];
+		result[n] = static_cast<int16_t>(sum >> 8);
+	}
+	return result;
+}
+
+}
+
+BOOST_AUTO_TEST_CASE(digi_upsample_polyphase_matches_convolution)
+{
+	std::mt19937 rng(19);
+	std::uniform_int_distribution<unsigned> byte(0, 255);
+	std::uniform_int_distribution<int32_t> coeff(-40000, 40000);
+	/* A filter with no zero taps, and with an even length. */
+	std::vector<int32_t> dense(24);
+	for (auto &c : dense)
+		c = coeff(rng);
+	for (const std::size_t length : {0u, 1u, 2u, 12u, 13u, 50u, 51u, 1000u})
+	{
+		std::vector<uint8_t> input(length);
+		for (auto &b : input)
+			b = byte(rng);
+		for (const unsigned factor : {1u, 2u, 4u})
+			for (const std::span<const int32_t> coeffs : {std::span<const int32_t>(coeffs_quarterband), std::span<const int32_t>(dense)})
+			{
+				const auto expected = reference_upsample(input, factor, coeffs);
+				std::vector<int16_t> output(input.size() * factor);
+				dcx::digi_upsample_polyphase(input, factor, coeffs, output);
+				BOOST_TEST(output == expected, "length " << length << " factor " << factor << " taps " << coeffs.size());
+			}
+	}
+}
+
+BOOST_AUTO_TEST_CASE(digi_sound_hash_depends_on_content)
+{
+	const std::vector<uint8_t> a{1, 2, 3}, b{1, 2, 4}, c{1, 2};
+	BOOST_TEST(dcx::digi_sound_hash(a) == dcx::digi_sound_hash(a));
+	BOOST_TEST(dcx::digi_sound_hash(a) != dcx::digi_sound_hash(b));
+	BOOST_TEST(dcx::digi_sound_hash(a) != dcx::digi_sound_hash(c));
+	/* The hash names files on disk, so it must never change. */
+	BOOST_TEST(dcx::digi_sound_hash({}) == UINT64_C(0xcbf29ce484222325));
+}
@@ -0,0 +1,50 @@
+#include "parallel.h"
+#include <atomic>
+#include <vector>
+
+#define BOOST_TEST_DYN_LINK
+#define BOOST_TEST_MODULE Rebirth parallel
+#include <boost/test/unit_test.hpp>
+
+/* Test that parallel_for calls nothing when the count is 0.
+ */
+BOOST_AUTO_TEST_CASE(parallel_for_empty)
+{
+	std::atomic<unsigned> calls{0};
+	dcx::parallel_for(0, [&](std::size_t) { ++ calls; });
+	BOOST_TEST(calls == 0u);
+}
+
+/* Test that parallel_for visits every index exactly once, for each
+ * supported thread count.
+ */
+BOOST_AUTO_TEST_CASE(parallel_for_each_index_once)
+{
+	for (const unsigned threads : {1u, 2u, 4u, 8u})
+	{
+		dcx::set_parallel_thread_count(threads);
+		BOOST_TEST(dcx::get_parallel_thread_count() == threads);
+		for (const std::size_t count : {1u, 2u, 7u, 350u, 4096u})
+		{
+			std::vector<std::atomic<unsigned>> visits(count);
+			dcx::parallel_for(count, [&](const std::size_t i) { ++ visits[i]; });
+			for (auto &v : visits)
+				BOOST_TEST(v == 1u);
+		}
+	}
+	dcx::set_parallel_thread_count(0);
+}
+
+/* Test that repeated jobs on the same workers each run to completion
+ * before parallel_for returns.
+ */
+BOOST_AUTO_TEST_CASE(parallel_for_repeated)
+{
+	dcx::set_parallel_thread_count(4);
+	std::vector<unsigned> values(1000);
+	for (unsigned pass = 0; pass != 100; ++pass)
+		dcx::parallel_for(values.size(), [&](const std::size_t i) { values[i] += i; });
+	for (std::size_t i = 0; i != values.size(); ++i)
+		BOOST_TEST(values[i] == i * 100);
+	dcx::set_parallel_thread_count(0);
+}
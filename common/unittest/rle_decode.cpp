@@ -0,0 +1,203 @@
+#include "rle_decode.h"
+#include <algorithm>
+#include <cstring>
+#include <memory>
+#include <random>
+#include <vector>
+
+#define BOOST_TEST_DYN_LINK
+#define BOOST_TEST_MODULE Rebirth rle_decode
+#include <boost/test/unit_test.hpp>
+
+/* gr_rle_decode scans for run codes and fills long runs with vector
+ * instructions where the target has them.  Compare it to the byte at a
+ * time decoder it replaced.  Source rows are copied into allocations of
+ * exactly their size, so that a build with -fsanitize=address catches
+ * any read past the row bound.
+ */
+
+namespace {
+
+using dcx::IS_RLE_CODE;
+using dcx::NOT_RLE_CODE;
+using dcx::RLE_CODE;
+
+uint8_t *reference_decode(const uint8_t *sb, uint8_t *db, const rle_position_t e)
+{
+	for (; sb != e.src;)
+	{
+		auto p{sb};
+		uint8_t c;
+		for (; c = *p, !IS_RLE_CODE(c);)
+			if (++p == e.src)
+				return db;
+		const std::size_t count{(std::size_t{c} & NOT_RLE_CODE)};
+		const std::size_t cn{std::min<std::size_t>(p - sb, e.dst - db)};
+		std::memcpy(db, sb, cn);
+		db += cn;
+		if (!count)
+			break;
+		sb += cn;
+		if (sb == e.src || db == e.dst || count > static_cast<std::size_t>(e.dst - db))
+			break;
+		if (++ sb == e.src)
+			break;
+		std::fill_n(db, count, *sb++);
+		db += count;
+	}
+	return db;
+}
+
+/* Encode one row the way gr_bitmap_rle_compress does, ending with a
+ * run of length 0.
+ */
+std::vector<uint8_t> encode_row(const std::vector<uint8_t> &pixels)
+{
+	std::vector<uint8_t> out;
+	for (std::size_t i = 0; i != pixels.size();)
+	{
+		const auto color = pixels[i];
+		std::size_t count = 1;
+		while (i + count != pixels.size() && pixels[i + count] == color && count < NOT_RLE_CODE)
+			++count;
+		if (count == 1 && !IS_RLE_CODE(color))
+			out.push_back(color);
+		else
+		{
+			out.push_back(RLE_CODE | count);
+			out.push_back(color);
+		}
+		i += count;
+	}
+	out.push_back(RLE_CODE);
+	return out;
+}
+
+/* A row of runs with random lengths up to `max_run`.  Colors are drawn
+ * so that some are run codes themselves and must be encoded as runs.
+ */
+std::vector<uint8_t> random_row(std::mt19937 &rng, const std::size_t width, const unsigned max_run)
+{
+	std::uniform_int_distribution<unsigned> run(1, max_run);
+	std::uniform_int_distribution<unsigned> color(0, 255);
+	std::vector<uint8_t> row;
+	while (row.size() < width)
+		row.insert(row.end(), std::min<std::size_t>(run(rng), width - row.size()), color(rng));
+	return row;
+}
+
+/* Decode `encoded` with both decoders into `width` bytes, from a copy
+ * that ends exactly at the end of its allocation.  Return what
+ * gr_rle_decode wrote, after checking that it matches the reference.
+ */
+std::vector<uint8_t> decode_both(const std::vector<uint8_t> &encoded, const std::size_t width)
+{
+	const std::unique_ptr<uint8_t[]> src{new uint8_t[encoded.size()]};
+	std::copy(encoded.begin(), encoded.end(), src.get());
+	/* One more byte than the destination bound, to check that neither
+	 * decoder writes past it.
+	 */
+	std::vector<uint8_t> expected(width + 1, 0x55), actual(width + 1, 0x55);
+	const auto src_end = src.get() + encoded.size();
+	const auto expected_end = reference_decode(src.get(), expected.data(), {src_end, expected.data() + width});
+	const auto actual_end = dcx::gr_rle_decode(src.get(), actual.data(), {src_end, actual.data() + width});
+	BOOST_TEST(actual_end - actual.data() == expected_end - expected.data());
+	BOOST_TEST(actual == expected);
+	BOOST_TEST(actual[width] == 0x55);
+	actual.pop_back();
+	return actual;
+}
+
+}
+
+BOOST_AUTO_TEST_CASE(rle_decode_long_runs)
+{
+	/* Every run length, so that the vector fill sees both of its
+	 * overlapping stores at every offset.
+	 */
+	for (unsigned length = 1; length <= NOT_RLE_CODE; ++length)
+		for (const unsigned offset : {0u, 1u, 15u, 16u, 17u})
+		{
+			std::vector<uint8_t> row(offset, 3);
+			row.insert(row.end(), length, 0xf0);
+			row.insert(row.end(), NOT_RLE_CODE, 7);
+			row.push_back(9);
+			BOOST_TEST(decode_both(encode_row(row), row.size()) == row);
+		}
+	std::mt19937 rng(15);
+	for (const std::size_t width : {16u, 64u, 320u, 1024u})
+		for (unsigned i = 0; i != 50; ++i)
+		{
+			const auto row = random_row(rng, width, NOT_RLE_CODE);
+			BOOST_TEST(decode_both(encode_row(row), width) == row);
+		}
+}
+
+BOOST_AUTO_TEST_CASE(rle_decode_literals)
+{
+	/* Long stretches without a run code are what the vector scan skips
+	 * over.
+	 */
+	std::mt19937 rng(16);
+	std::uniform_int_distribution<unsigned> literal(0, RLE_CODE - 1);
+	for (const std::size_t width : {1u, 15u, 16u, 17u, 31u, 32u, 33u, 64u, 257u})
+	{
+		std::vector<uint8_t> row(width);
+		for (auto &p : row)
+			p = literal(rng);
+		const auto encoded = encode_row(row);
+		BOOST_TEST(encoded.size() == width + 1);
+		BOOST_TEST(decode_both(encoded, width) == row);
+	}
+}
+
+BOOST_AUTO_TEST_CASE(rle_decode_row_bound)
+{
+	/* Rows that stop at the source bound: a row cut off before its end
+	 * code, in the middle of a run, or right after a run code, and rows
+	 * with more pixels than the destination holds.
+	 */
+	std::mt19937 rng(17);
+	for (unsigned i = 0; i != 200; ++i)
+	{
+		const auto row = random_row(rng, 1 + rng() % 200, 1 + rng() % NOT_RLE_CODE);
+		const auto encoded = encode_row(row);
+		for (std::size_t cut = 0; cut <= encoded.size(); cut += 1 + cut / 8)
+			decode_both(std::vector<uint8_t>(encoded.begin(), encoded.begin() + cut), row.size());
+		for (const std::size_t width : {std::size_t{0}, row.size() / 2, row.size() - 1})
+			decode_both(encoded, width);
+	}
+}
+
+BOOST_AUTO_TEST_CASE(rle_decode_bitmap_rows)
+{
+	/* Decode a whole bitmap row by row, with each row bounded by the end
+	 * of its encoded data as found from the length table.  The last row
+	 * ends at the end of the allocation.
+	 */
+	std::mt19937 rng(18);
+	constexpr std::size_t w = 64, h = 64;
+	std::vector<uint8_t> pixels;
+	std::vector<std::size_t> lengths;
+	std::vector<uint8_t> data;
+	for (std::size_t y = 0; y != h; ++y)
+	{
+		const auto row = random_row(rng, w, 1 + y % NOT_RLE_CODE);
+		pixels.insert(pixels.end(), row.begin(), row.end());
+		const auto encoded = encode_row(row);
+		lengths.push_back(encoded.size());
+		data.insert(data.end(), encoded.begin(), encoded.end());
+	}
+	const std::unique_ptr<uint8_t[]> src{new uint8_t[data.size()]};
+	std::copy(data.begin(), data.end(), src.get());
+	std::vector<uint8_t> decoded(w * h);
+	const uint8_t *sb = src.get();
+	for (std::size_t y = 0; y != h; ++y)
+	{
+		const auto db = &decoded[y * w];
+		BOOST_TEST(dcx::gr_rle_decode(sb, db, {sb + lengths[y], db + w}) == db + w);
+		sb += lengths[y];
+	}
+	BOOST_TEST(sb == src.get() + data.size());
+	BOOST_TEST(decoded == pixels);
+}
@@ -0,0 +1,71 @@
+#include "texmerge_row.h"
+#include <random>
+#include <vector>
+
+#define BOOST_TEST_DYN_LINK
+#define BOOST_TEST_MODULE Rebirth texmerge_row
+#include <boost/test/unit_test.hpp>
+
+/* Counts that cover an empty row, every remainder after a full vector,
+ * and the rows of common texture sizes.
+ */
+static constexpr std::size_t row_counts[]{0, 1, 2, 15, 16, 17, 31, 32, 33, 63, 64, 65, 128, 4096};
+
+static uint8_t reference_pixel(const uint8_t top, const uint8_t bottom, const bool super_transparent)
+{
+	if (top == 255)
+		return bottom;
+	if (super_transparent && top == 254)
+		return 255;
+	return top;
+}
+
+/* Most pixels of an overlay are transparent, supertransparent or
+ * nearby colors, so weight the random data toward those.
+ */
+static std::vector<uint8_t> random_pixels(std::mt19937 &rng, const std::size_t count)
+{
+	std::uniform_int_distribution<unsigned> pick(0, 7);
+	std::uniform_int_distribution<unsigned> color(0, 255);
+	std::vector<uint8_t> result(count);
+	for (auto &p : result)
+		switch (pick(rng))
+		{
+			case 0:
+			case 1:
+				p = 255;
+				break;
+			case 2:
+				p = 254;
+				break;
+			case 3:
+				p = 253;
+				break;
+			default:
+				p = color(rng);
+				break;
+		}
+	return result;
+}
+
+BOOST_AUTO_TEST_CASE(texmerge_row_matches_reference)
+{
+	std::mt19937 rng(1);
+	for (const bool super_transparent : {false, true})
+		for (const auto count : row_counts)
+			/* Offset the rows, so that the kernels see unaligned data. */
+			for (std::size_t offset = 0; offset != 3; ++offset)
+			{
+				const auto top = random_pixels(rng, count + offset);
+				const auto bottom = random_pixels(rng, count + offset);
+				std::vector<uint8_t> dest(count + offset, 0x5a);
+				dcx::texmerge_row(dest.data() + offset, top.data() + offset, bottom.data() + offset, count, super_transparent);
+				for (std::size_t i = 0; i != offset; ++i)
+					BOOST_TEST(dest[i] == 0x5a);
+				for (std::size_t i = offset; i != count + offset; ++i)
+				{
+					const auto expected = reference_pixel(top[i], bottom[i], super_transparent);
+					BOOST_TEST(dest[i] == expected, "count " << count << " offset " << offset << " super " << super_transparent << " pixel " << i);
+				}
+			}
+}
@@ -0,0 +1,181 @@
+#include "tmap_scanline_per.h"
+#include <algorithm>
+#include <array>
+#include <random>
+#include <vector>
+
+#define BOOST_TEST_DYN_LINK
+#define BOOST_TEST_MODULE Rebirth tmap_scanline_per
+#include <boost/test/unit_test.hpp>
+
+namespace {
+
+constexpr dcx::tmap_scanline_isa all_isas[]{
+	dcx::tmap_scanline_isa::scalar,
+	dcx::tmap_scanline_isa::sse2,
+	dcx::tmap_scanline_isa::avx2,
+};
+
+constexpr int image_width = 160;
+constexpr int image_height = 100;
+
+/* Use raw mt19937 output, which the standard fixes, rather than a
+ * distribution, whose results may differ between libraries.  The
+ * golden hash depends on it.
+ */
+struct test_bitmaps
+{
+	std::array<uint8_t, 64 * 64> texture;
+	std::array<uint8_t, 128 * 256> fade_table;
+	test_bitmaps()
+	{
+		std::mt19937 rng(17);
+		for (auto &t : texture)
+		{
+			const auto r = rng();
+			/* One texel in eight is transparent. */
+			t = (r & 0x700) ? r & 0xff : 255;
+		}
+		for (auto &f : fade_table)
+			f = rng() & 0xff;
+	}
+};
+
+const test_bitmaps bitmaps;
+
+/* A trapezoid whose left and right edges move by a fixed amount per
+ * row, with u, v, z and l stepped per row and per column.  This is the
+ * shape of the spans that the perspective mapper sends to the kernel.
+ */
+struct canned_polygon
+{
+	int top, bottom;
+	int xleft, xright;
+	int dxleft, dxright;
+	int32_t u, v, z, l;
+	int32_t du_dx, dv_dx, dz_dx, dl_dx;
+	int32_t du_dy, dv_dy, dz_dy, dl_dy;
+	bool transparent;
+};
+
+constexpr canned_polygon canned_polygons[]{
+	/* A wall seen head on. */
+	{2, 60, 3, 120, 0, 0, 0, 0, 0x10000, 0x1000, 0x200, 0x400 * 64, 0, 4, 0, 0x300 * 64, 0, 2, false},
+	/* A floor receding toward the top of the screen, getting darker. */
+	{30, 99, 70, 90, -1, 1, 0x2000, 0x10000 * 64, 0x8000, 0x1f00, 0x180, 0x80 * 64, 0x40, -3, 0x20, 0x500 * 64, 0x300, -40, false},
+	/* A steep wall, with every pixel covering many texels. */
+	{0, 99, 40, 44, 1, 1, -0x40000, 0x30000 * 64, 0x20000, 0x100, 0x7000, -0x5000 * 64, -0x120, 9, 0x9000, 0x2000 * 64, 0x80, 1, false},
+	/* A grate over the scene. */
+	{10, 80, 11, 148, 0, -1, 0x1234, 0x5678 * 64, 0x18000, 0x1000, 0x300, 0x280 * 64, 0x10, -1, 0x240, -0x310 * 64, 0x30, 5, true},
+	/* Coordinates large enough that stepping them wraps around. */
+	{50, 70, 0, 159, 0, 0, 0x7fff0000, -0x7fff0000, 0x40000, 0x4000, 0x1234567, -0x2345678, 0x10, 0x7f, -0x3456789, 0x4567891, 0x20, -0x7f, true},
+};
+
+std::vector<uint8_t> render_canned_polygons()
+{
+	std::vector<uint8_t> image(image_width * image_height);
+	for (std::size_t i = 0; i != image.size(); ++i)
+		image[i] = i * 7;
+	for (const auto &p : canned_polygons)
+		for (int y = p.top; y <= p.bottom; ++y)
+		{
+			const int row = y - p.top;
+			const int xleft = std::max(p.xleft + row * p.dxleft, 0);
+			const int xright = std::min(p.xright + row * p.dxright, image_width - 1);
+			if (xleft > xright)
+				continue;
+			const uint32_t r = row, c = xleft;
+			const dcx::tmap_per_span span{
+				&image[y * image_width + xleft],
+				bitmaps.texture.data(),
+				bitmaps.fade_table.data(),
+				static_cast<int32_t>(p.u + r * p.du_dy + c * p.du_dx),
+				static_cast<int32_t>(p.v + r * p.dv_dy + c * p.dv_dx),
+				static_cast<int32_t>(p.z + r * p.dz_dy + c * p.dz_dx),
+				static_cast<int32_t>(p.l + r * p.dl_dy + c * p.dl_dx),
+				p.du_dx, p.dv_dx, p.dz_dx, p.dl_dx,
+				static_cast<std::size_t>(xright - xleft + 1),
+				p.transparent,
+			};
+			dcx::tmap_scanline_per(span);
+		}
+	return image;
+}
+
+uint64_t fnv1a(const std::vector<uint8_t> &image)
+{
+	uint64_t h = 0xcbf29ce484222325;
+	for (const auto c : image)
+		h = (h ^ c) * 0x100000001b3;
+	return h;
+}
+
+uint8_t reference_pixel(const dcx::tmap_per_span &s, const uint32_t i, const uint8_t old)
+{
+	const int32_t u = s.u + i * s.du, v = s.v + i * s.dv, z = s.z + i * s.dz, l = s.l + i * s.dl;
+	const uint8_t c = s.texture[((v / z) & (64 * 63)) + ((u / z) & 63)];
+	if (s.transparent && c == 255)
+		return old;
+	return s.fade_table[256 * ((l >> 8) & 0x7f) + c];
+}
+
+}
+
+BOOST_AUTO_TEST_CASE(tmap_scanline_per_matches_reference)
+{
+	for (const auto isa : all_isas)
+	{
+		if (!dcx::tmap_scanline_set_isa(isa))
+			continue;
+		/* Cover an empty span, and every remainder after a full block of
+		 * 8 or 16 pixels, at every alignment of the destination.
+		 */
+		for (std::size_t count = 0; count != 40; ++count)
+			for (std::size_t offset = 0; offset != 4; ++offset)
+				for (const bool transparent : {false, true})
+				{
+					std::array<uint8_t, 48> dest;
+					for (std::size_t i = 0; i != dest.size(); ++i)
+						dest[i] = 0x5a + i;
+					const auto before = dest;
+					const dcx::tmap_per_span span{
+						dest.data() + offset,
+						bitmaps.texture.data(),
+						bitmaps.fade_table.data(),
+						0x3456 + static_cast<int32_t>(count) * 0x1000, 0x789a * 64, 0x14000, 0x2340,
+						0x1357, -0x9ab * 64, 0x321, -0x1c,
+						count,
+						transparent,
+					};
+					dcx::tmap_scanline_per(span);
+					for (std::size_t i = 0; i != dest.size(); ++i)
+					{
+						const auto expected = (i < offset || i >= offset + count)
+							? before[i]
+							: reference_pixel(span, i - offset, before[i]);
+						BOOST_TEST(dest[i] == expected, "isa " << static_cast<unsigned>(isa) << " count " << count << " offset " << offset << " transparent " << transparent << " pixel " << i);
+					}
+				}
+	}
+	dcx::tmap_scanline_set_isa(dcx::tmap_scanline_best_isa());
+}
+
+BOOST_AUTO_TEST_CASE(tmap_scanline_per_golden_image)
+{
+	BOOST_REQUIRE(dcx::tmap_scanline_set_isa(dcx::tmap_scanline_isa::scalar));
+	const auto golden = render_canned_polygons();
+	/* If the scalar kernel changes what it draws, this must change too.
+	 * Nothing else should change it.
+	 */
+	BOOST_TEST(fnv1a(golden) == UINT64_C(0x8569fd33f1cce0e3));
+	for (const auto isa : all_isas)
+	{
+		if (!dcx::tmap_scanline_set_isa(isa))
+			continue;
+		BOOST_TEST((dcx::tmap_scanline_get_isa() == isa));
+		const auto image = render_canned_polygons();
+		for (std::size_t i = 0; i != image.size(); ++i)
+			BOOST_TEST(image[i] == golden[i], "isa " << static_cast<unsigned>(isa) << " x " << (i % image_width) << " y " << (i / image_width));
+	}
+	dcx::tmap_scanline_set_isa(dcx::tmap_scanline_best_isa());
+}
@@ -0,0 +1,137 @@
+#include "udp_batch.h"
+#include <chrono>
+#include <netinet/in.h>
+#include <unistd.h>
+#include <vector>
+
+#define BOOST_TEST_DYN_LINK
+#define BOOST_TEST_MODULE Rebirth udp_batch benchmark
+#include <boost/test/unit_test.hpp>
+
+/* Time one host relaying a frame of game traffic to several peers over
+ * loopback: once with a `sendto` per message and a `recvfrom` per
+ * datagram, as net_udp used to, and once with a bundle per peer sent
+ * and drained in batches.  Run with `--log_level=message` to see the
+ * timings.
+ */
+
+static constexpr unsigned bench_peers = 7;
+/* Each peer gets the position of every other player, and one buffer
+ * of game events.
+ */
+static constexpr unsigned bench_pdata_per_peer = bench_peers;
+static constexpr std::size_t bench_pdata_size = 49;
+static constexpr std::size_t bench_mdata_size = 120;
+static constexpr unsigned bench_frames = 2000;
+static constexpr std::size_t bench_datagram_size = 1024;
+
+namespace {
+
+struct loopback_socket
+{
+	int fd;
+	sockaddr_in addr{};
+	loopback_socket() :
+		fd(socket(AF_INET, SOCK_DGRAM, 0))
+	{
+		/* Room for a whole frame of unbundled messages. */
+		const int size = 1 << 20;
+		setsockopt(fd, SOL_SOCKET, SO_RCVBUF, &size, sizeof(size));
+		addr.sin_family = AF_INET;
+		addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+		bind(fd, reinterpret_cast<const sockaddr *>(&addr), sizeof(addr));
+		socklen_t len = sizeof(addr);
+		getsockname(fd, reinterpret_cast<sockaddr *>(&addr), &len);
+	}
+	~loopback_socket()
+	{
+		close(fd);
+	}
+};
+
+struct bench_network
+{
+	loopback_socket host;
+	std::array<loopback_socket, bench_peers> peers;
+	std::array<uint8_t, bench_pdata_size> pdata{};
+	std::array<uint8_t, bench_mdata_size> mdata{};
+};
+
+/* Run `frame` for every benchmark frame, and return how long it took. */
+template <typename F>
+std::chrono::nanoseconds bench_frames_with(F &&frame)
+{
+	const auto start = std::chrono::steady_clock::now();
+	for (unsigned i = 0; i != bench_frames; ++i)
+		frame();
+	return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start);
+}
+
+double bench_us_per_frame(const std::chrono::nanoseconds t)
+{
+	return static_cast<double>(t.count()) / 1000 / bench_frames;
+}
+
+}
+
+BOOST_AUTO_TEST_CASE(udp_batch_benchmark)
+{
+	bench_network net;
+	for (auto &p : net.peers)
+		BOOST_TEST_REQUIRE(p.fd >= 0);
+	std::size_t unbatched_datagrams = 0, batched_datagrams = 0;
+	std::array<uint8_t, bench_datagram_size> buffer;
+
+	const auto unbatched = bench_frames_with([&]() {
+		for (auto &p : net.peers)
+		{
+			const auto to = reinterpret_cast<const sockaddr *>(&p.addr);
+			for (unsigned i = 0; i != bench_pdata_per_peer; ++i)
+				sendto(net.host.fd, net.pdata.data(), net.pdata.size(), 0, to, sizeof(p.addr));
+			sendto(net.host.fd, net.mdata.data(), net.mdata.size(), 0, to, sizeof(p.addr));
+		}
+		for (auto &p : net.peers)
+		{
+			sockaddr_in from;
+			socklen_t fromlen = sizeof(from);
+			while (recvfrom(p.fd, buffer.data(), buffer.size(), MSG_DONTWAIT, reinterpret_cast<sockaddr *>(&from), &fromlen) > 0)
+				++unbatched_datagrams;
+		}
+	});
+
+	std::array<dcx::udp_bundle<0xff, bench_datagram_size>, bench_peers> bundles;
+	std::array<std::array<uint8_t, bench_datagram_size>, 8> buffers;
+	std::array<sockaddr_in, 8> addrs;
+	std::array<dcx::udp_receive_item, 8> items;
+	const auto batched = bench_frames_with([&]() {
+		std::array<dcx::udp_send_item, bench_peers> send_items;
+		for (unsigned p = 0; p != bench_peers; ++p)
+		{
+			auto &b = bundles[p];
+			b.clear();
+			for (unsigned i = 0; i != bench_pdata_per_peer; ++i)
+				(void)b.append(net.pdata);
+			(void)b.append(net.mdata);
+			send_items[p] = {b.datagram(), reinterpret_cast<const sockaddr *>(&net.peers[p].addr), sizeof(net.peers[p].addr)};
+		}
+		dcx::udp_send_batch(net.host.fd, send_items);
+		for (auto &p : net.peers)
+		{
+			for (;;)
+			{
+				for (std::size_t i = 0; i != items.size(); ++i)
+					items[i] = {buffers[i], reinterpret_cast<sockaddr *>(&addrs[i]), sizeof(addrs[i]), 0};
+				const auto n = dcx::udp_receive_batch(p.fd, items);
+				batched_datagrams += n;
+				if (n != items.size())
+					break;
+			}
+		}
+	});
+
+	BOOST_TEST(unbatched_datagrams == std::size_t{bench_frames} * bench_peers * (bench_pdata_per_peer + 1));
+	BOOST_TEST(batched_datagrams == std::size_t{bench_frames} * bench_peers);
+	BOOST_TEST_MESSAGE(bench_peers << " peers, " << bench_pdata_per_peer + 1 << " messages per peer per frame");
+	BOOST_TEST_MESSAGE("datagram per message: " << bench_us_per_frame(unbatched) << " us/frame");
+	BOOST_TEST_MESSAGE("bundled and batched: " << bench_us_per_frame(batched) << " us/frame");
+}
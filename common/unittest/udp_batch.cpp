@@ -0,0 +1,179 @@
+#include "udp_batch.h"
+#include <netinet/in.h>
+#include <unistd.h>
+#include <vector>
+
+#define BOOST_TEST_DYN_LINK
+#define BOOST_TEST_MODULE Rebirth udp_batch
+#include <boost/test/unit_test.hpp>
+
+namespace {
+
+constexpr uint8_t test_opcode = 0xb0;
+using test_bundle = dcx::udp_bundle<test_opcode, 32>;
+
+std::vector<std::vector<uint8_t>> split(std::span<const uint8_t> datagram, bool &ok)
+{
+	std::vector<uint8_t> copy(datagram.begin(), datagram.end());
+	std::vector<std::vector<uint8_t>> result;
+	ok = dcx::udp_bundle_for_each(copy, [&result](const std::span<uint8_t> m) {
+		result.emplace_back(m.begin(), m.end());
+	});
+	return result;
+}
+
+/* A socket bound to an ephemeral port on the loopback address. */
+struct loopback_socket
+{
+	int fd;
+	sockaddr_in addr{};
+	loopback_socket() :
+		fd(socket(AF_INET, SOCK_DGRAM, 0))
+	{
+		addr.sin_family = AF_INET;
+		addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+		bind(fd, reinterpret_cast<const sockaddr *>(&addr), sizeof(addr));
+		socklen_t len = sizeof(addr);
+		getsockname(fd, reinterpret_cast<sockaddr *>(&addr), &len);
+	}
+	~loopback_socket()
+	{
+		close(fd);
+	}
+};
+
+}
+
+BOOST_AUTO_TEST_CASE(udp_bundle_single_message_is_unwrapped)
+{
+	test_bundle b;
+	BOOST_TEST(b.empty());
+	const uint8_t m[]{7, 8, 9};
+	BOOST_TEST(b.append(m));
+	BOOST_TEST(!b.empty());
+	const auto d = b.datagram();
+	BOOST_TEST(std::vector<uint8_t>(d.begin(), d.end()) == std::vector<uint8_t>(std::begin(m), std::end(m)));
+}
+
+BOOST_AUTO_TEST_CASE(udp_bundle_round_trip)
+{
+	test_bundle b;
+	const std::vector<uint8_t> m0{1}, m1{2, 3, 4}, m2(10, 5);
+	BOOST_TEST(b.append(m0));
+	BOOST_TEST(b.append(m1));
+	BOOST_TEST(b.append(m2));
+	const auto d = b.datagram();
+	BOOST_TEST(d.size() == 1u + 3 * 2 + 1 + 3 + 10);
+	BOOST_TEST(d[0] == test_opcode);
+	bool ok;
+	const auto messages = split(d, ok);
+	BOOST_TEST(ok);
+	BOOST_TEST_REQUIRE(messages.size() == 3u);
+	BOOST_TEST(messages[0] == m0);
+	BOOST_TEST(messages[1] == m1);
+	BOOST_TEST(messages[2] == m2);
+	b.clear();
+	BOOST_TEST(b.empty());
+	BOOST_TEST(b.append(m1));
+	BOOST_TEST(b.datagram().size() == m1.size());
+}
+
+/* For a peer that does not take bundles, the same messages come out one
+ * at a time, in order.
+ */
+BOOST_AUTO_TEST_CASE(udp_bundle_for_each_message)
+{
+	test_bundle b;
+	const std::vector<uint8_t> m0{1}, m1{2, 3, 4}, m2(10, 5);
+	std::vector<std::vector<uint8_t>> messages;
+	const auto collect = [&messages](const std::span<const uint8_t> m) {
+		messages.emplace_back(m.begin(), m.end());
+	};
+	b.for_each_message(collect);
+	BOOST_TEST(messages.empty());
+	BOOST_TEST(b.append(m0));
+	b.for_each_message(collect);
+	BOOST_TEST_REQUIRE(messages.size() == 1u);
+	BOOST_TEST(messages[0] == m0);
+	messages.clear();
+	BOOST_TEST(b.append(m1));
+	BOOST_TEST(b.append(m2));
+	b.for_each_message(collect);
+	BOOST_TEST_REQUIRE(messages.size() == 3u);
+	BOOST_TEST(messages[0] == m0);
+	BOOST_TEST(messages[1] == m1);
+	BOOST_TEST(messages[2] == m2);
+}
+
+BOOST_AUTO_TEST_CASE(udp_bundle_respects_capacity)
+{
+	test_bundle b;
+	/* 1 + 2 + 29 fills the bundle exactly. */
+	BOOST_TEST(!b.append(std::vector<uint8_t>(30, 1)));
+	BOOST_TEST(b.empty());
+	BOOST_TEST(b.append(std::vector<uint8_t>(20, 1)));
+	BOOST_TEST(!b.append(std::vector<uint8_t>(8, 2)));
+	BOOST_TEST(b.append(std::vector<uint8_t>(7, 2)));
+	BOOST_TEST(b.datagram().size() == 32u);
+	BOOST_TEST(!b.append(std::vector<uint8_t>(1, 3)));
+	/* Empty messages are never bundled. */
+	BOOST_TEST(!test_bundle().append({}));
+}
+
+BOOST_AUTO_TEST_CASE(udp_bundle_rejects_bad_lengths)
+{
+	bool ok;
+	/* The second length runs past the end. */
+	const uint8_t overrun[]{test_opcode, 1, 0, 9, 4, 0, 1, 2};
+	const auto m = split(overrun, ok);
+	BOOST_TEST(!ok);
+	BOOST_TEST(m.size() == 1u);
+	const uint8_t zero[]{test_opcode, 0, 0, 1};
+	BOOST_TEST(split(zero, ok).empty());
+	BOOST_TEST(!ok);
+	const uint8_t truncated[]{test_opcode, 1, 0, 9, 1};
+	BOOST_TEST(split(truncated, ok).size() == 1u);
+	BOOST_TEST(!ok);
+	const uint8_t opcode_only[]{test_opcode};
+	BOOST_TEST(split(opcode_only, ok).empty());
+	BOOST_TEST(ok);
+}
+
+BOOST_AUTO_TEST_CASE(udp_batch_loopback)
+{
+	loopback_socket sender, receiver;
+	BOOST_TEST_REQUIRE(sender.fd >= 0);
+	BOOST_TEST_REQUIRE(receiver.fd >= 0);
+	std::array<uint8_t, 40> received_buffers[50];
+	sockaddr_in received_addrs[50];
+	dcx::udp_receive_item items[50];
+	const auto reset_items = [&]() {
+		for (std::size_t i = 0; i != std::size(items); ++i)
+			items[i] = {received_buffers[i], reinterpret_cast<sockaddr *>(&received_addrs[i]), sizeof(received_addrs[i]), 0};
+	};
+	reset_items();
+	/* Nothing is waiting, so this must return at once. */
+	BOOST_TEST(dcx::udp_receive_batch(receiver.fd, items) == 0u);
+
+	/* More than one kernel batch, of different sizes. */
+	std::vector<std::vector<uint8_t>> sent(45);
+	std::vector<dcx::udp_send_item> send_items;
+	std::size_t total = 0;
+	for (std::size_t i = 0; i != sent.size(); ++i)
+	{
+		sent[i].assign(1 + i % 30, static_cast<uint8_t>(i));
+		total += sent[i].size();
+		send_items.push_back({sent[i], reinterpret_cast<const sockaddr *>(&receiver.addr), sizeof(receiver.addr)});
+	}
+	BOOST_TEST(dcx::udp_send_batch(sender.fd, send_items) == total);
+
+	const auto n = dcx::udp_receive_batch(receiver.fd, items);
+	BOOST_TEST_REQUIRE(n == sent.size());
+	for (std::size_t i = 0; i != n; ++i)
+	{
+		BOOST_TEST(std::vector<uint8_t>(received_buffers[i].begin(), received_buffers[i].begin() + items[i].size) == sent[i], "datagram " << i);
+		BOOST_TEST(received_addrs[i].sin_port == sender.addr.sin_port);
+	}
+	reset_items();
+	BOOST_TEST(dcx::udp_receive_batch(receiver.fd, items) == 0u);
+}
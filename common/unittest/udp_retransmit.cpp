@@ -0,0 +1,330 @@
+#include "udp_retransmit.h"
+#include "udp_batch.h"
+#include <algorithm>
+#include <cstring>
+#include <netinet/in.h>
+#include <random>
+#include <unistd.h>
+#include <vector>
+
+#define BOOST_TEST_DYN_LINK
+#define BOOST_TEST_MODULE Rebirth udp_retransmit
+#include <boost/test/unit_test.hpp>
+
+namespace {
+
+using test_queue = dcx::udp_retransmit_queue<int, 3, 8>;
+constexpr auto none = test_queue::none;
+
+std::vector<int> resend_all(test_queue &q, const std::size_t peer, const int64_t now, const int64_t interval)
+{
+	std::vector<int> r;
+	q.resend_due(peer, now, interval, [&](const test_queue::slot_index s) {
+		r.emplace_back(q.payload(s));
+		return true;
+	});
+	return r;
+}
+
+/* A socket bound to an ephemeral port on the loopback address. */
+struct loopback_socket
+{
+	int fd;
+	sockaddr_in addr{};
+	loopback_socket() :
+		fd(socket(AF_INET, SOCK_DGRAM, 0))
+	{
+		const int size = 1 << 20;
+		setsockopt(fd, SOL_SOCKET, SO_RCVBUF, &size, sizeof(size));
+		addr.sin_family = AF_INET;
+		addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+		bind(fd, reinterpret_cast<const sockaddr *>(&addr), sizeof(addr));
+		socklen_t len = sizeof(addr);
+		getsockname(fd, reinterpret_cast<sockaddr *>(&addr), &len);
+	}
+	~loopback_socket()
+	{
+		close(fd);
+	}
+};
+
+}
+
+BOOST_AUTO_TEST_CASE(udp_retransmit_find_by_pkt_num)
+{
+	test_queue q;
+	const auto a = q.add(0, 10);
+	const auto b = q.add(0, 11);
+	q.expect_ack(a, 0, 1, 5);
+	q.expect_ack(a, 2, 7, 5);
+	q.expect_ack(b, 0, 2, 5);
+	BOOST_TEST(q.size() == 2u);
+	BOOST_TEST(q.find(0, 1) == a);
+	BOOST_TEST(q.find(0, 2) == b);
+	BOOST_TEST(q.find(2, 7) == a);
+	BOOST_TEST(q.find(1, 1) == none);
+	/* Same table entry, different packet. */
+	BOOST_TEST(q.find(0, 9) == none);
+	q.acknowledge(a, 0);
+	BOOST_TEST(q.find(0, 1) == none);
+	BOOST_TEST(q.pending(a) == test_queue::peer_mask(0b100));
+	/* A second acknowledgement changes nothing. */
+	q.acknowledge(a, 0);
+	BOOST_TEST(q.find(2, 7) == a);
+}
+
+BOOST_AUTO_TEST_CASE(udp_retransmit_resend_order)
+{
+	test_queue q;
+	for (int i = 0; i != 4; ++i)
+		q.expect_ack(q.add(i, i), 1, i + 1, i + 10);
+	BOOST_TEST(resend_all(q, 1, 9, 10).empty());
+	/* Once the first is due, everything not acknowledged goes with it. */
+	BOOST_TEST(resend_all(q, 1, 10, 10) == (std::vector<int>{0, 1, 2, 3}));
+	BOOST_TEST(resend_all(q, 1, 19, 10).empty());
+	q.acknowledge(q.find(1, 3), 1);
+	BOOST_TEST(resend_all(q, 1, 20, 10) == (std::vector<int>{0, 1, 3}));
+	/* Stopping early leaves the rest due, ahead of those resent. */
+	std::vector<int> r;
+	q.resend_due(1, 30, 10, [&](const test_queue::slot_index s) {
+		if (r.size() == 1)
+			return false;
+		r.emplace_back(q.payload(s));
+		return true;
+	});
+	BOOST_TEST(r == (std::vector<int>{0}));
+	BOOST_TEST(resend_all(q, 1, 30, 10) == (std::vector<int>{1, 3, 0}));
+	/* A new message due at the same time as older ones goes after them. */
+	q.expect_ack(q.add(31, 4), 1, 5, 40);
+	BOOST_TEST(resend_all(q, 1, 40, 10) == (std::vector<int>{0, 1, 3, 4}));
+	BOOST_TEST(resend_all(q, 0, 40, 10).empty());
+}
+
+BOOST_AUTO_TEST_CASE(udp_retransmit_acknowledge_all)
+{
+	test_queue q;
+	const auto a = q.add(0, 1);
+	q.expect_ack(a, 0, 1, 0);
+	q.expect_ack(a, 1, 1, 0);
+	q.expect_ack(q.add(0, 2), 1, 2, 0);
+	q.acknowledge_all(1);
+	BOOST_TEST(q.find(1, 1) == none);
+	BOOST_TEST(q.find(1, 2) == none);
+	BOOST_TEST(q.find(0, 1) == a);
+	BOOST_TEST(resend_all(q, 1, 100, 10).empty());
+	BOOST_TEST(resend_all(q, 0, 100, 10) == (std::vector<int>{1}));
+}
+
+BOOST_AUTO_TEST_CASE(udp_retransmit_remove_finished)
+{
+	test_queue q;
+	const auto a = q.add(0, 1);
+	const auto b = q.add(5, 2);
+	const auto c = q.add(6, 3);
+	q.expect_ack(a, 0, 1, 0);
+	q.expect_ack(c, 0, 2, 0);
+	std::vector<int> removed;
+	const auto collect = [&](const test_queue::slot_index s) {
+		removed.emplace_back(q.pending(s).any() ? -q.payload(s) : q.payload(s));
+	};
+	/* b is acknowledged by all, but a is older and still waiting. */
+	BOOST_TEST(q.pending(b).none());
+	q.remove_finished(9, 10, collect);
+	BOOST_TEST(removed.empty());
+	BOOST_TEST(q.size() == 3u);
+	q.remove_finished(10, 10, collect);
+	BOOST_TEST(removed == (std::vector<int>{-1, 2}));
+	BOOST_TEST(q.oldest() == c);
+	q.acknowledge(q.find(0, 2), 0);
+	q.remove_finished(10, 10, collect);
+	BOOST_TEST(removed == (std::vector<int>{-1, 2, 3}));
+	BOOST_TEST(q.oldest() == none);
+	/* The removed message no longer answers to its packet number. */
+	BOOST_TEST(q.find(0, 1) == none);
+	BOOST_TEST(resend_all(q, 0, 100, 10).empty());
+}
+
+BOOST_AUTO_TEST_CASE(udp_retransmit_ring_wraps)
+{
+	test_queue q;
+	uint32_t pkt_num = 1;
+	/* Go around the ring several times, with packet numbers that wrap at
+	 * a multiple of the capacity.
+	 */
+	for (int i = 0; i != 50; ++i)
+	{
+		if (q.full())
+		{
+			const auto s = q.oldest();
+			BOOST_TEST(q.find(2, q.pkt_num(s, 2)) == s);
+			q.pop_oldest();
+		}
+		q.expect_ack(q.add(i, i), 2, pkt_num, i);
+		if (++pkt_num > 16)
+			pkt_num = 1;
+	}
+	BOOST_TEST(q.size() == 8u);
+	BOOST_TEST(q.payload(q.oldest()) == 42);
+	BOOST_TEST(resend_all(q, 2, 100, 10) == (std::vector<int>{42, 43, 44, 45, 46, 47, 48, 49}));
+}
+
+/* A host sends a stream of messages to several peers over loopback.
+ * Messages and acknowledgements are dropped at random.  Each tick, the
+ * host sends every peer one datagram, holding that tick's new messages
+ * and any resends that are due.  Run with `--log_level=message` to see
+ * the resend volume and the delivery latency.
+ */
+BOOST_AUTO_TEST_CASE(udp_retransmit_lossy_loopback)
+{
+	constexpr std::size_t peers = 7;
+	constexpr std::size_t capacity = 1024;
+	/* One reliable message every few ticks, as kills and door openings
+	 * arrive in a busy game.
+	 */
+	constexpr unsigned ticks = 1800, message_interval = 3;
+	constexpr int64_t resend_interval = 8, timeout = 150;
+	constexpr unsigned loss_percent = 10;
+	constexpr uint8_t bundle_opcode = 0xb0, data_opcode = 1, ack_opcode = 2;
+	constexpr std::size_t message_size = 60, datagram_size = 1024;
+	using queue_type = dcx::udp_retransmit_queue<uint32_t, peers, capacity>;
+
+	static queue_type q;
+	q.clear();
+	loopback_socket host;
+	std::array<loopback_socket, peers> peer_sockets;
+	BOOST_TEST_REQUIRE(host.fd >= 0);
+	for (auto &p : peer_sockets)
+		BOOST_TEST_REQUIRE(p.fd >= 0);
+
+	std::minstd_rand rng(1);
+	const auto lost = [&rng]() {
+		return rng() % 100 < loss_percent;
+	};
+	std::array<uint32_t, peers> next_pkt_num, expected_pkt_num;
+	next_pkt_num.fill(1);
+	expected_pkt_num.fill(1);
+	std::array<dcx::udp_bundle<bundle_opcode, datagram_size>, peers> bundles, ack_bundles;
+	std::array<uint8_t, datagram_size> buffer;
+	unsigned sent_messages = 0, resent_messages = 0, host_datagrams = 0, acked = 0, timed_out = 0;
+	int64_t total_latency = 0, max_latency = 0;
+	uint32_t next_id = 0;
+
+	const auto make_message = [](const uint32_t pkt_num) {
+		std::array<uint8_t, message_size> m{};
+		m[0] = data_opcode;
+		std::memcpy(&m[1], &pkt_num, sizeof(pkt_num));
+		return m;
+	};
+	const auto receive = [&buffer](const int fd, auto &&f) {
+		sockaddr_in from;
+		for (;;)
+		{
+			dcx::udp_receive_item item{buffer, reinterpret_cast<sockaddr *>(&from), sizeof(from), 0};
+			if (!dcx::udp_receive_batch(fd, std::span(&item, 1)))
+				break;
+			const auto d = std::span(buffer).first(item.size);
+			if (d[0] == bundle_opcode)
+				dcx::udp_bundle_for_each(d, f);
+			else
+				f(d);
+		}
+	};
+
+	for (int64_t now = 0; now < ticks || q.size(); ++now)
+	{
+		BOOST_TEST_REQUIRE(now < ticks + 10 * timeout);
+		for (auto &b : bundles)
+			b.clear();
+		/* Resends go first, so that a peer gets older packets before
+		 * newer ones.  As in net_udp, they may fill only half of the
+		 * datagram.
+		 */
+		for (std::size_t p = 0; p != peers; ++p)
+		{
+			std::size_t resent_size = 0;
+			q.resend_due(p, now, resend_interval, [&](const queue_type::slot_index s) {
+				if (resent_size >= datagram_size / 2)
+					return false;
+				resent_size += message_size;
+				++resent_messages;
+				if (!lost())
+					BOOST_TEST_REQUIRE(bundles[p].append(make_message(q.pkt_num(s, p))));
+				return true;
+			});
+		}
+		/* New messages go out once, and may be lost on the way. */
+		if (now < ticks && !(now % message_interval))
+		{
+			BOOST_TEST_REQUIRE(!q.full());
+			const auto s = q.add(now, next_id++);
+			for (std::size_t p = 0; p != peers; ++p)
+			{
+				const auto pkt_num = next_pkt_num[p]++;
+				q.expect_ack(s, p, pkt_num, now + resend_interval);
+				++sent_messages;
+				if (!lost())
+					BOOST_TEST_REQUIRE(bundles[p].append(make_message(pkt_num)));
+			}
+		}
+		std::array<dcx::udp_send_item, peers> items;
+		std::size_t n = 0;
+		for (std::size_t p = 0; p != peers; ++p)
+			if (!bundles[p].empty())
+				items[n++] = {bundles[p].datagram(), reinterpret_cast<const sockaddr *>(&peer_sockets[p].addr), sizeof(peer_sockets[p].addr)};
+		host_datagrams += n;
+		dcx::udp_send_batch(host.fd, std::span(items).first(n));
+
+		/* Peers accept only the next packet in order, and acknowledge
+		 * everything they have, as net_udp does.
+		 */
+		for (std::size_t p = 0; p != peers; ++p)
+		{
+			auto &acks = ack_bundles[p];
+			acks.clear();
+			receive(peer_sockets[p].fd, [&](const std::span<uint8_t> m) {
+				uint32_t pkt_num;
+				std::memcpy(&pkt_num, &m[1], sizeof(pkt_num));
+				if (pkt_num > expected_pkt_num[p])
+					return;
+				if (pkt_num == expected_pkt_num[p])
+					++expected_pkt_num[p];
+				if (lost())
+					return;
+				std::array<uint8_t, 6> ack{ack_opcode, static_cast<uint8_t>(p)};
+				std::memcpy(&ack[2], &pkt_num, sizeof(pkt_num));
+				(void)acks.append(ack);
+			});
+			if (!acks.empty())
+				sendto(peer_sockets[p].fd, acks.datagram().data(), acks.datagram().size(), 0, reinterpret_cast<const sockaddr *>(&host.addr), sizeof(host.addr));
+		}
+
+		receive(host.fd, [&](const std::span<uint8_t> m) {
+			uint32_t pkt_num;
+			std::memcpy(&pkt_num, &m[2], sizeof(pkt_num));
+			const std::size_t p = m[1];
+			if (const auto s = q.find(p, pkt_num); s != queue_type::none)
+			{
+				const auto latency = now - q.added(s);
+				total_latency += latency;
+				max_latency = std::max(max_latency, latency);
+				++acked;
+				q.acknowledge(s, p);
+			}
+		});
+		q.remove_finished(now, timeout, [&](const queue_type::slot_index s) {
+			if (q.pending(s).any())
+				++timed_out;
+		});
+	}
+
+	BOOST_TEST(timed_out == 0u);
+	BOOST_TEST(acked == sent_messages);
+	for (std::size_t p = 0; p != peers; ++p)
+		BOOST_TEST(expected_pkt_num[p] == next_pkt_num[p]);
+	/* At most one datagram per peer per tick. */
+	BOOST_TEST(host_datagrams <= (ticks + 10 * timeout) * peers);
+	BOOST_TEST_MESSAGE(peers << " peers, " << loss_percent << "% loss each way, " << sent_messages << " messages");
+	BOOST_TEST_MESSAGE("resent messages: " << resent_messages << " (" << 100. * resent_messages / sent_messages << "% of sent)");
+	BOOST_TEST_MESSAGE("host datagrams: " << host_datagrams << ", against " << host_datagrams + resent_messages << " with one datagram per resend");
+	BOOST_TEST_MESSAGE("ticks from send to acknowledgement: mean " << static_cast<double>(total_latency) / acked << ", max " << max_latency);
+}
@@ -0,0 +1,108 @@
+#include "vecmat.h"
+#include <chrono>
+#include <random>
+#include <vector>
+
+#define BOOST_TEST_DYN_LINK
+#define BOOST_TEST_MODULE Rebirth vecmat benchmark
+#include <boost/test/unit_test.hpp>
+
+/* Time the batch vector functions against a loop over the single forms.
+ * Run with `--log_level=message` to see the timings.  The results are
+ * also compared, so that a kernel cannot look fast by doing the wrong
+ * work.
+ */
+
+/* Roughly the number of vertices in a large level. */
+static constexpr std::size_t bench_points = 4096;
+static constexpr unsigned bench_passes = 2000;
+
+static constexpr dcx::vm_vec_batch_isa bench_isas[]{
+	dcx::vm_vec_batch_isa::scalar,
+	dcx::vm_vec_batch_isa::sse4_1,
+	dcx::vm_vec_batch_isa::avx2,
+	dcx::vm_vec_batch_isa::neon,
+};
+
+static const char *bench_isa_name(const dcx::vm_vec_batch_isa isa)
+{
+	switch (isa)
+	{
+		case dcx::vm_vec_batch_isa::scalar:
+			return "scalar";
+		case dcx::vm_vec_batch_isa::sse4_1:
+			return "sse4.1";
+		case dcx::vm_vec_batch_isa::avx2:
+			return "avx2";
+		case dcx::vm_vec_batch_isa::neon:
+			return "neon";
+	}
+	return "unknown";
+}
+
+template <typename F>
+static std::chrono::nanoseconds bench_time(F &&f)
+{
+	const auto start = std::chrono::steady_clock::now();
+	for (unsigned pass = 0; pass != bench_passes; ++pass)
+		f();
+	return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start);
+}
+
+static void bench_report(const char *const name, const char *const isa, const std::chrono::nanoseconds loop, const std::chrono::nanoseconds batch)
+{
+	const auto per_point = [](const std::chrono::nanoseconds t) {
+		return static_cast<double>(t.count()) / (bench_points * bench_passes);
+	};
+	BOOST_TEST_MESSAGE(name << " " << isa << ": loop " << per_point(loop) << " ns/point, batch " << per_point(batch) << " ns/point, speedup " << (static_cast<double>(loop.count()) / batch.count()));
+}
+
+BOOST_AUTO_TEST_CASE(vecmat_batch_benchmark)
+{
+	std::mt19937 rng(1);
+	std::uniform_int_distribution<dcx::fix> coordinate(-(1 << 29), 1 << 29);
+	std::vector<dcx::vms_vector> src(bench_points);
+	for (auto &v : src)
+		v = {coordinate(rng), coordinate(rng), coordinate(rng)};
+	const dcx::vms_matrix m{
+		.rvec = {coordinate(rng) >> 13, coordinate(rng) >> 13, coordinate(rng) >> 13},
+		.uvec = {coordinate(rng) >> 13, coordinate(rng) >> 13, coordinate(rng) >> 13},
+		.fvec = {coordinate(rng) >> 13, coordinate(rng) >> 13, coordinate(rng) >> 13},
+	};
+	const dcx::vms_vector point{coordinate(rng), coordinate(rng), coordinate(rng)};
+
+	std::vector<dcx::vms_vector> rotated_loop(bench_points), rotated_batch(bench_points);
+	std::vector<dcx::fix> dots_loop(bench_points), dots_batch(bench_points);
+	std::vector<dcx::vm_distance_squared> dist2_loop(bench_points), dist2_batch(bench_points);
+	const auto rotate_loop = bench_time([&]{
+		for (std::size_t i = 0; i != bench_points; ++i)
+			dcx::vm_vec_rotate(rotated_loop[i], src[i], m);
+	});
+	const auto dot_loop = bench_time([&]{
+		for (std::size_t i = 0; i != bench_points; ++i)
+			dots_loop[i] = dcx::vm_vec_dot(src[i], point);
+	});
+	const auto dist2_loop_time = bench_time([&]{
+		for (std::size_t i = 0; i != bench_points; ++i)
+			dist2_loop[i] = dcx::vm_vec_dist2(src[i], point);
+	});
+	for (const auto isa : bench_isas)
+	{
+		if (!dcx::vm_vec_batch_set_isa(isa))
+			continue;
+		const auto name = bench_isa_name(isa);
+		bench_report("rotate", name, rotate_loop, bench_time([&]{
+			dcx::vm_vec_rotate_n(rotated_batch, src, m);
+		}));
+		bench_report("dot", name, dot_loop, bench_time([&]{
+			dcx::vm_vec_dot_n(dots_batch, src, point);
+		}));
+		bench_report("dist2", name, dist2_loop_time, bench_time([&]{
+			dcx::vm_vec_dist2_n(dist2_batch, src, point);
+		}));
+		BOOST_TEST((rotated_batch == rotated_loop));
+		BOOST_TEST((dots_batch == dots_loop));
+		BOOST_TEST((dist2_batch == dist2_loop));
+	}
+	dcx::vm_vec_batch_set_isa(dcx::vm_vec_batch_best_isa());
+}
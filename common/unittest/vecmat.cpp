@@ -0,0 +1,144 @@
+#include "vecmat.h"
+#include <limits>
+#include <random>
+#include <vector>
+
+#define BOOST_TEST_DYN_LINK
+#define BOOST_TEST_MODULE Rebirth vecmat
+#include <boost/test/unit_test.hpp>
+
+static constexpr dcx::vm_vec_batch_isa all_isas[]{
+	dcx::vm_vec_batch_isa::scalar,
+	dcx::vm_vec_batch_isa::sse4_1,
+	dcx::vm_vec_batch_isa::avx2,
+	dcx::vm_vec_batch_isa::neon,
+};
+
+/* Counts that cover an empty batch, every remainder after the widest
+ * kernel, and a batch long enough to use many full iterations.
+ */
+static constexpr std::size_t batch_counts[]{0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 15, 16, 17, 1000};
+
+/* Coordinates are kept within 2^29, so that the differences in
+ * vm_vec_dist2 cannot overflow a fix.  Matrix entries use the full
+ * range, since the sum of three products of a 2^29 coordinate and a
+ * 2^31 entry still fits in 64 bits.
+ */
+static std::vector<dcx::vms_vector> random_vectors(std::mt19937 &rng, const std::size_t count)
+{
+	std::uniform_int_distribution<dcx::fix> coordinate(-(1 << 29), 1 << 29);
+	std::vector<dcx::vms_vector> result(count);
+	for (auto &v : result)
+		v = {coordinate(rng), coordinate(rng), coordinate(rng)};
+	return result;
+}
+
+static dcx::vms_matrix random_matrix(std::mt19937 &rng)
+{
+	std::uniform_int_distribution<dcx::fix> entry(std::numeric_limits<dcx::fix>::min(), std::numeric_limits<dcx::fix>::max());
+	return {
+		.rvec = {entry(rng), entry(rng), entry(rng)},
+		.uvec = {entry(rng), entry(rng), entry(rng)},
+		.fvec = {entry(rng), entry(rng), entry(rng)},
+	};
+}
+
+/* Edge values where a mistake in sign extension or in the shift would
+ * show.
+ */
+static std::vector<dcx::vms_vector> edge_vectors()
+{
+	constexpr dcx::fix values[]{0, 1, -1, F1_0, -F1_0, 0x7fff, -0x8000, 1 << 29, -(1 << 29), std::numeric_limits<dcx::fix>::max(), std::numeric_limits<dcx::fix>::min()};
+	std::vector<dcx::vms_vector> result;
+	/* Only one coordinate is extreme at a time, so that the scalar sum
+	 * cannot overflow.
+	 */
+	for (const auto v : values)
+	{
+		result.push_back({v, 0, 0});
+		result.push_back({0, v, 0});
+		result.push_back({0, 0, v});
+	}
+	return result;
+}
+
+/* Test that every kernel this processor supports gives exactly the
+ * scalar result for random inputs.
+ */
+BOOST_AUTO_TEST_CASE(vecmat_batch_matches_scalar)
+{
+	std::mt19937 rng(1);
+	for (const auto isa : all_isas)
+	{
+		if (!dcx::vm_vec_batch_set_isa(isa))
+			continue;
+		BOOST_TEST_MESSAGE("isa " << static_cast<unsigned>(isa));
+		for (const auto count : batch_counts)
+		{
+			const auto src = random_vectors(rng, count);
+			const auto m = random_matrix(rng);
+			const auto point = random_vectors(rng, 1).front();
+			std::vector<dcx::vms_vector> rotated(count);
+			std::vector<dcx::fix> dots(count);
+			std::vector<dcx::vm_distance_squared> distances2(count);
+			std::vector<dcx::vm_distance> distances(count);
+			dcx::vm_vec_rotate_n(rotated, src, m);
+			dcx::vm_vec_dot_n(dots, src, point);
+			dcx::vm_vec_dist2_n(distances2, src, point);
+			dcx::vm_vec_dist_n(distances, src, point);
+			for (std::size_t i = 0; i != count; ++i)
+			{
+				BOOST_TEST((rotated[i] == dcx::vm_vec_rotate(src[i], m)));
+				BOOST_TEST(dots[i] == dcx::vm_vec_dot(src[i], point));
+				BOOST_TEST((distances2[i] == dcx::vm_vec_dist2(src[i], point)));
+				BOOST_TEST(static_cast<dcx::fix>(distances[i]) == static_cast<dcx::fix>(dcx::vm_vec_dist(src[i], point)));
+			}
+		}
+	}
+	dcx::vm_vec_batch_set_isa(dcx::vm_vec_batch_best_isa());
+}
+
+/* Test that every kernel this processor supports gives exactly the
+ * scalar result for extreme coordinates and matrix entries.
+ */
+BOOST_AUTO_TEST_CASE(vecmat_batch_edge_values)
+{
+	const auto src = edge_vectors();
+	constexpr dcx::fix entries[]{0, 1, -1, F1_0, -F1_0, std::numeric_limits<dcx::fix>::max(), std::numeric_limits<dcx::fix>::min()};
+	for (const auto isa : all_isas)
+	{
+		if (!dcx::vm_vec_batch_set_isa(isa))
+			continue;
+		std::vector<dcx::vms_vector> rotated(src.size());
+		std::vector<dcx::fix> dots(src.size());
+		for (const auto e : entries)
+		{
+			const dcx::vms_matrix m{
+				.rvec = {e, 0, 0},
+				.uvec = {0, e, 0},
+				.fvec = {0, 0, e},
+			};
+			const dcx::vms_vector v{e, e, e};
+			dcx::vm_vec_rotate_n(rotated, src, m);
+			dcx::vm_vec_dot_n(dots, src, v);
+			for (std::size_t i = 0; i != src.size(); ++i)
+			{
+				BOOST_TEST((rotated[i] == dcx::vm_vec_rotate(src[i], m)));
+				BOOST_TEST(dots[i] == dcx::vm_vec_dot(src[i], v));
+			}
+		}
+	}
+	dcx::vm_vec_batch_set_isa(dcx::vm_vec_batch_best_isa());
+}
+
+/* Test that the scalar kernel is always available, and that the best
+ * instruction set can always be selected.
+ */
+BOOST_AUTO_TEST_CASE(vecmat_batch_select_isa)
+{
+	BOOST_TEST(dcx::vm_vec_batch_set_isa(dcx::vm_vec_batch_isa::scalar));
+	BOOST_TEST((dcx::vm_vec_batch_get_isa() == dcx::vm_vec_batch_isa::scalar));
+	const auto best = dcx::vm_vec_batch_best_isa();
+	BOOST_TEST(dcx::vm_vec_batch_set_isa(best));
+	BOOST_TEST((dcx::vm_vec_batch_get_isa() == best));
+}
@@ -67,7 +67,9 @@
 
 #include <algorithm>
 #include <memory>
+#include <unordered_map>
 #include <utility>
+#include <vector>
 using std::max;
 
 //change to 1 for lots of spew.
@@ -908,11 +910,159 @@ void _g3_draw_poly(grs_canvas &canvas, const std::span<cg3s_point *const> pointl
 	glDrawArrays(GL_TRIANGLE_FAN, 0, pointlist.size());
 }
 
+namespace {
+
+/* Textured faces collected between ogl_begin_tmap_batch and
+ * ogl_end_tmap_batch.  Each batch holds the faces of one texture as a
+ * triangle list, so that it can be drawn with one bind and one draw call.
+ * The vectors keep their storage from frame to frame.
+ */
+struct ogl_tmap_vertex
+{
+	GLfloat x, y, z;
+	GLfloat r, g, b, a;
+	GLfloat u, v;
+};
+
+struct ogl_tmap_batch
+{
+	ogl_texture *texture;
+	std::vector<ogl_tmap_vertex> vertices;
+};
+
+struct ogl_tmap_batch_layer
+{
+	std::vector<ogl_tmap_batch> batches;
+	std::unordered_map<const ogl_texture *, unsigned> index;
+	std::vector<ogl_tmap_vertex> &get(ogl_texture &texture);
+};
+
+std::vector<ogl_tmap_vertex> &ogl_tmap_batch_layer::get(ogl_texture &texture)
+{
+	const auto &&[i, inserted] = index.try_emplace(&texture, batches.size());
+	if (inserted)
+		batches.push_back({&texture, {}});
+	return batches[i->second].vertices;
+}
+
+/* Secondary textures must be drawn after every primary texture, so that
+ * an overlay is never hidden by the face beneath it.
+ */
+static std::array<ogl_tmap_batch_layer, 2> Ogl_tmap_batches;
+static bool Ogl_tmap_batch_active;
+static gr_blend Ogl_blend_func = gr_blend::normal;
+
+static GLfloat ogl_fade_alpha(const grs_canvas &canvas)
+{
+	return (canvas.cv_fade_level >= GR_FADE_OFF)
+		? 1.0
+		: (1.0 - static_cast<float>(canvas.cv_fade_level) / (static_cast<float>(GR_FADE_LEVELS) - 1.0));
+}
+
+static std::array<GLfloat, 2> ogl_tmap_2_texcoord(const texture2_rotation_low orient, const g3s_uvl &uvl)
+{
+	const GLfloat uf = f2glf(uvl.u), vf = f2glf(uvl.v);
+	switch(orient){
+		case texture2_rotation_low::_1:
+			return {{1.0f - vf, uf}};
+		case texture2_rotation_low::_2:
+			return {{1.0f - uf, 1.0f - vf}};
+		case texture2_rotation_low::_3:
+			return {{vf, 1.0f - uf}};
+		default:
+			return {{uf, vf}};
+	}
+}
+
+/* Return whether a face drawn now with `tmap_drawer_ptr` may be deferred
+ * to the end of the batch.
+ */
+static bool ogl_tmap_batchable(const tmap_drawer_type tmap_drawer_ptr)
+{
+	return Ogl_tmap_batch_active && tmap_drawer_ptr == draw_tmap && Ogl_blend_func == gr_blend::normal;
+}
+
+/* Append the fan `pointlist` to the batch of `bm`, as triangles. */
+template <typename texcoord_function>
+static void ogl_tmap_batch_add(const unsigned layer, const std::span<const g3s_point *const> pointlist, const g3s_lrgb *const light_rgb, const GLfloat alpha, grs_bitmap &bm, const bool edgepad, texcoord_function &&texcoord)
+{
+	if (pointlist.size() < 3)
+		return;
+	if (bm.gltexture == nullptr || bm.gltexture->handle <= 0)
+		ogl_loadbmtexture(bm, edgepad);
+	r_tpolyc++;
+	const bool lit = !bm.get_flag_mask(BM_FLAG_NO_LIGHTING);
+	const auto make_vertex = [&](const std::size_t i) {
+		auto &pv = pointlist[i]->p3_vec;
+		auto &light = light_rgb[i];
+		const auto &&[u, v] = texcoord(i);
+		return ogl_tmap_vertex{
+			f2glf(pv.x), f2glf(pv.y), -f2glf(pv.z),
+			lit ? f2glf(light.r) : 1.0f,
+			lit ? f2glf(light.g) : 1.0f,
+			lit ? f2glf(light.b) : 1.0f,
+			alpha, u, v
+		};
+	};
+	auto &vertices = Ogl_tmap_batches[layer].get(*bm.gltexture);
+	const auto first = make_vertex(0);
+	auto previous = make_vertex(1);
+	for (std::size_t i = 2, nv = pointlist.size(); i < nv; ++i)
+	{
+		const auto next = make_vertex(i);
+		vertices.insert(vertices.end(), {first, previous, next});
+		previous = next;
+	}
+}
+
+static void ogl_draw_tmap_batches()
+{
+	ogl_client_states<int, GL_VERTEX_ARRAY, GL_COLOR_ARRAY, GL_TEXTURE_COORD_ARRAY> cs;
+	(void)cs;
+	OGL_ENABLE(TEXTURE_2D);
+	for (auto &layer : Ogl_tmap_batches)
+	{
+		for (auto &[texture, vertices] : layer.batches)
+		{
+			if (vertices.empty())
+				continue;
+			OGL_BINDTEXTURE(texture->handle);
+			texture->numrend++;
+			ogl_texwrap(texture, GL_REPEAT);
+			glVertexPointer(3, GL_FLOAT, sizeof(ogl_tmap_vertex), &vertices[0].x);
+			glColorPointer(4, GL_FLOAT, sizeof(ogl_tmap_vertex), &vertices[0].r);
+			glTexCoordPointer(2, GL_FLOAT, sizeof(ogl_tmap_vertex), &vertices[0].u);
+			glDrawArrays(GL_TRIANGLES, 0, vertices.size());
+			vertices.clear();
+		}
+	}
+}
+
+}
+
+void ogl_begin_tmap_batch()
+{
+	Ogl_tmap_batch_active = true;
+}
+
+void ogl_end_tmap_batch()
+{
+	Ogl_tmap_batch_active = false;
+	ogl_draw_tmap_batches();
+}
+
 /*
  * Everything texturemapped (walls, robots, ship)
  */ 
 void _g3_draw_tmap(grs_canvas &canvas, const std::span<cg3s_point *const> pointlist, const g3s_uvl *const uvl_list, const g3s_lrgb *const light_rgb, grs_bitmap &bm, const tmap_drawer_type tmap_drawer_ptr)
 {
+	if (ogl_tmap_batchable(tmap_drawer_ptr))
+	{
+		ogl_tmap_batch_add(0, pointlist, light_rgb, ogl_fade_alpha(canvas), bm, 0, [uvl_list](const std::size_t i) {
+			return std::array<GLfloat, 2>{{f2glf(uvl_list[i].u), f2glf(uvl_list[i].v)}};
+		});
+		return;
+	}
 	GLfloat color_alpha = 1.0;
 
 	ogl_client_states<int, GL_VERTEX_ARRAY, GL_COLOR_ARRAY> cs;
@@ -922,7 +1072,7 @@ void _g3_draw_tmap(grs_canvas &canvas, const std::span<cg3s_point *const> pointl
 		ogl_bindbmtex(bm, 0);
 		ogl_texwrap(bm.gltexture, GL_REPEAT);
 		r_tpolyc++;
-		color_alpha = (canvas.cv_fade_level >= GR_FADE_OFF) ? 1.0 : (1.0 - static_cast<float>(canvas.cv_fade_level) / (static_cast<float>(GR_FADE_LEVELS) - 1.0));
+		color_alpha = ogl_fade_alpha(canvas);
 	} else if (tmap_drawer_ptr == draw_tmap_flat) {
 		OGL_DISABLE(TEXTURE_2D);
 		/* for cloaked state faces */
@@ -991,6 +1141,17 @@ void _g3_draw_tmap(grs_canvas &canvas, const std::span<cg3s_point *const> pointl
  */
 void _g3_draw_tmap_2(grs_canvas &canvas, const std::span<const g3s_point *const> pointlist, const std::span<const g3s_uvl, 4> uvl_list, const std::span<const g3s_lrgb, 4> light_rgb, grs_bitmap &bmbot, grs_bitmap &bm, const texture2_rotation_low orient, const tmap_drawer_type tmap_drawer_ptr)
 {
+	if (ogl_tmap_batchable(tmap_drawer_ptr))
+	{
+		const GLfloat alpha = ogl_fade_alpha(canvas);
+		ogl_tmap_batch_add(0, pointlist, light_rgb.data(), alpha, bmbot, 0, [uvl_list](const std::size_t i) {
+			return std::array<GLfloat, 2>{{f2glf(uvl_list[i].u), f2glf(uvl_list[i].v)}};
+		});
+		ogl_tmap_batch_add(1, pointlist, light_rgb.data(), alpha, bm, 1, [uvl_list, orient](const std::size_t i) {
+			return ogl_tmap_2_texcoord(orient, uvl_list[i]);
+		});
+		return;
+	}
 	_g3_draw_tmap(canvas, pointlist, uvl_list.data(), light_rgb.data(), bmbot, tmap_drawer_ptr);//draw the bottom texture first.. could be optimized with multitexturing..
 	ogl_client_states<int, GL_VERTEX_ARRAY, GL_COLOR_ARRAY, GL_TEXTURE_COORD_ARRAY> cs;
 	(void)cs;
@@ -1001,9 +1162,7 @@ void _g3_draw_tmap_2(grs_canvas &canvas, const std::span<const g3s_point *const>
 
 	flatten_array<GLfloat, 4, MAX_POINTS_PER_POLY> color_array;
 	{
-		const GLfloat alpha = (canvas.cv_fade_level >= GR_FADE_OFF)
-			? 1.0
-			: (1.0 - static_cast<float>(canvas.cv_fade_level) / (static_cast<float>(GR_FADE_LEVELS) - 1.0));
+		const GLfloat alpha = ogl_fade_alpha(canvas);
 		auto &&color_range = unchecked_partial_range(color_array.nested, pointlist.size());
 		if (bm.get_flag_mask(BM_FLAG_NO_LIGHTING))
 		{
@@ -1041,25 +1200,7 @@ void _g3_draw_tmap_2(grs_canvas &canvas, const std::span<const g3s_point *const>
 		)
 	)
 	{
-		const GLfloat uf = f2glf(uvl.u), vf = f2glf(uvl.v);
-		switch(orient){
-			case texture2_rotation_low::_1:
-				texcoord[0] = 1.0 - vf;
-				texcoord[1] = uf;
-				break;
-			case texture2_rotation_low::_2:
-				texcoord[0] = 1.0 - uf;
-				texcoord[1] = 1.0 - vf;
-				break;
-			case texture2_rotation_low::_3:
-				texcoord[0] = vf;
-				texcoord[1] = 1.0 - uf;
-				break;
-			default:
-				texcoord[0] = uf;
-				texcoord[1] = vf;
-				break;
-		}
+		texcoord = ogl_tmap_2_texcoord(orient, uvl);
 		vert[0] = f2glf(point->p3_vec.x);
 		vert[1] = f2glf(point->p3_vec.y);
 		vert[2] = -f2glf(point->p3_vec.z);
@@ -1246,6 +1387,7 @@ void ogl_toggle_depth_test(int enable)
  */
 void ogl_set_blending(const gr_blend cv_blend_func)
 {
+	Ogl_blend_func = cv_blend_func;
 	GLenum s, d;
 	switch (cv_blend_func)
 	{
@@ -1920,6 +2062,11 @@ void ogl_loadbmtexture_f(grs_bitmap &rbm, const opengl_texture_filter texfilt, b
 static void ogl_freetexture(ogl_texture &gltexture)
 {
 	if (gltexture.handle>0) {
+		/* A collected face may use this texture, so draw the faces
+		 * before its handle is released and reused.
+		 */
+		if (Ogl_tmap_batch_active)
+			ogl_draw_tmap_batches();
 		r_texcount--;
 		glmprintf((CON_DEBUG, "ogl_freetexture(%p):%i (%i left)", &gltexture, gltexture.handle, r_texcount));
 		glDeleteTextures( 1, &gltexture.handle );
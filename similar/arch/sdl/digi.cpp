@@ -74,6 +74,7 @@ struct sound_function_table_t
 	int  (*is_channel_playing)(sound_channel);
 	void (*stop_all_channels)();
 	void (*set_digi_volume)(int);
+	void (*prepare_level_sounds)();
 };
 
 #if DXX_SOUND_TABLE_STYLE == DXX_STS_MIXER_WITH_POINTER
@@ -162,6 +163,7 @@ constexpr sound_function_table_t digi_mixer_table{
 	&digi_mixer_is_channel_playing,
 	&digi_mixer_stop_all_channels,
 	&digi_mixer_set_digi_volume,
+	&digi_mixer_prepare_level_sounds,
 };
 #endif
 
@@ -176,6 +178,7 @@ constexpr sound_function_table_t digi_audio_table{
 	&digi_audio_is_channel_playing,
 	&digi_audio_stop_all_channels,
 	&digi_audio_set_digi_volume,
+	&digi_audio_prepare_level_sounds,
 };
 
 #if DXX_SOUND_TABLE_STYLE == DXX_STS_MIXER_WITH_POINTER
@@ -251,6 +254,7 @@ int  digi_is_channel_playing(const sound_channel channel)
 
 void digi_stop_all_channels() { fptr->stop_all_channels(); }
 void digi_set_digi_volume(int dvolume) { fptr->set_digi_volume(dvolume); }
+void digi_prepare_level_sounds() { fptr->prepare_level_sounds(); }
 
 #ifdef _WIN32
 // Windows native-MIDI stuff.
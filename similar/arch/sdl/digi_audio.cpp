@@ -11,9 +11,13 @@
  *
  */
 
-#include <stdlib.h>
-#include <stdio.h>
-#include <string.h>
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
 #include <SDL.h>
 #include <digi_audio.h>
 #include "dxxerror.h"
@@ -26,73 +30,27 @@
 #include "piggy.h"
 
 #include "compiler-range_for.h"
-#include "d_sdl_audio.h"
+#include "digi_audio_mix.h"
 #include "d_underlying_value.h"
 
 namespace dcx {
 
 namespace {
 
-//changed on 980905 by adb to increase number of concurrent sounds
-//end changes by adb
+/* Frames per SDL audio callback. */
 #define SOUND_BUFFER_SIZE 1024
+/* Frames that the mixer thread mixes at a time, and the most frames it
+ * keeps queued ahead of the callback.
+ */
+constexpr std::size_t mix_block_frames = 256;
+constexpr std::size_t mix_queued_frames = 2 * SOUND_BUFFER_SIZE;
 
 #define MIN_VOLUME 10
 
-/* This table is used to add two sound values together and pin
- * the value to avoid overflow.  (used with permission from ARDI)
- * DPH: Taken from SDL/src/SDL_mixer.c.
+/* The mixer does not share channels with SDL_mixer, so it can have more
+ * than digi_max_channels.
  */
-constexpr uint8_t mix8[] =
-{
-  0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
-  0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
-  0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
-  0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
-  0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
-  0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
-  0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
-  0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
-  0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
-  0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
-  0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
-  0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x01, 0x02, 0x03,
-  0x04, 0x05, 0x06, 0x07, 0x08, 0x09, 0x0A, 0x0B, 0x0C, 0x0D, 0x0E,
-  0x0F, 0x10, 0x11, 0x12, 0x13, 0x14, 0x15, 0x16, 0x17, 0x18, 0x19,
-  0x1A, 0x1B, 0x1C, 0x1D, 0x1E, 0x1F, 0x20, 0x21, 0x22, 0x23, 0x24,
-  0x25, 0x26, 0x27, 0x28, 0x29, 0x2A, 0x2B, 0x2C, 0x2D, 0x2E, 0x2F,
-  0x30, 0x31, 0x32, 0x33, 0x34, 0x35, 0x36, 0x37, 0x38, 0x39, 0x3A,
-  0x3B, 0x3C, 0x3D, 0x3E, 0x3F, 0x40, 0x41, 0x42, 0x43, 0x44, 0x45,
-  0x46, 0x47, 0x48, 0x49, 0x4A, 0x4B, 0x4C, 0x4D, 0x4E, 0x4F, 0x50,
-  0x51, 0x52, 0x53, 0x54, 0x55, 0x56, 0x57, 0x58, 0x59, 0x5A, 0x5B,
-  0x5C, 0x5D, 0x5E, 0x5F, 0x60, 0x61, 0x62, 0x63, 0x64, 0x65, 0x66,
-  0x67, 0x68, 0x69, 0x6A, 0x6B, 0x6C, 0x6D, 0x6E, 0x6F, 0x70, 0x71,
-  0x72, 0x73, 0x74, 0x75, 0x76, 0x77, 0x78, 0x79, 0x7A, 0x7B, 0x7C,
-  0x7D, 0x7E, 0x7F, 0x80, 0x81, 0x82, 0x83, 0x84, 0x85, 0x86, 0x87,
-  0x88, 0x89, 0x8A, 0x8B, 0x8C, 0x8D, 0x8E, 0x8F, 0x90, 0x91, 0x92,
-  0x93, 0x94, 0x95, 0x96, 0x97, 0x98, 0x99, 0x9A, 0x9B, 0x9C, 0x9D,
-  0x9E, 0x9F, 0xA0, 0xA1, 0xA2, 0xA3, 0xA4, 0xA5, 0xA6, 0xA7, 0xA8,
-  0xA9, 0xAA, 0xAB, 0xAC, 0xAD, 0xAE, 0xAF, 0xB0, 0xB1, 0xB2, 0xB3,
-  0xB4, 0xB5, 0xB6, 0xB7, 0xB8, 0xB9, 0xBA, 0xBB, 0xBC, 0xBD, 0xBE,
-  0xBF, 0xC0, 0xC1, 0xC2, 0xC3, 0xC4, 0xC5, 0xC6, 0xC7, 0xC8, 0xC9,
-  0xCA, 0xCB, 0xCC, 0xCD, 0xCE, 0xCF, 0xD0, 0xD1, 0xD2, 0xD3, 0xD4,
-  0xD5, 0xD6, 0xD7, 0xD8, 0xD9, 0xDA, 0xDB, 0xDC, 0xDD, 0xDE, 0xDF,
-  0xE0, 0xE1, 0xE2, 0xE3, 0xE4, 0xE5, 0xE6, 0xE7, 0xE8, 0xE9, 0xEA,
-  0xEB, 0xEC, 0xED, 0xEE, 0xEF, 0xF0, 0xF1, 0xF2, 0xF3, 0xF4, 0xF5,
-  0xF6, 0xF7, 0xF8, 0xF9, 0xFA, 0xFB, 0xFC, 0xFD, 0xFE, 0xFF, 0xFF,
-  0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
-  0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
-  0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
-  0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
-  0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
-  0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
-  0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
-  0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
-  0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
-  0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
-  0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
-  0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
-};
+constexpr std::integral_constant<unsigned, 32> digi_audio_max_channels{};
 
 static int digi_initialised = 0;
 
@@ -107,7 +65,7 @@ struct sound_slot {
 	std::span<const uint8_t> samples;
 	sound_object *soundobj;   // Which soundobject is on this channel
 	//end changes by adb
-	unsigned int position; // Position we are at at the moment.
+	uint64_t position; // Position we are at at the moment, in 1/65536 of a sample.
 };
 
 static void digi_audio_stop_sound(sound_slot &s)
@@ -117,47 +75,57 @@ static void digi_audio_stop_sound(sound_slot &s)
 	s.persistent = 0;
 }
 
-static enumerated_array<sound_slot, 32, sound_channel> SoundSlots;
+static enumerated_array<sound_slot, digi_audio_max_channels, sound_channel> SoundSlots;
+/* Held by the game thread to change SoundSlots, and by the mixer thread
+ * to mix one block.  The SDL callback never takes it.
+ */
+static std::mutex SoundSlots_mutex;
 static SDL_AudioSpec WaveSpec;
 static sound_channel next_channel;
 
+/* The mixer thread mixes SoundSlots into `ring`, and the SDL callback
+ * only copies from `ring`.
+ */
+struct digi_audio_mixer
+{
+	digi_mix_ring ring;
+	std::thread thread;
+	std::mutex wake_mutex;
+	std::condition_variable wake;
+	std::atomic<bool> running;
+	/* Step through a sound per output frame, in 1/65536 of a sample. */
+	uint32_t step;
+};
+
+static digi_audio_mixer Mixer;
+
 /* Return the next sound_channel after `c`, and roll back to 0 if incrementing
  * `c` exceeds the maximum available channels.
  */
 static sound_channel next(const sound_channel c)
 {
 	const std::underlying_type<sound_channel>::type v = underlying_value(c) + 1;
-	return (v >= digi_max_channels) ? sound_channel{} : sound_channel{v};
-}
-
+	return (v >= digi_audio_max_channels) ? sound_channel{} : sound_channel{v};
 }
 
+/* Convert a volume in fix to a mixer gain. */
+static int16_t mix_gain(const fix v)
+{
+	return std::clamp(v >> 2, 0, INT16_MAX);
 }
 
-namespace dsx {
-
-namespace {
-
-/* Audio mixing callback */
-//changed on 980905 by adb to cleanup, add pan support and optimize mixer
-static void audio_mixcallback(void *, Uint8 *stream, int len)
+/* Mix the next block of every playing slot into `out`. */
+static void mix_block(std::array<int16_t, 2 * mix_block_frames> &out)
 {
-	Uint8 *streamend = stream + len;
-	if (!digi_initialised)
-		return;
-
-	memset(stream, 0x80, len); // fix "static" sound bug on Mac OS X
-
-	RAII_SDL_LockAudio lock_audio{};
-
-	range_for (auto &sl, SoundSlots)
+	std::array<int32_t, 2 * mix_block_frames> acc{};
+	std::array<int16_t, mix_block_frames> mono;
 	{
-		if (sl.playing) {
-			auto sldata = std::next(sl.samples.begin(), sl.position), slend = sl.samples.end();
-			Uint8 *sp = stream, s;
-			signed char v;
+		std::lock_guard lock(SoundSlots_mutex);
+		for (auto &sl : SoundSlots)
+		{
+			if (!sl.playing)
+				continue;
 			fix vl, vr;
-
 			if (const auto x = static_cast<fix>(sl.pan); x & 0x8000) {
 				vl = 0x20000 - x * 2;
 				vr = 0x10000;
@@ -166,29 +134,53 @@ static void audio_mixcallback(void *, Uint8 *stream, int len)
 				vr = x * 2;
 			}
 			const auto sl_volume = sl.volume;
-			vl = fixmul(vl, sl_volume);
-			vr = fixmul(vr, sl_volume);
-			while (sp < streamend) {
-				if (sldata == slend) {
-					if (!sl.looped) {
-						sl.playing = 0;
-						break;
-					}
-					sldata = sl.samples.begin();
-				}
-				v = *(sldata++) - 0x80;
-				s = *sp;
-				*(sp++) = mix8[ s + fixmul(v, vl) + 0x80 ];
-				s = *sp;
-				*(sp++) = mix8[ s + fixmul(v, vr) + 0x80 ];
-			}
-			sl.position = std::distance(sl.samples.begin(), sldata);
+			const auto frames = digi_mix_resample(mono.data(), mono.size(), sl.samples, sl.position, Mixer.step, sl.looped);
+			digi_mix_accumulate(acc.data(), mono.data(), frames, mix_gain(fixmul(vl, sl_volume)), mix_gain(fixmul(vr, sl_volume)));
+			if (frames != mono.size())
+				sl.playing = 0;
 		}
 	}
+	digi_mix_saturate(out.data(), acc.data(), acc.size());
+}
+
+static void mixer_thread()
+{
+	std::array<int16_t, 2 * mix_block_frames> block;
+	while (Mixer.running.load(std::memory_order_relaxed))
+	{
+		while (Mixer.ring.size() + block.size() <= 2 * mix_queued_frames)
+		{
+			mix_block(block);
+			Mixer.ring.write(block.data(), block.size());
+		}
+		/* The callback wakes this thread after each copy.  The timeout
+		 * covers a wakeup sent before this thread began to wait.
+		 */
+		std::unique_lock lock(Mixer.wake_mutex);
+		Mixer.wake.wait_for(lock, std::chrono::milliseconds(5));
+	}
+}
+
+}
+
+}
+
+namespace dsx {
+
+namespace {
+
+/* Audio mixing callback */
+static void audio_mixcallback(void *, Uint8 *stream, int len)
+{
+	const auto out = reinterpret_cast<int16_t *>(stream);
+	const std::size_t count = len / sizeof(int16_t);
+	const auto n = Mixer.ring.read(out, count);
+	/* If the mixer fell behind, play silence rather than stale data. */
+	std::fill(out + n, out + count, 0);
+	Mixer.wake.notify_one();
 }
 
 }
-//end changes by adb
 
 /* Initialise audio devices. */
 int digi_audio_init()
@@ -197,17 +189,23 @@ int digi_audio_init()
 		Error("SDL audio initialisation failed: %s.",SDL_GetError());
 	}
 
+	/* Mix at 44.1KHz or 48KHz, and step through the 11KHz or 22KHz
+	 * sounds at their own rate.
+	 */
+	const unsigned output_rate = (CGameArg.SndOutputRate == 48000) ? 48000 : 44100;
 #if defined(DXX_BUILD_DESCENT_I)
 	/* Descent 1 sounds are always 11Khz. */
-	WaveSpec.freq = underlying_value(sound_sample_rate::_11k);
+	const unsigned sound_rate = underlying_value(sound_sample_rate::_11k);
 #elif defined(DXX_BUILD_DESCENT_II)
 	/* Descent 2 sounds are available in both 11Khz and 22Khz.  The user may
 	 * pick at program start time which to use.
 	 */
-	WaveSpec.freq = underlying_value(GameArg.SndDigiSampleRate);
+	const unsigned sound_rate = underlying_value(GameArg.SndDigiSampleRate);
 #endif
+	Mixer.step = (uint64_t{sound_rate} << 16) / output_rate;
+	WaveSpec.freq = output_rate;
 	//added/changed by Sam Lantinga on 12/01/98 for new SDL version
-	WaveSpec.format = AUDIO_U8;
+	WaveSpec.format = AUDIO_S16SYS;
 	WaveSpec.channels = 2;
 	//end this section addition/change - SL
 	WaveSpec.samples = SOUND_BUFFER_SIZE;
@@ -220,6 +218,9 @@ int digi_audio_init()
 		return 1;
 		//end edit -MM
 	}
+	Mixer.ring.reset(4 * mix_queued_frames);
+	Mixer.running.store(true, std::memory_order_relaxed);
+	Mixer.thread = std::thread(mixer_thread);
 	SDL_PauseAudio(0);
 
 	digi_initialised = 1;
@@ -237,10 +238,14 @@ void digi_audio_close()
 	SDL_Delay(500); // CloseAudio hangs if it's called too soon after opening?
 #endif
 	SDL_CloseAudio();
+	Mixer.running.store(false, std::memory_order_relaxed);
+	Mixer.wake.notify_one();
+	Mixer.thread.join();
 }
 
 void digi_audio_stop_all_channels()
 {
+	std::lock_guard lock(SoundSlots_mutex);
 	range_for (auto &i, SoundSlots)
 		digi_audio_stop_sound(i);
 }
@@ -255,7 +260,7 @@ sound_channel digi_audio_start_sound(short soundnum, fix volume, sound_pan pan,
 	if (soundnum < 0)
 		return sound_channel::None;
 
-	RAII_SDL_LockAudio lock_audio{};
+	std::lock_guard lock(SoundSlots_mutex);
 
 	const auto starting_channel = next_channel;
 
@@ -323,11 +328,19 @@ void digi_audio_set_digi_volume( int dvolume )
 }
 //end edit by adb
 
+/* The mixer resamples each sound as it plays, so there is nothing to
+ * convert ahead of time.
+ */
+void digi_audio_prepare_level_sounds()
+{
+}
+
 int digi_audio_is_channel_playing(const sound_channel channel)
 {
 	if (!digi_initialised)
 		return 0;
 
+	std::lock_guard lock(SoundSlots_mutex);
 	return SoundSlots[channel].playing;
 }
 
@@ -336,6 +349,7 @@ void digi_audio_set_channel_volume(const sound_channel channel, int volume)
 	if (!digi_initialised)
 		return;
 
+	std::lock_guard lock(SoundSlots_mutex);
 	if (!SoundSlots[channel].playing)
 		return;
 
@@ -347,6 +361,7 @@ void digi_audio_set_channel_pan(const sound_channel channel, const sound_pan pan
 	if (!digi_initialised)
 		return;
 
+	std::lock_guard lock(SoundSlots_mutex);
 	if (!SoundSlots[channel].playing)
 		return;
 
@@ -355,6 +370,7 @@ void digi_audio_set_channel_pan(const sound_channel channel, const sound_pan pan
 
 void digi_audio_stop_sound(const sound_channel channel)
 {
+	std::lock_guard lock(SoundSlots_mutex);
 	digi_audio_stop_sound(SoundSlots[channel]);
 }
 
@@ -363,6 +379,7 @@ void digi_audio_end_sound(const sound_channel channel)
 	if (!digi_initialised)
 		return;
 
+	std::lock_guard lock(SoundSlots_mutex);
 	if (!SoundSlots[channel].playing)
 		return;
 
@@ -14,8 +14,15 @@
  *  -- MD2211 (2006-10-12)
  */
 
+#include <algorithm>
+#include <atomic>
 #include <bitset>
+#include <cinttypes>
+#include <mutex>
 #include <span>
+#include <string>
+#include <thread>
+#include <vector>
 #include <stdlib.h>
 #include <stdio.h>
 #include <string.h>
@@ -43,6 +50,9 @@
 #include "d_underlying_value.h"
 #include "d_uspan.h"
 #include "d_zip.h"
+#include "digi_mixer_resample.h"
+#include "physfsx.h"
+#include "physfs_list.h"
 
 #define MIX_DIGI_DEBUG 0
 
@@ -84,6 +94,8 @@ static sound_channel digi_mixer_find_channel(const enumerated_bitset<64, sound_c
 
 struct RAIIMix_Chunk : public Mix_Chunk
 {
+	/* Hash of the sound data that `abuf` was converted from. */
+	uint64_t source_hash;
 	RAIIMix_Chunk() = default;
 	~RAIIMix_Chunk()
 	{
@@ -147,16 +159,6 @@ int digi_mixer_init()
 	return 0;
 }
 
-/* Shut down audio */
-void digi_mixer_close() {
-#if MIX_DIGI_DEBUG
-	con_printf(CON_DEBUG, "digi_close (SDL_Mixer)");
-#endif
-	if (!digi_initialised) return;
-	digi_initialised = 0;
-	Mix_CloseAudio();
-}
-
 namespace {
 
 #if DXX_FEATURE_INTERNAL_RESAMPLER
@@ -243,78 +245,6 @@ coeffs_halfband{{
 #endif
 ;
 
-// Fixed-point FIR filtering
-// Not optimal: consider optimization with 1/4, 1/2 band filters, and symmetric kernels
-static auto filter_fir(const unique_span<int8_t> signal_storage, const std::span<const int32_t, FILTER_LEN> coeffs)
-{
-	const auto signal{signal_storage.span()};
-	const std::size_t outsize = signal.size();
-	unique_span<int16_t> result(outsize);
-	const auto output{result.span()};
-	// A FIR filter is just a 1D convolution
-	// Keep only signalLen samples
-	for (const auto nn : xrange(outsize))
-	{
-		// Determine start/stop indices for convolved chunk
-		constexpr std::size_t coeffsLen = FILTER_LEN;
-		/* Avoid use of `std::max` here, since `nn + 1 < coeffsLen` would cause
-		 * unsigned subtraction to underflow.
-		 */
-		const std::size_t min_idx = (nn + 1 > coeffsLen ? nn + 1 - coeffsLen : 0u);
-		const std::size_t max_idx = nn;
-		if (min_idx > max_idx)
-			continue;
-
-		int32_t cur_output = 0;  // Increase bit size for fixed point expansion
-		// Sum over each sample * coefficient in this column
-		for (const auto kk : xrange(min_idx, max_idx + 1))
-		{
-			const auto product = int32_t{signal[kk]} * coeffs[nn - kk];
-			cur_output = cur_output + product;
-		}
-
-		// Save and fit back into int16
-		output[nn] = static_cast<int16_t>(cur_output >> 8);  // Arithmetic shift
-	}
-	return result;
-}
-
-static auto upsample(const std::span<const uint8_t> input, const upscale_factor upFactor)
-{
-	const std::size_t factor = underlying_value(upFactor);
-	switch (upFactor)
-	{
-		case upscale_factor::from_11khz_to_44khz:
-#if defined(DXX_BUILD_DESCENT_II)
-		case upscale_factor::from_22khz_to_44khz:
-#endif
-			break;
-		default:
-			cf_assert(false);
-	}
-	const auto upsampledLen = input.size() * factor;
-	/* Caution: `output` is sparsely initialized, so the value-initialization
-	 * from `make_unique` is necessary.  This site cannot be converted to
-	 * `make_unique_for_overwrite`.
-	 */
-	unique_span<int8_t> result(upsampledLen);
-	const auto output{result.span()};
-	using output_type = decltype(output)::value_type;
-	for (const auto ii : xrange(input.size()))
-	{
-		/* Assert that the minimum and maximum possible values in the input can
-		 * be represented in the output without truncation. */
-		using conversion_type = int16_t;
-		using input_type = decltype(input)::value_type;
-		constexpr int8_t convert_u8_to_s8{INT8_MIN};
-		static_assert(std::in_range<output_type>(conversion_type{input_type{0}} + convert_u8_to_s8));
-		static_assert(std::in_range<output_type>(conversion_type{input_type{UINT8_MAX}} + convert_u8_to_s8));
-		// Save input sample, convert to signed
-		output[ii*factor] = conversion_type{input[ii]} + convert_u8_to_s8;
-	}
-	return result;
-}
-
 static auto replicateChannel(const unique_span<int16_t> input_storage, const std::size_t output_per_input)
 {
 	const std::size_t chFactor = MIX_OUTPUT_CHANNELS;
@@ -343,12 +273,11 @@ static auto convert_audio(const std::span<const uint8_t> input, const std::size_
 #endif
 		coeffs_quarterband;
 
-	return replicateChannel(
-	// First upsample
-	// Apply LPF filter to smooth out upscaled points
+	// Upsample, and apply the LPF filter to smooth out upscaled points
 	// There will be some uniform amplitude loss here, but less than -3dB
-		filter_fir(upsample(input, upFactor), coeffs),
-		output_per_input);
+	unique_span<int16_t> upsampled(input.size() * underlying_value(upFactor));
+	digi_upsample_polyphase(input, underlying_value(upFactor), coeffs, upsampled.span());
+	return replicateChannel(std::move(upsampled), output_per_input);
 }
 
 }
@@ -418,18 +347,17 @@ namespace dsx {
 namespace {
 
 static std::array<RAIIMix_Chunk, MAX_SOUNDS> SoundChunks;
+/* Held by the game thread and by the level sound converter, to check
+ * and fill SoundChunks.
+ */
+static std::mutex SoundChunks_mutex;
 
 /*
- * Play-time conversion. Performs output conversion only once per sound effect used.
- * Once the sound sample has been converted, it is cached in SoundChunks[]
+ * Convert one sound to the output format.  Return an empty buffer if
+ * the sound cannot be converted.
  */
-static void mixdigi_convert_sound(const unsigned sound_idx, RAIIMix_Chunk &sci, const digi_sound &gs, const uint16_t freq)
+static unique_span<uint8_t> mixdigi_convert_data(const unsigned sound_idx, const std::span<const uint8_t> data, const uint16_t freq, const digi_mixer_method method)
 {
-	const auto data = gs.span();
-	if (data.empty())
-		return;
-
-	digi_mixer_method method = CGameArg.SndMixerMethod;
 	unique_span<uint8_t> cvtbuf;
 #if !DXX_FEATURE_EXTERNAL_RESAMPLER_SDL_NATIVE
 	(void)sound_idx;
@@ -458,7 +386,7 @@ static void mixdigi_convert_sound(const unsigned sound_idx, RAIIMix_Chunk &sci,
 						r = upscale_factor::from_22khz_to_44khz;
 #endif
 					else
-						return;
+						return {};
 					r;
 					});
 				const std::size_t output_per_input = underlying_value(upFactor) * MIX_OUTPUT_CHANNELS;
@@ -469,7 +397,7 @@ static void mixdigi_convert_sound(const unsigned sound_idx, RAIIMix_Chunk &sci,
 						/* This is unreachable, since the case labels of the
 						 * outer switch only match emulation paths.
 						 */
-						return;
+						return {};
 #endif
 #if DXX_FEATURE_INTERNAL_RESAMPLER_EMULATE_SDL1
 					case digi_mixer_method::emulate_sdl1:
@@ -491,29 +419,286 @@ static void mixdigi_convert_sound(const unsigned sound_idx, RAIIMix_Chunk &sci,
 			break;
 #endif
 	}
+	return cvtbuf;
+}
+
+#define SOUND_CACHE_DIR "sndcache/"
+
+/* Converted sounds are kept in SOUND_CACHE_DIR of the write directory,
+ * so that the next run can load them instead of converting them again.
+ * The name of each file has the hash of the source data, the method and
+ * the source rate.  The file has a header of 3 little endian integers:
+ * magic, version and data length.  Change the version when a change to
+ * a resampler would change its output.
+ */
+constexpr uint32_t sound_cache_magic = 0x50535844;	/* "DXSP" */
+constexpr uint32_t sound_cache_version = 1;
+
+struct sound_cache_key
+{
+	uint64_t hash;
+	uint16_t freq;
+	digi_mixer_method method;
+};
+
+/* SDL native conversion depends on the version of SDL, so it is not
+ * cached.
+ */
+static bool sound_cache_enabled(const digi_mixer_method method)
+{
+#if DXX_FEATURE_EXTERNAL_RESAMPLER_SDL_NATIVE
+	return method != digi_mixer_method::sdl_native;
+#else
+	(void)method;
+	return true;
+#endif
+}
+
+static std::array<char, 64> sound_cache_path(const sound_cache_key &key)
+{
+	std::array<char, 64> path;
+	snprintf(path.data(), path.size(), SOUND_CACHE_DIR "%016" PRIx64 "-%u-%u.pcm", key.hash, unsigned{underlying_value(key.method)}, unsigned{key.freq});
+	return path;
+}
+
+static unique_span<uint8_t> sound_cache_read(const sound_cache_key &key)
+{
+	const auto fp = PHYSFS_openRead(sound_cache_path(key).data());
+	if (!fp)
+		return {};
+	RAIIPHYSFS_File file{fp};
+	PHYSFS_uint32 magic, version, length;
+	if (!PHYSFS_readULE32(fp, &magic) || !PHYSFS_readULE32(fp, &version) || !PHYSFS_readULE32(fp, &length))
+		return {};
+	/* A file cut short by an interrupted write has the wrong length. */
+	if (magic != sound_cache_magic || version != sound_cache_version || !length || PHYSFS_fileLength(fp) != PHYSFS_sint64{length} + 12)
+		return {};
+	unique_span<uint8_t> result{length};
+	if (PHYSFS_readBytes(fp, result.get(), length) != length)
+		return {};
+	return result;
+}
+
+static void sound_cache_write(const sound_cache_key &key, const std::span<const uint8_t> data)
+{
+	PHYSFS_mkdir(SOUND_CACHE_DIR);
+	const auto path = sound_cache_path(key);
+	const auto fp = PHYSFS_openWrite(path.data());
+	if (!fp)
+		return;
+	const bool ok = PHYSFS_writeULE32(fp, sound_cache_magic) &&
+		PHYSFS_writeULE32(fp, sound_cache_version) &&
+		PHYSFS_writeULE32(fp, data.size()) &&
+		PHYSFS_writeBytes(fp, data.data(), data.size()) == static_cast<PHYSFS_sint64>(data.size());
+	if (!PHYSFS_close(fp) || !ok)
+		PHYSFS_delete(path.data());
+}
+
+/* Once the files in SOUND_CACHE_DIR take more than this many bytes,
+ * the least recently written ones are deleted.  A file that is still in
+ * use is written again when its sound is next converted.  This also
+ * removes the files of earlier versions and of sounds that are no longer
+ * used.
+ */
+constexpr PHYSFS_sint64 sound_cache_max_bytes{64 << 20};
+
+static void sound_cache_trim(const std::atomic<bool> &cancel)
+{
+	struct cache_file
+	{
+		PHYSFS_sint64 modtime, size;
+		std::string path;
+	};
+	std::vector<cache_file> files;
+	PHYSFS_sint64 total{};
+	{
+		const PHYSFSX_uncounted_list names{PHYSFS_enumerateFiles(SOUND_CACHE_DIR)};
+		if (!names)
+			return;
+		for (const auto name : names)
+		{
+			std::string path{SOUND_CACHE_DIR};
+			path += name;
+			PHYSFS_Stat st;
+			if (!PHYSFS_stat(path.c_str(), &st) || st.filetype != PHYSFS_FILETYPE_REGULAR)
+				continue;
+			total += st.filesize;
+			files.push_back({st.modtime, st.filesize, std::move(path)});
+		}
+	}
+	if (total <= sound_cache_max_bytes)
+		return;
+	std::ranges::sort(files, {}, &cache_file::modtime);
+	for (auto &f : files)
+	{
+		if (total <= sound_cache_max_bytes || cancel.load(std::memory_order_relaxed))
+			break;
+		if (PHYSFS_delete(f.path.c_str()))
+			total -= f.size;
+	}
+}
+
+static unique_span<uint8_t> mixdigi_convert_cached(const unsigned sound_idx, const std::span<const uint8_t> data, const uint16_t freq, const uint64_t hash)
+{
+	const auto method = CGameArg.SndMixerMethod;
+	const bool use_cache = sound_cache_enabled(method);
+	const sound_cache_key key{hash, freq, method};
+	if (use_cache)
+		if (auto cached = sound_cache_read(key); cached.size())
+			return cached;
+	auto cvtbuf = mixdigi_convert_data(sound_idx, data, freq, method);
+	if (use_cache && cvtbuf.size())
+		sound_cache_write(key, cvtbuf.span());
+	return cvtbuf;
+}
+
+static void mixdigi_install_sound(RAIIMix_Chunk &sci, unique_span<uint8_t> cvtbuf, const uint64_t hash)
+{
 	sci.alen = cvtbuf.size();
 	sci.abuf = cvtbuf.release();
 	sci.allocated = 1;
 	sci.volume = 128; // Max volume = 128
+	sci.source_hash = hash;
+}
+
+static uint16_t mixdigi_sound_freq(const digi_sound &gs)
+{
+#if defined(DXX_BUILD_DESCENT_I)
+	return gs.freq;
+#elif defined(DXX_BUILD_DESCENT_II)
+	(void)gs;
+	return underlying_value(GameArg.SndDigiSampleRate);
+#endif
 }
 
+/*
+ * Play-time conversion. Performs output conversion only once per sound effect used.
+ * Once the sound sample has been converted, it is cached in SoundChunks[]
+ */
 static Mix_Chunk &mixdigi_convert_sound(const unsigned i)
 {
 	auto &sci = SoundChunks[i];
+	std::lock_guard lock(SoundChunks_mutex);
 	if (!sci.abuf)
 	{
 		auto &gs = GameSounds[i];
-#if defined(DXX_BUILD_DESCENT_I)
-		const auto freq = gs.freq;
-#elif defined(DXX_BUILD_DESCENT_II)
-		const auto freq = underlying_value(GameArg.SndDigiSampleRate);
-#endif
 		//proceed only if not converted yet
-		mixdigi_convert_sound(i, sci, gs, freq);
+		if (const auto data = gs.span(); !data.empty())
+		{
+			const auto hash = digi_sound_hash(data);
+			mixdigi_install_sound(sci, mixdigi_convert_cached(i, data, mixdigi_sound_freq(gs), hash), hash);
+		}
 	}
 	return sci;
 }
 
+struct sound_prepare_job
+{
+	unsigned sound_idx;
+	uint16_t freq;
+	/* A copy, so that the sound data can change while the job waits. */
+	std::vector<uint8_t> data;
+};
+
+/* Converts the sounds of a level on a background thread, so that no
+ * sound needs to be converted when it first plays.
+ */
+class sound_preparer
+{
+	std::thread thread;
+	std::atomic<bool> cancel{false};
+	void run(std::vector<sound_prepare_job> jobs);
+public:
+	~sound_preparer()
+	{
+		stop();
+	}
+	void start(std::vector<sound_prepare_job> &&jobs)
+	{
+		thread = std::thread(&sound_preparer::run, this, std::move(jobs));
+	}
+	/* Abandon the remaining jobs, and wait for the thread to exit. */
+	void stop()
+	{
+		if (!thread.joinable())
+			return;
+		cancel.store(true, std::memory_order_relaxed);
+		thread.join();
+		cancel.store(false, std::memory_order_relaxed);
+	}
+};
+
+void sound_preparer::run(std::vector<sound_prepare_job> jobs)
+{
+	for (auto &j : jobs)
+	{
+		if (cancel.load(std::memory_order_relaxed))
+			return;
+		{
+			std::lock_guard lock(SoundChunks_mutex);
+			/* The game played this sound before the thread reached it. */
+			if (SoundChunks[j.sound_idx].abuf)
+				continue;
+		}
+		const auto hash = digi_sound_hash(j.data);
+		auto cvtbuf = mixdigi_convert_cached(j.sound_idx, j.data, j.freq, hash);
+		std::lock_guard lock(SoundChunks_mutex);
+		if (auto &sci = SoundChunks[j.sound_idx]; !sci.abuf)
+			mixdigi_install_sound(sci, std::move(cvtbuf), hash);
+	}
+	if (sound_cache_enabled(CGameArg.SndMixerMethod))
+		sound_cache_trim(cancel);
+}
+
+static sound_preparer SoundPreparer;
+
+}
+
+void digi_mixer_prepare_level_sounds()
+{
+	/* Under -lowmem, convert each sound only when it first plays, as
+	 * before.
+	 */
+	if (!digi_initialised || CGameArg.SysLowMem)
+		return;
+	SoundPreparer.stop();
+	const auto level_sounds = digi_level_sounds();
+	std::vector<sound_prepare_job> jobs;
+	bool halted = false;
+	for (const auto i : xrange(SoundChunks.size()))
+	{
+		auto &gs = GameSounds[i];
+		const auto data = gs.span();
+		const bool wanted = level_sounds[i] && !data.empty();
+		auto &sci = SoundChunks[i];
+		if (sci.abuf)
+		{
+			/* Keep a converted sound only if this level can play it and no
+			 * mission replaced it since it was converted.
+			 */
+			if (wanted && sci.source_hash == digi_sound_hash(data))
+				continue;
+			/* No channel may play the old data while it is freed. */
+			if (!std::exchange(halted, true))
+				digi_mixer_stop_all_channels();
+			delete [] std::exchange(sci.abuf, nullptr);
+			sci.alen = 0;
+		}
+		if (wanted)
+			jobs.push_back({static_cast<unsigned>(i), mixdigi_sound_freq(gs), {data.begin(), data.end()}});
+	}
+	SoundPreparer.start(std::move(jobs));
+}
+
+/* Shut down audio */
+void digi_mixer_close() {
+#if MIX_DIGI_DEBUG
+	con_printf(CON_DEBUG, "digi_close (SDL_Mixer)");
+#endif
+	SoundPreparer.stop();
+	if (!digi_initialised) return;
+	digi_initialised = 0;
+	Mix_CloseAudio();
 }
 
 // Volume 0-F1_0
@@ -291,7 +291,7 @@ int ObjectMakeCoop(void)
 	const auto &&objp = vmobjptr(Cur_object_index);
 	if (objp->type == OBJ_PLAYER)
 	{
-		objp->type = OBJ_COOP;
+		set_object_type(*objp, OBJ_COOP);
 		editor_status("You just made a player object COOPERATIVE");
 	} else
 		editor_status("This is not a player object");
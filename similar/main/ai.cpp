@@ -64,6 +64,8 @@ COPYRIGHT 1993-1999 PARALLAX SOFTWARE CORPORATION.  ALL RIGHTS RESERVED.
 #include "fuelcen.h"
 #include "controls.h"
 #include "kconfig.h"
+#include "cmd.h"
+#include "parallel.h"
 
 #if DXX_USE_EDITOR
 #include "editor/editor.h"
@@ -80,6 +82,7 @@ COPYRIGHT 1993-1999 PARALLAX SOFTWARE CORPORATION.  ALL RIGHTS RESERVED.
 #include "d_enumerate.h"
 #include "d_levelstate.h"
 #include <utility>
+#include <vector>
 
 using std::min;
 
@@ -798,6 +801,74 @@ static void ai_turn_randomly(const vms_vector &vec_to_player, object_base &obj,
 }
 #endif
 
+namespace {
+
+//	A visibility ray cast ahead of time by ai_prefetch_visibility.
+struct ai_visibility_cast
+{
+	vms_vector p0, p1;
+	segnum_t startseg;
+	fvi_hit_type hit_type;
+	vms_vector hit_pnt;
+	fvi_wall_trace walls;
+};
+
+//	The rays cast ahead of time for one robot.  At most two are cast: one
+//	from the gun point do_ai_frame is expected to use, and one from the
+//	robot center.  The entry is only meaningful when frame equals
+//	Ai_visibility_prefetch_frame.
+struct ai_visibility_prefetch
+{
+	unsigned frame;
+	uint8_t count;
+	std::array<ai_visibility_cast, 2> casts;
+};
+
+static std::array<ai_visibility_prefetch, MAX_OBJECTS> Ai_visibility_prefetch;
+static unsigned Ai_visibility_prefetch_frame;
+static bool Ai_visibility_prefetch_enabled{true};
+static bool Ai_visibility_prefetch_pending;
+static unsigned Ai_visibility_prefetch_hits, Ai_visibility_prefetch_misses;
+
+static fvi_query ai_visibility_query(const vms_vector &p0, const vms_vector &p1, const icobjptridx_t objp)
+{
+	return fvi_query{
+		p0,
+		p1,
+		fvi_query::unused_ignore_obj_list,
+		fvi_query::unused_LevelUniqueObjectState,
+		fvi_query::unused_Robot_info,
+		FQ_TRANSWALL, // -- Why were we checking objects? | FQ_CHECK_OBJS;		//what about trans walls???
+		objp,
+	};
+}
+
+//	Cast the visibility ray from pos to Believed_player_pos.  A prefetched
+//	cast is used only if it was made for exactly this query and every wall
+//	it depended on is unchanged, so the result is always the same as
+//	casting the ray here.
+static fvi_hit_type ai_cast_visibility(const vmobjptridx_t objp, const vms_vector &pos, const segnum_t startseg, vms_vector &hit_pnt)
+{
+	auto &p = Ai_visibility_prefetch[objp];
+	if (p.frame == Ai_visibility_prefetch_frame)
+	{
+		for (auto &c : partial_const_range(p.casts, p.count))
+			if (c.startseg == startseg && c.p0 == pos && c.p1 == Believed_player_pos && c.walls.unchanged())
+			{
+				++ Ai_visibility_prefetch_hits;
+				hit_pnt = c.hit_pnt;
+				return c.hit_type;
+			}
+		++ Ai_visibility_prefetch_misses;
+	}
+	fvi_info Hit_data;
+	const auto Hit_type = find_vector_intersection(ai_visibility_query(pos, Believed_player_pos, objp), startseg, F1_0 / 4, Hit_data);
+	hit_pnt = Hit_data.hit_pnt;
+	return Hit_type;
+}
+
+}
+
 //	Overall_agitation affects:
 //		Widens field of view.  Field of view is in range 0..1 (specified in bitmaps.tbl as N/360 degrees).
 //			Overall_agitation/128 subtracted from field of view, making robots see wider.
@@ -845,17 +916,7 @@ player_visibility_state player_is_visible_from_object(const d_robot_info_array &
 		}
 	} else
 		startseg			= obj.segnum;
-	fvi_info Hit_data;
-	const auto Hit_type = find_vector_intersection(fvi_query{
-		pos,
-		Believed_player_pos,
-		fvi_query::unused_ignore_obj_list,
-		fvi_query::unused_LevelUniqueObjectState,
-		fvi_query::unused_Robot_info,
-		FQ_TRANSWALL, // -- Why were we checking objects? | FQ_CHECK_OBJS;		//what about trans walls???
-		objp,
-	}, startseg, F1_0 / 4, Hit_data);
-	Hit_pos = Hit_data.hit_pnt;
+	const auto Hit_type = ai_cast_visibility(objp, pos, startseg, Hit_pos);
 
 	if (Hit_type == fvi_hit_type::None)
 	{
@@ -3219,6 +3280,110 @@ static bool skip_ai_for_time_splice(const vcobjptridx_t robot, const robot_info
 	return false;
 }
 
+static void ai_prefetch_cast(ai_visibility_cast &c, const vcobjptridx_t objp, const vms_vector &p0, const segnum_t startseg, const vms_vector &p1)
+{
+	c.p0 = p0;
+	c.p1 = p1;
+	c.startseg = startseg;
+	fvi_info hit_data;
+	c.hit_type = find_vector_intersection(ai_visibility_query(c.p0, c.p1, objp), startseg, F1_0 / 4, hit_data, c.walls);
+	c.hit_pnt = hit_data.hit_pnt;
+}
+
+//	Runs on a worker thread, so it must only read game state, apart from this
+//	robot's own Ai_visibility_prefetch entry.
+static void ai_prefetch_robot_visibility(const d_robot_info_array &Robot_info, const vcobjptridx_t objp)
+{
+	auto &obj = *objp;
+	auto &p = Ai_visibility_prefetch[objp];
+	p.frame = Ai_visibility_prefetch_frame;
+	p.count = 0;
+	auto &robptr = Robot_info[get_robot_id(obj)];
+	auto &aip = obj.ctype.ai_info;
+	auto &ailp = aip.ail;
+	const auto &target =
+#if defined(DXX_BUILD_DESCENT_II)
+		((aip.SUB_FLAGS & SUB_FLAGS_CAMERA_AWAKE) && Ai_last_missile_camera)
+		? Ai_last_missile_camera->pos
+		:
+#endif
+		ConsoleObject->pos;
+	const auto dist_to_player = vm_vec_dist_quick(target, obj.pos);
+	if (skip_ai_for_time_splice(objp, robptr, dist_to_player))
+		return;
+	//	do_ai_frame subtracts FrameTime from next_fire before it picks the
+	//	gun, so a threshold of FrameTime here matches its threshold of 0.
+	if (ready_to_fire_any_weapon(robptr, ailp, FrameTime) && dist_to_player < F1_0*200 && robptr.n_guns && !robptr.attack_type)
+	{
+		const auto gun_num =
+#if defined(DXX_BUILD_DESCENT_II)
+			(!ready_to_fire_weapon1(ailp, FrameTime))
+			? robot_gun_number::_0
+			:
+#endif
+			aip.CURRENT_GUN;
+		vms_vector gun_point;
+		calc_gun_point(robptr, gun_point, obj, gun_num);
+		auto &Segments = LevelSharedSegmentState.get_segments();
+		const auto &&segnum = find_point_seg(LevelSharedSegmentState, gun_point, Segments.vcptridx(obj.segnum));
+		if (segnum != segment_none)
+			ai_prefetch_cast(p.casts[p.count++], objp, gun_point, segnum, target);
+	}
+	ai_prefetch_cast(p.casts[p.count++], objp, obj.pos, obj.segnum, target);
+}
+
+//	Cast, on the worker threads, the visibility rays that do_ai_frame is
+//	expected to cast this frame.  This runs when the first robot is
+//	processed, after the players have moved, so the predicted rays usually
+//	match.  Only the ray results are computed here.  All AI decisions and
+//	every change to game state, including every d_rand call, still happen in
+//	do_ai_frame in object order.  A wrong prediction costs only the wasted
+//	cast, because ai_cast_visibility then casts the ray itself.
+static void ai_prefetch_visibility(const d_robot_info_array &Robot_info)
+{
+	auto &Objects = LevelUniqueObjectState.Objects;
+	auto &vmobjptr = Objects.vmptr;
+	auto &player_info = get_local_plrobj().ctype.player_info;
+	//	A cloaked player is sought at a randomly perturbed position.
+	if (player_info.powerup_flags & PLAYER_FLAGS_CLOAKED)
+		return;
+#if defined(DXX_BUILD_DESCENT_II)
+	if (cheats.robotskillrobots)
+		return;
+#endif
+	static std::vector<objnum_t> robots;
+	robots.clear();
+	for (auto &&objp : Objects.vcptridx)
+	{
+		if (objp->type == OBJ_ROBOT && objp->control_source == object::control_type::ai && !(objp->flags & OF_SHOULD_BE_DEAD) && !objp->ctype.ai_info.SKIP_AI_COUNT)
+			robots.emplace_back(objp);
+	}
+	parallel_for(robots.size(), [&Robot_info, &Objects](const std::size_t i) {
+		ai_prefetch_robot_visibility(Robot_info, Objects.vcptridx(robots[i]));
+	});
+}
+
+static void ai_cmd_prefetch(unsigned long argc, const char *const *const argv)
+{
+	if (argc > 1)
+		Ai_visibility_prefetch_enabled = strtoul(argv[1], nullptr, 10);
+	con_printf(CON_NORMAL, "ai_prefetch: %s, %u threads: %u hits, %u misses", Ai_visibility_prefetch_enabled ? "on" : "off", get_parallel_thread_count(), Ai_visibility_prefetch_hits, Ai_visibility_prefetch_misses);
+	Ai_visibility_prefetch_hits = Ai_visibility_prefetch_misses = 0;
+}
+
+}
+
+//	Called once per frame, before any object moves.  The prefetch itself is
+//	deferred to the first do_ai_frame call; see ai_prefetch_visibility.
+void ai_start_visibility_prefetch()
+{
+	++ Ai_visibility_prefetch_frame;
+	Ai_visibility_prefetch_pending = Ai_visibility_prefetch_enabled && get_parallel_thread_count() > 1;
+}
+
+void init_ai_commands()
+{
+	cmd_addcommand("ai_prefetch", ai_cmd_prefetch, "ai_prefetch [0|1]\n" "    show robot visibility prefetch counters, and optionally turn prefetching off or on");
 }
 
 // --------------------------------------------------------------------------------------------------------------------
@@ -3261,6 +3426,11 @@ void do_ai_frame(const d_level_shared_robot_info_state &LevelSharedRobotInfoStat
 #if defined(DXX_BUILD_DESCENT_II)
 	auto &Station = LevelUniqueFuelcenterState.Station;
 #endif
+	if (Ai_visibility_prefetch_pending)
+	{
+		Ai_visibility_prefetch_pending = false;
+		ai_prefetch_visibility(Robot_info);
+	}
 	auto &robptr = Robot_info[get_robot_id(obj)];
 	Assert(robptr.always_0xabcd == 0xabcd);
 
@@ -4558,16 +4728,17 @@ static unsigned process_awareness_events(fvcsegptridx &vcsegptridx, d_level_uniq
 }
 
 // ----------------------------------------------------------------------------------
-static void set_player_awareness_all(fvmobjptr &vmobjptr, fvcsegptridx &vcsegptridx, d_level_unique_robot_awareness_state &LevelUniqueRobotAwarenessState)
+static void set_player_awareness_all(d_level_unique_object_state &LevelUniqueObjectState, fvcsegptridx &vcsegptridx, d_level_unique_robot_awareness_state &LevelUniqueRobotAwarenessState)
 {
 	awareness_t New_awareness;
 
 	if (!process_awareness_events(vcsegptridx, LevelUniqueRobotAwarenessState, New_awareness))
 		return;
 
-	for (auto &obj : vmobjptr)
+	for (const auto &&objp : object_type_range(LevelUniqueObjectState.Object_types, LevelUniqueObjectState.Objects.vmptridx, {OBJ_ROBOT}))
 	{
-		if (obj.type == OBJ_ROBOT && obj.control_source == object::control_type::ai)
+		auto &obj = *objp;
+		if (obj.control_source == object::control_type::ai)
 		{
 			auto &ailp = obj.ctype.ai_info.ail;
 			auto &na = New_awareness[obj.segnum];
@@ -4593,12 +4764,11 @@ static void set_player_awareness_all(fvmobjptr &vmobjptr, fvcsegptridx &vcsegptr
 //  Setting player_awareness (a fix, time in seconds which object is aware of player)
 void do_ai_frame_all(const d_robot_info_array &Robot_info)
 {
-	auto &Objects = LevelUniqueObjectState.Objects;
-	auto &vmobjptr = Objects.vmptr;
-
-	set_player_awareness_all(vmobjptr, vcsegptridx, LevelUniqueRobotAwarenessState);
+	set_player_awareness_all(LevelUniqueObjectState, vcsegptridx, LevelUniqueRobotAwarenessState);
 
 #if defined(DXX_BUILD_DESCENT_II)
+	auto &Objects = LevelUniqueObjectState.Objects;
+	auto &vmobjptr = Objects.vmptr;
 	auto &BossUniqueState = LevelUniqueObjectState.BossState;
 	auto &vmobjptridx = Objects.vmptridx;
 	if (Ai_last_missile_camera)
@@ -512,7 +512,7 @@ void init_controlcen_for_level(const d_robot_info_array &Robot_info)
 			 * the boss is kept, and this block removes the control center, so
 			 * that players must destroy the boss to advance to the next level.
 			 */
-			cntrlcen_objp->type = OBJ_GHOST;
+			set_object_type(*cntrlcen_objp, OBJ_GHOST);
 			cntrlcen_objp->control_source = object::control_type::None;
 			cntrlcen_objp->render_type = render_type::RT_NONE;
 			LevelUniqueControlCenterState.Control_center_present = 0;
@@ -73,6 +73,7 @@ COPYRIGHT 1993-1999 PARALLAX SOFTWARE CORPORATION.  ALL RIGHTS RESERVED.
 #include "palette.h"
 #include "gameseq.h"
 #include "collide.h"
+#include "simbench.h"
 #include "escort.h"
 
 #include "d_levelstate.h"
@@ -2572,6 +2573,7 @@ struct assert_no_truncation
 
 void collide_two_objects(const d_robot_info_array &Robot_info, vmobjptridx_t A, vmobjptridx_t B, vms_vector &collision_point)
 {
+	const sim_bench_phase_timer timer{sim_bench_phase::collisions};
 	if (B->type < A->type)
 	{
 		using std::swap;
@@ -2736,6 +2738,7 @@ window_event_result collide_object_with_wall(
 #endif
 	const d_robot_info_array &Robot_info, const vmobjptridx_t A, fix hitspeed, const vmsegptridx_t hitseg, const sidenum_t hitwall, const vms_vector &hitpt)
 {
+	const sim_bench_phase_timer timer{sim_bench_phase::collisions};
 	auto &Objects = LevelUniqueObjectState.Objects;
 
 	switch( A->type )	{
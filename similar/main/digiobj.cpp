@@ -45,6 +45,12 @@ COPYRIGHT 1993-1999 PARALLAX SOFTWARE CORPORATION.  ALL RIGHTS RESERVED.
 
 #include "compiler-range_for.h"
 #include "d_levelstate.h"
+#include "d_enumerate.h"
+#include "d_range.h"
+#include "ai.h"
+#include "fuelcen.h"
+#include "partial_range.h"
+#include "robot.h"
 #include <iterator>
 #include <utility>
 
@@ -177,6 +183,80 @@ int digi_xlat_sound(int soundno)
 	return Sounds[soundno];
 }
 
+std::bitset<MAX_SOUNDS> digi_level_sounds()
+{
+	auto &Robot_info = LevelSharedRobotInfoState.Robot_info;
+	const auto N_robot_types = LevelSharedRobotInfoState.N_robot_types;
+	std::bitset<MAX_ROBOT_TYPES> present;
+	const auto add_robot = [&present, N_robot_types](const robot_id id) {
+		if (const auto r = underlying_value(id); r < N_robot_types)
+			present.set(r);
+	};
+	auto &vcobjptr = LevelUniqueObjectState.Objects.vcptr;
+	for (auto &obj : vcobjptr)
+	{
+		if (obj.type != OBJ_ROBOT)
+			continue;
+		add_robot(get_robot_id(obj));
+		if (obj.contains.type == contained_object_type::robot)
+			add_robot(obj.contains.id.robot);
+	}
+	for (auto &m : partial_const_range(LevelSharedRobotcenterState.RobotCenters, LevelSharedRobotcenterState.Num_robot_centers))
+		for (auto &&[i, flags] : enumerate(m.robot_flags))
+			for (const auto j : xrange(32u))
+				if (flags & (1u << j))
+					add_robot(robot_id{static_cast<uint8_t>(i * 32 + j)});
+	/* Add the robots that present robots leave behind when destroyed,
+	 * until no more are added.  A boss can bring in robots from lists
+	 * that are not known here, so then every robot may appear.
+	 */
+	for (bool added = true; added;)
+	{
+		added = false;
+		for (auto &&[idx, ri] : enumerate(partial_const_range(Robot_info, N_robot_types)))
+		{
+			if (!present[underlying_value(idx)])
+				continue;
+			if (ri.boss_flag != boss_robot_id::None)
+			{
+				for (const auto r : xrange(N_robot_types))
+					present.set(r);
+				break;
+			}
+			if (ri.contains.type == contained_object_type::robot)
+				if (const auto r = underlying_value(ri.contains.id.robot); r < N_robot_types && !present[r])
+				{
+					present.set(r);
+					added = true;
+				}
+		}
+	}
+	/* A sound is left out only if no robot of the level uses it, and
+	 * some other robot does.  Sounds that only absent robots use may
+	 * still be played by other code, which converts them on first use.
+	 */
+	std::bitset<MAX_SOUNDS> robot_sounds, present_sounds;
+	for (auto &&[idx, ri] : enumerate(partial_const_range(Robot_info, N_robot_types)))
+	{
+		auto &s = present[underlying_value(idx)] ? present_sounds : robot_sounds;
+		for (const int soundno : {
+				int{ri.see_sound}, int{ri.attack_sound}, int{ri.claw_sound},
+				int{ri.exp1_sound_num}, int{ri.exp2_sound_num},
+#if defined(DXX_BUILD_DESCENT_II)
+				int{ri.taunt_sound}, int{ri.deathroll_sound},
+#endif
+			})
+			if (soundno >= 0 && soundno < MAX_SOUNDS)
+				s.set(soundno);
+	}
+	std::bitset<MAX_SOUNDS> result;
+	for (const auto soundno : xrange(MAX_SOUNDS))
+		if (!robot_sounds[soundno] || present_sounds[soundno])
+			if (const auto i = digi_xlat_sound(soundno); i >= 0)
+				result.set(i);
+	return result;
+}
+
 namespace {
 
 static int digi_unxlat_sound(int soundno)
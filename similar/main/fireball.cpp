@@ -400,7 +400,17 @@ static imobjptridx_t object_create_explosion_with_damage(const d_robot_info_arra
 		fix damage;
 		// -- now legal for badass explosions on a wall. Assert(obj_explosion_origin != NULL);
 
-		range_for (const auto &&obj_iter, vmobjptridx)
+		/* These are the only types that can_collide accepts.  An object
+		 * that is `maxdistance` or farther along any axis is at least
+		 * that far by vm_vec_dist_quick, so skip it early.
+		 */
+		const object_type_mask damaged_types{
+			OBJ_ROBOT, OBJ_PLAYER, OBJ_CNTRLCEN,
+#if defined(DXX_BUILD_DESCENT_II)
+			OBJ_WEAPON,
+#endif
+		};
+		for (const auto &&obj_iter : object_type_range(LevelUniqueObjectState.Object_types, vmobjptridx, damaged_types, &obj_fireball->pos, vm_distance{maxdistance}))
 		{
 			//	Weapons used to be affected by badass explosions, but this introduces serious problems.
 			//	When a smart bomb blows up, if one of its children goes right towards a nearby wall, it will
@@ -1541,7 +1551,7 @@ void do_explosion_sequence(const d_robot_info_array &Robot_info, object &obj)
 			explode_model(del_obj);		//explode a polygon model
 
 		//set some parm in explosion
-		//If num_objects < MAX_USED_OBJECTS, expl_obj could be set to dead before this setting causing the delete_obj not to be removed. If so, directly delete del_obj
+		//If num_objects < get_max_used_objects(), expl_obj could be set to dead before this setting causing the delete_obj not to be removed. If so, directly delete del_obj
 		if (expl_obj && !(expl_obj->flags & OF_SHOULD_BE_DEAD))
 		{
 			if (del_obj->movement_source == object::movement_type::physics) {
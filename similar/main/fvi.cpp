@@ -24,6 +24,8 @@ COPYRIGHT 1993-1999 PARALLAX SOFTWARE CORPORATION.  ALL RIGHTS RESERVED.
  */
 
 #include <algorithm>
+#include <chrono>
+#include <vector>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
@@ -41,8 +43,12 @@ COPYRIGHT 1993-1999 PARALLAX SOFTWARE CORPORATION.  ALL RIGHTS RESERVED.
 #include "robot.h"
 #include "piggy.h"
 #include "player.h"
+#include "cmd.h"
+#include "console.h"
 #include "compiler-range_for.h"
 #include "d_levelstate.h"
+#include "d_zip.h"
+#include "partial_range.h"
 #include "segiter.h"
 
 using std::min;
@@ -376,24 +382,70 @@ static intersection_type special_check_line_to_face(vms_vector &newp, const vms_
 		return intersection_type::None;			//no hit
 }
 
+//Set to false by fvi_bench to time the exact object test without the
+//bounding box rejection.
+static bool fvi_object_prefilter{true};
+
+//Values which depend only on the vector of a query.  Every object test
+//in one call to find_vector_intersection uses the same vector, so
+//normalize it once, rather than once for each object tested.
+struct fvi_ray
+{
+	const vms_vector &p0;
+	vms_vector dn;
+	const vm_magnitude mag_d;
+	//Axis-aligned box around p0,p1
+	const vms_vector bounds_min, bounds_max;
+	fix64 extent;
+	fvi_ray(const vms_vector &p0, const vms_vector &p1);
+	[[nodiscard]]
+	bool may_hit_sphere(const vms_vector &sphere_pos, fix sphere_rad) const;
+};
+
+fvi_ray::fvi_ray(const vms_vector &p0, const vms_vector &p1) :
+	p0(p0),
+	mag_d{vm_vec_copy_normalize(dn, vm_vec_sub(p1, p0))},
+	bounds_min{std::min(p0.x, p1.x), std::min(p0.y, p1.y), std::min(p0.z, p1.z)},
+	bounds_max{std::max(p0.x, p1.x), std::max(p0.y, p1.y), std::max(p0.z, p1.z)},
+	extent{std::max({
+		static_cast<fix64>(bounds_max.x) - bounds_min.x,
+		static_cast<fix64>(bounds_max.y) - bounds_min.y,
+		static_cast<fix64>(bounds_max.z) - bounds_min.z
+	})}
+{
+}
+
+//Conservative test used to skip check_vector_to_sphere_1.  A hit
+//requires the sphere to touch the vector, so the center must be within
+//sphere_rad of the box around the vector.  The margin is doubled and
+//widened in proportion to the vector length to cover the rounding in
+//the fixed point normalize, so that this never rejects a sphere that
+//check_vector_to_sphere_1 would report as hit.
+bool fvi_ray::may_hit_sphere(const vms_vector &sphere_pos, const fix sphere_rad) const
+{
+	const fix64 margin{(static_cast<fix64>(sphere_rad) << 1) + F1_0 + (extent >> 6)};
+	const auto outside = [margin](const fix c, const fix lo, const fix hi) {
+		return c < lo - margin || c > hi + margin;
+	};
+	return !(outside(sphere_pos.x, bounds_min.x, bounds_max.x) ||
+		outside(sphere_pos.y, bounds_min.y, bounds_max.y) ||
+		outside(sphere_pos.z, bounds_min.z, bounds_max.z));
+}
+
 //maybe this routine should just return the distance and let the caller
 //decide it it's close enough to hit
 //determine if and where a vector intersects with a sphere
-//vector defined by p0,p1
+//vector defined by ray
 //returns dist if intersects, and fills in intp
 //else returns 0
 [[nodiscard]]
-static vm_distance_squared check_vector_to_sphere_1(vms_vector &intp,const vms_vector &p0,const vms_vector &p1,const vms_vector &sphere_pos,fix sphere_rad)
+static vm_distance_squared check_vector_to_sphere_1(vms_vector &intp, const fvi_ray &ray, const vms_vector &sphere_pos, const fix sphere_rad)
 {
-	vms_vector dn;
-
-	//this routine could be optimized if it's taking too much time!
-
-	const auto d{vm_vec_sub(p1, p0)};
+	auto &p0 = ray.p0;
+	auto &dn = ray.dn;
+	const auto mag_d{ray.mag_d};
 	const auto w{vm_vec_sub(sphere_pos, p0)};
 
-	const auto mag_d{vm_vec_copy_normalize(dn, d)};
-
 	if (mag_d == 0) {
 		const auto int_dist{vm_vec_mag2(w)};
 		intp = p0;
@@ -556,7 +608,7 @@ static vm_distance_squared check_vector_to_sphere_1(vms_vector &intp,const vms_v
 //determine if a vector intersects with an object
 //if no intersects, returns 0, else fills in intp and returns dist
 [[nodiscard]]
-static vm_distance_squared check_vector_to_object(const d_robot_info_array *const Robot_info, vms_vector &intp, const vms_vector &p0, const vms_vector &p1, const fix rad, const object_base &obj, const object &otherobj)
+static vm_distance_squared check_vector_to_object(const d_robot_info_array *const Robot_info, vms_vector &intp, const fvi_ray &ray, const fix rad, const object_base &obj, const object &otherobj)
 {
 	fix size{obj.size};
 
@@ -571,7 +623,9 @@ static vm_distance_squared check_vector_to_object(const d_robot_info_array *cons
 	 		((Game_mode & GM_MULTI_COOP) && otherobj.type == OBJ_WEAPON && otherobj.ctype.laser_info.parent_type == OBJ_PLAYER)))
 		size = size/2;
 
-	return check_vector_to_sphere_1(intp, p0, p1, obj.pos, size+rad);
+	if (fvi_object_prefilter && !ray.may_hit_sphere(obj.pos, size + rad))
+		return vm_distance_squared::minimum_value;
+	return check_vector_to_sphere_1(intp, ray, obj.pos, size+rad);
 }
 
 #define MAX_SEGS_VISITED 100
@@ -588,7 +642,10 @@ struct fvi_segments_visited_t : public fvi_segment_visit_count_t, public visited
 
 namespace dsx {
 namespace {
-static fvi_hit_type fvi_sub(const fvi_query &, vms_vector &intp, segnum_t &ints, const vcsegptridx_t startseg, fix rad, fvi_info::segment_array_t &seglist, segnum_t entry_seg, fvi_segments_visited_t &visited, sidenum_t &fvi_hit_side, icsegidx_t &fvi_hit_side_seg, unsigned &fvi_nest_count, icsegidx_t &fvi_hit_pt_seg, const vms_vector *&wall_norm, icobjidx_t &fvi_hit_object);
+static void fvi_record_query(const fvi_query &fq, segnum_t startseg, fix rad);
+static unsigned fvi_record_remaining;
+static fvi_hit_type fvi_find(const fvi_query &fq, segnum_t startseg, fix rad, fvi_info &hit_data, fvi_wall_trace *trace);
+static fvi_hit_type fvi_sub(const fvi_query &, const fvi_ray &, vms_vector &intp, segnum_t &ints, const vcsegptridx_t startseg, fix rad, fvi_info::segment_array_t &seglist, segnum_t entry_seg, fvi_segments_visited_t &visited, sidenum_t &fvi_hit_side, icsegidx_t &fvi_hit_side_seg, unsigned &fvi_nest_count, icsegidx_t &fvi_hit_pt_seg, const vms_vector *&wall_norm, icobjidx_t &fvi_hit_object, fvi_wall_trace *trace);
 }
 
 //What the hell is fvi_hit_seg for???
@@ -604,6 +661,47 @@ static fvi_hit_type fvi_sub(const fvi_query &, vms_vector &intp, segnum_t &ints,
 //  check_obj_flag	determines whether collisions with objects are checked
 //Returns the hit_data->hit_type
 fvi_hit_type find_vector_intersection(const fvi_query fq, const segnum_t startseg, const fix rad, fvi_info &hit_data)
+{
+	if (unlikely(fvi_record_remaining))
+		fvi_record_query(fq, startseg, rad);
+	return fvi_find(fq, startseg, rad, hit_data, nullptr);
+}
+
+//As above, but also fill in trace with every wall the result depended
+//on.  This variant may be called from worker threads, so it does not
+//feed fvi_record.
+fvi_hit_type find_vector_intersection(const fvi_query &fq, const segnum_t startseg, const fix rad, fvi_info &hit_data, fvi_wall_trace &trace)
+{
+	trace.count = 0;
+	trace.overflow = false;
+	return fvi_find(fq, startseg, rad, hit_data, &trace);
+}
+
+void fvi_wall_trace::add(const segnum_t segnum, const sidenum_t sidenum, const wall_is_doorway_result wid)
+{
+	if (count >= sides.size())
+	{
+		overflow = true;
+		return;
+	}
+	sides[count++] = {segnum, sidenum, wid};
+}
+
+bool fvi_wall_trace::unchanged() const
+{
+	if (overflow)
+		return false;
+	auto &Walls = LevelUniqueWallSubsystemState.Walls;
+	auto &vcwallptr = Walls.vcptr;
+	for (auto &s : partial_const_range(sides, count))
+		if (WALL_IS_DOORWAY(GameBitmaps, Textures, vcwallptr, vcsegptr(s.segnum), s.sidenum) != s.wid)
+			return false;
+	return true;
+}
+
+namespace {
+
+static fvi_hit_type fvi_find(const fvi_query &fq, const segnum_t startseg, const fix rad, fvi_info &hit_data, fvi_wall_trace *const trace)
 {
 	auto &LevelSharedVertexState = LevelSharedSegmentState.get_vertex_state();
 	auto &Vertices = LevelSharedVertexState.get_vertices();
@@ -649,7 +747,8 @@ fvi_hit_type find_vector_intersection(const fvi_query fq, const segnum_t startse
 	segnum_t hit_seg2{segment_none};
 
 	const vms_vector *wall_norm{nullptr};	//surface normal of hit wall
-	const auto hit_type = fvi_sub(fq, hit_pnt, hit_seg2, vcsegptridx(startseg), rad, hit_data.seglist, segment_exit, visited, fvi_hit_side, fvi_hit_side_seg, fvi_nest_count, fvi_hit_pt_seg, wall_norm, fvi_hit_object);
+	const fvi_ray ray{fq.p0, fq.p1};
+	const auto hit_type = fvi_sub(fq, ray, hit_pnt, hit_seg2, vcsegptridx(startseg), rad, hit_data.seglist, segment_exit, visited, fvi_hit_side, fvi_hit_side_seg, fvi_nest_count, fvi_hit_pt_seg, wall_norm, fvi_hit_object, trace);
 	segnum_t hit_seg;
 	if (hit_seg2 != segment_none && get_seg_masks(vcvertptr, hit_pnt, vcsegptr(hit_seg2), 0).centermask == sidemask_t{})
 		hit_seg = hit_seg2;
@@ -668,7 +767,7 @@ fvi_hit_type find_vector_intersection(const fvi_query fq, const segnum_t startse
 		//because of code that deal with object with non-zero radius has
 		//problems, try using zero radius and see if we hit a wall
 
-		const auto new_hit_type{fvi_sub(fq, new_hit_pnt, new_hit_seg2, vcsegptridx(startseg), 0, hit_data.seglist, segment_exit, visited, fvi_hit_side, fvi_hit_side_seg, fvi_nest_count, fvi_hit_pt_seg, wall_norm, fvi_hit_object)};
+		const auto new_hit_type{fvi_sub(fq, ray, new_hit_pnt, new_hit_seg2, vcsegptridx(startseg), 0, hit_data.seglist, segment_exit, visited, fvi_hit_side, fvi_hit_side_seg, fvi_nest_count, fvi_hit_pt_seg, wall_norm, fvi_hit_object, trace)};
 		(void)new_hit_type; // FIXME! This should become hit_type, right?
 
 		if (new_hit_seg2 != segment_none) {
@@ -744,8 +843,6 @@ fvi_hit_type find_vector_intersection(const fvi_query fq, const segnum_t startse
 	return hit_type;
 }
 
-namespace {
-
 static int check_trans_wall(const vms_vector &pnt, vcsegptridx_t seg, sidenum_t sidenum, int facenum);
 }
 }
@@ -763,7 +860,7 @@ static void append_segments(fvi_info::segment_array_t &dst, const fvi_info::segm
 
 namespace dsx {
 namespace {
-static fvi_hit_type fvi_sub(const fvi_query &fq, vms_vector &intp, segnum_t &ints, const vcsegptridx_t startseg, fix rad, fvi_info::segment_array_t &seglist, segnum_t entry_seg, fvi_segments_visited_t &visited, sidenum_t &fvi_hit_side, icsegidx_t &fvi_hit_side_seg, unsigned &fvi_nest_count, icsegidx_t &fvi_hit_pt_seg, const vms_vector *&wall_norm, icobjidx_t &fvi_hit_object)
+static fvi_hit_type fvi_sub(const fvi_query &fq, const fvi_ray &ray, vms_vector &intp, segnum_t &ints, const vcsegptridx_t startseg, fix rad, fvi_info::segment_array_t &seglist, segnum_t entry_seg, fvi_segments_visited_t &visited, sidenum_t &fvi_hit_side, icsegidx_t &fvi_hit_side_seg, unsigned &fvi_nest_count, icsegidx_t &fvi_hit_pt_seg, const vms_vector *&wall_norm, icobjidx_t &fvi_hit_object, fvi_wall_trace *trace)
 {
 	auto &LevelSharedVertexState = LevelSharedSegmentState.get_vertex_state();
 	auto &Vertices = LevelSharedVertexState.get_vertices();
@@ -847,7 +944,7 @@ static fvi_hit_type fvi_sub(const fvi_query &fq, vms_vector &intp, segnum_t &int
 				fudged_rad = rad/2;	//(rad*3)/4;
 
 			vms_vector hit_point;
-			const auto &&d = check_vector_to_object(Robot_info, hit_point, fq.p0, fq.p1, fudged_rad, objnum, thisobjnum);
+			const auto &&d = check_vector_to_object(Robot_info, hit_point, ray, fudged_rad, objnum, thisobjnum);
 			if (d != vm_distance_squared{0})          //we have intersection
 				if (d < closest_d) {
 					fvi_hit_object = objnum;
@@ -915,6 +1012,10 @@ static fvi_hit_type fvi_sub(const fvi_query &fq, vms_vector &intp, segnum_t &int
 						auto &Walls = LevelUniqueWallSubsystemState.Walls;
 						auto &vcwallptr = Walls.vcptr;
 						auto wid_flag = WALL_IS_DOORWAY(GameBitmaps, Textures, vcwallptr, startseg, side);
+						//Sides without a wall always give the same answer,
+						//so only walls need to be traced.
+						if (trace && startseg->shared_segment::sides[side].wall_num != wall_none)
+							trace->add(startseg, side, wid_flag);
 
 						//if what we have hit is a door, check the adjoining seg
 
@@ -950,7 +1051,7 @@ static fvi_hit_type fvi_sub(const fvi_query &fq, vms_vector &intp, segnum_t &int
 									goto quit_looking;		//we've looked a long time, so give up
 
 								fvi_info::segment_array_t temp_seglist;
-								const auto sub_hit_type = fvi_sub(fq, sub_hit_point, sub_hit_seg, startseg.absolute_sibling(newsegnum), rad, temp_seglist, startseg, visited, fvi_hit_side, fvi_hit_side_seg, fvi_nest_count, fvi_hit_pt_seg, wall_norm, fvi_hit_object);
+								const auto sub_hit_type = fvi_sub(fq, ray, sub_hit_point, sub_hit_seg, startseg.absolute_sibling(newsegnum), rad, temp_seglist, startseg, visited, fvi_hit_side, fvi_hit_side_seg, fvi_nest_count, fvi_hit_pt_seg, wall_norm, fvi_hit_object, trace);
 
 								if (sub_hit_type != fvi_hit_type::None)
 								{
@@ -1261,3 +1362,122 @@ sphere_intersects_wall_result sphere_intersects_wall(fvcsegptridx &vcsegptridx,
 	fvi_segments_visited_t visited;
 	return sphere_intersects_wall(vcsegptridx, vcvertptr, pnt, seg, rad, visited);
 }
+
+namespace dsx {
+
+namespace {
+
+//Queries captured by fvi_record, for replay by fvi_bench.
+struct fvi_recorded_query
+{
+	vms_vector p0, p1;
+	segnum_t startseg;
+	fix rad;
+	int flags;
+	objnum_t thisobjnum;
+	bool check_objects;
+	std::vector<objnum_t> ignore_obj_list;
+};
+
+static std::vector<fvi_recorded_query> fvi_recorded_queries;
+
+static void fvi_record_query(const fvi_query &fq, const segnum_t startseg, const fix rad)
+{
+	-- fvi_record_remaining;
+	auto &r = fvi_recorded_queries.emplace_back();
+	r.p0 = fq.p0;
+	r.p1 = fq.p1;
+	r.startseg = startseg;
+	r.rad = rad;
+	r.flags = fq.flags;
+	r.thisobjnum = fq.thisobjnum;
+	r.check_objects = fq.LevelUniqueObjectState != nullptr;
+	r.ignore_obj_list.assign(fq.ignore_obj_list.begin(), fq.ignore_obj_list.end());
+	if (!fvi_record_remaining)
+		con_printf(CON_NORMAL, "fvi_record: captured %zu queries", fvi_recorded_queries.size());
+}
+
+static void fvi_cmd_record(unsigned long argc, const char *const *const argv)
+{
+	fvi_recorded_queries.clear();
+	fvi_record_remaining = argc > 1 ? strtoul(argv[1], nullptr, 10) : 10000;
+	fvi_recorded_queries.reserve(fvi_record_remaining);
+	con_printf(CON_NORMAL, "fvi_record: capturing the next %u queries", fvi_record_remaining);
+}
+
+//Replay the captured queries against the current level state, with and
+//without the object rejection test, and report the time spent and any
+//difference in the results.
+static void fvi_cmd_bench(unsigned long argc, const char *const *const argv)
+{
+	if (fvi_recorded_queries.empty())
+	{
+		con_puts(CON_NORMAL, "fvi_bench: no queries recorded; use fvi_record first");
+		return;
+	}
+	const unsigned long passes = argc > 1 ? std::max(strtoul(argv[1], nullptr, 10), 1ul) : 10;
+	auto &Objects = LevelUniqueObjectState.Objects;
+	const auto segment_count = LevelSharedSegmentState.get_segments().get_count();
+	const auto replay = [&](std::vector<fvi_info> &results) {
+		results.clear();
+		std::vector<vcobjidx_t> ignore_obj_list;
+		for (auto &r : fvi_recorded_queries)
+		{
+			/* Skip queries which no longer make sense in this level, such
+			 * as those from an object that has since been deleted.
+			 */
+			if (r.startseg >= segment_count)
+				continue;
+			const auto &&thisobj = Objects.imptridx(r.thisobjnum);
+			if (r.check_objects && (thisobj == object_none || thisobj->type == OBJ_NONE))
+				continue;
+			ignore_obj_list.clear();
+			for (const auto o : r.ignore_obj_list)
+				ignore_obj_list.emplace_back(o);
+			auto &h = results.emplace_back();
+			(void)find_vector_intersection(fvi_query{
+				r.p0,
+				r.p1,
+				{ignore_obj_list.data(), ignore_obj_list.data() + ignore_obj_list.size()},
+				r.check_objects ? &LevelUniqueObjectState : fvi_query::unused_LevelUniqueObjectState,
+				&LevelSharedRobotInfoState.Robot_info,
+				r.flags,
+				thisobj,
+			}, r.startseg, r.rad, h);
+		}
+	};
+	std::vector<fvi_info> filtered, exact;
+	filtered.reserve(fvi_recorded_queries.size());
+	exact.reserve(fvi_recorded_queries.size());
+	using std::chrono::steady_clock;
+	steady_clock::duration filtered_time{}, exact_time{};
+	for (unsigned long i = 0; i < passes; ++i)
+	{
+		fvi_object_prefilter = false;
+		const auto t0 = steady_clock::now();
+		replay(exact);
+		fvi_object_prefilter = true;
+		const auto t1 = steady_clock::now();
+		replay(filtered);
+		const auto t2 = steady_clock::now();
+		exact_time += t1 - t0;
+		filtered_time += t2 - t1;
+	}
+	unsigned mismatches = 0;
+	for (const auto &&[a, b] : zip(filtered, exact))
+		if (a.hit_pnt != b.hit_pnt || a.hit_seg != b.hit_seg || a.hit_object != b.hit_object || a.hit_side != b.hit_side)
+			++ mismatches;
+	using std::chrono::duration_cast;
+	using std::chrono::microseconds;
+	con_printf(CON_NORMAL, "fvi_bench: %zu queries x %lu passes: exact %lu us, filtered %lu us, %u mismatches", filtered.size(), passes, static_cast<unsigned long>(duration_cast<microseconds>(exact_time).count()), static_cast<unsigned long>(duration_cast<microseconds>(filtered_time).count()), mismatches);
+}
+
+}
+
+void init_fvi_commands()
+{
+	cmd_addcommand("fvi_record", fvi_cmd_record, "fvi_record [count]\n" "    capture the next <count> find_vector_intersection queries");
+	cmd_addcommand("fvi_bench", fvi_cmd_bench, "fvi_bench [passes]\n" "    replay captured queries with and without the object bounding box test");
+}
+
+}
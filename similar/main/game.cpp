@@ -99,6 +99,7 @@ COPYRIGHT 1993-1999 PARALLAX SOFTWARE CORPORATION.  ALL RIGHTS RESERVED.
 #include "playsave.h"
 #include "maths.h"
 #include "hudmsg.h"
+#include "simbench.h"
 #if defined(DXX_BUILD_DESCENT_II)
 #include <climits>
 #include "gamepal.h"
@@ -159,7 +160,6 @@ game_window *Game_wind;
 
 namespace {
 
-static window_event_result GameProcessFrame(const d_level_shared_robot_info_state &);
 static bool FireLaser(player_info &, const control_info &Controls);
 static void powerup_grab_cheat_all();
 
@@ -665,6 +665,12 @@ void calc_frame_time()
 	if (FrameTime < 0)				//if bogus frametime...
 		FrameTime = (last_frametime==0?1:last_frametime);		//...then use time from last frame
 
+	advance_game_time();
+}
+
+//Advance the game clocks by FrameTime
+void advance_game_time()
+{
 	GameTime64 += FrameTime;
 
 	calc_d_tick();
@@ -1577,6 +1583,8 @@ void show_netgame_help()
 	DXX_MENUITEM(VERB, TEXT, "SHIFT-LEFT\t  FAST BACKWARD", DEMOHELP_FAST_BACKWARD)	\
 	DXX_MENUITEM(VERB, TEXT, "CTRL-RIGHT\t  JUMP TO END", DEMOHELP_JUMP_END)	\
 	DXX_MENUITEM(VERB, TEXT, "CTRL-LEFT\t  JUMP TO START", DEMOHELP_JUMP_START)	\
+	DXX_MENUITEM(VERB, TEXT, "PAGE DOWN\t  SKIP 15 SECONDS FORWARD", DEMOHELP_SKIP_FORWARD)	\
+	DXX_MENUITEM(VERB, TEXT, "PAGE UP\t  SKIP 15 SECONDS BACKWARD", DEMOHELP_SKIP_BACKWARD)	\
 	_DXX_HELP_MENU_HINT_CMD_KEY(VERB, DEMOHELP)	\
 
 enum {
@@ -1970,8 +1978,6 @@ void game_leave_menus(void)
 
 namespace dsx {
 
-namespace {
-
 window_event_result GameProcessFrame(const d_level_shared_robot_info_state &LevelSharedRobotInfoState)
 {
 	auto &LevelUniqueControlCenterState = LevelUniqueObjectState.ControlCenterState;
@@ -2085,14 +2091,20 @@ window_event_result GameProcessFrame(const d_level_shared_robot_info_state &Leve
 #ifndef NEWHOMER
 		player_info.homing_object_dist = -1; // Assume not being tracked.  Laser_do_weapon_sequence modifies this.
 #endif
-		result = std::max(game_move_all_objects(LevelSharedRobotInfoState), result);
+		{
+			const sim_bench_phase_timer timer{sim_bench_phase::object_movement};
+			result = std::max(game_move_all_objects(LevelSharedRobotInfoState), result);
+		}
 		powerup_grab_cheat_all();
 
 		if (Endlevel_sequence)	//might have been started during move
 			return result;
 
 		fuelcen_update_all(LevelSharedRobotInfoState.Robot_info);
-		do_ai_frame_all(LevelSharedRobotInfoState.Robot_info);
+		{
+			const sim_bench_phase_timer timer{sim_bench_phase::ai};
+			do_ai_frame_all(LevelSharedRobotInfoState.Robot_info);
+		}
 
 		auto laser_firing_count = FireLaser(player_info, Controls);
 		if (auto &Auto_fire_fusion_cannon_time = player_info.Auto_fire_fusion_cannon_time)
@@ -2150,8 +2162,6 @@ window_event_result GameProcessFrame(const d_level_shared_robot_info_state &Leve
 	return result;
 }
 
-}
-
 #if defined(DXX_BUILD_DESCENT_II)
 void compute_slide_segs()
 {
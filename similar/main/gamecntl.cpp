@@ -668,6 +668,10 @@ static window_event_result HandleDemoKey(int key)
 		case KEY_CTRLED + KEY_LEFT:
 			return newdemo_goto_beginning();
 			break;
+		case KEY_PAGEDOWN:
+			return newdemo_skip_seconds(15);
+		case KEY_PAGEUP:
+			return newdemo_skip_seconds(-15);
 
 		KEY_MAC(case KEY_COMMAND+KEY_P:)
 		case KEY_PAUSE:
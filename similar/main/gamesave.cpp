@@ -43,6 +43,7 @@ COPYRIGHT 1993-1999 PARALLAX SOFTWARE CORPORATION.  ALL RIGHTS RESERVED.
 #include "object.h"
 #include "game.h"
 #include "gameseg.h"
+#include "render.h"
 #include "wall.h"
 #include "gamemine.h"
 #include "robot.h"
@@ -1148,7 +1149,7 @@ static int load_game_data(
 			if (objsegnum > Highest_segment_index)		//bogus object
 			{
 				Warning("Object %p is in non-existent segment %hu, highest=%hu", &i, objsegnum, Highest_segment_index);
-				i.type = OBJ_NONE;
+				set_object_type(i, OBJ_NONE);
 			}
 			else {
 				obj_link_unchecked(Objects.vmptr, vmobjptridx(&i), vmsegptridx(objsegnum));
@@ -1528,6 +1529,8 @@ int load_level(
 #if defined(DXX_BUILD_DESCENT_II)
 	compute_slide_segs();
 #endif
+	flush_fcd_cache();
+	flush_segment_list_cache();
 	return 0;
 }
 }
@@ -25,7 +25,9 @@ COPYRIGHT 1993-1999 PARALLAX SOFTWARE CORPORATION.  ALL RIGHTS RESERVED.
 
 #include <algorithm>
 #include <cassert>
+#include <chrono>
 #include <numeric>
+#include <random>
 #include <stdlib.h>
 #include <stdio.h>
 #include <string.h>	//	for memset()
@@ -35,6 +37,7 @@ COPYRIGHT 1993-1999 PARALLAX SOFTWARE CORPORATION.  ALL RIGHTS RESERVED.
 #include "game.h"
 #include "dxxerror.h"
 #include "console.h"
+#include "cmd.h"
 #include "vecmat.h"
 #include "gameseg.h"
 #include "wall.h"
@@ -98,7 +101,6 @@ struct verts_for_normal
 	}
 };
 
-constexpr vm_distance fcd_abort_cache_value{F1_0 * 1000};
 constexpr vm_distance fcd_abort_return_value{-1};
 
 #if defined(DXX_BUILD_DESCENT_II)
@@ -770,119 +772,100 @@ icsegptridx_t find_point_seg(const d_level_shared_segment_state &LevelSharedSegm
 //--repair-- 	return ((Lsegment_highest_segment_index == Highest_segment_index) && (Lsegment_highest_vertex_index == Highest_vertex_index));
 //--repair-- }
 
-#if defined(DXX_BUILD_DESCENT_I)
-namespace {
-static inline void add_to_fcd_cache(segnum_t seg0, segnum_t seg1, vm_distance dist)
-{
-	(void)seg0;
-	(void)seg1;
-	(void)dist;
-}
-}
-#elif defined(DXX_BUILD_DESCENT_II)
-#define	MIN_CACHE_FCD_DIST	(F1_0*80)	//	Must be this far apart for cache lookup to succeed.  Recognizes small changes in distance matter at small distances.
 namespace {
 
-struct fcd_data {
-	segnum_t	seg0, seg1;
-	vm_distance dist;
+//	Outcome of one breadth-first search from seg0 to seg1.  The search
+//	depends only on the segment pair, the depth limit, the doorway mask
+//	and the state of the walls.  The caller's positions only enter into
+//	the first and last legs of the path, so the segments at either end
+//	of the path plus the length of the path between them are enough to
+//	rebuild the exact distance for any p0/p1.
+struct fcd_path
+{
+	//	Path segment adjacent to seg0 (near_seg0) and to seg1 (near_seg1).
+	//	near_seg0 is segment_none if the search was aborted.
+	segnum_t near_seg0 = segment_none, near_seg1 = segment_none;
+	vm_distance interior;
 };
 
-fix64	Last_fcd_flush_time;
-unsigned Fcd_index;
-std::array<fcd_data, 8> Fcd_cache;
-
-static void add_to_fcd_cache(const segnum_t seg0, const segnum_t seg1, const vm_distance dist)
+//	Direct-mapped table of recent searches.  Every entry is stamped with
+//	the wall generation that was current when it was computed.
+//	flush_fcd_cache advances the generation, which invalidates the whole
+//	table in O(1) without touching it.
+class fcd_cache_table
 {
-	if (dist > MIN_CACHE_FCD_DIST) {
-		if (Fcd_index >= Fcd_cache.size())
-			Fcd_index = 0;
-		auto &f = Fcd_cache[Fcd_index++];
-		f.seg0 = seg0;
-		f.seg1 = seg1;
-		f.dist = dist;
-	} else {
-		//	If it's in the cache, remove it.
-		for (auto &f : Fcd_cache)
-			if (f.seg0 == seg0 && f.seg1 == seg1)
-			{
-				f.seg0 = segment_none;
-				break;
-			}
+	struct entry : fcd_path
+	{
+		uint64_t key;
+		unsigned generation;
+	};
+	static constexpr unsigned table_bits = 12;
+	std::array<entry, 1u << table_bits> table{};
+	unsigned generation = 1;
+	static constexpr std::size_t slot(const uint64_t key)
+	{
+		return (key * UINT64_C(0x9e3779b97f4a7c15)) >> (64 - table_bits);
 	}
-}
-
-}
+public:
+	fix64 last_flush_time;
+	unsigned hits, misses;
+	static constexpr uint64_t build_key(const segnum_t seg0, const segnum_t seg1, const int max_depth, const wall_is_doorway_mask wid_flag)
+	{
+		return static_cast<uint64_t>(static_cast<uint16_t>(seg0)) |
+			(static_cast<uint64_t>(static_cast<uint16_t>(seg1)) << 16) |
+			(static_cast<uint64_t>(static_cast<uint8_t>(max_depth + 1)) << 32) |
+			(static_cast<uint64_t>(static_cast<uint8_t>(wid_flag)) << 40);
+	}
+	const fcd_path *find(const uint64_t key)
+	{
+		auto &e = table[slot(key)];
+		if (e.generation == generation && e.key == key)
+		{
+			++ hits;
+			return &e;
+		}
+		++ misses;
+		return nullptr;
+	}
+	void insert(const uint64_t key, const fcd_path &p)
+	{
+		auto &e = table[slot(key)];
+		static_cast<fcd_path &>(e) = p;
+		e.key = key;
+		e.generation = generation;
+	}
+	void flush()
+	{
+		if (unlikely(!++ generation))
+		{
+			/* Generation wrapped.  Clear the table so that entries
+			 * from the previous cycle cannot appear valid again.
+			 */
+			table = {};
+			generation = 1;
+		}
+		last_flush_time = GameTime64;
+	}
+};
 
-//	----------------------------------------------------------------------------------------------------------
-void flush_fcd_cache()
-{
-	Fcd_index = 0;
-	Last_fcd_flush_time = {GameTime64};
+fcd_cache_table Fcd_cache;
 
-	for (auto &f : Fcd_cache)
-		f.seg0 = segment_none;
-}
-#endif
+constexpr int fcd_max_path_segments = 64;
 
-//	----------------------------------------------------------------------------------------------------------
-//	Determine whether seg0 and seg1 are reachable in a way that allows sound to pass.
-//	Search up to a maximum depth of max_depth.
-//	Return the distance.
-vm_distance find_connected_distance(const vms_vector &p0, const vcsegptridx_t seg0, const vms_vector &p1, const vcsegptridx_t seg1, int max_depth, const wall_is_doorway_mask wid_flag)
+//	Uncached search used by find_connected_distance.  max_depth must
+//	already be clamped.
+static fcd_path fcd_search(fvcvertptr &vcvertptr, const vcsegptridx_t seg0, const vcsegptridx_t seg1, const int max_depth, const wall_is_doorway_mask wid_flag)
 {
-	auto &LevelSharedVertexState = LevelSharedSegmentState.get_vertex_state();
-	auto &Vertices = LevelSharedVertexState.get_vertices();
 	segnum_t		cur_seg;
 	int		qtail = 0, qhead = 0;
 	seg_seg	seg_queue[MAX_SEGMENTS];
 	int		cur_depth;
 	int		num_points;
-	struct point_seg
-	{
-		vms_vector point;
-	};
-	std::array<point_seg, 64> point_segs;
-
-	//	If > this, will overrun point_segs buffer
-#ifdef WINDOWS
-	if (max_depth == -1) max_depth = 200;
-#endif	
-
-	if (const auto s = std::size(point_segs) - 2u; max_depth > s)
-		max_depth = s;
+	std::array<segnum_t, fcd_max_path_segments> point_segs;
+	fcd_path result;
 
 	auto &Walls = LevelUniqueWallSubsystemState.Walls;
 	auto &vcwallptr = Walls.vcptr;
-	if (seg0 == seg1) {
-		return vm_vec_dist_quick(p0, p1);
-	} else {
-		auto conn_side = find_connect_side(seg0, seg1);
-		if (conn_side != side_none)
-		{
-#if defined(DXX_BUILD_DESCENT_II)
-			if (WALL_IS_DOORWAY(GameBitmaps, Textures, vcwallptr, seg1, conn_side) & wid_flag)
-#endif
-			{
-				return vm_vec_dist_quick(p0, p1);
-			}
-		}
-	}
-
-#if defined(DXX_BUILD_DESCENT_II)
-	//	Periodically flush cache.
-	if ((GameTime64 - Last_fcd_flush_time > F1_0*2) || (GameTime64 < Last_fcd_flush_time)) {
-		flush_fcd_cache();
-	}
-
-	else
-	//	Can't quickly get distance, so see if in Fcd_cache.
-	range_for (auto &i, Fcd_cache)
-		if (i.seg0 == seg0 && i.seg1 == seg1)
-		{
-			return i.dist;
-		}
-#endif
 
 	num_points = 0;
 
@@ -910,20 +893,16 @@ vm_distance find_connected_distance(const vms_vector &p0, const vcsegptridx_t se
 					seg_queue[qtail].end = this_seg;
 					depth[qtail++] = cur_depth+1;
 					if (max_depth != -1) {
-						if (depth[qtail-1] == max_depth) {
-							add_to_fcd_cache(seg0, seg1, fcd_abort_cache_value);
-							return fcd_abort_return_value;
-						}
+						if (depth[qtail-1] == max_depth)
+							return result;
 					} else if (this_seg == seg1) {
 						goto fcd_done1;
 					}
 			}
 		}	//	for (sidenum...
 
-		if (qhead >= qtail) {
-			add_to_fcd_cache(seg0, seg1, fcd_abort_cache_value);
-			return fcd_abort_return_value;
-		}
+		if (qhead >= qtail)
+			return result;
 
 		cur_seg = seg_queue[qhead].end;
 		cur_depth = depth[qhead];
@@ -934,18 +913,15 @@ fcd_done1: ;
 
 	//	Set qtail to the segment which ends at the goal.
 	while (seg_queue[--qtail].end != seg1)
-		if (qtail < 0) {
-			add_to_fcd_cache(seg0, seg1, fcd_abort_cache_value);
-			return fcd_abort_return_value;
-		}
+		if (qtail < 0)
+			return result;
 
-	auto &vcvertptr = Vertices.vcptr;
 	while (qtail >= 0) {
 		segnum_t	parent_seg, this_seg;
 
 		this_seg = seg_queue[qtail].end;
 		parent_seg = seg_queue[qtail].start;
-		point_segs[num_points].point = compute_segment_center(vcvertptr, vcsegptr(this_seg));
+		point_segs[num_points] = this_seg;
 		num_points++;
 
 		if (parent_seg == seg0)
@@ -955,23 +931,161 @@ fcd_done1: ;
 			Assert(qtail >= 0);
 	}
 
-	point_segs[num_points].point = compute_segment_center(vcvertptr, seg0);
+	point_segs[num_points] = seg0;
 	num_points++;
 
-	if (num_points == 1) {
-		return vm_vec_dist_quick(p0, p1);
-	}
-	auto dist = vm_vec_dist_quick(p1, point_segs[1].point);
-		dist += vm_vec_dist_quick(p0, point_segs[num_points-2].point);
-
+	result.near_seg1 = point_segs[1];
+	result.near_seg0 = point_segs[num_points - 2];
+	if (num_points > 3)
+	{
+		auto prev = compute_segment_center(vcvertptr, vcsegptr(point_segs[1]));
 		for (int i=1; i<num_points-2; i++) {
-			dist += vm_vec_dist_quick(point_segs[i].point, point_segs[i+1].point);
+			auto next = compute_segment_center(vcvertptr, vcsegptr(point_segs[i + 1]));
+			result.interior += vm_vec_dist_quick(prev, next);
+			prev = next;
 		}
+	}
+	return result;
+}
 
-	add_to_fcd_cache(seg0, seg1, dist);
-
+static vm_distance fcd_path_distance(fvcvertptr &vcvertptr, const fcd_path &p, const vms_vector &p0, const vms_vector &p1)
+{
+	if (p.near_seg0 == segment_none)
+		return fcd_abort_return_value;
+	auto dist = vm_vec_dist_quick(p1, compute_segment_center(vcvertptr, vcsegptr(p.near_seg1)));
+	dist += vm_vec_dist_quick(p0, compute_segment_center(vcvertptr, vcsegptr(p.near_seg0)));
+	dist += p.interior;
 	return dist;
+}
+
+static int fcd_clamp_depth(int max_depth)
+{
+	//	If > this, will overrun point_segs buffer
+#ifdef WINDOWS
+	if (max_depth == -1) max_depth = 200;
+#endif
+
+	if (constexpr int s = fcd_max_path_segments - 2; max_depth > s)
+		max_depth = s;
+	return max_depth;
+}
+
+//	Console command: compare the cached lookup against a fresh search
+//	over random segment pairs in the current level.
+static void fcd_cmd_bench(unsigned long argc, const char *const *const argv)
+{
+	auto &Segments = LevelSharedSegmentState.get_segments();
+	const auto segment_count = Segments.get_count();
+	if (!segment_count)
+	{
+		con_puts(CON_NORMAL, "fcd_bench: no level loaded");
+		return;
+	}
+	const unsigned long queries = argc > 1 ? strtoul(argv[1], nullptr, 10) : 10000;
+	const int max_depth = argc > 2 ? atoi(argv[2]) : 30;
+	auto &LevelSharedVertexState = LevelSharedSegmentState.get_vertex_state();
+	auto &vcvertptr = LevelSharedVertexState.get_vertices().vcptr;
+	std::minstd_rand mrd{queries};
+	std::uniform_int_distribution<std::underlying_type_t<segnum_t>> uid{0u, static_cast<std::underlying_type_t<segnum_t>>(segment_count - 1)};
+	/* Draw queries from a small working set of pairs, so that repeated
+	 * lookups resemble the sound and AI callers.
+	 */
+	std::vector<std::pair<segnum_t, segnum_t>> working_set(std::max(queries / 8, 1ul));
+	for (auto &i : working_set)
+		i = {segnum_t{uid(mrd)}, segnum_t{uid(mrd)}};
+	std::uniform_int_distribution<std::size_t> pick{0u, working_set.size() - 1};
+	std::vector<std::pair<segnum_t, segnum_t>> pairs;
+	pairs.reserve(queries);
+	for (unsigned long i = 0; i < queries; ++i)
+		pairs.emplace_back(working_set[pick(mrd)]);
+	const auto wid_flag = wall_is_doorway_mask::fly_rendpast;
+	std::vector<vm_distance> expected;
+	expected.reserve(queries);
+	const auto t0 = std::chrono::steady_clock::now();
+	for (const auto &[s0, s1] : pairs)
+	{
+		const auto &&seg0 = vcsegptridx(s0);
+		const auto &&seg1 = vcsegptridx(s1);
+		const auto p = fcd_search(vcvertptr, seg0, seg1, fcd_clamp_depth(max_depth), wid_flag);
+		expected.emplace_back(fcd_path_distance(vcvertptr, p, compute_segment_center(vcvertptr, seg0), compute_segment_center(vcvertptr, seg1)));
+	}
+	const auto t1 = std::chrono::steady_clock::now();
+	flush_fcd_cache();
+	Fcd_cache.hits = Fcd_cache.misses = 0;
+	unsigned mismatches = 0;
+	auto ei = expected.begin();
+	for (const auto &[s0, s1] : pairs)
+	{
+		const auto &&seg0 = vcsegptridx(s0);
+		const auto &&seg1 = vcsegptridx(s1);
+		const auto d = find_connected_distance(compute_segment_center(vcvertptr, seg0), seg0, compute_segment_center(vcvertptr, seg1), seg1, max_depth, wid_flag);
+		/* Adjacent and identical segments are answered before the
+		 * search runs, so only compare pairs that needed a search.
+		 */
+		if (seg0 != seg1 && find_connect_side(seg0, seg1) == side_none && d != *ei)
+			++ mismatches;
+		++ ei;
+	}
+	const auto t2 = std::chrono::steady_clock::now();
+	using std::chrono::duration_cast;
+	using std::chrono::microseconds;
+	con_printf(CON_NORMAL, "fcd_bench: %lu queries, depth %i: search %lu us, cached %lu us (%u hits, %u misses), %u mismatches", queries, max_depth, static_cast<unsigned long>(duration_cast<microseconds>(t1 - t0).count()), static_cast<unsigned long>(duration_cast<microseconds>(t2 - t1).count()), Fcd_cache.hits, Fcd_cache.misses, mismatches);
+}
+
+}
 
+//	----------------------------------------------------------------------------------------------------------
+void flush_fcd_cache()
+{
+	Fcd_cache.flush();
+}
+
+void init_fcd_cache_commands()
+{
+	cmd_addcommand("fcd_bench", fcd_cmd_bench, "fcd_bench [queries] [depth]\n" "    time find_connected_distance against an uncached search in the current level");
+}
+
+//	----------------------------------------------------------------------------------------------------------
+//	Determine whether seg0 and seg1 are reachable in a way that allows sound to pass.
+//	Search up to a maximum depth of max_depth.
+//	Return the distance.
+vm_distance find_connected_distance(const vms_vector &p0, const vcsegptridx_t seg0, const vms_vector &p1, const vcsegptridx_t seg1, int max_depth, const wall_is_doorway_mask wid_flag)
+{
+	auto &LevelSharedVertexState = LevelSharedSegmentState.get_vertex_state();
+	auto &Vertices = LevelSharedVertexState.get_vertices();
+
+	max_depth = fcd_clamp_depth(max_depth);
+
+	if (seg0 == seg1) {
+		return vm_vec_dist_quick(p0, p1);
+	} else {
+		auto conn_side = find_connect_side(seg0, seg1);
+		if (conn_side != side_none)
+		{
+#if defined(DXX_BUILD_DESCENT_II)
+			auto &Walls = LevelUniqueWallSubsystemState.Walls;
+			auto &vcwallptr = Walls.vcptr;
+			if (WALL_IS_DOORWAY(GameBitmaps, Textures, vcwallptr, seg1, conn_side) & wid_flag)
+#endif
+			{
+				return vm_vec_dist_quick(p0, p1);
+			}
+		}
+	}
+
+	//	Periodically flush cache.  Wall changes that go through
+	//	flush_fcd_cache take effect immediately; this bounds how long a
+	//	change made elsewhere (such as a remote wall update) can be missed.
+	if ((GameTime64 - Fcd_cache.last_flush_time > F1_0*2) || (GameTime64 < Fcd_cache.last_flush_time))
+		flush_fcd_cache();
+
+	auto &vcvertptr = Vertices.vcptr;
+	const auto key = fcd_cache_table::build_key(seg0, seg1, max_depth, wid_flag);
+	if (const auto p = Fcd_cache.find(key))
+		return fcd_path_distance(vcvertptr, *p, p0, p1);
+	const auto p = fcd_search(vcvertptr, seg0, seg1, max_depth, wid_flag);
+	Fcd_cache.insert(key, p);
+	return fcd_path_distance(vcvertptr, p, p0, p1);
 }
 
 }
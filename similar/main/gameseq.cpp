@@ -448,7 +448,7 @@ static void gameseq_init_network_players(const d_robot_info_array &Robot_info, o
 				: (type == OBJ_PLAYER || type == OBJ_GHOST)
 			)
 			{
-				o->type=OBJ_PLAYER;
+				set_object_type(*o, OBJ_PLAYER);
 				auto &pi = Player_init[k];
 				pi.pos = o->pos;
 				pi.orient = o->orient;
@@ -1100,6 +1100,7 @@ void LoadLevel(int level_num,int page_in_textures)
 
 	auto &vcvertptr = Vertices.vcptr;
 	set_sound_sources(vcsegptridx, vcvertptr);
+	digi_prepare_level_sounds();
 
 #if DXX_USE_EDITOR
 	if (!EditorWindow)
@@ -1133,7 +1134,7 @@ void InitPlayerObject()
 	plr.objnum = object_first;
 	const auto &&console = vmobjptr(plr.objnum);
 	ConsoleObject = console;
-	console->type				= OBJ_PLAYER;
+	set_object_type(*console, OBJ_PLAYER);
 	set_player_id(console, Player_num);
 	console->control_source	= object::control_type::flying;
 	console->movement_source	= object::movement_type::physics;
@@ -2207,7 +2208,9 @@ window_event_result StartNewLevel(int level_num)
 	ThisLevelTime = {};
 
 #if defined(DXX_BUILD_DESCENT_I)
-	if (!(Game_mode & GM_MULTI)) {
+	//The simulation benchmark never processes events, so it cannot
+	//dismiss a briefing
+	if (!(Game_mode & GM_MULTI) && !CGameArg.DbgSimBenchFrames) {
 		do_briefing_screens(Current_mission->briefing_text_filename, level_num);
 	}
 #elif defined(DXX_BUILD_DESCENT_II)
@@ -2215,7 +2218,8 @@ window_event_result StartNewLevel(int level_num)
 		maybe_set_first_secret_visit(level_num);
 	}
 
-	ShowLevelIntro(level_num);
+	if (!CGameArg.DbgSimBenchFrames)
+		ShowLevelIntro(level_num);
 #endif
 
 	return StartNewLevelSub(LevelSharedRobotInfoState.Robot_info, level_num, 1, secret_restore::none);
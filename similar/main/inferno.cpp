@@ -81,6 +81,13 @@ char copyright[] = "DESCENT II  COPYRIGHT (C) 1994-1996 PARALLAX SOFTWARE CORPOR
 #include "config.h"
 #include "multi.h"
 #include "gameseq.h"
+#include "gameseg.h"
+#include "fvi.h"
+#include "ai.h"
+#include "parallel.h"
+#include "piggy.h"
+#include "render.h"
+#include "simbench.h"
 #if defined(DXX_BUILD_DESCENT_II)
 #include "gamepal.h"
 #include "movie.h"
@@ -170,6 +177,8 @@ static void print_commandline_help()
 	VERB("\n System Options:\n\n")	\
 	VERB("  -nonicefps                    Don't free CPU-cycles\n")	\
 	VERB("  -maxfps <n>                   Set maximum framerate to <n>\n\t\t\t\t(default: " DXX_STRINGIZE(MAXIMUM_FPS) ", available: " DXX_STRINGIZE(MINIMUM_FPS) "-" DXX_STRINGIZE(MAXIMUM_FPS) ")\n")	\
+	VERB("  -threads <n>                  Use up to <n> threads for game simulation (default: 0, one per processor)\n")	\
+	VERB("  -maxobjects <n>               Allow up to <n> objects in a single player level (default: 350, available: 350-2000)\n")	\
 	VERB("  -hogdir <s>                   set shared data directory to <s>\n")	\
 	DXX_COMMAND_LINE_HELP_unix(	\
 		VERB("  -nohogdir                     don't try to use shared data directory\n")	\
@@ -200,6 +209,7 @@ static void print_commandline_help()
 	DXX_COMMAND_LINE_HELP_D2(	\
 		VERB("  -sound11k                     Use 11KHz sounds\n")	\
 	)	\
+	VERB("  -sndrate <n>                  Mix sound at <n> Hz without SDL_mixer (44100 or 48000, default: 44100)\n")	\
 	DXX_if_defined_01(DXX_USE_SDLMIXER, (	\
 		VERB("  -nosdlmixer                   Disable Sound output via SDL_mixer\n")	\
 	))	\
@@ -256,6 +266,10 @@ static void print_commandline_help()
 	VERB("  -verbose                      Enable verbose output.\n")	\
 	VERB("  -safelog                      Write gamelog.txt unbuffered.\n\t\t\t\tUse to keep helpful output to trace program crashes.\n")	\
 	VERB("  -norun                        Bail out after initialization\n")	\
+	VERB("  -simbench <n>                 Run <n> frames of a level without rendering, report\n\t\t\t\ttimings and a state hash, then exit\n")	\
+	VERB("  -simbench-level <n>           Level for -simbench (default: 1)\n")	\
+	VERB("  -simbench-mission <s>         Mission for -simbench (default: first listed)\n")	\
+	VERB("  -simbench-input <s>           Read -simbench controls from file <s>\n")	\
 	VERB("  -no-grab                      Never grab keyboard/mouse\n")	\
 	VERB("  -renderstats                  Enable renderstats info by default\n")	\
 	VERB("  -text <s>                     Specify alternate .tex file\n")	\
@@ -272,7 +286,7 @@ static void print_commandline_help()
 		VERB("  -gl_gettexlevelparam_ok <n>   Override DbgGlGetTexLevelParamOk (default: 1)\n")	\
 	)	\
 	DXX_COMMAND_LINE_HELP_SDL(	\
-		VERB("  -tmap <s>                     Select texmapper <s> to use\n\t\t\t\t(default: c, available: c, fp, quad)\n")	\
+		VERB("  -tmap <s>                     Select texmapper <s> to use\n\t\t\t\t(default: c, available: c, scalar, sse2, avx2, fp, quad)\n")	\
 		VERB("  -hwsurface                    Use SDL HW Surface\n")	\
 		VERB("  -asyncblit                    Use queued blits over SDL. Can speed up rendering\n")	\
 	)	\
@@ -444,6 +458,14 @@ static int main(int argc, char *argv[])
 	if (!PHYSFSX_init(argc, argv))
 		return 1;
 	con_init();  // Initialise the console
+	init_fcd_cache_commands();
+	init_fvi_commands();
+	init_ai_commands();
+	init_object_commands();
+	init_piggy_commands();
+	init_render_commands();
+	init_texmerge_commands();
+	set_parallel_thread_count(CGameArg.SysThreads);
 
 	setbuf(stdout, NULL); // unbuffered output via printf
 #ifdef _WIN32
@@ -685,7 +707,7 @@ static int main(int argc, char *argv[])
 		return(0);
 
 	con_puts(CON_DEBUG, "Initializing texture caching system...");
-	texmerge_init();		// 10 cache bitmaps
+	texmerge_init();
 
 #if defined(DXX_BUILD_DESCENT_II)
 	piggy_init_pigfile("groupa.pig");	//get correct pigfile
@@ -744,6 +766,9 @@ static int main(int argc, char *argv[])
 	else
 #endif
 #endif
+	if (CGameArg.DbgSimBenchFrames)
+		run_sim_bench();
+	else
 	{
 		Game_mode = {};
 		DoMenu();
@@ -1171,9 +1171,23 @@ imobjptridx_t find_homing_object_complete(const vms_vector &curpos, const vmobjp
 		HOMING_MIN_TRACKABLE_DOT
 	};
 
+	/* Only objects of the tracked types, and proximity bombs, can be
+	 * chosen, and only if they are nearer than the trackable distance.
+	 */
+	object_type_mask candidate_types;
+	for (const auto t : {track_obj_type1, track_obj_type2})
+		if (t >= 0)
+			candidate_types.insert(static_cast<object_type_t>(t));
+#if defined(DXX_BUILD_DESCENT_II)
+	candidate_types.insert(OBJ_WEAPON);
+	const auto max_trackable_radius{(tracker_id == weapon_id_type::OMEGA_ID) ? OMEGA_MAX_TRACKABLE_DIST : vm_distance{HOMING_MAX_TRACKABLE_DIST}};
+#elif defined(DXX_BUILD_DESCENT_I)
+	const vm_distance max_trackable_radius{HOMING_MAX_TRACKABLE_DIST};
+#endif
+
 	imobjptridx_t best_objnum{object_none};
 	fix	max_dot{-F1_0 * 2};
-	range_for (const auto &&curobjp, vmobjptridx)
+	for (const auto &&curobjp : object_type_range(LevelUniqueObjectState.Object_types, vmobjptridx, candidate_types, &curpos, max_trackable_radius))
 	{
 		int			is_proximity = 0;
 
@@ -2148,7 +2162,6 @@ struct miniparent
 // Create the children of a smart bomb, which is a bunch of homing missiles.
 static void create_smart_children(object_array &Objects, const vmobjptridx_t objp, const uint_fast32_t num_smart_children, const miniparent parent)
 {
-	auto &vcobjptridx = Objects.vcptridx;
 	auto &vcobjptr = Objects.vcptr;
 	unsigned numobjs = 0;
 	weapon_id_type blob_id;
@@ -2161,7 +2174,7 @@ static void create_smart_children(object_array &Objects, const vmobjptridx_t obj
 		if (Game_mode & GM_MULTI)
 			d_srand(8321L);
 
-		range_for (const auto &&curobjp, vcobjptridx)
+		for (const auto &&curobjp : object_type_range(LevelUniqueObjectState.Object_types, Objects.vmptridx, {OBJ_ROBOT, OBJ_PLAYER}, &objp->pos, MAX_SMART_DISTANCE))
 		{
 			if (((curobjp->type == OBJ_ROBOT && !curobjp->ctype.ai_info.CLOAKED) || curobjp->type == OBJ_PLAYER) && curobjp != parent.num)
 			{
@@ -510,7 +510,6 @@ static g3s_lrgb compute_light_emission(const d_robot_info_array &Robot_info, d_l
 void set_dynamic_light(const d_robot_info_array &Robot_info, render_state_t &rstate)
 {
 	auto &Objects = LevelUniqueObjectState.Objects;
-	auto &vcobjptridx = Objects.vcptridx;
 	std::array<vertnum_t, MAX_VERTICES> render_vertices;
 	std::array<segnum_t, MAX_VERTICES> vert_segnum_list;
 	static fix light_time; 
@@ -550,11 +549,9 @@ void set_dynamic_light(const d_robot_info_array &Robot_info, render_state_t &rst
 
 	cast_muzzle_flash_light(vmsegptridx, n_render_vertices, render_vertices, vert_segnum_list);
 
-	range_for (const auto &&obj, vcobjptridx)
+	for (const auto &&obj : object_type_range(LevelUniqueObjectState.Object_types, Objects.vmptridx, object_type_mask::all()))
 	{
 		const object &objp = obj;
-		if (objp.type == OBJ_NONE)
-			continue;
 		const auto &&obj_light_emission = compute_light_emission(Robot_info, LevelUniqueLightState, Vclip, obj);
 
 		if (((obj_light_emission.r+obj_light_emission.g+obj_light_emission.b)/3) > 0)
@@ -1216,6 +1216,16 @@ const char *load_mission_by_name (const mission_entry_predicate mission_name, co
 	return "No matching mission found in\ninstalled mission list.";
 }
 
+//loads the first mission that the New Game menu lists.
+//Returns nullptr if mission loaded ok, else error string.
+const char *load_first_mission()
+{
+	auto &&mission_list = build_mission_list(mission_filter_mode::exclude_anarchy);
+	if (mission_list.empty())
+		return "No missions found.";
+	return load_mission(&mission_list.front());
+}
+
 }
 
 namespace {
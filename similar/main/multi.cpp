@@ -675,7 +675,7 @@ void multi_make_player_ghost(const playernum_t playernum)
 		return;
 	}
 	const auto &&obj = vmobjptridx(vcplayerptr(playernum)->objnum);
-	obj->type = OBJ_GHOST;
+	set_object_type(*obj, OBJ_GHOST);
 	obj->render_type = render_type::RT_NONE;
 	obj->movement_source = object::movement_type::None;
 	multi_reset_player_object(obj);
@@ -692,7 +692,7 @@ void multi_make_ghost_player(const playernum_t playernum)
 		return;
 	}
 	const auto &&obj = vmobjptridx(vcplayerptr(playernum)->objnum);
-	obj->type = OBJ_PLAYER;
+	set_object_type(*obj, OBJ_PLAYER);
 	obj->movement_source = object::movement_type::physics;
 	multi_reset_player_object(obj);
 	if (playernum != Player_num)
@@ -800,7 +800,7 @@ static void net_destroy_controlcen(object_array &Objects, const d_robot_info_arr
 {
 	print_kill_goal_tables(Objects.vcptr);
 	HUD_init_message_literal(HM_MULTI, "The control center has been destroyed!");
-	net_destroy_controlcen_object(Robot_info, obj_find_first_of_type(Objects.vmptridx, OBJ_CNTRLCEN));
+	net_destroy_controlcen_object(Robot_info, obj_find_first_of_type(LevelUniqueObjectState, OBJ_CNTRLCEN));
 }
 
 static void multi_compute_kill(const d_robot_info_array &Robot_info, const imobjptridx_t killer, object &killed)
@@ -62,7 +62,10 @@
 #include "d_levelstate.h"
 #include "d_range.h"
 #include "d_zip.h"
+#include "delta_snapshot.h"
 #include "partial_range.h"
+#include "udp_batch.h"
+#include "udp_retransmit.h"
 #include <array>
 #include <utility>
 
@@ -100,6 +103,8 @@ enum class upid : uint8_t
 	mdata_pnorm,	// Packet containing multi buffer from a player. Priority 0,1 - no ACK needed.
 	mdata_pneedack,	// Packet containing multi buffer from a player. Priority 2 - ACK needed. Also contains pkt_num
 	mdata_ack,	// ACK packet for UPID_MDATA_P1.
+	bundle,	// Several game packets for one peer, packed into one datagram. Only between a host with netgame_rule_flags::packet_bundles and the players who send it bundles.
+	pdata_snapshot,	// Delta coded movement data of one or more players. Only in games with netgame_rule_flags::pdata_snapshots.
 #if DXX_USE_TRACKER
 	/* Tracker upid codes are special.  They must be compatible with the
 	 * tracker, which is a separate program maintained in a different
@@ -488,22 +493,50 @@ static void net_udp_read_endlevel_packet(const uint8_t *data, const _sockaddr &s
 static void net_udp_send_mdata(int needack, fix64 time);
 static void net_udp_process_mdata(const d_level_shared_robot_info_state &LevelSharedRobotInfoState, std::span<uint8_t> data, const _sockaddr &sender_addr, int needack);
 static void net_udp_send_pdata();
+static void net_udp_send_relayed_pdata();
 static void net_udp_process_pdata (std::span<const uint8_t> data, const _sockaddr &sender_addr);
 static void net_udp_read_pdata_packet(UDP_frame_info *pd);
+static void net_udp_process_pdata_snapshot(std::span<const uint8_t> data, const _sockaddr &sender_addr);
+static void net_udp_pdata_snapshot_init();
+static void net_udp_pdata_snapshot_reset(playernum_t pnum);
 static void net_udp_timeout_check(fix64 time);
 static int net_udp_get_new_player_num ();
 static void net_udp_noloss_got_ack(std::span<const uint8_t>);
 static void net_udp_noloss_init_mdata_queue();
 static void net_udp_noloss_clear_mdata_trace(ubyte player_num);
 static void net_udp_noloss_process_queue(fix64 time);
+static void net_udp_queue_send(unsigned pnum, std::span<const uint8_t> msg);
+static void net_udp_send_queued();
 static int net_udp_start_game();
 
 // Variables
 static int UDP_num_sendto, UDP_len_sendto, UDP_num_recvfrom, UDP_len_recvfrom;
 static UDP_mdata_info		UDP_MData;
-static unsigned UDP_mdata_queue_highest;
-static std::array<UDP_mdata_store, UDP_MDATA_STOR_QUEUE_SIZE> UDP_mdata_queue;
+// Packet numbers wrap at a multiple of the queue size, as UDP_mdata_queue requires.
+static_assert(UDP_MDATA_PKT_NUM_MAX % UDP_MDATA_STOR_QUEUE_SIZE == 0);
+static udp_retransmit_queue<UDP_mdata_store, MAX_PLAYERS, UDP_MDATA_STOR_QUEUE_SIZE> UDP_mdata_queue;
 static per_player_array<UDP_mdata_check> UDP_mdata_trace;
+// Game packets waiting to be sent, in one datagram per player
+static per_player_array<udp_bundle<underlying_value(upid::bundle), UPID_MAX_SIZE>> UDP_send_bundles;
+// Host: players who sent a bundle, so they are sent bundles instead of one datagram per packet.
+static std::bitset<MAX_PLAYERS> UDP_bundle_peers;
+// Player positions as delta coded snapshots, for games with netgame_rule_flags::pdata_snapshots
+using pdata_snapshot = delta_snapshot<MAX_PLAYERS, 15>;
+// Relayed positions go out every frame they arrive in, so a client can get up to (MAX_PLAYERS - 1) * MAX_PPS snapshots a second.
+constexpr std::size_t pdata_snapshot_history = 64;
+struct UDP_pdata_link
+{
+	// Host: this player sends snapshots, so it is sent snapshots instead of pdata.
+	bool snapshots;
+	// Host: players whose position arrived since the last snapshot sent to this player.
+	std::bitset<MAX_PLAYERS> fresh;
+	snapshot_sender<pdata_snapshot, pdata_snapshot_history> sender;
+	snapshot_receiver<pdata_snapshot, pdata_snapshot_history> receiver;
+};
+// One per peer. A client only uses the one for the host.
+static per_player_array<UDP_pdata_link> UDP_pdata_links;
+// Host: the latest position received from each player
+static per_player_array<UDP_frame_info> UDP_pdata_latest;
 static UDP_sequence_syncplayer_packet UDP_sync_player; // For rejoin object syncing
 static uint16_t UDP_MyPort;
 #if DXX_USE_TRACKER
@@ -721,7 +754,6 @@ struct csockaddr_ref
 };
 
 using csocket_data_buffer = std::span<const uint8_t>;
-using socket_data_buffer = std::span<uint8_t>;
 
 class start_poll_menu_items
 {
@@ -888,16 +920,6 @@ ssize_t dxx_sendto(const int sockfd, const csocket_data_buffer msg, const int fl
 	return rv;
 }
 
-ssize_t dxx_recvfrom(const int sockfd, const socket_data_buffer msg, const int flags, sockaddr_ref from)
-{
-	ssize_t rv = recvfrom(sockfd, reinterpret_cast<char *>(msg.data()), msg.size(), flags, &from.sa, &from.len);
-
-	UDP_num_recvfrom++;
-	UDP_len_recvfrom += rv;
-
-	return rv;
-}
-
 static game_info_request_result net_udp_check_game_info_request(const upid_rspan<upid::game_info_lite_req> data, std::integral_constant<upid, upid::game_info_lite_req>)
 {
 	if (const auto sender_major_version = GET_INTEL_SHORT(&(data[5])); sender_major_version != DXX_VERSION_MAJORi)
@@ -967,6 +989,8 @@ static std::optional<upid> build_upid_from_untrusted(const uint8_t cmd)
 		case static_cast<uint8_t>(upid::mdata_pnorm):
 		case static_cast<uint8_t>(upid::mdata_pneedack):
 		case static_cast<uint8_t>(upid::mdata_ack):
+		case static_cast<uint8_t>(upid::bundle):
+		case static_cast<uint8_t>(upid::pdata_snapshot):
 #if DXX_USE_TRACKER
 		case static_cast<uint8_t>(upid::tracker_gameinfo):
 		case static_cast<uint8_t>(upid::tracker_ack):
@@ -1126,44 +1150,35 @@ static int udp_open_socket(RAIIsocket &sock, int port)
 	return 0;
 }
 
-#ifndef MSG_DONTWAIT
-static int udp_general_packet_ready(const SOCKET sock)
+// Packets received by one call to udp_receive_batch
+template <std::size_t N>
+struct udp_receive_packets
 {
-	fd_set set;
-	struct timeval tv;
-
-	FD_ZERO(&set);
-	FD_SET(sock, &set);
-	tv.tv_sec = tv.tv_usec = 0;
-	if (select(sock + 1, &set, NULL, NULL, &tv) > 0)
-		return 1;
-	else
-		return 0;
-}
-#endif
+	std::array<std::array<uint8_t, UPID_MAX_SIZE>, N> packets;
+	std::array<_sockaddr, N> sender_addrs;
+	std::array<udp_receive_item, N> items;
+	// Receive waiting packets, and return how many arrived.
+	std::size_t receive(RAIIsocket &sock);
+};
 
-// Gets some text. Returns 0 if nothing on there.
-static ssize_t udp_receive_packet(RAIIsocket &sock, const socket_data_buffer msg, const sockaddr_ref sender_addr)
+template <std::size_t N>
+std::size_t udp_receive_packets<N>::receive(RAIIsocket &sock)
 {
-	if (!sock)
-		return -1;
-#ifndef MSG_DONTWAIT
-	if (!udp_general_packet_ready(sock))
-		return 0;
-#endif
-	ssize_t msglen;
-		int flags = 0;
-#ifdef MSG_DONTWAIT
-		flags |= MSG_DONTWAIT;
-#endif
-		msglen = dxx_recvfrom(sock, msg, flags, sender_addr);
-
-		if (msglen < 0)
-			return 0;
-
-	if (msglen < msg.size())
-		msg[msglen] = 0;
-	return msglen;
+	for (std::size_t i = 0; i != N; ++i)
+	{
+		const sockaddr_ref addr{sender_addrs[i]};
+		items[i] = {packets[i], &addr.sa, addr.len, 0};
+	}
+	const auto n = udp_receive_batch(sock, items);
+	for (std::size_t i = 0; i != n; ++i)
+	{
+		const auto size = items[i].size;
+		UDP_num_recvfrom++;
+		UDP_len_recvfrom += size;
+		if (size < UPID_MAX_SIZE)
+			packets[i][size] = 0;
+	}
+	return n;
 }
 /* General UDP functions - END */
 
@@ -1798,6 +1813,8 @@ void net_udp_init()
 	Netgame = {};
 	UDP_MData = {};
 	net_udp_noloss_init_mdata_queue();
+	net_udp_pdata_snapshot_init();
+	UDP_bundle_peers.reset();
 	UDP_sequence_request_packet UDP_Seq{GetMyNetRanking(), InterfaceUniqueState.PilotName, 0};
 
 	multi_new_game();
@@ -1811,6 +1828,7 @@ void net_udp_init()
 
 void net_udp_close()
 {
+	net_udp_send_queued();
 	UDP_Socket = {};
 #ifdef _WIN32
 	WSACleanup();
@@ -1923,6 +1941,8 @@ void dispatch_table::disconnect_player(int playernum) const
 		VerifyPlayerJoined=-1;
 
 	net_udp_noloss_clear_mdata_trace(playernum);
+	net_udp_pdata_snapshot_reset(playernum);
+	UDP_bundle_peers.reset(playernum);
 }
 }
 }
@@ -1983,6 +2003,8 @@ static void net_udp_new_player(const UDP_sequence_addplayer_packet &their, const
 #endif
 
 	net_udp_noloss_clear_mdata_trace(pnum);
+	net_udp_pdata_snapshot_reset(pnum);
+	UDP_bundle_peers.reset(pnum);
 }
 }
 }
@@ -2016,7 +2038,7 @@ static void net_udp_welcome_player(const UDP_sequence_request_packet &their, con
 
 	// Joining a running game will need quite a few packets on the mdata-queue, so let players only join if we have enough space.
 	if (Netgame.PacketLossPrevention)
-		if ((UDP_MDATA_STOR_QUEUE_SIZE - UDP_mdata_queue_highest) < UDP_MDATA_STOR_MIN_FREE_2JOIN)
+		if ((UDP_MDATA_STOR_QUEUE_SIZE - UDP_mdata_queue.size()) < UDP_MDATA_STOR_MIN_FREE_2JOIN)
 			return;
 
 	if (their.Current_level_num != Current_level_num)
@@ -2123,6 +2145,8 @@ static void net_udp_welcome_player(const UDP_sequence_request_packet &their, con
 		multi_send_score();
 
 		net_udp_noloss_clear_mdata_trace(player_num);
+		net_udp_pdata_snapshot_reset(player_num);
+		UDP_bundle_peers.reset(player_num);
 	}
 
 	auto &obj = *vmobjptr(vcplayerptr(player_num)->objnum);
@@ -3528,6 +3552,9 @@ static void net_udp_process_packet(const d_level_shared_robot_info_state &LevelS
 			if (const auto s = build_upid_rspan<upid::pdata>(buf))
 				net_udp_process_pdata(*s, sender_addr);
 			break;
+		case upid::pdata_snapshot:
+			net_udp_process_pdata_snapshot(buf, sender_addr);
+			break;
 		case upid::mdata_pnorm:
 			net_udp_process_mdata(LevelSharedRobotInfoState, buf, sender_addr, 0);
 			break;
@@ -3538,6 +3565,21 @@ static void net_udp_process_packet(const d_level_shared_robot_info_state &LevelS
 			if (const auto s = build_upid_rspan<upid::mdata_ack>(buf))
 				net_udp_noloss_got_ack(*s);
 			break;
+		case upid::bundle:
+			// A player who sends bundles can read them.
+			if (multi_i_am_master())
+				for (unsigned i = 1; i < MAX_PLAYERS; ++i)
+					if (Netgame.players[i].protocol.udp.addr == sender_addr)
+					{
+						UDP_bundle_peers.set(i);
+						break;
+					}
+			udp_bundle_for_each(buf, [&LevelSharedRobotInfoState, &sender_addr](const std::span<uint8_t> message) {
+				// Only game packets are bundled, so never a bundle.
+				if (message[0] != underlying_value(upid::bundle))
+					net_udp_process_packet(LevelSharedRobotInfoState, message, sender_addr);
+			});
+			break;
 #if DXX_USE_TRACKER
 		case upid::tracker_gameinfo:
 			udp_tracker_process_game(buf, sender_addr);
@@ -4711,7 +4753,7 @@ void net_udp_read_sync_packet(const uint8_t *data, uint_fast32_t data_len, const
 		}
 	}
 
-	get_local_plrobj().type = OBJ_PLAYER;
+	set_object_type(get_local_plrobj(), OBJ_PLAYER);
 
 	Network_status = network_state::playing;
 	multi_sort_kill_list();
@@ -4953,6 +4995,7 @@ static int net_udp_start_game()
 	net_udp_set_game_mode(Netgame.gamemode);
 
 	Netgame.protocol.udp.your_index = 0; // I am Host. I need to know that y'know? For syncing later.
+	Netgame.game_flag |= netgame_rule_flags::pdata_snapshots | netgame_rule_flags::packet_bundles;
 	
 	if (!net_udp_select_players()
 		|| StartNewLevel(Netgame.levelnum) == window_event_result::close)
@@ -5083,6 +5126,8 @@ window_event_result dispatch_table::level_sync() const
 
 	UDP_MData = {};
 	net_udp_noloss_init_mdata_queue();
+	net_udp_pdata_snapshot_init();
+	UDP_bundle_peers.reset();
 
 	net_udp_flush(UDP_Socket); // Flush any old packets
 
@@ -5288,10 +5333,14 @@ static void net_udp_flush(RAIIsocket &s)
 	if (!s)
 		return;
 	unsigned i = 0;
-	struct _sockaddr sender_addr;
-	std::array<uint8_t, UPID_MAX_SIZE> packet;
-	while (udp_receive_packet(s, packet, sender_addr) > 0)
-		++i;
+	udp_receive_packets<8> batch;
+	for (;;)
+	{
+		const auto n = batch.receive(s);
+		i += n;
+		if (n != batch.items.size())
+			break;
+	}
 	if (i)
 		con_printf(CON_VERBOSE, "Flushed %u UDP packets from socket %i", i, static_cast<int>(s));
 }
@@ -5309,20 +5358,25 @@ namespace {
 
 static void net_udp_listen(RAIIsocket &sock)
 {
-	if (!sock)
-		return;
-	struct _sockaddr sender_addr;
-	std::array<uint8_t, UPID_MAX_SIZE> packet;
+	/* Processing a packet can listen again, so keep the batch on the
+	 * stack, and small.
+	 */
+	udp_receive_packets<8> batch;
 	for (;;)
 	{
-		const auto size = udp_receive_packet(sock, packet, sender_addr);
-		if (!(size > 0))
+		if (!sock)
+			return;
+		const auto n = batch.receive(sock);
+		for (std::size_t i = 0; i != n; ++i)
+		{
+			// Processing an earlier packet may have closed the socket.
+			if (!sock)
+				return;
+			if (const auto size = batch.items[i].size)
+				net_udp_process_packet(LevelSharedRobotInfoState, std::span(batch.packets[i]).first(size), batch.sender_addrs[i]);
+		}
+		if (n != batch.items.size())
 			break;
-		/* Casting from ssize_t to std::size_t is safe here.  Only negative
-		 * values would be affected by the narrowing conversion, and a negative
-		 * value would have caused the preceding `if` test to `break`.
-		 */
-		net_udp_process_packet(LevelSharedRobotInfoState, {packet.data(), static_cast<std::size_t>(size)}, sender_addr);
 	}
 }
 
@@ -5414,6 +5468,9 @@ void dispatch_table::do_protocol_frame(int force, int listen) const
 	if (WaitForRefuseAnswer && time>(RefuseTimeLimit+(F1_0*12)))
 		WaitForRefuseAnswer=0;
 
+	// Queue resends before new packets, so that players get them in order.
+	net_udp_noloss_process_queue(time);
+
 	// Send positional update either in the regular PPS interval OR if forced
 	if (force || (time >= (last_pdata_time+(F1_0/Netgame.PacketsPerSec))))
 	{
@@ -5431,8 +5488,6 @@ void dispatch_table::do_protocol_frame(int force, int listen) const
 		net_udp_send_mdata(0, time);
 	}
 
-	net_udp_noloss_process_queue(time);
-
 	if (VerifyPlayerJoined!=-1 && time >= last_resync_time+F1_0)
 	{
 		last_resync_time = time;
@@ -5471,6 +5526,10 @@ void dispatch_table::do_protocol_frame(int force, int listen) const
 			net_udp_send_extras();
 	}
 
+	// Pass on the positions that just came in, rather than at the next pdata tick.
+	net_udp_send_relayed_pdata();
+
+	net_udp_send_queued();
 	udp_traffic_stat();
 }
 }
@@ -5493,17 +5552,15 @@ static void net_udp_noloss_add_queue_pkt(fix64 time, const std::span<const uint8
 	if (!Netgame.PacketLossPrevention)
 		return;
 
-	if (UDP_mdata_queue_highest == UDP_MDATA_STOR_QUEUE_SIZE) // The list is full. That should not happen. But if it does, we must do something.
+	if (UDP_mdata_queue.full()) // The list is full. That should not happen. But if it does, we must do something.
 	{
 		con_printf(CON_VERBOSE, "P#%u: MData store list is full!", Player_num);
 		if (multi_i_am_master()) // I am host. I will kick everyone who did not ACK the first packet and then remove it.
 		{
+			const auto &pending = UDP_mdata_queue.pending(UDP_mdata_queue.oldest());
 			for ( int i=1; i<N_players; i++ )
-				if (UDP_mdata_queue[0].player_ack[i] == 0)
+				if (pending[i])
 					multi::udp::dispatch->kick_player(Netgame.players[i].protocol.udp.addr, kick_player_reason::pkttimeout);
-			std::move(std::next(UDP_mdata_queue.begin()), UDP_mdata_queue.end(), UDP_mdata_queue.begin());
-			UDP_mdata_queue[UDP_MDATA_STOR_QUEUE_SIZE - 1] = {};
-			UDP_mdata_queue_highest--;
 		}
 		else // I am just a client. I gotta go.
 		{
@@ -5517,27 +5574,24 @@ static void net_udp_noloss_add_queue_pkt(fix64 time, const std::span<const uint8
 			multi_quit_game = 1;
 			game_leave_menus();
 		}
-		Assert(UDP_mdata_queue_highest == (UDP_MDATA_STOR_QUEUE_SIZE - 1));
+		UDP_mdata_queue.pop_oldest();
 	}
 
 	con_printf(CON_VERBOSE, "P#%u: Adding MData pkt_num [%i,%i,%i,%i,%i,%i,%i,%i], type %i from P#%i to MData store list", Player_num, UDP_mdata_trace[0].pkt_num_tosend,UDP_mdata_trace[1].pkt_num_tosend,UDP_mdata_trace[2].pkt_num_tosend,UDP_mdata_trace[3].pkt_num_tosend,UDP_mdata_trace[4].pkt_num_tosend,UDP_mdata_trace[5].pkt_num_tosend,UDP_mdata_trace[6].pkt_num_tosend,UDP_mdata_trace[7].pkt_num_tosend, data[0], pnum);
-	UDP_mdata_queue[UDP_mdata_queue_highest].used = 1;
-	UDP_mdata_queue[UDP_mdata_queue_highest].pkt_initial_timestamp = time;
+	UDP_mdata_store m;
+	m.Player_num = pnum;
+	memcpy(m.data.data(), data.data(), m.data_size = data.size());
+	const auto slot = UDP_mdata_queue.add(time, m);
 	for (unsigned i = 0; i < MAX_PLAYERS; ++i)
 	{
 		if (i == Player_num || player_ack[i] || vcplayerptr(i)->connected == player_connection_status::disconnected)	// if player me, is not playing or does not require an ACK, do not add timestamp or increment pkt_num
 			continue;
 		
-		UDP_mdata_queue[UDP_mdata_queue_highest].pkt_timestamp[i] = time;
-		UDP_mdata_queue[UDP_mdata_queue_highest].pkt_num[i] = UDP_mdata_trace[i].pkt_num_tosend;
+		UDP_mdata_queue.expect_ack(slot, i, UDP_mdata_trace[i].pkt_num_tosend, time + UDP_MDATA_RESEND_INTERVAL);
 		UDP_mdata_trace[i].pkt_num_tosend++;
 		if (UDP_mdata_trace[i].pkt_num_tosend > UDP_MDATA_PKT_NUM_MAX)
 			UDP_mdata_trace[i].pkt_num_tosend = UDP_MDATA_PKT_NUM_MIN;
 	}
-	UDP_mdata_queue[UDP_mdata_queue_highest].Player_num = pnum;
-	UDP_mdata_queue[UDP_mdata_queue_highest].player_ack = player_ack;
-	memcpy(&UDP_mdata_queue[UDP_mdata_queue_highest].data, data.data(), UDP_mdata_queue[UDP_mdata_queue_highest].data_size = data.size());
-	UDP_mdata_queue_highest++;
 }
 
 /*
@@ -5605,23 +5659,20 @@ void net_udp_noloss_got_ack(const std::span<const uint8_t> data)
 	dest_pnum = data[len];												len++;
 	const uint32_t pkt_num{GET_INTEL_INT(&data[len])};										len += 4;
 
-	for (int i = 0; i < UDP_mdata_queue_highest; i++)
-	{
-		if ((pkt_num == UDP_mdata_queue[i].pkt_num[sender_pnum]) && (dest_pnum == UDP_mdata_queue[i].Player_num))
-		{
-			con_printf(CON_VERBOSE, "P#%u: Got MData ACK for pkt_num %i from pnum %i for pnum %i",Player_num, pkt_num, sender_pnum, dest_pnum);
-			UDP_mdata_queue[i].player_ack[sender_pnum] = 1;
-			break;
-		}
-	}
+	if (sender_pnum >= MAX_PLAYERS)
+		return;
+	const auto slot = UDP_mdata_queue.find(sender_pnum, pkt_num);
+	if (slot == UDP_mdata_queue.none || UDP_mdata_queue.payload(slot).Player_num != dest_pnum)
+		return;
+	con_printf(CON_VERBOSE, "P#%u: Got MData ACK for pkt_num %i from pnum %i for pnum %i",Player_num, pkt_num, sender_pnum, dest_pnum);
+	UDP_mdata_queue.acknowledge(slot, sender_pnum);
 }
 
 /* Init/Free the queue. Call at start and end of a game or level. */
 void net_udp_noloss_init_mdata_queue(void)
 {
-	UDP_mdata_queue_highest=0;
 	con_printf(CON_VERBOSE, "P#%u: Clearing MData store/trace list",Player_num);
-	UDP_mdata_queue = {};
+	UDP_mdata_queue.clear();
 	for (int i = 0; i < MAX_PLAYERS; i++)
 		net_udp_noloss_clear_mdata_trace(i);
 }
@@ -5642,99 +5693,70 @@ void net_udp_noloss_clear_mdata_trace(ubyte player_num)
  */
 void net_udp_noloss_process_queue(fix64 time)
 {
-	int total_len = 0;
-
 	if (!(Game_mode&GM_NETWORK) || !UDP_Socket[0])
 		return;
 
 	if (!Netgame.PacketLossPrevention)
 		return;
 
-	for (int queuec = 0; queuec < UDP_mdata_queue_highest; queuec++)
+	for (unsigned plc = 0; plc < MAX_PLAYERS; ++plc)
 	{
-		int needack = 0;
-
-		// This might happen if we get out ACK's in the wrong order. So ignore that packet for now. It'll resolve itself.
-		if (!UDP_mdata_queue[queuec].used)
+		// If player is not playing anymore, we can remove him from list. Also remove *me* (even if that should have been done already). Also make sure Clients do not send to anyone else than Host
+		if ((vcplayerptr(plc)->connected != player_connection_status::playing || plc == Player_num) || (!multi_i_am_master() && plc > 0))
+		{
+			UDP_mdata_queue.acknowledge_all(plc);
 			continue;
+		}
 
-		// Check if at least one connected player has not ACK'd the packet
-		for (unsigned plc = 0; plc < MAX_PLAYERS; ++plc)
+		// Resend if enough time has passed.  Send up to half our max packet size to each player, bundled with the other packets for that player.
+		unsigned total_len = 0;
+		UDP_mdata_queue.resend_due(plc, time, UDP_MDATA_RESEND_INTERVAL, [plc, &total_len](const auto slot) {
+			if (total_len >= (UPID_MAX_SIZE/2))
+				return false;
+			const auto &m = UDP_mdata_queue.payload(slot);
+			const auto pkt_num = UDP_mdata_queue.pkt_num(slot, plc);
+			con_printf(CON_VERBOSE, "P#%u: Resending pkt_num %i from pnum %i to pnum %i",Player_num, pkt_num, m.Player_num, plc);
+			std::array<uint8_t, sizeof(UDP_mdata_info)> buf{};
+
+			unsigned len = 0;
+			// Prepare the packet and send it
+			buf[len] = underlying_value(upid::mdata_pneedack);													len++;
+			buf[len] = m.Player_num;								len++;
+			PUT_INTEL_INT(&buf[len], pkt_num);					len += 4;
+			memcpy(&buf[len], m.data.data(), sizeof(char)*m.data_size);
+																						len += m.data_size;
+			net_udp_queue_send(plc, std::span(buf).first(len));
+			total_len += len;
+			return true;
+		});
+	}
+
+	// Remove packets from the front of the queue that everyone ACK'd or that timed out.
+	UDP_mdata_queue.remove_finished(time, UDP_TIMEOUT, [](const auto slot) {
+		const auto &pending = UDP_mdata_queue.pending(slot);
+		if (pending.any()) // packet timed out but still not all have ack'd.
 		{
-			// If player is not playing anymore, we can remove him from list. Also remove *me* (even if that should have been done already). Also make sure Clients do not send to anyone else than Host
-			if ((vcplayerptr(plc)->connected != player_connection_status::playing || plc == Player_num) || (!multi_i_am_master() && plc > 0))
-				UDP_mdata_queue[queuec].player_ack[plc] = 1;
-
-			if (!UDP_mdata_queue[queuec].player_ack[plc])
+			if (multi_i_am_master()) // We are host, so we kick the remaining players.
 			{
-				// Resend if enough time has passed.
-				if (UDP_mdata_queue[queuec].pkt_timestamp[plc] + (F1_0/4) <= time)
-				{
-					con_printf(CON_VERBOSE, "P#%u: Resending pkt_num %i from pnum %i to pnum %i",Player_num, UDP_mdata_queue[queuec].pkt_num[plc], UDP_mdata_queue[queuec].Player_num, plc);
-					UDP_mdata_queue[queuec].pkt_timestamp[plc] = time;
-					std::array<uint8_t, sizeof(UDP_mdata_info)> buf{};
-
-					unsigned len = 0;
-					// Prepare the packet and send it
-					buf[len] = underlying_value(upid::mdata_pneedack);													len++;
-					buf[len] = UDP_mdata_queue[queuec].Player_num;								len++;
-					PUT_INTEL_INT(&buf[len], UDP_mdata_queue[queuec].pkt_num[plc]);					len += 4;
-					memcpy(&buf[len], UDP_mdata_queue[queuec].data.data(), sizeof(char)*UDP_mdata_queue[queuec].data_size);
-																								len += UDP_mdata_queue[queuec].data_size;
-					dxx_sendto(UDP_Socket[0], std::span(buf).first(len), 0, Netgame.players[plc].protocol.udp.addr);
-					total_len += len;
-				}
-				needack++;
+				for ( int plc=1; plc<N_players; plc++ )
+					if (pending[plc])
+						multi::udp::dispatch->kick_player(Netgame.players[plc].protocol.udp.addr, kick_player_reason::pkttimeout);
 			}
-		}
-
-		// Check if we can remove that packet due to to it had no resend's or Timeout
-		if (needack==0 || (UDP_mdata_queue[queuec].pkt_initial_timestamp + UDP_TIMEOUT <= time))
-		{
-			if (needack) // packet timed out but still not all have ack'd.
+			else // We are client, so we gotta go.
 			{
-				if (multi_i_am_master()) // We are host, so we kick the remaining players.
-				{
-					for ( int plc=1; plc<N_players; plc++ )
-						if (UDP_mdata_queue[queuec].player_ack[plc] == 0)
-							multi::udp::dispatch->kick_player(Netgame.players[plc].protocol.udp.addr, kick_player_reason::pkttimeout);
-				}
-				else // We are client, so we gotta go.
-				{
-					Netgame.PacketLossPrevention = 0; // Disable PLP - otherwise we get stuck in an infinite loop here. NOTE: We could as well clean the whole queue to continue protect our disconnect signal bit it's not that important - we just wanna leave.
-					const auto g = Game_wind;
-					if (g)
-						g->set_visible(0);
-					nm_messagebox_str(menu_title{nullptr}, nm_messagebox_tie(TXT_OK), menu_subtitle{"You left the game. You failed\nsending important packets.\nSorry."});
-					if (g)
-						g->set_visible(1);
-					multi_quit_game = 1;
-					game_leave_menus();
-				}
+				Netgame.PacketLossPrevention = 0; // Disable PLP - otherwise we get stuck in an infinite loop here. NOTE: We could as well clean the whole queue to continue protect our disconnect signal bit it's not that important - we just wanna leave.
+				const auto g = Game_wind;
+				if (g)
+					g->set_visible(0);
+				nm_messagebox_str(menu_title{nullptr}, nm_messagebox_tie(TXT_OK), menu_subtitle{"You left the game. You failed\nsending important packets.\nSorry."});
+				if (g)
+					g->set_visible(1);
+				multi_quit_game = 1;
+				game_leave_menus();
 			}
-			con_printf(CON_VERBOSE, "P#%u: Removing stored pkt_num [%i,%i,%i,%i,%i,%i,%i,%i] - missing ACKs: %i",Player_num, UDP_mdata_queue[queuec].pkt_num[0],UDP_mdata_queue[queuec].pkt_num[1],UDP_mdata_queue[queuec].pkt_num[2],UDP_mdata_queue[queuec].pkt_num[3],UDP_mdata_queue[queuec].pkt_num[4],UDP_mdata_queue[queuec].pkt_num[5],UDP_mdata_queue[queuec].pkt_num[6],UDP_mdata_queue[queuec].pkt_num[7], needack); // Just *marked* for removal. The actual process happens further below.
-			UDP_mdata_queue[queuec].used = 0;
 		}
-
-		// Send up to half our max packet size
-		if (total_len >= (UPID_MAX_SIZE/2))
-			break;
-	}
-
-	// Now that we are done processing the queue, actually remove all unused packets from the top of the list.
-	{
-		const auto b = UDP_mdata_queue.begin();
-		const auto e = std::next(b, UDP_mdata_queue_highest);
-		const auto &&first_used_entry{std::ranges::find_if(b, e, [](const UDP_mdata_store &m) { return m.used; })};
-		if (first_used_entry != b)
-		{
-			std::move(first_used_entry, e, b);
-			const auto total_used_entries = std::distance(first_used_entry, e);
-			UDP_mdata_queue_highest = total_used_entries;
-			for (auto first_unused_entry = std::next(b, total_used_entries); first_unused_entry != e; ++first_unused_entry)
-				*first_unused_entry = {};
-		}
-	}
+		con_printf(CON_VERBOSE, "P#%u: Removing stored MData from pnum %i - missing ACKs: %zu",Player_num, UDP_mdata_queue.payload(slot).Player_num, pending.count());
+	});
 }
 
 }
@@ -5776,7 +5798,7 @@ void dispatch_table::send_data_direct(const std::span<const uint8_t> data, const
 		len += count_to_copy;
 	}
 
-	dxx_sendto(UDP_Socket[0], std::span(buf).first(len), 0, Netgame.players[pnum].protocol.udp.addr);
+	net_udp_queue_send(pnum, std::span(buf).first(len));
 
 	if (needack)
 	{
@@ -5792,6 +5814,85 @@ void dispatch_table::send_data_direct(const std::span<const uint8_t> data, const
 
 namespace {
 
+/* Can player `pnum` read bundles?  The host learns it from the first
+ * bundle that the player sends.  A client sends bundles to a host whose
+ * netgame info says that it takes them.
+ */
+bool net_udp_peer_takes_bundles(const unsigned pnum)
+{
+	if (multi_i_am_master())
+		return UDP_bundle_peers[pnum];
+	return pnum == 0 && (Netgame.game_flag & netgame_rule_flags::packet_bundles) != netgame_rule_flags::None;
+}
+
+/* Send at once the packets queued for player `pnum`: as one datagram if
+ * the player takes bundles, otherwise one datagram per packet.
+ */
+void net_udp_send_bundle(const unsigned pnum)
+{
+	auto &bundle = UDP_send_bundles[pnum];
+	const auto &addr = Netgame.players[pnum].protocol.udp.addr;
+	if (net_udp_peer_takes_bundles(pnum))
+		dxx_sendto(UDP_Socket[0], bundle.datagram(), 0, addr);
+	else
+		bundle.for_each_message([&addr](const std::span<const uint8_t> msg) {
+			dxx_sendto(UDP_Socket[0], msg, 0, addr);
+		});
+	bundle.clear();
+}
+
+/* Queue a game packet for player `pnum`.  net_udp_send_queued sends all
+ * the packets queued for a player as one datagram, or one datagram each
+ * to a player that does not take bundles.
+ */
+void net_udp_queue_send(const unsigned pnum, const std::span<const uint8_t> msg)
+{
+	auto &bundle = UDP_send_bundles[pnum];
+	if (bundle.append(msg))
+		return;
+	if (!bundle.empty())
+	{
+		// Send the full bundle now, so that the player gets the packets in order.
+		net_udp_send_bundle(pnum);
+		if (bundle.append(msg))
+			return;
+	}
+	dxx_sendto(UDP_Socket[0], msg, 0, Netgame.players[pnum].protocol.udp.addr);
+}
+
+// Send the packets queued for every player, in as few system calls as possible.
+void net_udp_send_queued()
+{
+	std::array<udp_send_item, 32> items;
+	std::size_t n = 0;
+	const auto flush = [&items, &n]() {
+		if (n && UDP_Socket[0])
+		{
+			UDP_num_sendto += n;
+			UDP_len_sendto += udp_send_batch(UDP_Socket[0], std::span(items).first(n));
+		}
+		n = 0;
+	};
+	for (auto &&[pnum, bundle] : enumerate(UDP_send_bundles))
+	{
+		if (bundle.empty())
+			continue;
+		const csockaddr_ref addr{Netgame.players[pnum].protocol.udp.addr};
+		const auto add = [&items, &n, &flush, &addr](const std::span<const uint8_t> data) {
+			if (n == items.size())
+				flush();
+			items[n++] = {data, &addr.sa, addr.len};
+		};
+		if (net_udp_peer_takes_bundles(pnum))
+			add(bundle.datagram());
+		else
+			bundle.for_each_message(add);
+	}
+	flush();
+	for (auto &bundle : UDP_send_bundles)
+		bundle.clear();
+}
+
 void net_udp_send_mdata(int needack, fix64 time)
 {
 	if (!(Game_mode&GM_NETWORK) || !UDP_Socket[0])
@@ -5824,7 +5925,7 @@ void net_udp_send_mdata(int needack, fix64 time)
 			{
 				if (needack) // assign pkt_num
 					PUT_INTEL_INT(&buf[2], UDP_mdata_trace[i].pkt_num_tosend);
-				dxx_sendto(UDP_Socket[0], std::span(buf).first(len), 0, Netgame.players[i].protocol.udp.addr);
+				net_udp_queue_send(i, std::span(buf).first(len));
 				player_ack[i] = 0;
 			}
 		}
@@ -5833,7 +5934,7 @@ void net_udp_send_mdata(int needack, fix64 time)
 	{
 		if (needack) // assign pkt_num
 			PUT_INTEL_INT(&buf[2], UDP_mdata_trace[0].pkt_num_tosend);
-		dxx_sendto(UDP_Socket[0], std::span(buf).first(len), 0, Netgame.players[0].protocol.udp.addr);
+		net_udp_queue_send(0, std::span(buf).first(len));
 		player_ack[0] = 0;
 	}
 	
@@ -5895,7 +5996,7 @@ void net_udp_process_mdata(const d_level_shared_robot_info_state &LevelSharedRob
 					player_ack[i] = 0;
 					PUT_INTEL_INT(&data[2], UDP_mdata_trace[i].pkt_num_tosend);
 				}
-				dxx_sendto(UDP_Socket[0], data, 0, Netgame.players[i].protocol.udp.addr);
+				net_udp_queue_send(i, data);
 			}
 		}
 
@@ -5912,26 +6013,66 @@ void net_udp_process_mdata(const d_level_shared_robot_info_state &LevelSharedRob
 	multi_process_bigdata(LevelSharedRobotInfoState, pnum, subdata);
 }
 
-void net_udp_send_pdata()
+// Positions and velocities in snapshots drop this many fraction bits, far below anything visible, so that small movements make small deltas.
+constexpr unsigned pdata_snapshot_fraction_shift = 4;
+// upid, Player_num, seq, baseline seq, ack seq, flags
+constexpr std::size_t pdata_snapshot_header_size = 9;
+constexpr uint8_t pdata_snapshot_has_baseline = 1;
+constexpr uint8_t pdata_snapshot_has_ack = 2;
+// A snapshot of every player, with every field changed, still fits in one packet.
+static_assert(pdata_snapshot_header_size + (MAX_PLAYERS * (2 + 15 * 38) + 7) / 8 <= UPID_MAX_SIZE);
+
+int32_t pdata_snapshot_quantize(const fix f)
 {
-	auto &Objects = LevelUniqueObjectState.Objects;
-	auto &vmobjptr = Objects.vmptr;
-	std::array<uint8_t, 3 + quaternionpos::packed_size::value> buf;
-	int len = 0;
+	return static_cast<int32_t>((int64_t{f} + (1 << (pdata_snapshot_fraction_shift - 1))) >> pdata_snapshot_fraction_shift);
+}
 
-	if (!(Game_mode&GM_NETWORK) || !UDP_Socket[0])
-		return;
-	auto &plr = get_local_player();
-	if (plr.connected != player_connection_status::playing)
-		return;
-	if (!(Network_status == network_state::playing || Network_status == network_state::endlevel))
-		return;
+fix pdata_snapshot_dequantize(const int32_t q)
+{
+	return static_cast<fix>(static_cast<uint32_t>(q) << pdata_snapshot_fraction_shift);
+}
+
+pdata_snapshot::entity pdata_snapshot_entity(const player_connection_status connected, const quaternionpos &qpp)
+{
+	const auto q = pdata_snapshot_quantize;
+	return {{
+		underlying_value(connected),
+		qpp.orient.w, qpp.orient.x, qpp.orient.y, qpp.orient.z,
+		q(qpp.pos.x), q(qpp.pos.y), q(qpp.pos.z),
+		static_cast<uint16_t>(qpp.segment),
+		q(qpp.vel.x), q(qpp.vel.y), q(qpp.vel.z),
+		q(qpp.rotvel.x), q(qpp.rotvel.y), q(qpp.rotvel.z),
+	}};
+}
+
+std::optional<UDP_frame_info> pdata_snapshot_frame(const playernum_t pnum, const pdata_snapshot::entity &e)
+{
+	if (e[8] < 0 || e[8] > UINT16_MAX)
+		return std::nullopt;
+	const auto s{vmsegidx_t::check_nothrow_index(static_cast<uint16_t>(e[8]))};
+	if (!s)
+		return std::nullopt;
+	const auto d = pdata_snapshot_dequantize;
+	UDP_frame_info pd{};
+	pd.Player_num = pnum;
+	pd.connected = player_connection_status{static_cast<uint8_t>(e[0])};
+	pd.qpp.orient = {static_cast<short>(e[1]), static_cast<short>(e[2]), static_cast<short>(e[3]), static_cast<short>(e[4])};
+	pd.qpp.pos = {d(e[5]), d(e[6]), d(e[7])};
+	pd.qpp.segment = *s;
+	pd.qpp.vel = {d(e[9]), d(e[10]), d(e[11])};
+	pd.qpp.rotvel = {d(e[12]), d(e[13]), d(e[14])};
+	return pd;
+}
+
+std::array<uint8_t, upid_length<upid::pdata>> net_udp_build_pdata(const playernum_t pnum, const player_connection_status connected, const quaternionpos &qpp)
+{
+	std::array<uint8_t, upid_length<upid::pdata>> buf;
+	int len = 0;
 
 	buf[len] = underlying_value(upid::pdata);									len++;
-	buf[len] = Player_num;									len++;
-	buf[len] = underlying_value(plr.connected);						len++;
+	buf[len] = pnum;									len++;
+	buf[len] = underlying_value(connected);						len++;
 
-	const auto qpp{build_quaternionpos(vmobjptr(plr.objnum))};
 	PUT_INTEL_SHORT(&buf[len], qpp.orient.w);							len += 2;
 	PUT_INTEL_SHORT(&buf[len], qpp.orient.x);							len += 2;
 	PUT_INTEL_SHORT(&buf[len], qpp.orient.y);							len += 2;
@@ -5944,16 +6085,141 @@ void net_udp_send_pdata()
 	multi_put_vector(&buf[len], qpp.rotvel);
 	len += 12;
 	// 46 + 3 = 49
+	return buf;
+}
+
+/* Send `current` to player `pnum`, coded against the latest snapshot
+ * that player acknowledged, and acknowledge the latest one it sent us.
+ */
+void net_udp_send_pdata_snapshot(const playernum_t pnum, const pdata_snapshot &current)
+{
+	auto &link = UDP_pdata_links[pnum];
+	std::array<uint8_t, UPID_MAX_SIZE> buf{};
+	bit_writer w{std::span(buf).subspan<pdata_snapshot_header_size>()};
+	const auto h = link.sender.encode(w, current);
+	if (w.overflow())
+		return;
+	const auto ack = link.receiver.latest();
+	buf[0] = underlying_value(upid::pdata_snapshot);
+	buf[1] = Player_num;
+	PUT_INTEL_SHORT(&buf[2], h.seq);
+	PUT_INTEL_SHORT(&buf[4], h.baseline.value_or(0));
+	PUT_INTEL_SHORT(&buf[6], ack.value_or(0));
+	buf[8] = (h.baseline ? pdata_snapshot_has_baseline : 0) | (ack ? pdata_snapshot_has_ack : 0);
+	net_udp_queue_send(pnum, std::span(buf).first(pdata_snapshot_header_size + w.bytes()));
+}
+
+/* As host, send player `pnum` the positions of the other players that
+ * came in since the last snapshot to it, and `own`, my own position, if
+ * given.
+ */
+void net_udp_send_client_pdata_snapshot(const playernum_t pnum, const pdata_snapshot::entity *const own)
+{
+	auto &link = UDP_pdata_links[pnum];
+	pdata_snapshot current;
+	if (own)
+	{
+		current.state[Player_num] = *own;
+		current.updated.set(Player_num);
+	}
+	if (vcplayerptr(pnum)->connected != player_connection_status::waiting)
+		for (unsigned j = 1; j < MAX_PLAYERS; ++j)
+		{
+			if (j == pnum || !link.fresh[j] || vcplayerptr(j)->connected != player_connection_status::playing)
+				continue;
+			auto &latest = UDP_pdata_latest[j];
+			current.state[j] = pdata_snapshot_entity(latest.connected, latest.qpp);
+			current.updated.set(j);
+		}
+	link.fresh.reset();
+	if (current.updated.none())
+		return;
+	net_udp_send_pdata_snapshot(pnum, current);
+}
+
+void net_udp_send_pdata()
+{
+	auto &Objects = LevelUniqueObjectState.Objects;
+	auto &vmobjptr = Objects.vmptr;
+
+	if (!(Game_mode&GM_NETWORK) || !UDP_Socket[0])
+		return;
+	auto &plr = get_local_player();
+	if (plr.connected != player_connection_status::playing)
+		return;
+	if (!(Network_status == network_state::playing || Network_status == network_state::endlevel))
+		return;
+
+	const auto qpp{build_quaternionpos(vmobjptr(plr.objnum))};
+	const auto buf{net_udp_build_pdata(Player_num, plr.connected, qpp)};
+	const auto own = pdata_snapshot_entity(plr.connected, qpp);
 
 	if (multi_i_am_master())
 	{
 		for (unsigned i = 1; i < MAX_PLAYERS; ++i)
-			if (vcplayerptr(i)->connected != player_connection_status::disconnected)
-				dxx_sendto(UDP_Socket[0], buf, 0, Netgame.players[i].protocol.udp.addr);
+		{
+			if (vcplayerptr(i)->connected == player_connection_status::disconnected)
+				continue;
+			if (!UDP_pdata_links[i].snapshots)
+			{
+				net_udp_queue_send(i, buf);
+				continue;
+			}
+			// My own position, and those of the other players that came in since the last snapshot.
+			net_udp_send_client_pdata_snapshot(i, &own);
+		}
+	}
+	else if ((Netgame.game_flag & netgame_rule_flags::pdata_snapshots) != netgame_rule_flags::None)
+	{
+		pdata_snapshot current;
+		current.state[Player_num] = own;
+		current.updated.set(Player_num);
+		net_udp_send_pdata_snapshot(0, current);
 	}
 	else
 	{
-		dxx_sendto(UDP_Socket[0], buf, 0, Netgame.players[0].protocol.udp.addr);
+		net_udp_queue_send(0, buf);
+	}
+}
+
+/* As host, send each player that takes snapshots the positions that
+ * came in for the others since its last snapshot, without waiting for my
+ * next pdata tick.
+ */
+void net_udp_send_relayed_pdata()
+{
+	if (!multi_i_am_master())
+		return;
+	for (unsigned i = 1; i < MAX_PLAYERS; ++i)
+	{
+		if (UDP_pdata_links[i].fresh.none() || vcplayerptr(i)->connected == player_connection_status::disconnected)
+			continue;
+		net_udp_send_client_pdata_snapshot(i, nullptr);
+	}
+}
+
+/* As host, pass on the position of a player: as pdata now to players
+ * that take pdata, and in a snapshot at the end of the protocol frame to
+ * the others.
+ */
+void net_udp_relay_pdata(const UDP_frame_info &pd, const std::span<const uint8_t> pdata)
+{
+	const unsigned ppn = pd.Player_num;
+	if (!(ppn > 0 && ppn <= N_players && vcplayerptr(ppn)->connected == player_connection_status::playing)) // some checking whether this packet is legal
+		return;
+	UDP_pdata_latest[ppn] = pd;
+	for (unsigned i = 1; i < MAX_PLAYERS; ++i)
+	{
+		// not to sender or disconnected/waiting players - right.
+		if (i == ppn)
+			continue;
+		auto &iplr = *vcplayerptr(i);
+		if (iplr.connected == player_connection_status::disconnected || iplr.connected == player_connection_status::waiting)
+			continue;
+		if (auto &link = UDP_pdata_links[i]; link.snapshots)
+			link.fresh.set(ppn);
+		else
+			net_udp_queue_send(i, pdata);
 	}
 }
 
@@ -5995,23 +6261,69 @@ void net_udp_process_pdata(const std::span<const uint8_t> data, const _sockaddr
 	len += 12;
 
 	if (multi_i_am_master()) // I am host - must relay this packet to others!
+		net_udp_relay_pdata(pd, data);
+
+	net_udp_read_pdata_packet (&pd);
+}
+
+void net_udp_process_pdata_snapshot(const std::span<const uint8_t> data, const _sockaddr &sender_addr)
+{
+	if (!((Game_mode & GM_NETWORK) && (Network_status == network_state::playing || Network_status == network_state::endlevel)))
+		return;
+	if (data.size() < pdata_snapshot_header_size)
+		return;
+	const playernum_t playernum = data[1];
+	if (playernum >= std::size(Netgame.players))
+		return;
+	// Clients send snapshots only to the host, and only of themselves.
+	const auto master = multi_i_am_master();
+	if (master ? playernum == 0 : playernum != 0)
+		return;
+	if (sender_addr != Netgame.players[playernum].protocol.udp.addr)
+		return;
+
+	auto &link = UDP_pdata_links[playernum];
+	link.snapshots = true;
+	const uint16_t seq = GET_INTEL_SHORT(&data[2]);
+	const uint8_t flags = data[8];
+	if (flags & pdata_snapshot_has_ack)
+		link.sender.acknowledge(GET_INTEL_SHORT(&data[6]));
+	std::optional<uint16_t> baseline;
+	if (flags & pdata_snapshot_has_baseline)
+		baseline = GET_INTEL_SHORT(&data[4]);
+	bit_reader r(data.subspan<pdata_snapshot_header_size>());
+	const auto s = link.receiver.decode(r, seq, baseline);
+	if (!s)
+		return;
+	for (playernum_t pnum = 0; pnum != MAX_PLAYERS; ++pnum)
 	{
-		const unsigned ppn = pd.Player_num;
-		if (ppn > 0 && ppn <= N_players && vcplayerptr(ppn)->connected == player_connection_status::playing) // some checking whether this packet is legal
-		{
-			for (unsigned i = 1; i < MAX_PLAYERS; ++i)
-			{
-				// not to sender or disconnected/waiting players - right.
-				if (i == ppn)
-					continue;
-				auto &iplr = *vcplayerptr(i);
-				if (iplr.connected != player_connection_status::disconnected && iplr.connected != player_connection_status::waiting)
-					dxx_sendto(UDP_Socket[0], data, 0, Netgame.players[i].protocol.udp.addr);
-			}
-		}
+		if (!s->updated[pnum] || (master ? pnum != playernum : pnum == Player_num))
+			continue;
+		auto pd{pdata_snapshot_frame(pnum, s->state[pnum])};
+		if (!pd)
+			continue;
+		if (master)
+			net_udp_relay_pdata(*pd, net_udp_build_pdata(pnum, pd->connected, pd->qpp));
+		net_udp_read_pdata_packet(&*pd);
 	}
+}
 
-	net_udp_read_pdata_packet (&pd);
+void net_udp_pdata_snapshot_init()
+{
+	for (const playernum_t pnum : xrange(MAX_PLAYERS))
+		net_udp_pdata_snapshot_reset(pnum);
+}
+
+/* Forget the snapshots exchanged with a player who joined or left. */
+void net_udp_pdata_snapshot_reset(const playernum_t pnum)
+{
+	auto &link = UDP_pdata_links[pnum];
+	link.snapshots = false;
+	link.fresh.reset();
+	link.sender.clear();
+	link.receiver.clear();
+	for (auto &l : UDP_pdata_links)
+		l.fresh.reset(pnum);
 }
 
 void net_udp_read_pdata_packet(UDP_frame_info *pd)
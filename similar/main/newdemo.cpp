@@ -81,9 +81,12 @@ COPYRIGHT 1993-1999 PARALLAX SOFTWARE CORPORATION.  ALL RIGHTS RESERVED.
 #include "controls.h"
 #include "playsave.h"
 
+#include "async_writer.h"
 #include "compiler-range_for.h"
 #include "d_levelstate.h"
 #include "partial_range.h"
+#include <limits>
+#include <memory>
 #include <utility>
 
 #define ND_EVENT_EOF				0	// EOF
@@ -169,6 +172,11 @@ const std::array<file_extension_t, 1> demo_file_extensions{{DEMO_EXT}};
 static RAIIPHYSFS_File infile;
 static RAIIPHYSFS_File outfile;
 
+/* Demo data is serialized into memory on the game thread, and written
+ * to outfile once per recorded frame by a background thread.
+ */
+static async_writer nd_record_v_writer;
+
 namespace dcx {
 game_mode_flags Newdemo_game_mode;
 }
@@ -241,7 +249,7 @@ int newdemo_get_percent_done()	{
 		return (PHYSFS_tell(infile) * 100) / nd_playback_v_demosize;
 	}
 	if ( Newdemo_state == ND_STATE_RECORDING ) {
-		return PHYSFS_tell(outfile);
+		return Newdemo_num_written;
 	}
 	return 0;
 }
@@ -293,15 +301,43 @@ static int newdemo_read(std::integral auto *const buffer, const std::size_t elsi
 	return _newdemo_read(buffer, {elsize}, {nelem});
 }
 
+/* The object most recently read with each signature.  Demos record
+ * 16-bit signatures, so this is indexed directly.  Entries are not
+ * cleared between frames; a lookup only trusts an entry after checking
+ * that the object is still live and still has that signature.
+ */
+static std::array<objnum_t, 1u << 16> nd_playback_v_objnum_by_signature;
+
 namespace dsx {
 
+namespace {
+
+static bool nd_object_has_signature(const object_base &obj, const object_signature_t signature)
+{
+	return obj.type != OBJ_NONE && obj.signature == signature;
+}
+
+static void nd_index_object(const vcobjptridx_t obj)
+{
+	auto &Objects = LevelUniqueObjectState.Objects;
+	auto &e = nd_playback_v_objnum_by_signature[static_cast<uint16_t>(obj->signature)];
+	/* If two objects share a signature, keep the lower numbered one,
+	 * which is the one a scan of the object array would find.
+	 */
+	if (e < obj.get_unchecked_index() && e < Objects.get_count() && nd_object_has_signature(*Objects.vcptr(e), obj->signature))
+		return;
+	e = obj.get_unchecked_index();
+}
+
+}
+
 icobjptridx_t newdemo_find_object(object_signature_t signature)
 {
 	auto &Objects = LevelUniqueObjectState.Objects;
-	auto &vcobjptridx = Objects.vcptridx;
-	range_for (const auto &&objp, vcobjptridx)
+	if (const auto objnum = nd_playback_v_objnum_by_signature[static_cast<uint16_t>(signature)]; objnum < Objects.get_count())
 	{
-		if ( (objp->type != OBJ_NONE) && (objp->signature == signature))
+		const auto &&objp = Objects.vcptridx(objnum);
+		if (nd_object_has_signature(objp, signature))
 			return objp;
 	}
 	return object_none;
@@ -311,21 +347,45 @@ icobjptridx_t newdemo_find_object(object_signature_t signature)
 
 namespace {
 
+static bool nd_write_to_outfile(void *, const uint8_t *const data, const std::size_t size)
+{
+	return (PHYSFS_writeBytes)(outfile, data, size) == static_cast<PHYSFS_sint64>(size);
+}
+
+static void nd_open_writer()
+{
+	nd_record_v_writer.start(nd_write_to_outfile, nullptr);
+}
+
+/* Write out everything recorded, then close outfile.  Return whether
+ * all of it was written.
+ */
+static bool nd_close_writer()
+{
+	const auto written = nd_record_v_writer.finish();
+	outfile.reset();
+	return written;
+}
+
 static int _newdemo_write(const void *buffer, int elsize, int nelem )
 {
-	int num_written, total_size;
+	int total_size;
 
 	if (unlikely(nd_record_v_no_space))
 		return -1;
 
-	total_size = elsize * nelem;
-	nd_record_v_framebytes_written += total_size;
-	Newdemo_num_written += total_size;
-	Assert(outfile);
-	num_written = (PHYSFS_writeBytes)(outfile, buffer, elsize * nelem);
-
-	if (likely(num_written == nelem))
-		return num_written;
+	/* A failed write is only seen on a later call, once the background
+	 * thread has reached it.
+	 */
+	if (likely(!nd_record_v_writer.failed()))
+	{
+		total_size = elsize * nelem;
+		nd_record_v_framebytes_written += total_size;
+		Newdemo_num_written += total_size;
+		Assert(outfile);
+		nd_record_v_writer.write(buffer, total_size);
+		return nelem;
+	}
 
 	nd_record_v_no_space=2;
 	newdemo_stop_recording();
@@ -609,6 +669,7 @@ static void nd_read_object(const vmobjptridx_t obj)
 	nd_read_short(&shortsig);
 	// It's OKAY! We made sure, obj->signature is never has a value which short cannot handle!!! We cannot do this otherwise, without breaking the demo format!
 	obj->signature = object_signature_t{static_cast<uint16_t>(shortsig)};
+	nd_index_object(obj);
 	nd_read_shortpos(obj);
 
 #if defined(DXX_BUILD_DESCENT_II)
@@ -1183,6 +1244,8 @@ void newdemo_record_start_frame(fix frame_time )
 #endif
 		nd_record_v_frame_number -= nd_record_v_start_frame;
 
+		/* The previous frame is complete, so it can be written out. */
+		nd_record_v_writer.submit();
 		nd_write_byte(ND_EVENT_START_FRAME);
 		nd_write_short(nd_record_v_framebytes_written - 1);        // from previous frame
 		nd_record_v_framebytes_written=3;
@@ -2076,6 +2139,206 @@ static void newdemo_pop_ctrlcen_triggers()
 	}
 }
 
+namespace dsx {
+
+namespace {
+
+/* Demos can only be read forwards cheaply: reading backwards reparses
+ * one frame per step, so rewinding through a long demo takes minutes.
+ * While a demo plays forwards, keep an in-memory index of the playback
+ * state every few frames, so that seeking can restore the nearest
+ * snapshot and read forward from there.
+ *
+ * The index is built lazily as the demo is read, so it works for every
+ * demo, and the demo file format is unchanged.
+ */
+
+/* Demos record at most one frame per REC_DELAY. */
+constexpr int nd_frames_per_second = F1_0 / (REC_DELAY);
+
+/* About two seconds of recording. */
+constexpr int nd_keyframe_initial_interval = 2 * nd_frames_per_second;
+
+/* When the index is full, every other snapshot is dropped and the
+ * interval doubles, so memory use is bounded for any demo length.
+ */
+constexpr std::size_t nd_keyframe_max_count = 256;
+
+struct nd_keyframe_side
+{
+	texture1_value tmap_num;
+	texture2_value tmap_num2;
+};
+
+/* The state that frame events change, as it was just before the frame
+ * at `offset` was read.  Everything else is reread from the frame.
+ */
+struct nd_keyframe
+{
+	PHYSFS_sint64 offset;
+	int framecount;
+	int level;
+	sbyte cntrlcen_destroyed;
+	ubyte dead, rear;
+#if defined(DXX_BUILD_DESCENT_II)
+	ubyte guided;
+#endif
+	unsigned n_players;
+	d_level_unique_control_center_state control_center;
+	std::vector<object> objects;
+	std::vector<player> players;
+	std::vector<wall> walls;
+	std::vector<active_door> active_doors;
+#if defined(DXX_BUILD_DESCENT_II)
+	std::vector<cloaking_wall> cloaking_walls;
+#endif
+	std::vector<per_side_array<nd_keyframe_side>> sides;
+};
+
+class nd_keyframe_index
+{
+	std::vector<nd_keyframe> keyframes;
+	int interval = nd_keyframe_initial_interval;
+	/* The frame after the last one that was read forwards without a
+	 * gap since the start of the demo.  Only those frames are indexed,
+	 * since state reached by jumping to the end or by reading
+	 * backwards is not exact.
+	 */
+	int frontier = std::numeric_limits<int>::min();
+public:
+	void clear()
+	{
+		keyframes = {};
+		interval = nd_keyframe_initial_interval;
+		frontier = std::numeric_limits<int>::min();
+	}
+	/* Start indexing once the opening frames, which load the level,
+	 * have been read.
+	 */
+	void start(const int framecount)
+	{
+		clear();
+		frontier = framecount;
+	}
+	bool wants(const int framecount) const
+	{
+		return framecount == frontier && (keyframes.empty() || framecount >= keyframes.back().framecount + interval);
+	}
+	void advance(const int framecount)
+	{
+		if (framecount == frontier)
+			++frontier;
+	}
+	void add(nd_keyframe &&k)
+	{
+		if (keyframes.size() == nd_keyframe_max_count)
+		{
+			std::size_t j = 0;
+			for (std::size_t i = 0; i < keyframes.size(); i += 2)
+				keyframes[j++] = std::move(keyframes[i]);
+			keyframes.resize(j);
+			interval *= 2;
+		}
+		keyframes.emplace_back(std::move(k));
+	}
+	int get_interval() const
+	{
+		return interval;
+	}
+	/* The last snapshot of `level` taken before `framecount`. */
+	const nd_keyframe *find_before(const int framecount, const int level) const
+	{
+		const auto i = std::partition_point(keyframes.begin(), keyframes.end(), [framecount](const nd_keyframe &k) { return k.framecount < framecount; });
+		/* Restoring a snapshot of another level would need that level
+		 * loaded first, so leave those seeks to the slower paths.
+		 */
+		if (i == keyframes.begin() || std::prev(i)->level != level)
+			return nullptr;
+		return &*std::prev(i);
+	}
+};
+
+static nd_keyframe_index nd_playback_v_keyframes;
+
+static std::unique_ptr<nd_keyframe> nd_keyframe_capture()
+{
+	auto &Objects = LevelUniqueObjectState.Objects;
+	auto &Walls = LevelUniqueWallSubsystemState.Walls;
+	auto &ActiveDoors = LevelUniqueWallSubsystemState.ActiveDoors;
+	auto k = std::make_unique<nd_keyframe>();
+	k->offset = PHYSFS_tell(infile);
+	k->framecount = nd_playback_v_framecount;
+	k->level = Current_level_num;
+	k->cntrlcen_destroyed = nd_playback_v_cntrlcen_destroyed;
+	k->dead = nd_playback_v_dead;
+	k->rear = nd_playback_v_rear;
+#if defined(DXX_BUILD_DESCENT_II)
+	k->guided = nd_playback_v_guided;
+#endif
+	k->n_players = N_players;
+	k->control_center = LevelUniqueObjectState.ControlCenterState;
+	k->objects.assign(Objects.begin(), Objects.begin() + Objects.get_count());
+	k->players.assign(Players.begin(), Players.end());
+	k->walls.assign(Walls.begin(), Walls.begin() + Walls.get_count());
+	k->active_doors.assign(ActiveDoors.begin(), ActiveDoors.begin() + ActiveDoors.get_count());
+#if defined(DXX_BUILD_DESCENT_II)
+	auto &CloakingWalls = LevelUniqueWallSubsystemState.CloakingWalls;
+	k->cloaking_walls.assign(CloakingWalls.begin(), CloakingWalls.begin() + CloakingWalls.get_count());
+#endif
+	k->sides.reserve(Highest_segment_index + 1);
+	for (const unique_segment &useg : vcsegptr)
+	{
+		auto &s = k->sides.emplace_back();
+		for (const auto side : MAX_SIDES_PER_SEGMENT)
+			s[side] = {useg.sides[side].tmap_num, useg.sides[side].tmap_num2};
+	}
+	return k;
+}
+
+static void nd_keyframe_restore(const nd_keyframe &k)
+{
+	auto &Objects = LevelUniqueObjectState.Objects;
+	auto &Walls = LevelUniqueWallSubsystemState.Walls;
+	auto &ActiveDoors = LevelUniqueWallSubsystemState.ActiveDoors;
+	PHYSFS_seek(infile, k.offset);
+	nd_playback_v_framecount = k.framecount;
+	nd_playback_v_at_eof = 0;
+	nd_playback_v_cntrlcen_destroyed = k.cntrlcen_destroyed;
+	nd_playback_v_dead = k.dead;
+	nd_playback_v_rear = k.rear;
+#if defined(DXX_BUILD_DESCENT_II)
+	nd_playback_v_guided = k.guided;
+#endif
+	N_players = k.n_players;
+	LevelUniqueObjectState.ControlCenterState = k.control_center;
+	std::copy(k.objects.begin(), k.objects.end(), Objects.begin());
+	Objects.set_count(k.objects.size());
+	std::copy(k.players.begin(), k.players.end(), Players.begin());
+	std::copy(k.walls.begin(), k.walls.end(), Walls.begin());
+	Walls.set_count(k.walls.size());
+	std::copy(k.active_doors.begin(), k.active_doors.end(), ActiveDoors.begin());
+	ActiveDoors.set_count(k.active_doors.size());
+#if defined(DXX_BUILD_DESCENT_II)
+	auto &CloakingWalls = LevelUniqueWallSubsystemState.CloakingWalls;
+	std::copy(k.cloaking_walls.begin(), k.cloaking_walls.end(), CloakingWalls.begin());
+	CloakingWalls.set_count(k.cloaking_walls.size());
+#endif
+	auto s = k.sides.begin();
+	for (unique_segment &useg : vmsegptr)
+	{
+		for (const auto side : MAX_SIDES_PER_SEGMENT)
+		{
+			useg.sides[side].tmap_num = (*s)[side].tmap_num;
+			useg.sides[side].tmap_num2 = (*s)[side].tmap_num2;
+		}
+		++s;
+	}
+}
+
+}
+
+}
+
 namespace dsx {
 static int newdemo_read_frame_information(int rewrite)
 {
@@ -2089,6 +2352,11 @@ static int newdemo_read_frame_information(int rewrite)
 
 	done = 0;
 
+	const bool forward = !rewrite && (Newdemo_vcr_state == ND_STATE_PLAYBACK || Newdemo_vcr_state == ND_STATE_FASTFORWARD || Newdemo_vcr_state == ND_STATE_ONEFRAMEFORWARD);
+	const int start_framecount = nd_playback_v_framecount;
+	const int start_level = Current_level_num;
+	auto keyframe = forward && nd_playback_v_keyframes.wants(start_framecount) ? nd_keyframe_capture() : nullptr;
+
 	if (Newdemo_vcr_state != ND_STATE_PAUSED)
 		for (unique_segment &useg : vmsegptr)
 		{
@@ -3419,6 +3687,15 @@ static int newdemo_read_frame_information(int rewrite)
 		nm_messagebox(menu_title{nullptr}, {TXT_OK}, "%s %s", TXT_DEMO_ERR_READING, TXT_DEMO_OLD_CORRUPT);
 		Current_mission.reset();
 	}
+	else if (forward && done == 1)
+	{
+		nd_playback_v_keyframes.advance(start_framecount);
+		/* A snapshot taken just before a level change holds the old
+		 * level's segments, so it cannot be restored.
+		 */
+		if (keyframe && start_level == Current_level_num)
+			nd_playback_v_keyframes.add(std::move(*keyframe));
+	}
 
 	return done;
 }
@@ -3635,18 +3912,176 @@ static window_event_result newdemo_back_frames(int frames)
 	return window_event_result::handled;
 }
 
+/* Read forwards without sound until the frame after `target`.  Reading
+ * stops early at the end of the demo, which pauses playback.
+ */
+static window_event_result newdemo_read_frames_until(const int target)
+{
+	const auto saved_vcr_state = std::exchange(Newdemo_vcr_state, ND_STATE_FASTFORWARD);
+	do {
+		if (newdemo_read_frame_information(0) == -1)
+		{
+			if (!nd_playback_v_at_eof)
+			{
+				newdemo_stop_playback();
+				return window_event_result::close;
+			}
+			Newdemo_vcr_state = ND_STATE_PAUSED;
+			return window_event_result::handled;
+		}
+	} while (nd_playback_v_framecount < target);
+	Newdemo_vcr_state = saved_vcr_state;
+	return window_event_result::handled;
+}
+
+window_event_result newdemo_skip_seconds(const int seconds)
+{
+	const int target = std::max(nd_playback_v_framecount + seconds * nd_frames_per_second, 0);
+	if (const auto k = nd_playback_v_keyframes.find_before(target + 1, Current_level_num))
+	{
+		/* Going forwards, the snapshot only helps if it is past the
+		 * current frame.
+		 */
+		if (target < nd_playback_v_framecount || k->framecount > nd_playback_v_framecount)
+		{
+			nd_keyframe_restore(*k);
+			return newdemo_read_frames_until(target);
+		}
+	}
+	if (target >= nd_playback_v_framecount)
+	{
+		if (nd_playback_v_at_eof)
+			return window_event_result::ignored;
+		return newdemo_read_frames_until(target);
+	}
+	/* The target is on an earlier level, or before the first
+	 * snapshot, so replay from the start.
+	 */
+	const auto saved_vcr_state = Newdemo_vcr_state;
+	if (const auto result = newdemo_goto_beginning(); result == window_event_result::close)
+		return result;
+	Newdemo_vcr_state = saved_vcr_state;
+	return newdemo_read_frames_until(target);
+}
+
+namespace {
+
+/* The parts of an object that interpolation moves. */
+struct nd_interpolation_object
+{
+	object_signature_t signature;
+	vms_vector pos;
+	vms_matrix orient;
+};
+
+/* Copy the live objects, sorted by signature for lookup.  The sort is
+ * stable, so among objects that share a signature, the lowest numbered
+ * one is found first, as a scan of the object array would find it.
+ */
+static void nd_interpolation_capture(std::vector<nd_interpolation_object> &result)
+{
+	auto &Objects = LevelUniqueObjectState.Objects;
+	auto &vcobjptr = Objects.vcptr;
+	result.clear();
+	for (auto &obj : vcobjptr)
+		if (obj.type != OBJ_NONE)
+			result.push_back({obj.signature, obj.pos, obj.orient});
+	std::stable_sort(result.begin(), result.end(), [](const nd_interpolation_object &a, const nd_interpolation_object &b) { return a.signature < b.signature; });
+}
+
+static const nd_interpolation_object *nd_interpolation_find(const std::vector<nd_interpolation_object> &objects, const object_signature_t signature)
+{
+	const auto i = std::partition_point(objects.begin(), objects.end(), [signature](const nd_interpolation_object &o) { return o.signature < signature; });
+	return i != objects.end() && i->signature == signature ? &*i : nullptr;
+}
+
+/* The objects of the frame after the one being shown.  Interpolation
+ * used to read that frame, then step back two frames and reread the
+ * shown frame, on every rendered frame.  Now that happens once per
+ * recorded frame, and the rendered frames in between use this copy.
+ */
+struct nd_interpolation_next_frame
+{
+	/* The shown frame that `objects` follows. */
+	int framecount = -1;
+	int level = -1;
+	PHYSFS_sint64 offset = -1;
+	std::vector<nd_interpolation_object> objects;
+	/* Rereading the shown frame sets these again each time, since
+	 * newdemo_playback_one_frame resets them before every frame.
+	 */
+	uint8_t control_center_destroyed;
+	int countdown_seconds_left;
+	int palette_red_add, palette_green_add, palette_blue_add;
+	bool is_current() const
+	{
+		return framecount == nd_playback_v_framecount && level == Current_level_num && offset == PHYSFS_tell(infile);
+	}
+	void invalidate()
+	{
+		framecount = -1;
+	}
+};
+
+static nd_interpolation_next_frame nd_playback_v_next_frame;
+
+static window_event_result nd_interpolation_read_next_frame()
+{
+	auto &LevelUniqueControlCenterState = LevelUniqueObjectState.ControlCenterState;
+	auto &Objects = LevelUniqueObjectState.Objects;
+	auto &next = nd_playback_v_next_frame;
+	const auto num_cur_objs = Objects.get_count();
+	std::vector<object> cur_objs(Objects.begin(), Objects.begin() + num_cur_objs);
+
+	Newdemo_vcr_state = ND_STATE_PAUSED;
+	if (newdemo_read_frame_information(0) == -1) {
+		newdemo_stop_playback();
+		return window_event_result::close;
+	}
+	nd_interpolation_capture(next.objects);
+
+	// get back to original position in the demo file.  Reread the current
+	// frame information again to reset all of the object stuff not covered
+	// with Highest_object_index and the object array (previously rendered
+	// objects, etc....)
+
+	auto result = newdemo_back_frames(1);
+	result = std::max(newdemo_back_frames(1), result);
+	if (newdemo_read_frame_information(0) == -1)
+	{
+		newdemo_stop_playback();
+		return window_event_result::close;
+	}
+	Newdemo_vcr_state = ND_STATE_PLAYBACK;
+
+	std::copy(cur_objs.begin(), cur_objs.begin() + num_cur_objs, Objects.begin());
+	Objects.set_count(num_cur_objs);
+
+	next.framecount = nd_playback_v_framecount;
+	next.level = Current_level_num;
+	next.offset = PHYSFS_tell(infile);
+	next.control_center_destroyed = LevelUniqueControlCenterState.Control_center_destroyed;
+	next.countdown_seconds_left = LevelUniqueControlCenterState.Countdown_seconds_left;
+	next.palette_red_add = PaletteRedAdd;
+	next.palette_green_add = PaletteGreenAdd;
+	next.palette_blue_add = PaletteBlueAdd;
+	return result;
+}
+
+}
+
 /*
  *  routine to interpolate the viewer position.  the current position is
- *  stored in the Viewer object.  Save this position, and read the next
- *  frame to get all objects read in.  Calculate the delta playback and
- *  the delta recording frame times between the two frames, then intepolate
- *  the viewers position accordingly.  nd_recorded_time is the time that it
- *  took the recording to render the frame that we are currently looking
- *  at.
+ *  stored in the Viewer object.  Calculate the delta playback and the
+ *  delta recording frame times between this frame and the next, then
+ *  intepolate the viewers position accordingly.  nd_recorded_time is the
+ *  time that it took the recording to render the frame that we are
+ *  currently looking at.
 */
 
 static window_event_result interpolate_frame(fix d_play, fix d_recorded)
 {
+	auto &LevelUniqueControlCenterState = LevelUniqueObjectState.ControlCenterState;
 	auto &Objects = LevelUniqueObjectState.Objects;
 	auto &vmobjptr = Objects.vmptr;
 	fix factor;
@@ -3659,13 +4094,19 @@ static window_event_result interpolate_frame(fix d_play, fix d_recorded)
 	if (factor > F1_0)
 		factor = F1_0;
 
-	const auto num_cur_objs = Objects.get_count();
-	std::vector<object> cur_objs(Objects.begin(), Objects.begin() + num_cur_objs);
-
-	Newdemo_vcr_state = ND_STATE_PAUSED;
-	if (newdemo_read_frame_information(0) == -1) {
-		newdemo_stop_playback();
-		return window_event_result::close;
+	auto &next = nd_playback_v_next_frame;
+	auto result = window_event_result::handled;
+	if (!next.is_current())
+	{
+		result = nd_interpolation_read_next_frame();
+		if (result == window_event_result::close)
+			return result;
+	}
+	else
+	{
+		LevelUniqueControlCenterState.Control_center_destroyed = next.control_center_destroyed;
+		LevelUniqueControlCenterState.Countdown_seconds_left = next.countdown_seconds_left;
+		PALETTE_FLASH_SET(next.palette_red_add, next.palette_green_add, next.palette_blue_add);
 	}
 
 	InterpolStep -= FrameTime;
@@ -3673,76 +4114,59 @@ static window_event_result interpolate_frame(fix d_play, fix d_recorded)
 	// This interpolating looks just more crappy on high FPS, so let's not even waste performance on it.
 	if (InterpolStep <= 0)
 	{
-		range_for (auto &i, partial_range(cur_objs, num_cur_objs)) {
-			for (auto &obj : vmobjptr)
+		for (auto &i : vmobjptr)
+		{
+			if (i.type == OBJ_NONE)
+				continue;
+			if (const auto obj = nd_interpolation_find(next.objects, i.signature))
 			{
-				if (i.signature == obj.signature)
-				{
-					const auto rtype = i.render_type;
-					fix delta_x, delta_y, delta_z;
+				const auto rtype = i.render_type;
+				fix delta_x, delta_y, delta_z;
 
-					//  Extract the angles from the object orientation matrix.
-					//  Some of this code taken from ai_turn_towards_vector
-					//  Don't do the interpolation on certain render types which don't use an orientation matrix
+				//  Extract the angles from the object orientation matrix.
+				//  Some of this code taken from ai_turn_towards_vector
+				//  Don't do the interpolation on certain render types which don't use an orientation matrix
 
-					if (!(rtype == render_type::RT_LASER || rtype == render_type::RT_FIREBALL || rtype == render_type::RT_POWERUP))
-					{
-						vms_vector  fvec1, fvec2, rvec1, rvec2;
-
-						fvec1 = i.orient.fvec;
-						vm_vec_scale(fvec1, F1_0-factor);
-						fvec2 = obj.orient.fvec;
-						vm_vec_scale(fvec2, factor);
-						vm_vec_add2(fvec1, fvec2);
-						const auto mag1 = vm_vec_normalize_quick(fvec1);
-						if (mag1 > F1_0/256) {
-							rvec1 = i.orient.rvec;
-							vm_vec_scale(rvec1, F1_0-factor);
-							rvec2 = obj.orient.rvec;
-							vm_vec_scale(rvec2, factor);
-							vm_vec_add2(rvec1, rvec2);
-							vm_vec_normalize_quick(rvec1); // Note: Doesn't matter if this is null, if null, vm_vector_to_matrix will just use fvec1
-							vm_vector_to_matrix_r(i.orient, fvec1, rvec1);
-						}
+				if (!(rtype == render_type::RT_LASER || rtype == render_type::RT_FIREBALL || rtype == render_type::RT_POWERUP))
+				{
+					vms_vector  fvec1, fvec2, rvec1, rvec2;
+
+					fvec1 = i.orient.fvec;
+					vm_vec_scale(fvec1, F1_0-factor);
+					fvec2 = obj->orient.fvec;
+					vm_vec_scale(fvec2, factor);
+					vm_vec_add2(fvec1, fvec2);
+					const auto mag1 = vm_vec_normalize_quick(fvec1);
+					if (mag1 > F1_0/256) {
+						rvec1 = i.orient.rvec;
+						vm_vec_scale(rvec1, F1_0-factor);
+						rvec2 = obj->orient.rvec;
+						vm_vec_scale(rvec2, factor);
+						vm_vec_add2(rvec1, rvec2);
+						vm_vec_normalize_quick(rvec1); // Note: Doesn't matter if this is null, if null, vm_vector_to_matrix will just use fvec1
+						vm_vector_to_matrix_r(i.orient, fvec1, rvec1);
 					}
+				}
 
-					// Interpolate the object position.  This is just straight linear
-					// interpolation.
+				// Interpolate the object position.  This is just straight linear
+				// interpolation.
 
-					delta_x = obj.pos.x - i.pos.x;
-					delta_y = obj.pos.y - i.pos.y;
-					delta_z = obj.pos.z - i.pos.z;
+				delta_x = obj->pos.x - i.pos.x;
+				delta_y = obj->pos.y - i.pos.y;
+				delta_z = obj->pos.z - i.pos.z;
 
-					delta_x = fixmul(delta_x, factor);
-					delta_y = fixmul(delta_y, factor);
-					delta_z = fixmul(delta_z, factor);
+				delta_x = fixmul(delta_x, factor);
+				delta_y = fixmul(delta_y, factor);
+				delta_z = fixmul(delta_z, factor);
 
-					i.pos.x += delta_x;
-					i.pos.y += delta_y;
-					i.pos.z += delta_z;
-				}
+				i.pos.x += delta_x;
+				i.pos.y += delta_y;
+				i.pos.z += delta_z;
 			}
 		}
 		InterpolStep = fl2f(.01);
 	}
 
-	// get back to original position in the demo file.  Reread the current
-	// frame information again to reset all of the object stuff not covered
-	// with Highest_object_index and the object array (previously rendered
-	// objects, etc....)
-
-	auto result = newdemo_back_frames(1);
-	result = std::max(newdemo_back_frames(1), result);
-	if (newdemo_read_frame_information(0) == -1)
-	{
-		newdemo_stop_playback();
-		result =  window_event_result::close;
-	}
-	Newdemo_vcr_state = ND_STATE_PLAYBACK;
-
-	std::copy(cur_objs.begin(), cur_objs.begin() + num_cur_objs, Objects.begin());
-	Objects.set_count(num_cur_objs);
-
 	return result;
 }
 
@@ -3782,7 +4206,19 @@ window_event_result newdemo_playback_one_frame()
 			return newdemo_goto_beginning();
 		}
 		if (Newdemo_vcr_state == ND_STATE_REWINDING)
+		{
+			/* Where the index covers this part of the demo, step back a
+			 * whole snapshot at a time instead of rereading every frame
+			 * backwards.
+			 */
+			const auto k = nd_playback_v_keyframes.find_before(nd_playback_v_framecount - 1, level);
+			if (k && nd_playback_v_framecount - k->framecount <= 2 * nd_playback_v_keyframes.get_interval())
+			{
+				nd_keyframe_restore(*k);
+				return newdemo_read_frames_until(k->framecount);
+			}
 			frames_back = 10;
+		}
 		else
 			frames_back = 1;
 		if (nd_playback_v_at_eof) {
@@ -3877,11 +4313,9 @@ window_event_result newdemo_playback_one_frame()
 			if (nd_recorded_total - nd_playback_total < FrameTime) {
 				d_recorded = nd_recorded_total - nd_playback_total;
 
+				std::vector<nd_interpolation_object> cur_objs;
 				while (nd_recorded_total - nd_playback_total < FrameTime) {
-					unsigned num_objs;
-
-					num_objs = Highest_object_index;
-					std::vector<object> cur_objs(Objects.begin(), Objects.begin() + num_objs + 1);
+					nd_interpolation_capture(cur_objs);
 
 					const int level = Current_level_num;
 					if (newdemo_read_frame_information(0) == -1) {
@@ -3902,15 +4336,13 @@ window_event_result newdemo_playback_one_frame()
 					//  copy that interpolated object to the new Objects array so that the
 					//  interpolated position and orientation can be preserved.
 
-					range_for (auto &i, partial_const_range(cur_objs, 1 + num_objs)) {
-						for (auto &obj : vmobjptr)
+					for (auto &i : cur_objs)
+					{
+						if (const auto &&objp = newdemo_find_object(i.signature); objp != object_none)
 						{
-							if (i.signature == obj.signature)
-							{
-								obj.orient = i.orient;
-								obj.pos = i.pos;
-								break;
-							}
+							auto &obj = *vmobjptr(objp.get_unchecked_index());
+							obj.orient = i.orient;
+							obj.pos = i.pos;
 						}
 					}
 					d_recorded += nd_recorded_time;
@@ -3972,7 +4404,10 @@ void newdemo_start_recording()
 		run_blocking_newmenu<error_writing_demo>(errstr);
 	}
 	else
+	{
+		nd_open_writer();
 		newdemo_record_start_demo();
+	}
 }
 
 static void newdemo_write_end()
@@ -4147,7 +4582,8 @@ void newdemo_stop_recording()
 		newdemo_write_end();
 	}
 
-	outfile.reset();
+	if (!nd_close_writer() && !nd_record_v_no_space)
+		nd_record_v_no_space = 2;
 	Newdemo_state = ND_STATE_NORMAL;
 	gr_palette_load( gr_palette );
 try_again:
@@ -4303,6 +4739,8 @@ void newdemo_start_playback(const char * filename)
 	nd_playback_v_guided = 0;
 #endif
 	nd_playback_v_dead = nd_playback_v_rear = 0;
+	nd_playback_v_keyframes.clear();
+	nd_playback_v_next_frame.invalidate();
 	HUD_clear_messages();
 	if (!Game_wind)
 		hide_menus();
@@ -4311,6 +4749,7 @@ void newdemo_start_playback(const char * filename)
 
 	if (result == window_event_result::close)
 		return;	// whoops, there was an error reading the first two frames! Abort!
+	nd_playback_v_keyframes.start(nd_playback_v_framecount);
 
 	if (!Game_wind)
 		Game_wind = game_setup();							// create game environment
@@ -4322,6 +4761,8 @@ namespace dsx {
 void newdemo_stop_playback()
 {
 	infile.reset();
+	nd_playback_v_keyframes.clear();
+	nd_playback_v_next_frame.invalidate();
 	Newdemo_state = ND_STATE_NORMAL;
 	change_playernum_to(0);             //this is reality
 	get_local_player().callsign = nd_playback_v_save_callsign;
@@ -4359,6 +4800,7 @@ int newdemo_swap_endian(const char *filename)
 		goto read_error;
 	}
 
+	nd_open_writer();
 	Newdemo_num_written = 0;
 	nd_playback_v_bad_read = 0;
 	swap_endian = 1;
@@ -4368,12 +4810,13 @@ int newdemo_swap_endian(const char *filename)
 	if (newdemo_read_demo_start(purpose_type::rewrite))
 	{
 		infile.reset();
-		outfile.reset();
+		nd_close_writer();
 		swap_endian = 0;
 		return 0;
 	}
 
-	while (newdemo_read_frame_information(1) == 1) {}	// rewrite all frames
+	while (newdemo_read_frame_information(1) == 1)	// rewrite all frames
+		nd_record_v_writer.submit();
 
 	newdemo_goto_end(1);	// get end of demo data
 	newdemo_write_end();	// and write it
@@ -4381,7 +4824,8 @@ int newdemo_swap_endian(const char *filename)
 	swap_endian = 0;
 	complete = nd_playback_v_demosize == Newdemo_num_written;
 	infile.reset();
-	outfile.reset();
+	if (!nd_close_writer())
+		complete = false;
 
 	std::array<char, PATH_MAX> bakpath;
 	if (complete && change_filename_extension(bakpath, inpath, DEMO_BACKUP_EXT))
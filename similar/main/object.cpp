@@ -24,10 +24,14 @@ COPYRIGHT 1993-1999 PARALLAX SOFTWARE CORPORATION.  ALL RIGHTS RESERVED.
  */
 
 #include <algorithm>
+#include <bit>
+#include <bitset>
+#include <chrono>
 #include <cstdlib>
 #include <stdio.h>
 
 #include "inferno.h"
+#include "args.h"
 #include "game.h"
 #include "gr.h"
 #include "bm.h"
@@ -71,6 +75,8 @@ COPYRIGHT 1993-1999 PARALLAX SOFTWARE CORPORATION.  ALL RIGHTS RESERVED.
 #include "gameseq.h"
 #include "playsave.h"
 #include "timer.h"
+#include "cmd.h"
+#include "parallel.h"
 #if DXX_USE_EDITOR
 #include "editor/editor.h"
 #endif
@@ -81,6 +87,7 @@ COPYRIGHT 1993-1999 PARALLAX SOFTWARE CORPORATION.  ALL RIGHTS RESERVED.
 #include "d_underlying_value.h"
 #include "partial_range.h"
 #include <utility>
+#include <vector>
 
 using std::min;
 using std::max;
@@ -149,13 +156,113 @@ void object_goto_next_viewer(const object_array &Objects, const object *&viewer)
 }
 #endif
 
-imobjptridx_t obj_find_first_of_type(fvmobjptridx &vmobjptridx, const object_type_t type)
+d_object_type_index::d_object_type_index()
 {
-	range_for (const auto &&i, vmobjptridx)
+	indexed_type.fill(OBJ_NONE);
+}
+
+void d_object_type_index::update(const objnum_t objnum, const object_type_t type)
+{
+	auto &old_type = indexed_type[objnum];
+	if (old_type == type)
+		return;
+	const auto w = objnum / word_bits;
+	const auto bit = word_type{1} << (objnum % word_bits);
+	if (old_type < MAX_OBJECT_TYPES)
+		objects_by_type[old_type][w] &= ~bit;
+	if (type < MAX_OBJECT_TYPES)
 	{
-		if (i->type==type)
-			return i;
+		objects_by_type[type][w] |= bit;
+		old_type = type;
+	}
+	else
+		old_type = OBJ_NONE;
+}
+
+void d_object_type_index::rebuild(const object_array &Objects)
+{
+	objects_by_type = {};
+	indexed_type.fill(OBJ_NONE);
+	/* Every object above Highest_object_index is free. */
+	for (objnum_t i = 0, n = Objects.get_count(); i != n; ++i)
+		update(i, Objects.vcptr(i)->type);
+}
+
+#ifndef NDEBUG
+bool d_object_type_index::matches(const object_array &Objects) const
+{
+	const auto n = Objects.get_count();
+	for (objnum_t i = 0; i != MAX_OBJECTS; ++i)
+	{
+		const auto type = i < n ? Objects.vcptr(i)->type : OBJ_NONE;
+		const auto expected = type < MAX_OBJECT_TYPES ? type : OBJ_NONE;
+		if (indexed_type[i] != expected)
+			return false;
+		const auto w = i / word_bits;
+		const auto bit = word_type{1} << (i % word_bits);
+		for (std::size_t t = 0; t != MAX_OBJECT_TYPES; ++t)
+			if (!(objects_by_type[t][w] & bit) != (t != expected))
+				return false;
+	}
+	return true;
+}
+#endif
+
+objnum_t d_object_type_index::find_next(const objnum_t first, const objnum_t end, const object_type_mask types) const
+{
+	const auto type_bits = types.get_bits();
+	/* Mask off the object numbers before `first` in its word. */
+	auto skip = word_type{~0ull} << (first % word_bits);
+	for (std::size_t w = first / word_bits; w * word_bits < end; ++w, skip = ~word_type{0})
+	{
+		word_type found = 0;
+		for (auto t = type_bits; t; t &= t - 1)
+			found |= objects_by_type[std::countr_zero(t)][w];
+		if (found &= skip)
+		{
+			const std::size_t objnum = w * word_bits + std::countr_zero(found);
+			return objnum < end ? objnum : end;
+		}
+	}
+	return end;
+}
+
+objnum_t object_type_range::find_next(objnum_t first) const
+{
+	for (;; ++first)
+	{
+		first = index.find_next(first, end_objnum, types);
+		if (first == end_objnum || !center)
+			return first;
+		/* Widen before subtracting, so that a distant object cannot
+		 * overflow into range.
+		 */
+		const auto &pos = vmobjptridx(first)->pos;
+		if (std::abs(int64_t{pos.x} - center->x) < radius.d &&
+			std::abs(int64_t{pos.y} - center->y) < radius.d &&
+			std::abs(int64_t{pos.z} - center->z) < radius.d)
+			return first;
 	}
+}
+
+void note_object_type_change(const object_base &obj)
+{
+	auto &Objects = LevelUniqueObjectState.Objects;
+	/* Objects outside the object array, such as local copies, are not
+	 * indexed.
+	 */
+	const auto base = &Objects.front();
+	const auto p = &static_cast<const object &>(obj);
+	if (p < base || p >= base + MAX_OBJECTS)
+		return;
+	LevelUniqueObjectState.Object_types.update(p - base, obj.type);
+}
+
+imobjptridx_t obj_find_first_of_type(d_level_unique_object_state &LevelUniqueObjectState, const object_type_t type)
+{
+	auto &Objects = LevelUniqueObjectState.Objects;
+	for (const auto &&i : object_type_range(LevelUniqueObjectState.Object_types, Objects.vmptridx, {type}))
+		return i;
 	return object_none;
 }
 
@@ -925,7 +1032,7 @@ void reset_player_object(object_base &ConsoleObject)
 //make object0 the player, setting all relevant fields
 void init_player_object(const d_level_shared_polygon_model_state &LevelSharedPolygonModelState, object_base &console)
 {
-	console.type = OBJ_PLAYER;
+	set_object_type(console, OBJ_PLAYER);
 	set_player_id(console, 0);					//no sub-types for player
 	console.signature = object_signature_t{0};
 	auto &Polygon_models = LevelSharedPolygonModelState.Polygon_models;
@@ -937,6 +1044,15 @@ void init_player_object(const d_level_shared_polygon_model_state &LevelSharedPol
 	reset_player_object(console);
 }
 
+/* In a netgame, every player must refuse the same objects when the
+ * limit is reached, and the limit is not part of the netgame info, so
+ * netgames keep the original limit.
+ */
+static unsigned level_object_limit()
+{
+	return (Game_mode & GM_MULTI) ? DEFAULT_MAX_OBJECTS : CGameArg.SysMaxObjects;
+}
+
 //sets up the free list & init player & whatever else
 void init_objects()
 {
@@ -958,7 +1074,9 @@ void init_objects()
 	init_player_object(LevelSharedPolygonModelState, *ConsoleObject);
 	obj_link_unchecked(Objects.vmptr, Objects.vmptridx(ConsoleObject), Segments.vmptridx(segment_first));	//put in the world in segment 0
 	LevelUniqueObjectState.num_objects = 1;						//just the player
+	LevelUniqueObjectState.Object_limit = level_object_limit();
 	Objects.set_count(1);
+	LevelUniqueObjectState.Object_types.rebuild(Objects);
 }
 
 //after calling init_object(), the network code has grabbed specific
@@ -1002,6 +1120,7 @@ void special_reset_objects(d_level_unique_object_state &LevelUniqueObjectState,
 	LevelUniqueObjectState.BuddyState.Buddy_objnum = Buddy_objnum;
 #endif
 	LevelUniqueObjectState.num_objects = num_objects;
+	LevelUniqueObjectState.Object_types.rebuild(Objects);
 }
 
 void obj_link_unchecked(fvmobjptr &vmobjptr, const vmobjptridx_t obj, const vmsegptridx_t segnum)
@@ -1054,7 +1173,7 @@ void obj_unlink(fvmobjptr &vmobjptr, fvmsegptr &vmsegptr, object_base &obj)
 imobjptridx_t obj_allocate(d_level_unique_object_state &LevelUniqueObjectState)
 {
 	auto &Objects = LevelUniqueObjectState.Objects;
-	if (LevelUniqueObjectState.num_objects >= Objects.size())
+	if (LevelUniqueObjectState.num_objects >= LevelUniqueObjectState.Object_limit)
 		return object_none;
 
 	const auto objnum = LevelUniqueObjectState.free_obj_list[LevelUniqueObjectState.num_objects++];
@@ -1103,10 +1222,14 @@ static void free_object_slots(uint_fast32_t num_used)
 	auto &vmobjptr = Objects.vmptr;
 	std::array<object *, MAX_OBJECTS>	obj_list;
 	unsigned	num_already_free, num_to_free, olind = 0;
+	/* Objects loaded from a level, a saved game or a network host may
+	 * reach past the limit set for this game.
+	 */
+	const unsigned object_limit = std::max<unsigned>(LevelUniqueObjectState.Object_limit, Objects.get_count());
 
-	num_already_free = MAX_OBJECTS - Highest_object_index - 1;
+	num_already_free = object_limit - Highest_object_index - 1;
 
-	if (MAX_OBJECTS - num_already_free < num_used)
+	if (object_limit - num_already_free < num_used)
 		return;
 
 	for (auto &obj : vmobjptr)
@@ -1114,14 +1237,14 @@ static void free_object_slots(uint_fast32_t num_used)
 		if (obj.flags & OF_SHOULD_BE_DEAD)
 		{
 			num_already_free++;
-			if (MAX_OBJECTS - num_already_free < num_used)
+			if (object_limit - num_already_free < num_used)
 				return;
 		} else
 			switch (obj.type)
 			{
 				case OBJ_NONE:
 					num_already_free++;
-					if (MAX_OBJECTS - num_already_free < num_used)
+					if (object_limit - num_already_free < num_used)
 						return;
 					break;
 				case OBJ_WALL:
@@ -1148,7 +1271,7 @@ static void free_object_slots(uint_fast32_t num_used)
 
 	}
 
-	num_to_free = MAX_OBJECTS - num_used - num_already_free;
+	num_to_free = object_limit - num_used - num_already_free;
 
 	if (num_to_free > olind) {
 		num_to_free = olind;
@@ -1231,6 +1354,7 @@ imobjptridx_t obj_create(d_level_unique_object_state &LevelUniqueObjectState, co
 
 	obj->signature = next(signature);
 	obj->type 				= type;
+	LevelUniqueObjectState.Object_types.update(obj.get_unchecked_index(), type);
 	obj->id 				= id;
 	obj->pos 				= pos;
 	obj->size 				= size;
@@ -1375,6 +1499,7 @@ void obj_delete(d_level_unique_object_state &LevelUniqueObjectState, segment_arr
 	const auto signature = obj->signature;
 	DXX_POISON_VAR(*obj, 0xfa);
 	obj->type = OBJ_NONE;		//unused!
+	LevelUniqueObjectState.Object_types.update(obj.get_unchecked_index(), OBJ_NONE);
 	/* Preserve signature across the poison value.  When the object slot
 	 * is reused, the allocator will need the old signature so that the
 	 * new one can be derived from it.  No other sites should read it
@@ -1425,7 +1550,7 @@ void dead_player_end(void)
 	Dead_player_camera = NULL;
 	select_cockpit(PlayerCfg.CockpitMode[0]);
 	Viewer = Viewer_save;
-	ConsoleObject->type = OBJ_PLAYER;
+	set_object_type(*ConsoleObject, OBJ_PLAYER);
 	ConsoleObject->flags = Player_flags_save;
 
 	assert(Control_type_save == object::control_type::flying || Control_type_save == object::control_type::slew);
@@ -1573,7 +1698,7 @@ window_event_result dead_player_frame(const d_robot_info_array &Robot_info)
 				explode_object(LevelUniqueObjectState, Robot_info, LevelSharedSegmentState, LevelUniqueSegmentState, cobjp, 0);
 				ConsoleObject->flags &= ~OF_SHOULD_BE_DEAD;		//don't really kill player
 				ConsoleObject->render_type = render_type::RT_NONE;				//..just make him disappear
-				ConsoleObject->type = OBJ_GHOST;						//..and kill intersections
+				set_object_type(*ConsoleObject, OBJ_GHOST);						//..and kill intersections
 #if defined(DXX_BUILD_DESCENT_II)
 				player_info.powerup_flags &= ~PLAYER_FLAGS_HEADLIGHT_ON;
 #endif
@@ -1706,9 +1831,9 @@ static void obj_delete_all_that_should_be_dead()
 	objnum_t		local_dead_player_object=object_none;
 
 	// Move all objects
-	range_for (const auto &&objp, vmobjptridx)
+	for (const auto &&objp : object_type_range(LevelUniqueObjectState.Object_types, vmobjptridx, object_type_mask::all()))
 	{
-		if ((objp->type!=OBJ_NONE) && (objp->flags&OF_SHOULD_BE_DEAD) )	{
+		if (objp->flags&OF_SHOULD_BE_DEAD)	{
 			Assert(!(objp->type==OBJ_FIREBALL && objp->ctype.expl_info.delete_time!=-1));
 			if (objp->type==OBJ_PLAYER) {
 				if ( get_player_id(objp) == Player_num ) {
@@ -1840,6 +1965,23 @@ int Drop_afterburner_blob_flag;		//ugly hack
 
 namespace {
 
+static void object_count_down_lifeleft(object_base &obj)
+{
+	auto lifeleft = obj.lifeleft;
+	if (lifeleft != IMMORTAL_TIME) //if not immortal...
+	{
+		lifeleft -= FrameTime; //...inevitable countdown towards death
+#if defined(DXX_BUILD_DESCENT_II)
+		if (obj.type == OBJ_MARKER)
+		{
+			if (lifeleft < F1_0*1000)
+				lifeleft += F1_0; // Make sure this object doesn't go out.
+		}
+#endif
+		obj.lifeleft = lifeleft;
+	}
+}
+
 //--------------------------------------------------------------------
 //move an object for the current frame
 static window_event_result object_move_one(const d_level_shared_robot_info_state &LevelSharedRobotInfoState, const vmobjptridx_t obj, control_info &Controls)
@@ -1877,21 +2019,7 @@ static window_event_result object_move_one(const d_level_shared_robot_info_state
 		}
 	}
 
-	{
-		auto lifeleft = obj->lifeleft;
-		if (lifeleft != IMMORTAL_TIME) //if not immortal...
-		{
-			lifeleft -= FrameTime; //...inevitable countdown towards death
-#if defined(DXX_BUILD_DESCENT_II)
-			if (obj->type == OBJ_MARKER)
-			{
-				if (lifeleft < F1_0*1000)
-					lifeleft += F1_0; // Make sure this object doesn't go out.
-			}
-#endif
-			obj->lifeleft = lifeleft;
-		}
-	}
+	object_count_down_lifeleft(obj);
 #if defined(DXX_BUILD_DESCENT_II)
 	Drop_afterburner_blob_flag = 0;
 #endif
@@ -2132,6 +2260,124 @@ static window_event_result object_move_one(const d_level_shared_robot_info_state
 	return result;
 }
 
+//	Objects that object_move_all may move as one batch, before the other
+//	objects and possibly on several threads.  Moving one of these changes
+//	only its own lifetime, flags and animation frame.  It does not move the
+//	object, create an object, play a sound or call d_rand, and nothing moved
+//	later in the frame reads what it changes, so the batch gives the same
+//	game state as moving these objects in object order.
+//	An expiring powerup leaves an explosion and plays a sound, and an
+//	explosion that will create or delete another object reads that object,
+//	so those stay with the serial objects.
+static bool object_moves_independently(const object &obj)
+{
+	if (obj.flags & OF_SHOULD_BE_DEAD)
+		return false;
+	if (obj.movement_source != object::movement_type::None)
+		return false;
+	switch (obj.control_source)
+	{
+		case object::control_type::None:
+		case object::control_type::light:
+			return true;
+		case object::control_type::powerup:
+			return obj.lifeleft == IMMORTAL_TIME || obj.lifeleft > FrameTime;
+		case object::control_type::explosion:
+			return obj.ctype.expl_info.spawn_time < 0 && obj.ctype.expl_info.delete_time < 0;
+		default:
+			return false;
+	}
+}
+
+//	The part of object_move_one that applies to objects accepted by
+//	object_moves_independently.
+static void object_move_independent(const d_robot_info_array &Robot_info, const vmobjptridx_t obj)
+{
+	object_count_down_lifeleft(obj);
+	switch (obj->control_source)
+	{
+		case object::control_type::powerup:
+			do_powerup_frame(Vclip, obj);
+			break;
+		case object::control_type::explosion:
+			do_explosion_sequence(Robot_info, obj);
+			break;
+		default:
+			break;
+	}
+	if (obj->lifeleft < 0)		// We died of old age
+		obj->flags |= OF_SHOULD_BE_DEAD;
+}
+
+//	Batches smaller than this are not worth waking the worker threads.
+constexpr std::size_t object_move_parallel_threshold = 64;
+
+static bool Object_move_batch_enabled = true;
+
+struct object_move_class_timing
+{
+	unsigned long objects;
+	std::chrono::steady_clock::duration time;
+	void add(const std::size_t count, const std::chrono::steady_clock::time_point start, const std::chrono::steady_clock::time_point end)
+	{
+		objects += count;
+		time += end - start;
+	}
+};
+
+static unsigned long Object_move_frames;
+static object_move_class_timing Object_move_independent_timing, Object_move_serial_timing;
+
+static void object_move_print_timing(const char *const name, const object_move_class_timing &t)
+{
+	const auto us = std::chrono::duration_cast<std::chrono::microseconds>(t.time).count();
+	con_printf(CON_NORMAL, "    %s: %lu objects, %lu us/frame", name, Object_move_frames ? t.objects / Object_move_frames : 0ul, Object_move_frames ? static_cast<unsigned long>(us / Object_move_frames) : 0ul);
+}
+
+static void object_cmd_move_stats(unsigned long argc, const char *const *const argv)
+{
+	if (argc > 1)
+		Object_move_batch_enabled = strtoul(argv[1], nullptr, 10);
+	con_printf(CON_NORMAL, "object_move_stats: batch %s, %u threads, %lu frames", Object_move_batch_enabled ? "on" : "off", get_parallel_thread_count(), Object_move_frames);
+	object_move_print_timing("independent", Object_move_independent_timing);
+	object_move_print_timing("serial", Object_move_serial_timing);
+	Object_move_frames = 0;
+	Object_move_independent_timing = {};
+	Object_move_serial_timing = {};
+}
+
+//	Move the objects accepted by object_moves_independently, and mark their
+//	slots in `moved`.  Return the number of objects moved.
+static std::size_t object_move_independent_batch(const d_robot_info_array &Robot_info, std::bitset<MAX_OBJECTS> &moved, std::array<object_signature_t, MAX_OBJECTS> &moved_signature)
+{
+	auto &Objects = LevelUniqueObjectState.Objects;
+	auto &vmobjptridx = Objects.vmptridx;
+	static std::vector<objnum_t> batch;
+	batch.clear();
+	for (const auto &&objp : object_type_range(LevelUniqueObjectState.Object_types, vmobjptridx, {OBJ_FIREBALL, OBJ_POWERUP, OBJ_HOSTAGE, OBJ_CLUTTER, OBJ_LIGHT,
+#if defined(DXX_BUILD_DESCENT_II)
+		OBJ_MARKER,
+#endif
+	}))
+	{
+		if (!object_moves_independently(objp))
+			continue;
+		const objnum_t objnum = objp;
+		batch.emplace_back(objnum);
+		moved.set(objnum);
+		moved_signature[objnum] = objp->signature;
+	}
+	const auto move = [&Robot_info, &vmobjptridx](const std::size_t i) {
+		object_move_independent(Robot_info, vmobjptridx(batch[i]));
+	};
+	if (batch.size() >= object_move_parallel_threshold)
+		parallel_for(batch.size(), move);
+	else
+		for (std::size_t i = 0; i != batch.size(); ++i)
+			move(i);
+	return batch.size();
+}
+
 //--------------------------------------------------------------------
 //move all objects for the current frame
 static window_event_result object_move_all(const d_level_shared_robot_info_state &LevelSharedRobotInfoState)
@@ -2140,23 +2386,47 @@ static window_event_result object_move_all(const d_level_shared_robot_info_state
 	auto &vmobjptridx = Objects.vmptridx;
 	auto result = window_event_result::ignored;
 
-	if (Highest_object_index > MAX_USED_OBJECTS)
-		free_object_slots(MAX_USED_OBJECTS);		//	Free all possible object slots.
+	if (const auto max_used_objects = LevelUniqueObjectState.get_max_used_objects(); Highest_object_index > max_used_objects)
+		free_object_slots(max_used_objects);		//	Free all possible object slots.
 
 	obj_delete_all_that_should_be_dead();
+	assert(LevelUniqueObjectState.Object_types.matches(Objects));
 
 	if (PlayerCfg.AutoLeveling)
 		ConsoleObject->mtype.phys_info.flags |= PF_LEVELLING;
 	else
 		ConsoleObject->mtype.phys_info.flags &= ~PF_LEVELLING;
 
-	// Move all objects
-	range_for (const auto &&objp, vmobjptridx)
+	ai_start_visibility_prefetch();
+
+	// Move the objects that do not interact with anything first, then
+	// the rest in object order.  A slot moved in the batch is skipped
+	// below unless it was reused for a new object in the meantime.
+	std::bitset<MAX_OBJECTS> moved;
+	std::array<object_signature_t, MAX_OBJECTS> moved_signature;
+	const auto batch_start = std::chrono::steady_clock::now();
+	const auto batch_count = Object_move_batch_enabled ? object_move_independent_batch(LevelSharedRobotInfoState.Robot_info, moved, moved_signature) : 0;
+	const auto serial_start = std::chrono::steady_clock::now();
+	Object_move_independent_timing.add(batch_count, batch_start, serial_start);
+
+	// Move all objects.  Walk the type index, so that the free slots
+	// between live objects are not read at all.
+	std::size_t serial_count = 0;
+	for (const auto &&objp : object_type_range(LevelUniqueObjectState.Object_types, vmobjptridx, object_type_mask::all()))
 	{
-		if ( (objp->type != OBJ_NONE) && (!(objp->flags&OF_SHOULD_BE_DEAD)) )	{
+		if (const objnum_t objnum = objp; moved.test(objnum) && objp->signature == moved_signature[objnum])
+		{
+			if (!(objp->flags&OF_SHOULD_BE_DEAD))
+				result = std::max(window_event_result::handled, result);
+			continue;
+		}
+		if (!(objp->flags&OF_SHOULD_BE_DEAD))	{
+			++ serial_count;
 			result = std::max(object_move_one(LevelSharedRobotInfoState, objp, Controls), result);
 		}
 	}
+	Object_move_serial_timing.add(serial_count, serial_start, std::chrono::steady_clock::now());
+	++ Object_move_frames;
 
 //	check_duplicate_objects();
 //	remove_incorrect_objects();
@@ -2177,6 +2447,11 @@ window_event_result endlevel_move_all_objects(const d_level_shared_robot_info_st
 	return object_move_all(LevelSharedRobotInfoState);
 }
 
+void init_object_commands()
+{
+	cmd_addcommand("object_move_stats", object_cmd_move_stats, "object_move_stats [0|1]\n" "    show object movement times for the independent batch and the serial objects, and optionally turn the batch off or on");
+}
+
 //--unused-- // -----------------------------------------------------------
 //--unused-- //	Moved here from eobject.c on 02/09/94 by MK.
 //--unused-- int find_last_obj(int i)
@@ -2247,6 +2522,7 @@ void reset_objects(d_level_unique_object_state &LevelUniqueObjectState, const un
 {
 	LevelUniqueObjectState.Debris_object_count = 0;
 	LevelUniqueObjectState.num_objects = n_objs;
+	LevelUniqueObjectState.Object_limit = level_object_limit();
 	assert(LevelUniqueObjectState.num_objects > 0);
 	auto &Objects = LevelUniqueObjectState.get_objects();
 	assert(LevelUniqueObjectState.num_objects < Objects.size());
@@ -2264,6 +2540,7 @@ void reset_objects(d_level_unique_object_state &LevelUniqueObjectState, const un
 		obj.type = OBJ_NONE;
 		obj.signature = object_signature_t{0};
 	}
+	LevelUniqueObjectState.Object_types.rebuild(Objects);
 }
 
 //Tries to find a segment for an object, using find_point_seg()
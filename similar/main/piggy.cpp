@@ -48,18 +48,26 @@ COPYRIGHT 1993-1999 PARALLAX SOFTWARE CORPORATION.  ALL RIGHTS RESERVED.
 #include "gamemine.h"
 #include "textures.h"
 #include "texmerge.h"
+#if !DXX_USE_OGL
+#include "texmap.h"
+#endif
 #include "paging.h"
 #include "game.h"
 #include "text.h"
 #include "vclip.h"
 #include "makesig.h"
 #include "console.h"
+#include "cmd.h"
 #include "compiler-cf_assert.h"
 #include "compiler-range_for.h"
 #include "d_range.h"
 #include "d_zip.h"
 #include "partial_range.h"
+#include <algorithm>
+#include <bit>
+#include <climits>
 #include <memory>
+#include <vector>
 
 #if defined(DXX_BUILD_DESCENT_I)
 #include "custom.h"
@@ -127,6 +135,8 @@ unsigned Num_bitmap_files;
 namespace dsx {
 std::array<digi_sound, MAX_SOUND_FILES> GameSounds;
 GameBitmaps_array GameBitmaps;
+enumerated_array<unsigned, MAX_BITMAP_FILES, bitmap_index> GameBitmapLastUse;
+unsigned Piggy_bitmap_cache_hits;
 }
 
 #if defined(DXX_BUILD_DESCENT_I)
@@ -145,6 +155,162 @@ static uint8_t *Piggy_bitmap_cache_data;
 static enumerated_array<uint8_t, MAX_BITMAP_FILES, bitmap_index> GameBitmapFlags;
 static enumerated_array<bitmap_index, MAX_BITMAP_FILES, bitmap_index> GameBitmapXlat;
 static RAIINamedPHYSFS_File Piggy_fp;
+
+/* A copy of the whole pig file, read once when the pig is opened.  While
+ * it is present, paging in a bitmap only points the bitmap into it, so
+ * nothing is read from Piggy_fp and nothing is evicted from
+ * Piggy_bitmap_cache_data.  It is absent under -lowmem and for pig files
+ * that must be byte swapped, which use the Piggy_fp path instead.
+ *
+ * The image is kept when Piggy_fp is closed, because the editor writes a
+ * new pig from the paged in bitmaps after closing the old one.  It is only
+ * replaced when a new pig file is read.
+ */
+struct pig_image
+{
+	std::unique_ptr<uint8_t[]> data;
+	std::size_t size;
+};
+static pig_image Piggy_image;
+
+/* Allocator for bitmaps paged in from Piggy_fp.  It manages the part of
+ * Piggy_bitmap_cache_data after Piggy_bitmap_cache_next, which is kept
+ * for bitmaps that the editor copies into the cache.
+ *
+ * Blocks come in power of two size classes.  A free block is split in
+ * halves until it fits the request, and a released block is merged with
+ * its buddy when the buddy is also free, so that evicting a few bitmaps
+ * makes room for a large one without moving any other.
+ */
+class bitmap_cache_arena
+{
+public:
+	static constexpr unsigned min_order = 8;
+	static constexpr unsigned max_order = 24;
+private:
+	uint8_t *base = nullptr;
+	std::size_t size = 0;
+	unsigned top_order = 0;
+	/* One bit per block of each size class, set if that block is free. */
+	std::array<std::vector<uint64_t>, max_order - min_order + 1> free_blocks;
+	std::vector<uint64_t> &free_bits(const unsigned order)
+	{
+		return free_blocks[order - min_order];
+	}
+	void set_free(const unsigned order, const std::size_t index)
+	{
+		free_bits(order)[index / 64] |= uint64_t{1} << (index % 64);
+	}
+	bool take_free(const unsigned order, const std::size_t index)
+	{
+		auto &word = free_bits(order)[index / 64];
+		const auto mask = uint64_t{1} << (index % 64);
+		if (!(word & mask))
+			return false;
+		word &= ~mask;
+		return true;
+	}
+public:
+	std::size_t used = 0;
+	bool valid = false;
+	[[nodiscard]]
+	static unsigned order_for_size(const std::size_t n)
+	{
+		return std::max<unsigned>(min_order, std::bit_width(n - 1));
+	}
+	[[nodiscard]]
+	bool fits(const unsigned order) const
+	{
+		return order <= top_order;
+	}
+	[[nodiscard]]
+	std::size_t capacity() const
+	{
+		return size;
+	}
+	void reset(uint8_t *b, std::size_t n);
+	[[nodiscard]]
+	uint8_t *allocate(unsigned order);
+	void release(uint8_t *p, unsigned order);
+	void shrink(uint8_t *p, unsigned order, unsigned new_order);
+};
+
+void bitmap_cache_arena::reset(uint8_t *const b, const std::size_t n)
+{
+	base = b;
+	size = n;
+	used = 0;
+	valid = true;
+	top_order = n >= (std::size_t{1} << min_order)
+		? std::min<unsigned>(max_order, std::bit_width(n) - 1)
+		: 0;
+	for (unsigned order = min_order; order <= max_order; ++order)
+		free_bits(order).assign(order <= top_order ? (n >> order) / 64 + 1 : 0, 0);
+	if (!top_order)
+		return;
+	/* Cover the range with the largest blocks that fit.  Each block is
+	 * aligned to its size, since it follows only larger blocks.
+	 */
+	std::size_t offset = 0;
+	for (unsigned order = top_order; order >= min_order; --order)
+		for (const std::size_t block = std::size_t{1} << order; n - offset >= block; offset += block)
+			set_free(order, offset >> order);
+}
+
+uint8_t *bitmap_cache_arena::allocate(const unsigned order)
+{
+	for (unsigned o = order; o <= top_order; ++o)
+	{
+		auto &bits = free_bits(o);
+		for (std::size_t w = 0; w != bits.size(); ++w)
+		{
+			if (!bits[w])
+				continue;
+			auto index = w * 64 + std::countr_zero(bits[w]);
+			bits[w] &= bits[w] - 1;
+			/* Split the block, keeping the lower half each time. */
+			for (; o != order; --o)
+			{
+				index <<= 1;
+				set_free(o - 1, index + 1);
+			}
+			used += std::size_t{1} << order;
+			return base + (index << order);
+		}
+	}
+	return nullptr;
+}
+
+void bitmap_cache_arena::release(uint8_t *const p, unsigned order)
+{
+	used -= std::size_t{1} << order;
+	auto index = static_cast<std::size_t>(p - base) >> order;
+	for (; order < top_order && take_free(order, index ^ 1); ++order)
+		index >>= 1;
+	set_free(order, index);
+}
+
+/* Give back the tail of a block that was allocated before the size of
+ * its contents was known.
+ */
+void bitmap_cache_arena::shrink(uint8_t *const p, const unsigned order, const unsigned new_order)
+{
+	const std::size_t offset = p - base;
+	for (unsigned o = new_order; o != order; ++o)
+		set_free(o, (offset >> o) + 1);
+	used -= (std::size_t{1} << order) - (std::size_t{1} << new_order);
+}
+
+struct bitmap_cache_block
+{
+	uint8_t *data;
+	/* 0 if the bitmap has no block in the arena */
+	uint8_t order;
+};
+
+static bitmap_cache_arena Piggy_bitmap_arena;
+static enumerated_array<bitmap_cache_block, MAX_BITMAP_FILES, bitmap_index> GameBitmapCacheBlock;
+static unsigned Piggy_bitmap_cache_misses, Piggy_bitmap_cache_evictions, Piggy_bitmap_cache_flushes;
 }
 
 #if defined(DXX_BUILD_DESCENT_I)
@@ -438,6 +604,86 @@ int piggy_find_sound(const std::span<const char> name)
 
 namespace dsx {
 namespace {
+
+#if defined(DXX_BUILD_DESCENT_II)
+static bool piggy_is_mac_pigfile(const pigfile_size pigsize)
+{
+#ifdef MACDATA
+	(void)pigsize;
+	return false;
+#else
+	switch (pigsize) {
+	default:
+		return GameArg.EdiMacData;
+	case pigfile_size::mac_alien1_pigsize:
+	case pigfile_size::mac_alien2_pigsize:
+	case pigfile_size::mac_fire_pigsize:
+	case pigfile_size::mac_groupa_pigsize:
+	case pigfile_size::mac_ice_pigsize:
+	case pigfile_size::mac_water_pigsize:
+		return true;
+	}
+#endif
+}
+#endif
+
+static void piggy_read_image(PHYSFS_File *const fp)
+{
+	Piggy_image = {};
+	if (CGameArg.SysLowMem)
+		return;
+	const auto length = PHYSFS_fileLength(fp);
+	if (length <= 0)
+		return;
+#if defined(DXX_BUILD_DESCENT_I)
+	if (MacPig)
+#elif defined(DXX_BUILD_DESCENT_II)
+	if (piggy_is_mac_pigfile(pigfile_size{static_cast<uint32_t>(length)}))
+#endif
+		return;
+	std::unique_ptr<uint8_t[]> data{new(std::nothrow) uint8_t[length]};
+	if (!data)
+		return;
+	const auto position = PHYSFS_tell(fp);
+	if (PHYSFS_seek(fp, 0) && PHYSFSX_readBytes(fp, data.get(), length) == length)
+		Piggy_image = {std::move(data), static_cast<std::size_t>(length)};
+	PHYSFS_seek(fp, position);
+}
+
+/* Point `bmp` at its data in Piggy_image.  Return false if there is no
+ * image, or the bitmap does not fit in it, so the caller must read the
+ * bitmap from Piggy_fp.
+ */
+static bool piggy_page_in_from_image(grs_bitmap &bmp, const uint8_t flags, const pig_bitmap_offset bitmap_offset)
+{
+	const auto image = Piggy_image.data.get();
+	if (!image)
+		return false;
+	const std::size_t offset = underlying_value(bitmap_offset);
+	const auto available = Piggy_image.size;
+	if (offset + 4 > available)
+		return false;
+	const std::size_t size = (flags & BM_FLAG_RLE)
+		? GET_INTEL_INT(&image[offset])
+		: bmp.bm_w * bmp.bm_h;
+	if (size > available - offset)
+		return false;
+	gr_set_bitmap_flags(bmp, flags);
+	gr_set_bitmap_data(bmp, &image[offset]);
+	compute_average_rgb(&bmp, bmp.avg_color_rgb);
+	return true;
+}
+
+/* Forget every block in the arena.  The arena is laid out again on the
+ * next allocation, after any editor bitmaps have been copied into the
+ * cache.
+ */
+static void piggy_bitmap_cache_reset()
+{
+	Piggy_bitmap_arena.valid = false;
+	GameBitmapCacheBlock = {};
+}
+
 static void piggy_close_file()
 {
 	if (Piggy_fp)
@@ -529,6 +775,7 @@ properties_init_result properties_init(d_level_shared_robot_info_state &LevelSha
 	}
 	
 	HiresGFXAvailable = MacPig;	// for now at least
+	piggy_read_image(Piggy_fp);
 
 	properties_init_result retval;
 	if (PCSharePig)
@@ -631,6 +878,7 @@ properties_init_result properties_init(d_level_shared_robot_info_state &LevelSha
 	BitmapBits = std::make_unique<ubyte[]>(Piggy_bitmap_cache_size);
 	Piggy_bitmap_cache_data = BitmapBits.get();
 	Piggy_bitmap_cache_next = 0;
+	piggy_bitmap_cache_reset();
 
 	return retval;
 }
@@ -690,6 +938,7 @@ void piggy_init_pigfile(const std::span<const char> filename)
 
 	std::copy_n(filename.data(), std::min(filename.size(), std::size(Current_pigfile) - 1), Current_pigfile.begin());
 
+	piggy_read_image(Piggy_fp);
 	N_bitmaps = PHYSFSX_readInt(Piggy_fp);
 
 	header_size = N_bitmaps * sizeof(DiskBitmapHeader);
@@ -733,6 +982,7 @@ void piggy_init_pigfile(const std::span<const char> filename)
 	BitmapBits = std::make_unique<ubyte[]>(Piggy_bitmap_cache_size);
 	Piggy_bitmap_cache_data = BitmapBits.get();
 	Piggy_bitmap_cache_next = 0;
+	piggy_bitmap_cache_reset();
 
 	Pigfile_initialized=1;
 }
@@ -760,6 +1010,7 @@ void piggy_new_pigfile(const std::span<char, FILENAME_LEN> pigname)
 		piggy_close_file();             //close old pig if still open
 
 	Piggy_bitmap_cache_next = 0;            //free up cache
+	piggy_bitmap_cache_reset();
 
 	std::copy_n(pigname.data(), std::min(pigname.size(), std::size(Current_pigfile) - 1), Current_pigfile.begin());
 
@@ -805,6 +1056,7 @@ void piggy_new_pigfile(const std::span<char, FILENAME_LEN> pigname)
 			Error("Cannot load PIG file: expected (id=%.8lx version=%.8x), found (id=%.8x version=%.8x) in \"%s\"", PIGFILE_ID, PIGFILE_VERSION, pig_id, pig_version, effective_filename);
 		#endif
 		}
+		piggy_read_image(Piggy_fp);
 		N_bitmaps = PHYSFSX_readInt(Piggy_fp);
 
 		header_size = N_bitmaps * sizeof(DiskBitmapHeader);
@@ -1274,6 +1526,132 @@ void piggy_read_sounds(void)
 }
 #endif
 
+namespace {
+
+/* Return the bitmap whose data `bi` shares under -lowmem. */
+static bitmap_index piggy_bitmap_owner(const bitmap_index bi)
+{
+	return CGameArg.SysLowMem ? GameBitmapXlat[bi] : bi;
+}
+
+/* Evict bitmaps from the arena, least recently used first, until a block
+ * of `order` can be allocated.  Bitmaps used in the current frame are
+ * kept, since the caller may still hold their data.  Return nullptr if
+ * that is not enough.
+ */
+static uint8_t *piggy_bitmap_cache_evict(GameBitmaps_array &GameBitmaps, const unsigned order)
+{
+	const unsigned n = Num_bitmap_files;
+	/* Frames since each resident bitmap, or any bitmap that shares its
+	 * data, was last used.
+	 */
+	enumerated_array<unsigned, MAX_BITMAP_FILES, bitmap_index> age;
+	age.fill(UINT_MAX);
+	for (const uint16_t i : xrange(n))
+	{
+		const bitmap_index bi{i};
+		auto &a = age[piggy_bitmap_owner(bi)];
+		a = std::min(a, Event_frame_count - GameBitmapLastUse[bi]);
+	}
+	std::vector<std::pair<unsigned, bitmap_index>> candidates;
+	for (const uint16_t i : xrange(n))
+	{
+		const bitmap_index bi{i};
+		if (GameBitmapCacheBlock[bi].order && age[bi])
+			candidates.emplace_back(age[bi], bi);
+	}
+	std::ranges::sort(candidates, std::ranges::greater{}, &std::pair<unsigned, bitmap_index>::first);
+
+	enumerated_array<bool, MAX_BITMAP_FILES, bitmap_index> evicted{};
+	uint8_t *result = nullptr;
+	for (const auto bi : candidates | std::views::values)
+	{
+		auto &block = GameBitmapCacheBlock[bi];
+		Piggy_bitmap_arena.release(block.data, block.order);
+		block = {};
+		evicted[bi] = true;
+		++ Piggy_bitmap_cache_evictions;
+		if ((result = Piggy_bitmap_arena.allocate(order)))
+			break;
+	}
+	for (const uint16_t i : xrange(n))
+	{
+		const bitmap_index bi{i};
+		if (evicted[piggy_bitmap_owner(bi)] && GameBitmapOffset[bi] != pig_bitmap_offset::None)
+		{
+			auto &gb = GameBitmaps[bi];
+			gb.set_flags(BM_FLAG_PAGED_OUT);
+			gr_set_bitmap_data(gb, nullptr);
+		}
+	}
+	return result;
+}
+
+/* Allocate `size` bytes of the arena for bitmap `owner`, evicting other
+ * bitmaps if the arena is full.
+ */
+static uint8_t *piggy_bitmap_cache_allocate(GameBitmaps_array &GameBitmaps, const bitmap_index owner, const std::size_t size)
+{
+	auto &arena = Piggy_bitmap_arena;
+	if (!arena.valid)
+		arena.reset(&Piggy_bitmap_cache_data[Piggy_bitmap_cache_next], Piggy_bitmap_cache_size - Piggy_bitmap_cache_next);
+	const auto order = bitmap_cache_arena::order_for_size(size);
+	if (!arena.fits(order))
+		Error("Bitmap %u needs %zu bytes, but the bitmap cache has only %zu", underlying_value(owner), size, arena.capacity());
+	auto data = arena.allocate(order);
+#if !DXX_USE_OGL
+	/* Polygons recorded by the binned rasterizer may use the bitmaps
+	 * about to be evicted.
+	 */
+	if (!data)
+		tmap_flush_bin();
+#endif
+	if (!data && !(data = piggy_bitmap_cache_evict(GameBitmaps, order)))
+	{
+		/* Every resident bitmap was used in this frame.  Start over,
+		 * as if for a new level.
+		 */
+		++ Piggy_bitmap_cache_flushes;
+		piggy_bitmap_page_out_all();
+		arena.reset(&Piggy_bitmap_cache_data[Piggy_bitmap_cache_next], Piggy_bitmap_cache_size - Piggy_bitmap_cache_next);
+		data = arena.allocate(order);
+	}
+	GameBitmapCacheBlock[owner] = {data, static_cast<uint8_t>(order)};
+	return data;
+}
+
+/* Give back the part of the block of `owner` past its first `size`
+ * bytes.
+ */
+static void piggy_bitmap_cache_shrink(const bitmap_index owner, const std::size_t size)
+{
+	auto &block = GameBitmapCacheBlock[owner];
+	const auto order = bitmap_cache_arena::order_for_size(size);
+	if (order >= block.order)
+		return;
+	Piggy_bitmap_arena.shrink(block.data, block.order, order);
+	block.order = order;
+}
+
+static void piggy_cmd_bitmap_cache(unsigned long argc, const char *const *const argv)
+{
+	auto &arena = Piggy_bitmap_arena;
+	unsigned resident = 0;
+	for (auto &block : partial_range(GameBitmapCacheBlock, Num_bitmap_files))
+		if (block.order)
+			++ resident;
+	con_printf(CON_NORMAL, "bitmap_cache: %s, %zu of %zu bytes in %u bitmaps: %u hits, %u misses, %u evictions, %u flushes", Piggy_image.data ? "pig in memory" : "paging from pig", arena.valid ? arena.used : 0, arena.valid ? arena.capacity() : 0, resident, Piggy_bitmap_cache_hits, Piggy_bitmap_cache_misses, Piggy_bitmap_cache_evictions, Piggy_bitmap_cache_flushes);
+	if (argc > 1 && !strcmp(argv[1], "reset"))
+		Piggy_bitmap_cache_hits = Piggy_bitmap_cache_misses = Piggy_bitmap_cache_evictions = Piggy_bitmap_cache_flushes = 0;
+}
+
+}
+
+void init_piggy_commands()
+{
+	cmd_addcommand("bitmap_cache", piggy_cmd_bitmap_cache, "bitmap_cache [reset]\n" "    show bitmap cache counters, and optionally reset them");
+}
+
 void piggy_bitmap_page_in(GameBitmaps_array &GameBitmaps, const bitmap_index entry_bitmap_index)
 {
 	const auto i = underlying_value(entry_bitmap_index);
@@ -1288,115 +1666,56 @@ void piggy_bitmap_page_in(GameBitmaps_array &GameBitmaps, const bitmap_index ent
 	if (GameBitmapOffset[entry_bitmap_index] == pig_bitmap_offset::None)
 		return;		// A read-from-disk bitmap!!!
 
+	GameBitmapLastUse[entry_bitmap_index] = Event_frame_count;
 	const auto xlat_bitmap_index = CGameArg.SysLowMem ? GameBitmapXlat[entry_bitmap_index] : entry_bitmap_index;	// Xlat for low-memory settings!
 	grs_bitmap *const bmp = &GameBitmaps[xlat_bitmap_index];
 
-	if (bmp->get_flag_mask(BM_FLAG_PAGED_OUT))
+	if (!bmp->get_flag_mask(BM_FLAG_PAGED_OUT))
+		++ Piggy_bitmap_cache_hits;
+	else if (++ Piggy_bitmap_cache_misses; !piggy_page_in_from_image(*bmp, GameBitmapFlags[xlat_bitmap_index], GameBitmapOffset[xlat_bitmap_index]))
 	{
 		pause_game_world_time p;
 
-	ReDoIt:
-		PHYSFS_seek(Piggy_fp, static_cast<unsigned>(GameBitmapOffset[xlat_bitmap_index]));
-
-		gr_set_bitmap_flags(*bmp, GameBitmapFlags[xlat_bitmap_index]);
+		const auto flags = GameBitmapFlags[xlat_bitmap_index];
 #if defined(DXX_BUILD_DESCENT_I)
-		gr_set_bitmap_data (*bmp, &Piggy_bitmap_cache_data [Piggy_bitmap_cache_next]);
+		const bool mac = MacPig;
+#elif defined(DXX_BUILD_DESCENT_II)
+		const bool mac = piggy_is_mac_pigfile(pigfile_size{static_cast<uint32_t>(PHYSFS_fileLength(Piggy_fp))});
 #endif
+		PHYSFS_seek(Piggy_fp, static_cast<unsigned>(GameBitmapOffset[xlat_bitmap_index]));
 
-		if (bmp->get_flag_mask(BM_FLAG_RLE))
+		if (flags & BM_FLAG_RLE)
 		{
-			int zsize = PHYSFSX_readInt(Piggy_fp);
+			const int zsize = PHYSFSX_readInt(Piggy_fp);
+			/* Swapping colors 0 and 255 can lengthen an RLE bitmap, so
+			 * allocate for the worst case, then give back the unused
+			 * tail.
+			 */
+			const auto data = piggy_bitmap_cache_allocate(GameBitmaps, xlat_bitmap_index, mac ? std::max<std::size_t>(zsize, MAX_BMP_SIZE(bmp->bm_w, bmp->bm_h)) : zsize);
+			gr_set_bitmap_flags(*bmp, flags);
+			gr_set_bitmap_data(*bmp, data);
 #if defined(DXX_BUILD_DESCENT_I)
-
-			// GET JOHN NOW IF YOU GET THIS ASSERT!!!
-			Assert( Piggy_bitmap_cache_next+zsize < Piggy_bitmap_cache_size );
-			if ( Piggy_bitmap_cache_next+zsize >= Piggy_bitmap_cache_size ) {
-				piggy_bitmap_page_out_all();
-				goto ReDoIt;
-			}
-			memcpy( &Piggy_bitmap_cache_data[Piggy_bitmap_cache_next], &zsize, sizeof(int) );
-			Piggy_bitmap_cache_next += sizeof(int);
-			PHYSFSX_readBytes(Piggy_fp, &Piggy_bitmap_cache_data[Piggy_bitmap_cache_next], zsize - 4);
-			if (MacPig)
-			{
-				rle_swap_0_255(*bmp);
-				memcpy(&zsize, bmp->bm_data, 4);
-			}
-			Piggy_bitmap_cache_next += zsize-4;
+			memcpy(data, &zsize, sizeof(int));
 #elif defined(DXX_BUILD_DESCENT_II)
-			const pigfile_size pigsize{static_cast<uint32_t>(PHYSFS_fileLength(Piggy_fp))};
-
-			// GET JOHN NOW IF YOU GET THIS ASSERT!!!
-			//Assert( Piggy_bitmap_cache_next+zsize < Piggy_bitmap_cache_size );
-			if ( Piggy_bitmap_cache_next+zsize >= Piggy_bitmap_cache_size ) {
-				Int3();
-				piggy_bitmap_page_out_all();
-				goto ReDoIt;
-			}
-			PHYSFSX_readBytes(Piggy_fp, &Piggy_bitmap_cache_data[Piggy_bitmap_cache_next + 4], zsize - 4);
-			PUT_INTEL_INT(&Piggy_bitmap_cache_data[Piggy_bitmap_cache_next], zsize);
-			gr_set_bitmap_data(*bmp, &Piggy_bitmap_cache_data[Piggy_bitmap_cache_next]);
-
-#ifndef MACDATA
-			switch (pigsize) {
-			default:
-				if (!GameArg.EdiMacData)
-					break;
-				[[fallthrough]];
-			case pigfile_size::mac_alien1_pigsize:
-			case pigfile_size::mac_alien2_pigsize:
-			case pigfile_size::mac_fire_pigsize:
-			case pigfile_size::mac_groupa_pigsize:
-			case pigfile_size::mac_ice_pigsize:
-			case pigfile_size::mac_water_pigsize:
-				rle_swap_0_255(*bmp);
-				memcpy(&zsize, bmp->bm_data, 4);
-				break;
-			}
+			PUT_INTEL_INT(data, zsize);
 #endif
-
-			Piggy_bitmap_cache_next += zsize;
-			if ( Piggy_bitmap_cache_next+zsize >= Piggy_bitmap_cache_size ) {
-				Int3();
-				piggy_bitmap_page_out_all();
-				goto ReDoIt;
-			}
-#endif
-
-		} else {
-			// GET JOHN NOW IF YOU GET THIS ASSERT!!!
-			Assert( Piggy_bitmap_cache_next+(bmp->bm_h*bmp->bm_w) < Piggy_bitmap_cache_size );
-			if ( Piggy_bitmap_cache_next+(bmp->bm_h*bmp->bm_w) >= Piggy_bitmap_cache_size ) {
-				piggy_bitmap_page_out_all();
-				goto ReDoIt;
+			PHYSFSX_readBytes(Piggy_fp, &data[4], zsize - 4);
+			if (mac)
+			{
+				rle_swap_0_255(*bmp);
+				int swapped_size;
+				memcpy(&swapped_size, data, 4);
+				piggy_bitmap_cache_shrink(xlat_bitmap_index, swapped_size);
 			}
-			PHYSFSX_readBytes(Piggy_fp, &Piggy_bitmap_cache_data[Piggy_bitmap_cache_next], bmp->bm_h * bmp->bm_w);
-#if defined(DXX_BUILD_DESCENT_I)
-			Piggy_bitmap_cache_next+=bmp->bm_h*bmp->bm_w;
-			if (MacPig)
-				swap_0_255(*bmp);
-#elif defined(DXX_BUILD_DESCENT_II)
-			const pigfile_size pigsize{static_cast<uint32_t>(PHYSFS_fileLength(Piggy_fp))};
-			gr_set_bitmap_data(*bmp, &Piggy_bitmap_cache_data[Piggy_bitmap_cache_next]);
-			Piggy_bitmap_cache_next+=bmp->bm_h*bmp->bm_w;
-
-#ifndef MACDATA
-			switch (pigsize) {
-			default:
-				if (!GameArg.EdiMacData)
-					break;
-				[[fallthrough]];
-			case pigfile_size::mac_alien1_pigsize:
-			case pigfile_size::mac_alien2_pigsize:
-			case pigfile_size::mac_fire_pigsize:
-			case pigfile_size::mac_groupa_pigsize:
-			case pigfile_size::mac_ice_pigsize:
-			case pigfile_size::mac_water_pigsize:
+		}
+		else
+		{
+			const auto data = piggy_bitmap_cache_allocate(GameBitmaps, xlat_bitmap_index, bmp->bm_h * bmp->bm_w);
+			gr_set_bitmap_flags(*bmp, flags);
+			gr_set_bitmap_data(*bmp, data);
+			PHYSFSX_readBytes(Piggy_fp, data, bmp->bm_h * bmp->bm_w);
+			if (mac)
 				swap_0_255(*bmp);
-				break;
-			}
-#endif
-#endif
 		}
 
 		//@@if ( bmp->bm_selector ) {
@@ -1429,7 +1748,7 @@ namespace {
 
 void piggy_bitmap_page_out_all()
 {
-	Piggy_bitmap_cache_next = 0;
+	piggy_bitmap_cache_reset();
 
 	texmerge_flush();
 	rle_cache_flush();
@@ -1449,6 +1768,7 @@ void piggy_bitmap_page_out_all()
 void piggy_load_level_data()
 {
 	piggy_bitmap_page_out_all();
+	texmerge_prepare_level();
 	paging_touch_all(Vclip);
 }
 
@@ -1781,6 +2101,7 @@ void load_bitmap_replacements(const std::span<const char, FILENAME_LEN> level_na
 		}
 		last_palette_loaded_pig[0]= 0;  //force pig re-load
 		texmerge_flush();       //for re-merging with new textures
+		rle_cache_flush();
 	}
 }
 
@@ -2109,6 +2430,7 @@ void load_d1_bitmap_replacements()
 	last_palette_loaded_pig[0]= 0;  //force pig re-load
 
 	texmerge_flush();       //for re-merging with new textures
+	rle_cache_flush();
 }
 
 /*
@@ -31,7 +31,9 @@ COPYRIGHT 1993-1999 PARALLAX SOFTWARE CORPORATION.  ALL RIGHTS RESERVED.
 #include <string.h>
 #include <math.h>
 #include <optional>
+#include <chrono>
 #include <ranges>
+#include <vector>
 #include "render_state.h"
 #include "inferno.h"
 #include "segment.h"
@@ -46,6 +48,7 @@ COPYRIGHT 1993-1999 PARALLAX SOFTWARE CORPORATION.  ALL RIGHTS RESERVED.
 #include "wall.h"
 #include "texmerge.h"
 #include "3d.h"
+#include "common/3d/globvars.h"
 #include "gameseg.h"
 #include "vclip.h"
 #include "lighting.h"
@@ -56,6 +59,9 @@ COPYRIGHT 1993-1999 PARALLAX SOFTWARE CORPORATION.  ALL RIGHTS RESERVED.
 #include "timer.h"
 #include "effects.h"
 #include "playsave.h"
+#include "cmd.h"
+#include "console.h"
+#include "parallel.h"
 #if DXX_USE_OGL
 #include "ogl_init.h"
 #endif
@@ -111,7 +117,7 @@ static std::bitset<MAX_OBJECTS> object_rendered;
 namespace dcx {
 
 //Global vars for window clip test
-int Window_clip_left,Window_clip_top,Window_clip_right,Window_clip_bot;
+thread_local int Window_clip_left,Window_clip_top,Window_clip_right,Window_clip_bot;
 
 }
 
@@ -699,32 +705,91 @@ void render_start_frame()
 	++ s_current_generation;
 }
 
-//Given a lit of point numbers, rotate any that haven't been rotated this frame
-g3s_codes rotate_list(fvcvertptr &vcvertptr, const std::span<const vertnum_t> pointnumlist)
+namespace {
+
+//Vertices waiting to be rotated, and scratch space for rotating them.
+//Kept between frames so that the vectors are only allocated once.
+struct vertex_transform_batch
 {
-	g3s_codes cc;
-	const auto current_generation = s_current_generation;
-	const auto cheats_acid = cheats.acid;
-	const float f = likely(!cheats_acid)
-		? 0.0f /* unused */
-		: 2.0f * (static_cast<float>(timer_query()) / F1_0);
+	std::vector<vertnum_t> vertnums;
+	std::vector<vms_vector> deltas, rotated;
+	void transform(fvcvertptr &vcvertptr, bool project);
+};
+
+static vertex_transform_batch Vertex_transform_batch;
+
+//Rotate, code and optionally project every pending vertex in one pass,
+//then clear the list.  This computes exactly what g3_rotate_point and
+//g3_project_point would for each vertex, but lets vm_vec_rotate_n use
+//SIMD across vertices.
+void vertex_transform_batch::transform(fvcvertptr &vcvertptr, const bool project)
+{
+	const std::size_t n = vertnums.size();
+	deltas.resize(n);
+	rotated.resize(n);
+	for (std::size_t i = 0; i != n; ++i)
+		vm_vec_sub(deltas[i], *vcvertptr(vertnums[i]), View_position);
+	vm_vec_rotate_n(rotated, deltas, View_matrix);
+	for (std::size_t i = 0; i != n; ++i)
+	{
+		auto &pnt = Segment_points[vertnums[i]];
+		pnt.p3_vec = rotated[i];
+		pnt.p3_flags = {};
+		g3_code_point(pnt);
+		if (project)
+			g3_project_point(pnt);
+	}
+	vertnums.clear();
+}
 
+//Rotate each point with the acid cheat's wobble.  This is not batched,
+//since the wobble must be applied before rotation.
+static void rotate_list_acid(fvcvertptr &vcvertptr, const std::span<const vertnum_t> pointnumlist, const uint16_t current_generation)
+{
+	const float f = 2.0f * (static_cast<float>(timer_query()) / F1_0);
 	for (const auto pnum : pointnumlist)
 	{
 		auto &pnt = Segment_points[pnum];
 		if (pnt.p3_last_generation != current_generation)
 		{
 			pnt.p3_last_generation = current_generation;
-			auto &v = *vcvertptr(pnum);
-			vertex tmpv;
-			g3_rotate_point(pnt, likely(!cheats_acid) ? v : (
-				tmpv = v,
-				tmpv.x += fl2f(sinf(f + f2fl(tmpv.x))),
-				tmpv.y += fl2f(sinf(f * 1.5f + f2fl(tmpv.y))),
-				tmpv.z += fl2f(sinf(f * 2.5f + f2fl(tmpv.z))),
-				tmpv
-			));
+			vertex tmpv = *vcvertptr(pnum);
+			tmpv.x += fl2f(sinf(f + f2fl(tmpv.x)));
+			tmpv.y += fl2f(sinf(f * 1.5f + f2fl(tmpv.y)));
+			tmpv.z += fl2f(sinf(f * 2.5f + f2fl(tmpv.z)));
+			g3_rotate_point(pnt, tmpv);
+		}
+	}
+}
+
+}
+
+//Given a lit of point numbers, rotate any that haven't been rotated this frame
+g3s_codes rotate_list(fvcvertptr &vcvertptr, const std::span<const vertnum_t> pointnumlist)
+{
+	g3s_codes cc;
+	const auto current_generation = s_current_generation;
+	if (unlikely(cheats.acid))
+		rotate_list_acid(vcvertptr, pointnumlist, current_generation);
+	else
+	{
+		auto &batch = Vertex_transform_batch;
+		for (const auto pnum : pointnumlist)
+		{
+			auto &pnt = Segment_points[pnum];
+			if (pnt.p3_last_generation != current_generation)
+			{
+				pnt.p3_last_generation = current_generation;
+				batch.vertnums.emplace_back(pnum);
+			}
 		}
+		if (!batch.vertnums.empty())
+			batch.transform(vcvertptr, false);
+	}
+
+	for (const auto pnum : pointnumlist)
+	{
+		auto &pnt = Segment_points[pnum];
 		cc.uand &= pnt.p3_codes;
 		cc.uor  |= pnt.p3_codes;
 	}
@@ -733,6 +798,39 @@ g3s_codes rotate_list(fvcvertptr &vcvertptr, const std::span<const vertnum_t> po
 
 }
 
+namespace {
+
+//Rotate, code and project, in one batch, every vertex of the visible
+//segments that was not already rotated this frame.  When the segment
+//list comes from the cache, the portal walk did not run, so this
+//transforms the whole view at once.  render_segment then finds every
+//point done, and rotate_list only reads the codes.
+static void rotate_render_list(fvcvertptr &vcvertptr, fvcsegptr &vcsegptr, const render_state_t &rstate)
+{
+	if (unlikely(cheats.acid))
+		return;
+	auto &batch = Vertex_transform_batch;
+	const auto current_generation = s_current_generation;
+	for (const auto segnum : partial_const_range(rstate.Render_list, rstate.N_render_segs))
+	{
+		if (segnum == segment_none)
+			continue;
+		for (const auto pnum : vcsegptr(segnum)->verts)
+		{
+			auto &pnt = Segment_points[pnum];
+			if (pnt.p3_last_generation != current_generation)
+			{
+				pnt.p3_last_generation = current_generation;
+				batch.vertnums.emplace_back(pnum);
+			}
+		}
+	}
+	if (!batch.vertnums.empty())
+		batch.transform(vcvertptr, true);
+}
+
+}
+
 namespace {
 //Given a lit of point numbers, project any that haven't been projected
 static void project_list(const std::array<vertnum_t, 8> &pointnumlist)
@@ -1227,6 +1325,28 @@ static void build_object_lists(object_array &Objects, fvcsegptr &vcsegptr, const
 
 int Rear_view=0;
 
+namespace {
+
+//	The most recent views passed to build_segment_list, oldest first once the
+//	ring has wrapped.  render_bench replays them.
+struct recorded_view
+{
+	vms_vector eye;
+	vms_matrix orient;
+	fix zoom;
+	segnum_t start_seg;
+};
+
+static std::array<recorded_view, 256> Recorded_views;
+static unsigned Recorded_view_count;
+
+static void record_view(const vms_vector &eye, const vms_matrix &orient, const fix zoom, const segnum_t start_seg)
+{
+	Recorded_views[Recorded_view_count++ % Recorded_views.size()] = {eye, orient, zoom, start_seg};
+}
+
+}
+
 namespace dsx {
 //renders onto current canvas
 void render_frame(grs_canvas &canvas, fix eye_offset, window_rendered_data &window)
@@ -1280,10 +1400,10 @@ void render_frame(grs_canvas &canvas, fix eye_offset, window_rendered_data &wind
 	if (start_seg_num==segment_none)
 		start_seg_num = viewer_segp;
 
-	g3_set_view_matrix(Viewer_eye,
-		(Rear_view && Viewer == ConsoleObject)
+	const auto view_orient = (Rear_view && Viewer == ConsoleObject)
 		? vm_matrix_x_matrix(Viewer->orient, vm_angles_2_matrix(vms_angvec{0, 0, INT16_MAX}))
-		: Viewer->orient, /* Render_zoom = */ {
+		: Viewer->orient;
+	const fix view_zoom{
 		(Game_mode & GM_MULTI) && !(Game_mode & GM_MULTI_COOP)
 			/* In competitive multiplayer, ignore command line adjustment, for fairness.
 			 * In all other game modes, allow the adjustment.
@@ -1296,7 +1416,9 @@ void render_frame(grs_canvas &canvas, fix eye_offset, window_rendered_data &wind
 			 * useful.
 			 */
 			: std::max(40, CGameArg.SysRenderZoomAdjustment + Render_zoom)
-	});
+	};
+	g3_set_view_matrix(Viewer_eye, view_orient, view_zoom);
+	record_view(Viewer_eye, view_orient, view_zoom, start_seg_num);
 
 	if (Clear_window == 1) {
 		if (Clear_window_color == -1)
@@ -1321,9 +1443,20 @@ window_rendered_data::window_rendered_data()
 }
 
 namespace {
+
+//	A wall side that build_segment_list examined, and what WALL_IS_DOORWAY
+//	returned for it.  Sides without a wall depend only on the level geometry.
+struct segment_list_wall_side
+{
+	segnum_t segnum;
+	sidenum_t sidenum;
+	wall_is_doorway_result wid;
+};
+
 //build a list of segments to be rendered
 //fills in Render_list & N_render_segs
-static void build_segment_list(render_state_t &rstate, const vms_vector &Viewer_eye, visited_twobit_array_t &visited, unsigned &first_terminal_seg, const vcsegidx_t start_seg_num)
+//if walls is not null, appends each wall side that was examined
+static void build_segment_list_uncached(render_state_t &rstate, const vms_vector &Viewer_eye, visited_twobit_array_t &visited, unsigned &first_terminal_seg, const vcsegidx_t start_seg_num, std::vector<segment_list_wall_side> *const walls)
 {
 	auto &LevelSharedVertexState = LevelSharedSegmentState.get_vertex_state();
 	auto &Vertices = LevelSharedVertexState.get_vertices();
@@ -1383,6 +1516,8 @@ static void build_segment_list(render_state_t &rstate, const vms_vector &Viewer_
 			for (const auto &&[c, sv] : enumerate(Side_to_verts))
 			{		//build list of sides
 				const auto wid = WALL_IS_DOORWAY(GameBitmaps, Textures, vcwallptr, seg, c);
+				if (walls && seg->shared_segment::sides[c].wall_num != wall_none)
+					walls->push_back({segnum, c, wid});
 				if (wid & WALL_IS_DOORWAY_FLAG::rendpast)
 				{
 					if (uor != clipping_code::None)
@@ -1503,6 +1638,259 @@ done_list:
 	rstate.N_render_segs = lcnt;
 
 }
+
+//	Everything that build_segment_list_uncached reads, other than the level
+//	geometry and the wall sides that it records.
+struct segment_list_key
+{
+	vms_vector eye, view_position, matrix_scale, rvec, uvec, fvec;
+	fix canv_w2, canv_h2;
+	segnum_t start_seg;
+	int render_depth;
+	uint16_t canvas_w, canvas_h;
+	constexpr bool operator==(const segment_list_key &) const = default;
+};
+
+//	The result of one build_segment_list_uncached call.  A stationary viewer
+//	asks for the same list every frame, so the list is kept and reused for as
+//	long as the key matches and every recorded wall side is unchanged.
+struct segment_list_cache_entry
+{
+	struct segment_state
+	{
+		segnum_t segnum;
+		uint16_t Seg_depth;
+		bool processed;
+		rect render_window;
+	};
+	segment_list_key key;
+	unsigned last_use = 0;
+	bool valid = false;
+	unsigned first_terminal_seg;
+	std::vector<segment_state> segments;
+	std::vector<segment_list_wall_side> walls;
+	[[nodiscard]]
+	bool walls_unchanged() const;
+	void save(const render_state_t &rstate, unsigned first_terminal_seg);
+	void restore(render_state_t &rstate, visited_twobit_array_t &visited, unsigned &first_terminal_seg) const;
+};
+
+bool segment_list_cache_entry::walls_unchanged() const
+{
+	auto &Walls = LevelUniqueWallSubsystemState.Walls;
+	auto &vcwallptr = Walls.vcptr;
+	for (auto &w : walls)
+		if (WALL_IS_DOORWAY(GameBitmaps, Textures, vcwallptr, vcsegptr(w.segnum), w.sidenum) != w.wid)
+			return false;
+	return true;
+}
+
+void segment_list_cache_entry::save(const render_state_t &rstate, const unsigned terminal)
+{
+	first_terminal_seg = terminal;
+	segments.clear();
+	for (const auto segnum : partial_const_range(rstate.Render_list, rstate.N_render_segs))
+	{
+		auto &srsm = rstate.render_seg_map.at(segnum);
+		segments.push_back({segnum, srsm.Seg_depth, srsm.processed, srsm.render_window});
+	}
+}
+
+void segment_list_cache_entry::restore(render_state_t &rstate, visited_twobit_array_t &visited, unsigned &terminal) const
+{
+	rstate.render_pos.fill(-1);
+	short i = 0;
+	for (auto &s : segments)
+	{
+		rstate.Render_list[i] = s.segnum;
+		rstate.render_pos[s.segnum] = i++;
+		auto &srsm = rstate.render_seg_map[s.segnum];
+		srsm.Seg_depth = s.Seg_depth;
+		srsm.processed = s.processed;
+		srsm.render_window = s.render_window;
+		visited[s.segnum] = 1;
+	}
+	rstate.N_render_segs = segments.size();
+	terminal = first_terminal_seg;
+}
+
+//	One entry for each view that is commonly rendered in the same frame: the
+//	main view, the rear view, and the cockpit windows.
+static std::array<segment_list_cache_entry, 4> Segment_list_cache;
+static unsigned Segment_list_cache_clock;
+static unsigned Segment_list_cache_hits, Segment_list_cache_misses;
+static uint8_t Segment_list_cache_enabled = 1;
+#if !DXX_USE_OGL
+static uint8_t Render_bin_enabled = 1;
+#endif
+
+static segment_list_key make_segment_list_key(const vms_vector &Viewer_eye, const vcsegidx_t start_seg_num)
+{
+	const auto &bm = grd_curcanv->cv_bitmap;
+	return {
+		Viewer_eye, View_position, Matrix_scale,
+		View_matrix.rvec, View_matrix.uvec, View_matrix.fvec,
+		Canv_w2, Canv_h2,
+		start_seg_num, Render_depth, bm.bm_w, bm.bm_h
+	};
+}
+
+static void build_segment_list(render_state_t &rstate, const vms_vector &Viewer_eye, visited_twobit_array_t &visited, unsigned &first_terminal_seg, const vcsegidx_t start_seg_num)
+{
+	/* The acid cheat moves the vertices every frame, and the editor can
+	 * change the level between frames.
+	 */
+	if (!Segment_list_cache_enabled || cheats.acid
+#if DXX_USE_EDITOR
+		|| EditorWindow
+#endif
+		)
+		return build_segment_list_uncached(rstate, Viewer_eye, visited, first_terminal_seg, start_seg_num, nullptr);
+	const auto key = make_segment_list_key(Viewer_eye, start_seg_num);
+	const auto now = ++ Segment_list_cache_clock;
+	auto oldest = Segment_list_cache.begin();
+	for (auto i = Segment_list_cache.begin(); i != Segment_list_cache.end(); ++i)
+	{
+		auto &e = *i;
+		if (e.valid && e.key == key && e.walls_unchanged())
+		{
+			++ Segment_list_cache_hits;
+			e.last_use = now;
+			e.restore(rstate, visited, first_terminal_seg);
+			return;
+		}
+		if (!e.valid || (oldest->valid && e.last_use < oldest->last_use))
+			oldest = i;
+	}
+	++ Segment_list_cache_misses;
+	auto &e = *oldest;
+	e.walls.clear();
+	build_segment_list_uncached(rstate, Viewer_eye, visited, first_terminal_seg, start_seg_num, &e.walls);
+	e.key = key;
+	e.last_use = now;
+	e.valid = true;
+	e.save(rstate, first_terminal_seg);
+}
+
+#if !DXX_USE_OGL
+static void render_cmd_bin(unsigned long argc, const char *const *const argv)
+{
+	if (argc > 1)
+		Render_bin_enabled = strtoul(argv[1], nullptr, 10);
+	con_printf(CON_NORMAL, "render_bin: %s, %u threads", Render_bin_enabled ? "on" : "off", get_parallel_thread_count());
+}
+#endif
+
+static void render_cmd_cache(unsigned long argc, const char *const *const argv)
+{
+	if (argc > 1)
+	{
+		Segment_list_cache_enabled = strtoul(argv[1], nullptr, 10);
+		flush_segment_list_cache();
+	}
+	con_printf(CON_NORMAL, "render_cache: %s: %u hits, %u misses", Segment_list_cache_enabled ? "on" : "off", Segment_list_cache_hits, Segment_list_cache_misses);
+	Segment_list_cache_hits = Segment_list_cache_misses = 0;
+}
+
+static bool same_segment_list(const render_state_t &a, const unsigned a_terminal, const render_state_t &b, const unsigned b_terminal)
+{
+	if (a.N_render_segs != b.N_render_segs || a_terminal != b_terminal)
+		return false;
+	for (const unsigned i : xrange(a.N_render_segs))
+	{
+		const auto segnum = a.Render_list[i];
+		if (segnum != b.Render_list[i])
+			return false;
+		auto &wa = a.render_seg_map.at(segnum).render_window;
+		auto &wb = b.render_seg_map.at(segnum).render_window;
+		if (wa.left != wb.left || wa.top != wb.top || wa.right != wb.right || wa.bot != wb.bot)
+			return false;
+	}
+	return true;
+}
+
+//	Time build_segment_list over the recently rendered views, once without the
+//	cache and once with it, and check that both give the same lists.
+static void render_cmd_bench(unsigned long argc, const char *const *const argv)
+{
+	const unsigned recorded = std::min<unsigned>(Recorded_view_count, Recorded_views.size());
+	if (!recorded)
+	{
+		con_puts(CON_NORMAL, "render_bench: no views recorded");
+		return;
+	}
+	const unsigned long passes = argc > 1 ? std::max(strtoul(argv[1], nullptr, 10), 1ul) : 10;
+	const unsigned first = Recorded_view_count - recorded;
+	struct result
+	{
+		render_state_t rstate;
+		unsigned first_terminal_seg;
+	};
+	std::vector<result> expected(recorded);
+	const auto for_each_view = [&](auto &&f) {
+		for (const unsigned i : xrange(recorded))
+		{
+			auto &v = Recorded_views[(first + i) % Recorded_views.size()];
+			render_start_frame();
+			g3_set_view_matrix(v.eye, v.orient, v.zoom);
+			visited_twobit_array_t visited;
+			f(i, v.eye, visited, vcsegidx_t{v.start_seg});
+		}
+	};
+	const auto enabled = std::exchange(Segment_list_cache_enabled, 1);
+	flush_segment_list_cache();
+	const auto t0 = std::chrono::steady_clock::now();
+	for (const unsigned long pass : xrange(passes))
+	{
+		(void)pass;
+		for_each_view([&](const unsigned i, const vms_vector &eye, visited_twobit_array_t &visited, const vcsegidx_t start_seg) {
+			auto &r = expected[i];
+			r.rstate = {};
+			build_segment_list_uncached(r.rstate, eye, visited, r.first_terminal_seg, start_seg, nullptr);
+		});
+	}
+	const auto t1 = std::chrono::steady_clock::now();
+	Segment_list_cache_hits = Segment_list_cache_misses = 0;
+	for (const unsigned long pass : xrange(passes))
+	{
+		(void)pass;
+		for_each_view([&](unsigned, const vms_vector &eye, visited_twobit_array_t &visited, const vcsegidx_t start_seg) {
+			result r;
+			build_segment_list(r.rstate, eye, visited, r.first_terminal_seg, start_seg);
+		});
+	}
+	const auto t2 = std::chrono::steady_clock::now();
+	const auto hits = Segment_list_cache_hits, misses = Segment_list_cache_misses;
+	unsigned mismatches = 0;
+	for_each_view([&](const unsigned i, const vms_vector &eye, visited_twobit_array_t &visited, const vcsegidx_t start_seg) {
+		result r;
+		build_segment_list(r.rstate, eye, visited, r.first_terminal_seg, start_seg);
+		if (!same_segment_list(r.rstate, r.first_terminal_seg, expected[i].rstate, expected[i].first_terminal_seg))
+			++ mismatches;
+	});
+	using std::chrono::duration_cast;
+	using std::chrono::microseconds;
+	con_printf(CON_NORMAL, "render_bench: %u views, %lu passes: uncached %lu us, cached %lu us (%u hits, %u misses), %u mismatches", recorded, passes, static_cast<unsigned long>(duration_cast<microseconds>(t1 - t0).count()), static_cast<unsigned long>(duration_cast<microseconds>(t2 - t1).count()), hits, misses, mismatches);
+	Segment_list_cache_hits = Segment_list_cache_misses = 0;
+	Segment_list_cache_enabled = enabled;
+	flush_segment_list_cache();
+}
+
+}
+
+void flush_segment_list_cache()
+{
+	for (auto &e : Segment_list_cache)
+		e.valid = false;
+}
+
+void init_render_commands()
+{
+	cmd_addcommand("render_cache", render_cmd_cache, "render_cache [0|1]\n" "    show visible segment list cache counters, and optionally turn the cache off or on");
+	cmd_addcommand("render_bench", render_cmd_bench, "render_bench [passes]\n" "    time building the visible segment list for recently rendered views, with and without the cache");
+#if !DXX_USE_OGL
+	cmd_addcommand("render_bin", render_cmd_bin, "render_bin [0|1]\n" "    show whether walls are drawn in parallel bands, and optionally turn banding off or on");
+#endif
 }
 
 //renders onto current canvas
@@ -1546,6 +1934,8 @@ void render_mine(grs_canvas &canvas, const vms_vector &Viewer_eye, const vcsegid
 		//NOTE LINK TO ABOVE!!	-Link killed by kreatordxx to get editor selection working again
 		build_segment_list(rstate, Viewer_eye, visited, first_terminal_seg, start_seg_num);		//fills in Render_list & N_render_segs
 
+	rotate_render_list(Vertices.vcptr, vcsegptr, rstate);
+
 	const auto &&render_range = partial_const_range(rstate.Render_list, rstate.N_render_segs);
 	const auto &&reversed_render_range = render_range.reversed();
 	//render away
@@ -1585,6 +1975,14 @@ void render_mine(grs_canvas &canvas, const vms_vector &Viewer_eye, const vcsegid
 		}
 	}
 #if !DXX_USE_OGL
+	// Walls are recorded, and drawn in parallel bands.  Objects are drawn
+	// directly, so draw the walls recorded so far before the objects of
+	// each segment.
+	const bool binned = Render_bin_enabled && !_search_mode
+#ifndef NDEBUG
+		&& !Outline_mode
+#endif
+		&& tmap_begin_bin(canvas);
 	range_for (const auto segnum, reversed_render_range)
 	{
 		// Interpolation_method = 0;
@@ -1607,6 +2005,8 @@ void render_mine(grs_canvas &canvas, const vms_vector &Viewer_eye, const vcsegid
 			visited[segnum]=3;
 			if (srsm.objects.empty())
 				continue;
+			if (binned)
+				tmap_end_bin();
 
 			{		//reset for objects
 				Window_clip_left  = Window_clip_top = 0;
@@ -1623,9 +2023,13 @@ void render_mine(grs_canvas &canvas, const vms_vector &Viewer_eye, const vcsegid
 				}
 				Max_linear_depth = save_linear_depth;
 			}
+			if (binned)
+				tmap_begin_bin(canvas);
 
 		}
 	}
+	if (binned)
+		tmap_end_bin();
 #else
         // Two pass rendering. Since sprites and some level geometry can have transparency (blending), we need some fancy sorting.
         // GL_DEPTH_TEST helps to sort everything in view but we should make sure translucent sprites are rendered after geometry to prevent them to turn walls invisible (if rendered BEFORE geometry but still in FRONT of it).
@@ -1635,6 +2039,16 @@ void render_mine(grs_canvas &canvas, const vms_vector &Viewer_eye, const vcsegid
 	auto &Walls = LevelUniqueWallSubsystemState.Walls;
 	auto &vcwallptr = Walls.vcptr;
         // First Pass: render opaque level geometry and level geometry with alpha pixels (high Alpha-Test func)
+	// Opaque sides are collected by texture and drawn together once every segment has been visited.  Sides with alpha pixels are drawn after them, so that their edges blend with the walls behind.
+	struct deferred_side
+	{
+		segnum_t segnum;
+		sidenum_t sidenum;
+		wall_is_doorway_result wid;
+	};
+	std::vector<deferred_side> deferred_sides;
+	if (!_search_mode)
+		ogl_begin_tmap_batch();
 	range_for (const auto segnum, reversed_render_range)
 	{
 		auto &srsm = rstate.render_seg_map[segnum];
@@ -1671,9 +2085,7 @@ void render_mine(grs_canvas &canvas, const vms_vector &Viewer_eye, const vcsegid
 						{
 							if (PlayerCfg.AlphaBlendEClips && is_alphablend_eclip(TmapInfo[get_texture_index(seg->unique_segment::sides[sn].tmap_num)].eclip_num)) // Do NOT render geometry with blending textures. Since we've not rendered any objects, yet, they would disappear behind them.
                                                                 continue;
-							glAlphaFunc(GL_GEQUAL,0.8); // prevent ugly outlines if an object (which is rendered later) is shown behind a grate, door, etc. if texture filtering is enabled. These sides are rendered later again with normal AlphaFunc
-							render_side(vcvertptr, canvas, seg, sn, wid, Viewer_eye);
-							glAlphaFunc(GL_GEQUAL,0.02);
+							deferred_sides.push_back({segnum, sn, wid});
 						}
 						else
 							render_side(vcvertptr, canvas, seg, sn, wid, Viewer_eye);
@@ -1682,6 +2094,12 @@ void render_mine(grs_canvas &canvas, const vms_vector &Viewer_eye, const vcsegid
 			}
 		}
 	}
+	if (!_search_mode)
+		ogl_end_tmap_batch();
+	glAlphaFunc(GL_GEQUAL,0.8); // prevent ugly outlines if an object (which is rendered later) is shown behind a grate, door, etc. if texture filtering is enabled. These sides are rendered later again with normal AlphaFunc
+	for (const auto &d : deferred_sides)
+		render_side(vcvertptr, canvas, vcsegptridx(d.segnum), d.sidenum, d.wid, Viewer_eye);
+	glAlphaFunc(GL_GEQUAL,0.02);
 
         // Second pass: Render objects and level geometry with alpha pixels (normal Alpha-Test func) and eclips with blending
 	range_for (const auto segnum, reversed_render_range)
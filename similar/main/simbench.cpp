@@ -0,0 +1,276 @@
+/*
+ * This file is part of the DXX-Rebirth project <https://www.dxx-rebirth.com/>.
+ * It is copyright by its individual contributors, as recorded in the
+ * project's Git history.  See COPYING.txt at the top level for license
+ * terms and a link to the Git history.
+ */
+
+/*
+ *
+ * Headless simulation benchmark
+ *
+ */
+
+#include <algorithm>
+#include <chrono>
+#include <cinttypes>
+#include <cstdio>
+#include <utility>
+#include <vector>
+#include "simbench.h"
+#include "args.h"
+#include "console.h"
+#include "game.h"
+#include "gameseq.h"
+#include "kconfig.h"
+#include "maths.h"
+#include "mission.h"
+#include "object.h"
+#include "physfsx.h"
+#include "player.h"
+#include "playsave.h"
+#include "window.h"
+#include "d_levelstate.h"
+
+namespace dcx {
+
+bool Sim_bench_active;
+std::array<std::chrono::steady_clock::duration, sim_bench_phase_count> Sim_bench_phase_time;
+
+namespace {
+
+/* Seed d_rand the same way on every run, so that runs of the same
+ * build, level and input reach the same state.
+ */
+constexpr unsigned sim_bench_seed = 1;
+
+/* One line of an input script.  Axes are percentages of full
+ * deflection, from -100 to 100.  The controls hold from `frame` until
+ * the next line's frame.
+ */
+struct sim_bench_input
+{
+	unsigned frame;
+	int forward, sideways, vertical, pitch, heading, bank;
+	unsigned fire_primary, fire_secondary;
+};
+
+/* Script lines have the form:
+ *
+ *	<frame> <forward> <sideways> <vertical> <pitch> <heading> <bank> <fire_primary> <fire_secondary>
+ *
+ * Trailing fields may be omitted, and default to 0.  Blank lines and
+ * lines starting with ';' are ignored.  Lines must be in frame order.
+ */
+static std::vector<sim_bench_input> sim_bench_read_input(const char *const filename)
+{
+	std::vector<sim_bench_input> result;
+	auto &&[fp, physfserr] = PHYSFSX_openReadBuffered(filename);
+	if (!fp)
+	{
+		con_printf(CON_URGENT, "simbench: cannot open input \"%s\": %s", filename, PHYSFS_getErrorByCode(physfserr));
+		return result;
+	}
+	PHYSFSX_gets_line_t<128> line;
+	for (unsigned lineno = 1; PHYSFSX_fgets(line, fp); ++lineno)
+	{
+		const char *const p = line;
+		if (!*p || *p == ';')
+			continue;
+		sim_bench_input i{};
+		if (sscanf(p, "%u %d %d %d %d %d %d %u %u", &i.frame, &i.forward, &i.sideways, &i.vertical, &i.pitch, &i.heading, &i.bank, &i.fire_primary, &i.fire_secondary) < 1)
+		{
+			con_printf(CON_URGENT, "simbench: %s:%u: ignoring malformed line", filename, lineno);
+			continue;
+		}
+		if (!result.empty() && i.frame < result.back().frame)
+		{
+			con_printf(CON_URGENT, "simbench: %s:%u: ignoring line out of frame order", filename, lineno);
+			continue;
+		}
+		result.emplace_back(i);
+	}
+	return result;
+}
+
+static fix sim_bench_axis(const fix frametime, const int percent)
+{
+	return static_cast<fix>(static_cast<int64_t>(frametime) * std::clamp(percent, -100, 100) / 100);
+}
+
+/* FNV-1a, which is enough to tell whether two runs diverged. */
+class sim_bench_hash
+{
+	uint64_t h = 0xcbf29ce484222325ull;
+public:
+	void add(const uint64_t v)
+	{
+		for (unsigned i = 0; i != 8; ++i)
+		{
+			h ^= static_cast<uint8_t>(v >> (8 * i));
+			h *= 0x100000001b3ull;
+		}
+	}
+	void add(const vms_vector &v)
+	{
+		add(static_cast<uint32_t>(v.x));
+		add(static_cast<uint32_t>(v.y));
+		add(static_cast<uint32_t>(v.z));
+	}
+	uint64_t value() const
+	{
+		return h;
+	}
+};
+
+static double sim_bench_ms(const std::chrono::steady_clock::duration d)
+{
+	return std::chrono::duration<double, std::milli>(d).count();
+}
+
+}
+
+}
+
+namespace dsx {
+
+namespace {
+
+static void sim_bench_apply_input(control_info &Controls, const sim_bench_input &i, const fix frametime)
+{
+	Controls = {};
+	Controls.forward_thrust_time = sim_bench_axis(frametime, i.forward);
+	Controls.sideways_thrust_time = sim_bench_axis(frametime, i.sideways);
+	Controls.vertical_thrust_time = sim_bench_axis(frametime, i.vertical);
+	Controls.pitch_time = sim_bench_axis(frametime, i.pitch);
+	Controls.heading_time = sim_bench_axis(frametime, i.heading);
+	Controls.bank_time = sim_bench_axis(frametime, i.bank);
+	Controls.state.fire_primary = i.fire_primary != 0;
+	Controls.state.fire_secondary = i.fire_secondary != 0;
+}
+
+/* Hash the state that the simulation changes: every live object, and
+ * the local player's resources.
+ */
+static uint64_t sim_bench_state_hash()
+{
+	auto &Objects = LevelUniqueObjectState.Objects;
+	auto &vcobjptr = Objects.vcptr;
+	auto &vmobjptr = Objects.vmptr;
+	sim_bench_hash h;
+	h.add(static_cast<uint64_t>(GameTime64));
+	for (auto &obj : vcobjptr)
+	{
+		if (obj.type == OBJ_NONE)
+			continue;
+		h.add(static_cast<uint16_t>(obj.signature));
+		h.add(obj.type);
+		h.add(obj.id);
+		h.add(obj.flags);
+		h.add(static_cast<uint16_t>(obj.segnum));
+		h.add(obj.pos);
+		h.add(obj.orient.rvec);
+		h.add(obj.orient.uvec);
+		h.add(obj.orient.fvec);
+		h.add(static_cast<uint32_t>(obj.shields));
+	}
+	auto &player_info = get_local_plrobj().ctype.player_info;
+	h.add(static_cast<uint32_t>(player_info.energy));
+	h.add(static_cast<uint32_t>(player_info.mission.score));
+	return h.value();
+}
+
+}
+
+void run_sim_bench()
+{
+	const unsigned requested_frames = CGameArg.DbgSimBenchFrames;
+	const int level = CGameArg.DbgSimBenchLevel;
+	if (const auto errstr = CGameArg.DbgSimBenchMission.empty()
+		? load_first_mission()
+		: load_mission_by_name(mission_entry_predicate{CGameArg.DbgSimBenchMission.c_str()
+#if defined(DXX_BUILD_DESCENT_II)
+			, false, {}
+#endif
+			}, mission_name_type::guess))
+	{
+		con_printf(CON_URGENT, "simbench: cannot load mission \"%s\": %s", CGameArg.DbgSimBenchMission.c_str(), errstr);
+		return;
+	}
+	if (!level || level > Current_mission->last_level || level < Current_mission->last_secret_level)
+	{
+		con_printf(CON_URGENT, "simbench: mission has no level %i", level);
+		return;
+	}
+	const auto input = CGameArg.DbgSimBenchInput.empty()
+		? std::vector<sim_bench_input>{}
+		: sim_bench_read_input(CGameArg.DbgSimBenchInput.c_str());
+
+	/* An autosave would write to the player's save directory, and the
+	 * time it takes would count against the simulation.
+	 */
+	const auto saved_autosave_interval = std::exchange(PlayerCfg.SPGameplayOptions.AutosaveInterval, {});
+	StartNewGame(level);
+	if (!Game_wind)
+	{
+		PlayerCfg.SPGameplayOptions.AutosaveInterval = saved_autosave_interval;
+		con_printf(CON_URGENT, "simbench: level %i did not start", level);
+		return;
+	}
+	d_srand(sim_bench_seed);
+
+	/* Step at the rate the game was designed for.  Nothing is rendered,
+	 * so state that rendering feeds back to the game, such as robots
+	 * noticing that they are on screen, differs from a windowed run.
+	 * Hashes are only comparable between -simbench runs.
+	 */
+	constexpr fix frametime = DESIGNATED_GAME_FRAMETIME;
+	Sim_bench_phase_time = {};
+	Sim_bench_active = true;
+	Controls = {};
+	auto next_input = input.begin();
+	unsigned frame = 0;
+	const auto start = std::chrono::steady_clock::now();
+	for (; frame != requested_frames; ++frame)
+	{
+		/* Stop if anything, such as a death or the end of the level,
+		 * puts another window in front of the game.
+		 */
+		if (!Game_wind || window_get_front() != Game_wind)
+			break;
+		for (; next_input != input.end() && next_input->frame <= frame; ++next_input)
+			sim_bench_apply_input(Controls, *next_input, frametime);
+		FrameTime = frametime;
+		advance_game_time();
+		if (GameProcessFrame(LevelSharedRobotInfoState) == window_event_result::close)
+		{
+			++ frame;
+			break;
+		}
+	}
+	const auto elapsed = std::chrono::steady_clock::now() - start;
+	Sim_bench_active = false;
+	PlayerCfg.SPGameplayOptions.AutosaveInterval = saved_autosave_interval;
+
+	const auto per_frame = [frame](const std::chrono::steady_clock::duration d) {
+		return frame ? sim_bench_ms(d) / frame : 0.0;
+	};
+	con_printf(CON_NORMAL, "simbench: %u of %u frames of level %i, %.3f ms total, %.4f ms/frame", frame, requested_frames, level, sim_bench_ms(elapsed), per_frame(elapsed));
+	static constexpr const char *phase_names[sim_bench_phase_count]{
+		"ai",
+		"object movement",
+		"physics",
+		"collisions",
+	};
+	for (std::size_t i = 0; i != sim_bench_phase_count; ++i)
+		con_printf(CON_NORMAL, "simbench: %-16s %10.3f ms total, %.4f ms/frame", phase_names[i], sim_bench_ms(Sim_bench_phase_time[i]), per_frame(Sim_bench_phase_time[i]));
+	if (Game_wind)
+	{
+		con_printf(CON_NORMAL, "simbench: state hash %016" PRIx64, sim_bench_state_hash());
+		window_close(Game_wind);
+	}
+	else
+		con_puts(CON_NORMAL, "simbench: game ended before the last frame; no state hash");
+}
+
+}
@@ -2204,6 +2204,7 @@ int state_restore_all_sub(const d_level_shared_destructible_light_state &LevelSh
 			cloaking_wall_read(w, fp);
 	}
 #endif
+	flush_fcd_cache();
 
 	//Restore trigger info
 	{
@@ -2467,7 +2468,7 @@ int state_restore_all_sub(const d_level_shared_destructible_light_state &LevelSh
 				obj->ctype.player_info = pl_info;
 				obj->shields = rpd.shields;
 				restore_objects[i] = *obj;
-				obj->type = OBJ_GHOST;
+				set_object_type(*obj, OBJ_GHOST);
 				multi_reset_player_object(obj);
 			}
 		}
@@ -2497,7 +2498,7 @@ int state_restore_all_sub(const d_level_shared_destructible_light_state &LevelSh
 					obj->rtype.pobj_info = restore_objects[j].rtype.pobj_info;
 					// make this restored player object an actual player again
 					assert(obj->type == OBJ_GHOST);
-					obj->type = OBJ_PLAYER;
+					set_object_type(*obj, OBJ_PLAYER);
 					set_player_id(obj, i); // assign player object id to player number
 					multi_reset_player_object(obj);
 					update_object_seg(vmobjptr, LevelSharedSegmentState, LevelUniqueSegmentState, obj);
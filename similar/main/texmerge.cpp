@@ -24,6 +24,10 @@ COPYRIGHT 1993-1999 PARALLAX SOFTWARE CORPORATION.  ALL RIGHTS RESERVED.
  */
 
 
+#include <algorithm>
+#include <cstring>
+#include <unordered_map>
+#include <vector>
 #include "gr.h"
 #include "dxxerror.h"
 #include "fmtcheck.h"
@@ -33,41 +37,59 @@ COPYRIGHT 1993-1999 PARALLAX SOFTWARE CORPORATION.  ALL RIGHTS RESERVED.
 #include "piggy.h"
 #include "segment.h"
 #include "texmerge.h"
+#include "texmerge_row.h"
 #include "piggy.h"
+#include "effects.h"
+#include "wall.h"
+#include "console.h"
+#include "cmd.h"
+#include "game.h"
+#include "d_levelstate.h"
 
 #include "compiler-range_for.h"
 #include "d_range.h"
 #include "d_underlying_value.h"
+#include "d_zip.h"
 #include "partial_range.h"
 
 #if DXX_USE_OGL
 #include "ogl_init.h"
+#else
+#include "texmap.h"
 #endif
-#define MAX_NUM_CACHE_BITMAPS 10
+/* The cache always has room for this many bitmaps, and
+ * texmerge_prepare_level raises the limit to the number of merged
+ * bitmaps the level can show, up to MAX_NUM_CACHE_BITMAPS.
+ */
+#define MIN_NUM_CACHE_BITMAPS 10
+#define MAX_NUM_CACHE_BITMAPS 1024
 
-//static grs_bitmap * cache_bitmaps[MAX_NUM_CACHE_BITMAPS];                     
+static_assert(TRANSPARENCY_COLOR == 255, "texmerge_row assumes TRANSPARENCY_COLOR is 255");
 
 namespace {
 
+/* Merged bitmaps are identified by the bitmaps they were merged from,
+ * not by tmap_num and tmap_num2, since animated textures change which
+ * bitmap a texture shows.
+ */
+using texmerge_key = uint64_t;
+
+static texmerge_key build_texmerge_key(const bitmap_index bottom, const bitmap_index top, const texture2_rotation_high orient)
+{
+	return (texmerge_key{underlying_value(bottom)} << 32) | (texmerge_key{underlying_value(top)} << 16) | underlying_value(get_texture_rotation_low(orient));
+}
+
 struct TEXTURE_CACHE {
 	grs_bitmap_ptr bitmap;
-	grs_bitmap * bottom_bmp;
-	grs_bitmap * top_bmp;
-	texture2_rotation_high orient;
+	texmerge_key key;
 	fix64		last_time_used;
 };
 
-/* Helper classes merge_texture_0 through merge_texture_3 correspond to
- * the four values of `orient` used by texmerge_get_cached_bitmap.
+/* Helper classes merge_texture_1 through merge_texture_3 correspond to
+ * the rotated values of `orient` used by texmerge_get_cached_bitmap.
+ * texture2_rotation_high::Normal needs no rotation, so the top bitmap
+ * is merged in place.
  */
-struct merge_texture_0
-{
-	static size_t get_top_data_index(const unsigned wh, const unsigned y, const unsigned x)
-	{
-		return wh * y + x;
-	}
-};
-
 struct merge_texture_1
 {
 	static size_t get_top_data_index(const unsigned wh, const unsigned y, const unsigned x)
@@ -92,153 +114,75 @@ struct merge_texture_3
 	}
 };
 
-/* For supertransparent colors, remap 254.
- * For regular transparent colors, do nothing.
- *
- * In both cases, the caller remaps TRANSPARENCY_COLOR to the bottom
- * bitmap.
+/* Copy the top bitmap into `dest_data` in the orientation that
+ * `get_index` describes.  The blend is then one texmerge_row call over
+ * the whole bitmap, whatever the orientation.
  */
-struct merge_transform_super_xparent
-{
-	static uint8_t transform_color(uint8_t c)
-	{
-		return c == 254 ? TRANSPARENCY_COLOR : c;
-	}
-};
-
-struct merge_transform_new
-{
-	static uint8_t transform_color(uint8_t c)
-	{
-		return c;
-	}
-};
-
-/* Run the transform for one texture merge case.  Different values of
- * `orient` in texmerge_get_cached_bitmap lead to different types for
- * `get_index`.
- */
-template <typename texture_transform, typename get_index>
-static void merge_textures_case(const unsigned wh, const uint8_t *const top_data, const uint8_t *const bottom_data, uint8_t *dest_data)
+template <typename get_index>
+static void rotate_texture(const unsigned wh, const uint8_t *const top_data, uint8_t *dest_data)
 {
 	const auto &&whr = xrange(wh);
 	for (const auto y : whr)
 		for (const auto x : whr)
-		{
-			const auto c = top_data[get_index::get_top_data_index(wh, y, x)];
-			/* All merged textures support TRANSPARENCY_COLOR, so handle
-			 * it here.  Supertransparency is delegated down to
-			 * `texture_transform`, since not all textures want
-			 * supertransparency.
-			 */
-			*dest_data++ = (c == TRANSPARENCY_COLOR)
-				? bottom_data[wh * y + x]
-				: texture_transform::transform_color(c);
-		}
+			*dest_data++ = top_data[get_index::get_top_data_index(wh, y, x)];
 }
 
-/* Dispatch a texture transformation based on the value of `orient`.
- * The loops are duplicated in each case so that `orient` is not reread
- * for each byte processed.
+/* Scratch space for a rotated top bitmap, kept so that a miss does not
+ * allocate.
  */
-template <typename texture_transform>
-static void merge_textures(const texture2_rotation_high orient, const grs_bitmap &expanded_bottom_bmp, const grs_bitmap &expanded_top_bmp, uint8_t *const dest_data)
-{
-	const auto &top_data = expanded_top_bmp.bm_data;
-	const auto &bottom_data = expanded_bottom_bmp.bm_data;
-	const auto wh = expanded_bottom_bmp.bm_w;
-	switch (orient)
-	{
-		case texture2_rotation_high::Normal:
-			merge_textures_case<texture_transform, merge_texture_0>(wh, top_data, bottom_data, dest_data);
-			break;
-		case texture2_rotation_high::_1:
-			merge_textures_case<texture_transform, merge_texture_1>(wh, top_data, bottom_data, dest_data);
-			break;
-		case texture2_rotation_high::_2:
-			merge_textures_case<texture_transform, merge_texture_2>(wh, top_data, bottom_data, dest_data);
-			break;
-		case texture2_rotation_high::_3:
-			merge_textures_case<texture_transform, merge_texture_3>(wh, top_data, bottom_data, dest_data);
-			break;
-	}
-}
+static std::vector<uint8_t> rotated_top;
 
-static std::array<TEXTURE_CACHE, MAX_NUM_CACHE_BITMAPS> Cache;
-
-static int cache_hits = 0;
-static int cache_misses = 0;
-
-}
-
-//----------------------------------------------------------------------
-
-int texmerge_init()
+/* All merged textures support TRANSPARENCY_COLOR.  Supertransparency
+ * is only applied when the top bitmap asks for it.
+ */
+static void merge_textures(const texture2_rotation_high orient, const grs_bitmap &expanded_bottom_bmp, const grs_bitmap &expanded_top_bmp, uint8_t *const dest_data, const bool super_transparent)
 {
-	range_for (auto &i, Cache)
+	const uint8_t *top_data = expanded_top_bmp.bm_data;
+	const auto &bottom_data = expanded_bottom_bmp.bm_data;
+	const unsigned wh = expanded_bottom_bmp.bm_w;
+	const std::size_t size = wh * wh;
+	if (orient != texture2_rotation_high::Normal)
 	{
-		i.bitmap = NULL;
-		i.last_time_used = -1;
-		i.top_bmp = NULL;
-		i.bottom_bmp = NULL;
+		rotated_top.resize(size);
+		switch (orient)
+		{
+			case texture2_rotation_high::Normal:
+				break;
+			case texture2_rotation_high::_1:
+				rotate_texture<merge_texture_1>(wh, top_data, rotated_top.data());
+				break;
+			case texture2_rotation_high::_2:
+				rotate_texture<merge_texture_2>(wh, top_data, rotated_top.data());
+				break;
+			case texture2_rotation_high::_3:
+				rotate_texture<merge_texture_3>(wh, top_data, rotated_top.data());
+				break;
+		}
+		top_data = rotated_top.data();
 	}
-
-	return 1;
+	texmerge_row(dest_data, top_data, bottom_data, size, super_transparent);
 }
 
-void texmerge_flush()
-{
-	range_for (auto &i, Cache)
-	{
-		i.last_time_used = -1;
-		i.top_bmp = NULL;
-		i.bottom_bmp = NULL;
-	}
-}
+/* Cache entries, in no particular order.  Cache_index maps a key to
+ * its position in Cache.  Bitmaps are allocated separately, so
+ * references returned by texmerge_get_cached_bitmap stay valid when
+ * Cache grows, until the entry is evicted.  A flush only marks the
+ * entries unused, since piggy can flush while a merge is in progress.
+ */
+static std::vector<TEXTURE_CACHE> Cache;
+static std::unordered_map<texmerge_key, std::size_t> Cache_index;
+static std::size_t Cache_capacity = MIN_NUM_CACHE_BITMAPS;
 
+static unsigned cache_hits;
+static unsigned cache_misses;
 
-//-------------------------------------------------------------------------
-void texmerge_close()
+static grs_bitmap &texmerge_merge_bitmap(const texmerge_key key, const texture1_value tmap_bottom, const bitmap_index texture_bottom, const texture2_value tmap_top, const bitmap_index texture_top, const texture2_rotation_high orient)
 {
-	range_for (auto &i, Cache)
-	{
-		i.bitmap.reset();
-	}
-}
-
-//--unused-- int info_printed = 0;
+	grs_bitmap *const bitmap_top = &GameBitmaps[texture_top];
+	grs_bitmap *const bitmap_bottom = &GameBitmaps[texture_bottom];
 
-grs_bitmap &texmerge_get_cached_bitmap(const texture1_value tmap_bottom, const texture2_value tmap_top)
-{
-	grs_bitmap *bitmap_top, *bitmap_bottom;
-	int lowest_time_used;
-
-	auto &texture_top = Textures[get_texture_index(tmap_top)];
-	bitmap_top = &GameBitmaps[texture_top];
-	auto &texture_bottom = Textures[get_texture_index(tmap_bottom)];
-	bitmap_bottom = &GameBitmaps[texture_bottom];
-	
-	const auto orient = get_texture_rotation_high(tmap_top);
-
-	lowest_time_used = Cache[0].last_time_used;
-	auto least_recently_used = &Cache.front();
-	range_for (auto &i, Cache)
-	{
-		if ( (i.last_time_used > -1) && (i.top_bmp==bitmap_top) && (i.bottom_bmp==bitmap_bottom) && (i.orient==orient ))	{
-			cache_hits++;
-			i.last_time_used = timer_query();
-			return *i.bitmap.get();
-		}	
-		if ( i.last_time_used < lowest_time_used )	{
-			lowest_time_used = i.last_time_used;
-			least_recently_used = &i;
-		}
-	}
-
-	//---- Page out the LRU bitmap;
-	cache_misses++;
-
-	// Make sure the bitmaps are paged in...
+	// Make sure the bitmaps are paged in...  Paging in may flush the
+	// cache, so do it before choosing an entry.
 
 	PIGGY_PAGE_IN(texture_top);
 	PIGGY_PAGE_IN(texture_bottom);
@@ -247,6 +191,28 @@ grs_bitmap &texmerge_get_cached_bitmap(const texture1_value tmap_bottom, const t
 	if (bitmap_bottom->bm_w != bitmap_top->bm_w || bitmap_bottom->bm_h != bitmap_top->bm_h)
 		Error("Top and Bottom textures have different size!\nbottom tmap = %u; bottom bitmap = %u; bottom width = %u; bottom height = %u\ntop tmap = %hu; top bitmap = %u; top width=%u; top height=%u", underlying_value(tmap_bottom), underlying_value(texture_bottom), bitmap_bottom->bm_w, bitmap_bottom->bm_h, underlying_value(tmap_top), underlying_value(texture_top), bitmap_top->bm_w, bitmap_top->bm_h);
 
+	//---- Page out the LRU bitmap, if the cache is full;
+	TEXTURE_CACHE *least_recently_used;
+	if (Cache.size() < Cache_capacity)
+		least_recently_used = &Cache.emplace_back();
+	else
+	{
+		least_recently_used = &*std::min_element(Cache.begin(), Cache.end(), [](const TEXTURE_CACHE &a, const TEXTURE_CACHE &b) {
+			return a.last_time_used < b.last_time_used;
+		});
+		/* An entry left over from before a flush may share its key with
+		 * a newer entry.
+		 */
+		if (const auto i = Cache_index.find(least_recently_used->key); i != Cache_index.end() && &Cache[i->second] == least_recently_used)
+			Cache_index.erase(i);
+#if !DXX_USE_OGL
+		/* A wall recorded by the binned rasterizer may use the evicted
+		 * bitmap.
+		 */
+		tmap_flush_bin();
+#endif
+	}
+
 	least_recently_used->bitmap = gr_create_bitmap(bitmap_bottom->bm_w,  bitmap_bottom->bm_h);
 #if DXX_USE_OGL
 	ogl_freebmtexture(*least_recently_used->bitmap.get());
@@ -256,22 +222,167 @@ grs_bitmap &texmerge_get_cached_bitmap(const texture1_value tmap_bottom, const t
 	auto &expanded_bottom_bmp = *rle_expand_texture(*bitmap_bottom);
 	if (bitmap_top->get_flag_mask(BM_FLAG_SUPER_TRANSPARENT))
 	{
-		merge_textures<merge_transform_super_xparent>(orient, expanded_bottom_bmp, expanded_top_bmp, least_recently_used->bitmap->get_bitmap_data());
+		merge_textures(orient, expanded_bottom_bmp, expanded_top_bmp, least_recently_used->bitmap->get_bitmap_data(), true);
 		gr_set_bitmap_flags(*least_recently_used->bitmap.get(), BM_FLAG_TRANSPARENT);
 #if !DXX_USE_OGL
 		least_recently_used->bitmap->avg_color = bitmap_top->avg_color;
 #endif
 	} else	{
-		merge_textures<merge_transform_new>(orient, expanded_bottom_bmp, expanded_top_bmp, least_recently_used->bitmap->get_bitmap_data());
+		merge_textures(orient, expanded_bottom_bmp, expanded_top_bmp, least_recently_used->bitmap->get_bitmap_data(), false);
 		least_recently_used->bitmap->set_flags(bitmap_bottom->get_flag_mask(~BM_FLAG_RLE));
 #if !DXX_USE_OGL
 		least_recently_used->bitmap->avg_color = bitmap_bottom->avg_color;
 #endif
 	}
 
-	least_recently_used->top_bmp = bitmap_top;
-	least_recently_used->bottom_bmp = bitmap_bottom;
+	least_recently_used->key = key;
 	least_recently_used->last_time_used = timer_query();
-	least_recently_used->orient = orient;
+	Cache_index.insert_or_assign(key, least_recently_used - Cache.data());
 	return *least_recently_used->bitmap.get();
 }
+
+static void texmerge_cmd_cache(unsigned long argc, const char *const *const argv)
+{
+	con_printf(CON_NORMAL, "texmerge_cache: %zu of %zu bitmaps: %u hits, %u misses", Cache.size(), Cache_capacity, cache_hits, cache_misses);
+	if (argc > 1 && !strcmp(argv[1], "reset"))
+		cache_hits = cache_misses = 0;
+}
+
+}
+
+//----------------------------------------------------------------------
+
+int texmerge_init()
+{
+	Cache_capacity = MIN_NUM_CACHE_BITMAPS;
+	Cache.reserve(Cache_capacity);
+	return 1;
+}
+
+void init_texmerge_commands()
+{
+	cmd_addcommand("texmerge_cache", texmerge_cmd_cache, "texmerge_cache [reset]\n" "    show merged texture cache counters, and optionally reset them");
+}
+
+void texmerge_flush()
+{
+	Cache_index.clear();
+	for (auto &i : Cache)
+		i.last_time_used = -1;
+}
+
+
+//-------------------------------------------------------------------------
+void texmerge_close()
+{
+	Cache_index.clear();
+	Cache.clear();
+	rotated_top = {};
+}
+
+namespace dsx {
+
+/* Size the cache for every merged bitmap the level can show, and merge
+ * them now, so that the first view of a wall does not stall.  Sides are
+ * scanned for their tmap_num/tmap_num2 pairs, including the frames that
+ * doors switch to, and each texture is expanded to every frame of its
+ * wall effect.  Effects that only start later, such as the frames shown
+ * while the reactor is critical, are merged when first used.
+ */
+void texmerge_prepare_level()
+{
+	texmerge_flush();
+	auto &Effects = LevelUniqueEffectsClipState.Effects;
+	auto &WallAnims = GameSharedState.WallAnims;
+	auto &Walls = LevelUniqueWallSubsystemState.Walls;
+	auto &vcwallptr = Walls.vcptr;
+	struct side_pair
+	{
+		texture1_value bottom;
+		texture2_value top;
+		constexpr bool operator==(const side_pair &) const = default;
+		constexpr auto operator<=>(const side_pair &) const = default;
+	};
+	std::vector<side_pair> pairs;
+	for (const cscusegment segp : vcsegptr)
+		for (const auto &&[sside, uside] : zip(segp.s.sides, segp.u.sides))
+		{
+			if (uside.tmap_num2 != texture2_value::None)
+				pairs.push_back({uside.tmap_num, uside.tmap_num2});
+			if (sside.wall_num == wall_none)
+				continue;
+			const auto clip_num = vcwallptr(sside.wall_num)->clip_num;
+			if (clip_num < 0)
+				continue;
+			const auto &anim = WallAnims[clip_num];
+			for (const auto frame : partial_const_range(anim.frames, anim.num_frames))
+			{
+				if (!(anim.flags & WCF_TMAP1))
+					pairs.push_back({uside.tmap_num, texture2_value{frame}});
+				else if (uside.tmap_num2 != texture2_value::None)
+					pairs.push_back({texture1_value{frame}, uside.tmap_num2});
+			}
+		}
+	std::sort(pairs.begin(), pairs.end());
+	pairs.erase(std::unique(pairs.begin(), pairs.end()), pairs.end());
+
+	/* Call `f` with each bitmap that texture `t` can show. */
+	const auto for_each_bitmap = [&Effects](const texture_index t, auto &&f) {
+		for (auto &ec : partial_const_range(Effects, Num_effects))
+			if (ec.changing_wall_texture == t)
+			{
+				for (const auto b : partial_const_range(ec.vc.frames, ec.vc.num_frames))
+					f(b);
+				return;
+			}
+		f(Textures[t]);
+	};
+	struct merge_request
+	{
+		texmerge_key key;
+		side_pair tmaps;
+		bitmap_index bottom, top;
+	};
+	std::vector<merge_request> requests;
+	for (const auto &p : pairs)
+	{
+		const auto orient = get_texture_rotation_high(p.top);
+		for_each_bitmap(get_texture_index(p.bottom), [&](const bitmap_index bottom) {
+			for_each_bitmap(get_texture_index(p.top), [&](const bitmap_index top) {
+				requests.push_back({build_texmerge_key(bottom, top, orient), p, bottom, top});
+			});
+		});
+	}
+	std::sort(requests.begin(), requests.end(), [](const merge_request &a, const merge_request &b) { return a.key < b.key; });
+	requests.erase(std::unique(requests.begin(), requests.end(), [](const merge_request &a, const merge_request &b) { return a.key == b.key; }), requests.end());
+
+	Cache_capacity = std::clamp<std::size_t>(requests.size(), MIN_NUM_CACHE_BITMAPS, MAX_NUM_CACHE_BITMAPS);
+	// Release the entries of a bigger previous level.  They were flushed above, so nothing refers to them.
+	if (Cache.size() > Cache_capacity)
+		Cache.resize(Cache_capacity);
+	Cache.reserve(Cache_capacity);
+	Cache_index.reserve(Cache_capacity);
+	for (const auto &r : partial_const_range(requests, std::min(requests.size(), Cache_capacity)))
+		texmerge_merge_bitmap(r.key, r.tmaps.bottom, r.bottom, r.tmaps.top, r.top, get_texture_rotation_high(r.tmaps.top));
+	con_printf(CON_VERBOSE, "texmerge: %zu merged bitmaps in level, %zu cached", requests.size(), Cache.size());
+}
+
+}
+
+grs_bitmap &texmerge_get_cached_bitmap(const texture1_value tmap_bottom, const texture2_value tmap_top)
+{
+	const auto texture_top = Textures[get_texture_index(tmap_top)];
+	const auto texture_bottom = Textures[get_texture_index(tmap_bottom)];
+	const auto orient = get_texture_rotation_high(tmap_top);
+	const auto key = build_texmerge_key(texture_bottom, texture_top, orient);
+
+	if (const auto i = Cache_index.find(key); i != Cache_index.end())
+	{
+		auto &e = Cache[i->second];
+		cache_hits++;
+		e.last_time_used = timer_query();
+		return *e.bitmap.get();
+	}
+	cache_misses++;
+	return texmerge_merge_bitmap(key, tmap_bottom, texture_bottom, tmap_top, texture_top, orient);
+}
@@ -268,6 +268,7 @@ void wall_set_tmap_num(const wclip &anim, const vmsegptridx_t seg, const sidenum
 			uside.tmap_num = cuside.tmap_num = t1;
 			if (newdemo_state == ND_STATE_RECORDING)
 				newdemo_record_wall_set_tmap_num1(seg,side,csegp,cside,t1);
+			flush_fcd_cache();
 		}
 	} else	{
 		const texture2_value t2{tmap};
@@ -276,6 +277,7 @@ void wall_set_tmap_num(const wclip &anim, const vmsegptridx_t seg, const sidenum
 			uside.tmap_num2 = cuside.tmap_num2 = t2;
 			if (newdemo_state == ND_STATE_RECORDING)
 				newdemo_record_wall_set_tmap_num2(seg,side,csegp,cside,t2);
+			flush_fcd_cache();
 		}
 	}
 }
@@ -1026,6 +1028,7 @@ static bool do_door_close(active_door &d)
 
 	if (remove)
 		wall_close_door_ref(Segments.vmptridx, Walls, WallAnims, d);
+	flush_fcd_cache();
 	return remove;
 }
 
@@ -1054,6 +1057,7 @@ static void wall_illusion_op(fvmwallptr &vmwallptr, const vcsegptridx_t seg, con
 	{
 		op(*r.first);
 		op(*r.second);
+		flush_fcd_cache();
 	}
 }
 
@@ -1386,6 +1390,8 @@ bool cw_removal_predicate::operator()(cloaking_wall &d)
 	}
 	if (!r.remove)
 		++ num_cloaking_walls;
+	else
+		flush_fcd_cache();
 	return r.remove;
 }
 
@@ -1550,8 +1550,7 @@ imobjptridx_t spit_powerup(d_level_unique_object_state &LevelUniqueObjectState,
 
 void DropCurrentWeapon (player_info &player_info)
 {
-	auto &Objects = LevelUniqueObjectState.Objects;
-	if (LevelUniqueObjectState.num_objects >= Objects.size())
+	if (LevelUniqueObjectState.num_objects >= LevelUniqueObjectState.Object_limit)
 		return;
 
 	powerup_type_t drop_type;
@@ -1655,11 +1654,10 @@ void DropCurrentWeapon (player_info &player_info)
 
 void DropSecondaryWeapon (player_info &player_info)
 {
-	auto &Objects = LevelUniqueObjectState.Objects;
 	int seed;
 	ushort sub_ammo=0;
 
-	if (LevelUniqueObjectState.num_objects >= Objects.size())
+	if (LevelUniqueObjectState.num_objects >= LevelUniqueObjectState.Object_limit)
 		return;
 
 	auto &Secondary_weapon = player_info.Secondary_weapon;
@@ -146,6 +146,8 @@ static void arg_port_number(Arglist::iterator &pp, Arglist::const_iterator end,
 static void InitGameArg()
 {
 	CGameArg.SysMaxFPS = MAXIMUM_FPS;
+	CGameArg.SysMaxObjects = DEFAULT_MAX_OBJECTS;
+	CGameArg.SndOutputRate = 44100;
 	CGameArg.SysRenderZoomAdjustment = 0;
 #if DXX_USE_UDP
 	CGameArg.MplUdpHostAddr = UDP_MANUAL_ADDR_DEFAULT;
@@ -156,6 +158,7 @@ static void InitGameArg()
 #endif
 	CGameArg.DbgVerbose = CON_NORMAL;
 	CGameArg.DbgBpp = 32;
+	CGameArg.DbgSimBenchLevel = 1;
 #if DXX_USE_OGL
 	CGameArg.OglSyncMethod = OGL_SYNC_METHOD_DEFAULT;
 	CGameArg.OglSyncWait = OGL_SYNC_WAIT_DEFAULT;
@@ -209,6 +212,10 @@ static void ReadCmdArgs(Inilist &ini, Arglist &&Args)
 			CGameArg.SysNoNiceFPS = true;
 		else if (!d_stricmp(p, "-maxfps"))
 			CGameArg.SysMaxFPS = arg_integer(pp, end);
+		else if (!d_stricmp(p, "-threads"))
+			CGameArg.SysThreads = arg_integer(pp, end);
+		else if (!d_stricmp(p, "-maxobjects"))
+			CGameArg.SysMaxObjects = arg_integer(pp, end);
 		else if (!d_stricmp(p, "-render-zoom"))
 			CGameArg.SysRenderZoomAdjustment = arg_integer(pp, end);
 		else if (!d_stricmp(p, "-hogdir"))
@@ -274,6 +281,8 @@ static void ReadCmdArgs(Inilist &ini, Arglist &&Args)
 		else if (!d_stricmp(p, "-sound11k"))
 			GameArg.SndDigiSampleRate = sound_sample_rate::_11k;
 #endif
+		else if (!d_stricmp(p, "-sndrate"))
+			CGameArg.SndOutputRate = arg_integer(pp, end);
 		else if (!d_stricmp(p, "-nosdlmixer"))
 		{
 #if DXX_USE_SDLMIXER
@@ -398,6 +407,14 @@ static void ReadCmdArgs(Inilist &ini, Arglist &&Args)
 			CGameArg.DbgSafelog = true;
 		else if (!d_stricmp(p, "-norun"))
 			CGameArg.DbgNoRun = true;
+		else if (!d_stricmp(p, "-simbench"))
+			CGameArg.DbgSimBenchFrames = arg_integer(pp, end);
+		else if (!d_stricmp(p, "-simbench-level"))
+			CGameArg.DbgSimBenchLevel = arg_integer(pp, end);
+		else if (!d_stricmp(p, "-simbench-mission"))
+			CGameArg.DbgSimBenchMission = arg_string(pp, end);
+		else if (!d_stricmp(p, "-simbench-input"))
+			CGameArg.DbgSimBenchInput = arg_string(pp, end);
 		else if (!d_stricmp(p, "-renderstats"))
 			CGameArg.DbgRenderStats = true;
 		else if (!d_stricmp(p, "-text"))
@@ -464,6 +481,10 @@ static void PostProcessGameArg()
 		CGameArg.SysMaxFPS = MINIMUM_FPS;
 	else if (CGameArg.SysMaxFPS > MAXIMUM_FPS)
 		CGameArg.SysMaxFPS = MAXIMUM_FPS;
+	if (CGameArg.SysMaxObjects < DEFAULT_MAX_OBJECTS)
+		CGameArg.SysMaxObjects = DEFAULT_MAX_OBJECTS;
+	else if (CGameArg.SysMaxObjects > MAX_OBJECTS)
+		CGameArg.SysMaxObjects = MAX_OBJECTS;
 #if PHYSFS_VER_MAJOR >= 2
 	if (!CGameArg.SysMissionDir.empty())
 		PHYSFS_mount(CGameArg.SysMissionDir.c_str(), MISSION_DIR, 1);